@@ -0,0 +1,517 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    SarApiTest.cpp
+
+Abstract:
+
+    Checks the C interface (SarApi.h) against a SarSessionMock session, through the exported
+    functions of libsarapi only: opening and closing a session, Wi-Fi and LTE gets and sets,
+    coalesced sets, reading and writing configuration through the mock firmware, a container
+    and a folder, and the ...WifiSarAll calls' buffer rules.  Run by ctest; prints each check and returns non-zero
+    if any failed.
+
+    Usage: sarapitest
+
+Environment:
+
+    User Mode
+
+--*/
+
+#include "SarApi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Pairs sent by the Wi-Fi checks; more than SAR_API_MAX_INTERFACE_CONFIG_SETS, so the
+// ...WifiSarAll reads cut them short.
+//
+static const UINT32 SAR_API_TEST_CONFIG_SETS = SAR_API_MAX_INTERFACE_CONFIG_SETS + 4;
+
+static
+HRESULT
+SarApiTestFail(
+    _In_z_ LPCSTR check,
+    HRESULT hr
+    )
+/*++
+
+Routine Description:
+
+    Reports a failed check.
+
+Arguments:
+
+    check - What was checked.
+    hr - The result the check saw.
+
+Return Value:
+
+    E_UNEXPECTED
+
+--*/
+{
+    printf("    FAILED: %s (hr = 0x%08x)\n", check, (UINT32)hr);
+    return E_UNEXPECTED;
+}
+
+static
+VOID
+SarApiTestExampleConfig(
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Fills in a configuration whose every struct differs from zero, so a struct lost on the way
+    through a store is noticed.
+
+Arguments:
+
+    blobs - Receives the configuration.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    memset(blobs, 0, sizeof(*blobs));
+
+    blobs->Header.Size = sizeof(SAR_CONFIG_HEADER) + 2 * sizeof(SAR_CONFIG_VALUES);
+    blobs->Header.HeaderOffset1 = sizeof(SAR_CONFIG_HEADER);
+    blobs->Header.HeaderOffset2 = sizeof(SAR_CONFIG_HEADER) + sizeof(SAR_CONFIG_VALUES);
+    blobs->Header.ProductID = 0x4;
+    blobs->Header.Version = 0x5;
+    blobs->Header.Revision = 0x6;
+    blobs->Header.NumberSARTables = 0x7;
+
+    blobs->Values.Size = sizeof(SAR_CONFIG_VALUES);
+    blobs->Values.SARSafetyTimer = 0xabcdef01;
+    blobs->Values.SARUnsolicitedUpdateTimer = 1000;
+    blobs->Values.SARState = 0x55;
+
+    blobs->Region.GeoCountryString.AsciiChars = 0x5048; // "PH"
+    blobs->Region.GeoLocationValue = 0x11111111;
+
+    for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+    {
+        for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+        {
+            blobs->PowerTable.PowerValues[row][col] = (UINT8)(1 + col + row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE);
+        }
+    }
+}
+
+static
+HRESULT
+SarApiTestWifi(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Sets the mock driver's Wi-Fi SAR state and reads it back, whole and into too small a buffer,
+    and checks the driver's interface version.
+
+Arguments:
+
+    session - A mock session.
+
+Return Value:
+
+    S_OK if every check passed, otherwise E_UNEXPECTED.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[SAR_API_TEST_CONFIG_SETS];
+    WDI_SAR_CONFIG_SET readSets[SAR_API_TEST_CONFIG_SETS];
+    WDI_SAR_STATE state;
+    WDI_SAR_RESULT result = (WDI_SAR_RESULT)-1;
+    UINT32 major = 0;
+    UINT32 minor = 0;
+
+    for (UINT32 i = 0; i < SAR_API_TEST_CONFIG_SETS; i++)
+    {
+        configSets[i].WDI_SARAntennaIndex = i;
+        configSets[i].WDI_SARBackOffIndex = i % 4;
+    }
+
+    hr = SarSessionSetWifiSar(session, WDI_SARBACKOFF_ENABLED, 3, configSets, SAR_API_TEST_CONFIG_SETS, &result);
+    if ((hr != S_OK) || (result != WDI_SAR_SUCCESS))
+    {
+        return SarApiTestFail("SarSessionSetWifiSar", hr);
+    }
+
+    memset(readSets, 0, sizeof(readSets));
+    hr = SarSessionGetWifiSar(session, &state, readSets, SAR_API_TEST_CONFIG_SETS);
+    if ((hr != S_OK) ||
+        (state.SarBackoffStatus != WDI_SARBACKOFF_ENABLED) ||
+        (state.MIMOConfigType != 3) ||
+        (state.NumWdiSarConfigElements != SAR_API_TEST_CONFIG_SETS) ||
+        (0 != memcmp(readSets, configSets, sizeof(configSets))))
+    {
+        return SarApiTestFail("SarSessionGetWifiSar returns the pairs set", hr);
+    }
+
+    hr = SarSessionGetWifiSar(session, &state, readSets, 2);
+    if ((hr != E_NOT_SUFFICIENT_BUFFER) || (state.NumWdiSarConfigElements != SAR_API_TEST_CONFIG_SETS))
+    {
+        return SarApiTestFail("SarSessionGetWifiSar into 2 pairs", hr);
+    }
+
+    hr = SarSessionGetInterfaceVersion(session, &major, &minor);
+    if ((hr != S_OK) || (major != (UINT32)WDI_SAR_INTERFACE_VERSION_MAJOR))
+    {
+        return SarApiTestFail("SarSessionGetInterfaceVersion", hr);
+    }
+
+    return S_OK;
+}
+
+static
+HRESULT
+SarApiTestWifiAll(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Sends a set to every mock WLAN interface and reads them all back: into an array of
+    interfaces that is too small, which fails, and into one that holds them all, where each
+    interface's pairs are cut short without failing the call.
+
+Arguments:
+
+    session - A mock session.
+
+Return Value:
+
+    S_OK if every check passed, otherwise E_UNEXPECTED.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[SAR_API_TEST_CONFIG_SETS];
+    SAR_WIFI_INTERFACE_SAR interfaces[4];
+    UINT32 count = 0;
+
+    for (UINT32 i = 0; i < SAR_API_TEST_CONFIG_SETS; i++)
+    {
+        configSets[i].WDI_SARAntennaIndex = i;
+        configSets[i].WDI_SARBackOffIndex = 1;
+    }
+
+    hr = SarSessionSetWifiSarAll(session, WDI_SARBACKOFF_ENABLED, 1, configSets, SAR_API_TEST_CONFIG_SETS, interfaces, ARRAYSIZE(interfaces), &count);
+    if ((hr != S_OK) || (count < 2))
+    {
+        return SarApiTestFail("SarSessionSetWifiSarAll", hr);
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if ((interfaces[i].Status != S_OK) || (interfaces[i].Result != WDI_SAR_SUCCESS))
+        {
+            return SarApiTestFail("SarSessionSetWifiSarAll sets every interface", interfaces[i].Status);
+        }
+    }
+
+    hr = SarSessionGetWifiSarAll(session, interfaces, 1, &count);
+    if ((hr != E_NOT_SUFFICIENT_BUFFER) || (count < 2))
+    {
+        return SarApiTestFail("SarSessionGetWifiSarAll into 1 interface", hr);
+    }
+
+    hr = SarSessionGetWifiSarAll(session, interfaces, ARRAYSIZE(interfaces), &count);
+    if ((hr != S_OK) || (count < 2) || (count > ARRAYSIZE(interfaces)))
+    {
+        return SarApiTestFail("SarSessionGetWifiSarAll", hr);
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if ((interfaces[i].Status != S_FALSE) ||
+            (interfaces[i].State.NumWdiSarConfigElements != SAR_API_TEST_CONFIG_SETS) ||
+            (0 != memcmp(interfaces[i].ConfigSets, configSets, sizeof(interfaces[i].ConfigSets))))
+        {
+            return SarApiTestFail("SarSessionGetWifiSarAll cuts each interface's pairs short", interfaces[i].Status);
+        }
+    }
+
+    return S_OK;
+}
+
+static
+HRESULT
+SarApiTestLte(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Sets the mock modem's antennas and reads them back.
+
+Arguments:
+
+    session - A mock session.
+
+Return Value:
+
+    S_OK if every check passed, otherwise E_UNEXPECTED.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_LTE_ANTENNA antennas[2] = { { 0, 3 }, { 1, 5 } };
+    SAR_LTE_ANTENNA readAntennas[2];
+    BOOL backoffEnabled = FALSE;
+    UINT32 count = 0;
+
+    hr = SarSessionSetLteSar(session, antennas, ARRAYSIZE(antennas));
+    if (hr != S_OK)
+    {
+        return SarApiTestFail("SarSessionSetLteSar", hr);
+    }
+
+    hr = SarSessionGetLteSar(session, &backoffEnabled, readAntennas, ARRAYSIZE(readAntennas), &count);
+    if ((hr != S_OK) || !backoffEnabled || (count != ARRAYSIZE(antennas)) ||
+        (0 != memcmp(readAntennas, antennas, sizeof(antennas))))
+    {
+        return SarApiTestFail("SarSessionGetLteSar returns the antennas set", hr);
+    }
+
+    hr = SarSessionGetLteSar(session, &backoffEnabled, readAntennas, 1, &count);
+    if ((hr != E_NOT_SUFFICIENT_BUFFER) || (count != ARRAYSIZE(antennas)))
+    {
+        return SarApiTestFail("SarSessionGetLteSar into 1 antenna", hr);
+    }
+
+    return S_OK;
+}
+
+static
+HRESULT
+SarApiTestCoalescing(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Checks the coalescing window's limit, and that a queued Wi-Fi set is sent by the read after
+    it and counted.
+
+Arguments:
+
+    session - A mock session.
+
+Return Value:
+
+    S_OK if every check passed, otherwise E_UNEXPECTED.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[2] = { { 0, 2 }, { 1, 3 } };
+    WDI_SAR_CONFIG_SET readSets[2];
+    WDI_SAR_STATE state;
+    WDI_SAR_RESULT result = (WDI_SAR_RESULT)-1;
+    SAR_COALESCING_STATS wifiStats;
+
+    hr = SarSessionSetCoalescing(session, 60001);
+    if (hr != E_INVALIDARG)
+    {
+        return SarApiTestFail("SarSessionSetCoalescing of more than a minute", hr);
+    }
+
+    hr = SarSessionSetCoalescing(session, 60000);
+    if (hr != S_OK)
+    {
+        return SarApiTestFail("SarSessionSetCoalescing", hr);
+    }
+
+    hr = SarSessionSetWifiSar(session, WDI_SARBACKOFF_ENABLED, 1, configSets, ARRAYSIZE(configSets), &result);
+    if ((hr != S_OK) || (result != WDI_SAR_SUCCESS))
+    {
+        return SarApiTestFail("SarSessionSetWifiSar queued", hr);
+    }
+
+    memset(readSets, 0, sizeof(readSets));
+    hr = SarSessionGetWifiSar(session, &state, readSets, ARRAYSIZE(readSets));
+    if ((hr != S_OK) ||
+        (state.NumWdiSarConfigElements != ARRAYSIZE(configSets)) ||
+        (0 != memcmp(readSets, configSets, sizeof(configSets))))
+    {
+        return SarApiTestFail("SarSessionGetWifiSar sends the queued set", hr);
+    }
+
+    hr = SarSessionGetCoalescingStats(session, &wifiStats, nullptr);
+    if ((hr != S_OK) || (wifiStats.Requests != 1) || (wifiStats.DriverCalls != 1) || (wifiStats.Failed != 0))
+    {
+        return SarApiTestFail("SarSessionGetCoalescingStats", hr);
+    }
+
+    hr = SarSessionFlush(session);
+    if (hr != S_OK)
+    {
+        return SarApiTestFail("SarSessionFlush", hr);
+    }
+
+    hr = SarSessionSetCoalescing(session, 0);
+    if (hr != S_OK)
+    {
+        return SarApiTestFail("SarSessionSetCoalescing of 0", hr);
+    }
+
+    return S_OK;
+}
+
+static
+HRESULT
+SarApiTestConfig(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR root
+    )
+/*++
+
+Routine Description:
+
+    Writes a configuration to the mock firmware, a container and a folder, compressed and not,
+    and checks that each reads back unchanged; and that a missing configuration fails to read.
+
+Arguments:
+
+    session - A mock session.
+    root - A scratch directory.
+
+Return Value:
+
+    S_OK if every check passed, otherwise E_UNEXPECTED.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS written;
+    SAR_CONFIG_BLOBS read;
+    std::string container = std::string(root) + "/config.sarc";
+    std::string folder = std::string(root) + "/config";
+    const std::string paths[] = { "UEFI", container, folder };
+
+    SarApiTestExampleConfig(&written);
+    fs::create_directory(folder);
+
+    for (const std::string& path : paths)
+    {
+        for (UINT32 flags : { 0u, (UINT32)SAR_WRITE_CONFIG_COMPRESS })
+        {
+            std::string check = "SarSessionWriteConfig and SarSessionReadConfig of " + path;
+
+            hr = SarSessionWriteConfig(session, path.c_str(), &written, flags);
+            if (hr != S_OK)
+            {
+                return SarApiTestFail(check.c_str(), hr);
+            }
+
+            memset(&read, 0xcc, sizeof(read));
+            hr = SarSessionReadConfig(session, path.c_str(), &read);
+
+            // A compressed write says so in the header; the table itself reads back unchanged.
+            read.Header.SARTablesCompressed = written.Header.SARTablesCompressed;
+            if ((hr != S_OK) || (0 != memcmp(&read, &written, sizeof(read))))
+            {
+                return SarApiTestFail(check.c_str(), hr);
+            }
+        }
+    }
+
+    hr = SarSessionReadConfig(session, (std::string(root) + "/missing.sarc").c_str(), &read);
+    if (SUCCEEDED(hr))
+    {
+        return SarApiTestFail("SarSessionReadConfig of a missing container fails", hr);
+    }
+
+    return S_OK;
+}
+
+int
+_cdecl
+main(
+    VOID
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrCheck;
+    SAR_SESSION* session = nullptr;
+    char root[] = "/tmp/sarapitest-XXXXXX";
+    int failed = 0;
+
+    printf("SarApiVersion %u\n", SarApiVersion());
+
+    hr = SarSessionOpen(SarSessionMock, nullptr, nullptr);
+    if (hr != E_POINTER)
+    {
+        SarApiTestFail("SarSessionOpen without a session pointer", hr);
+        failed++;
+    }
+
+    hr = SarSessionOpen(SarSessionMock, nullptr, &session);
+    if ((hr != S_OK) || (session == nullptr))
+    {
+        SarApiTestFail("SarSessionOpen", hr);
+        return 1;
+    }
+
+    if (mkdtemp(root) == nullptr)
+    {
+        printf("Failed to create a scratch directory\n");
+        SarSessionClose(session);
+        return 1;
+    }
+
+    printf("Wi-Fi get and set\n");
+    hrCheck = SarApiTestWifi(session);
+    failed += FAILED(hrCheck) ? 1 : 0;
+
+    printf("Wi-Fi get and set on every interface\n");
+    hrCheck = SarApiTestWifiAll(session);
+    failed += FAILED(hrCheck) ? 1 : 0;
+
+    printf("LTE get and set\n");
+    hrCheck = SarApiTestLte(session);
+    failed += FAILED(hrCheck) ? 1 : 0;
+
+    printf("Coalesced sets\n");
+    hrCheck = SarApiTestCoalescing(session);
+    failed += FAILED(hrCheck) ? 1 : 0;
+
+    printf("Configuration read and write\n");
+    hrCheck = SarApiTestConfig(session, root);
+    failed += FAILED(hrCheck) ? 1 : 0;
+
+    SarSessionClose(session);
+    SarSessionClose(nullptr);
+
+    std::error_code ec;
+    fs::remove_all(root, ec);
+
+    printf("%s: %d failed\n", (failed == 0) ? "PASSED" : "FAILED", failed);
+    return (failed == 0) ? 0 : 1;
+}
+
+// eof: SarApiTest.cpp
+//
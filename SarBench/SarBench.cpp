@@ -0,0 +1,2246 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name
+
+    SarBench.cpp
+
+Abstract:
+
+    Micro-benchmarks for the portable SarTool libraries.  Reports the encode and decode cost of
+    each WDI SAR struct in nanoseconds per record, next to a raw memcpy of the same struct, the
+    size and cost of the compressed power table format against the raw PowerValues layout, the
+    cost of checking a power table against its regulatory caps with and without SIMD, the cost
+    of a UEFI write+read round-trip of all four provisioning variables through the firmware
+    stores that can run without real firmware, the cost and accuracy of the latency
+    histograms, the callback-side cost of the unsolicited notification pipeline, the cost of
+    writing and decoding the binary event log, and the throughput of Wi-Fi SAR requests
+    through a local SarTool server backed by the mock device service.  Also times the getconfig
+    read paths (fread against memory-mapped, for folders and containers), formatting a power
+    table in each getconfig output format, and building WDI_SET_SAR_STATE requests of 1 to 256
+    pairs, a WDI_SET_SAR_STATE sent to 1 to 8 mock WLAN interfaces one after another against
+    all at once, lookups in the interface version cache, and the driver calls a flapping proximity sensor's sets cost with and without
+    coalescing.
+
+    Usage: sarbench [records] [--json <file>]
+
+    --json also writes every figure to <file> as one JSON result per line, each named by suite,
+    name and metric, so the results of two builds can be compared line by line.
+
+Environment:
+
+    User Mode
+
+--*/
+
+#include "SarPlatform.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SarCodec.h"
+#include "SarColumns.h"
+#include "SarConfigFiles.h"
+#include "SarContainer.h"
+#include "SarDeviceService.h"
+#include "SarEventLog.h"
+#include "SarFanOut.h"
+#include "SarFirmwareStore.h"
+#include "SarInterfaceVersion.h"
+#include "SarMappedFile.h"
+#include "SarNotification.h"
+#include "SarOutput.h"
+#include "SarServer.h"
+#include "SarSetQueue.h"
+#include "SarStats.h"
+#include "SarTableCompression.h"
+#include "SarValidate.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Records are cycled through a working set this large so the data stays cache-resident and the
+// benchmark measures the codec rather than memory bandwidth.
+//
+static const size_t SAR_BENCH_WORKING_SET = 1024;
+static const size_t SAR_BENCH_DEFAULT_RECORDS = 4 * 1024 * 1024;
+
+// Firmware round-trips are far more expensive than encoding a record, so fewer are timed.
+//
+static const size_t SAR_BENCH_ROUND_TRIP_DIVISOR = 256;
+
+// Client thread counts used for the server load test.
+//
+static const UINT32 SarBenchServerClients[] = { 1, 4, 16 };
+
+// Pairs per WDI_SET_SAR_STATE in the load test: a whole 4x4 MIMO radio.
+//
+static const UINT32 SAR_BENCH_CONFIG_SETS = 4;
+
+// Microseconds between bursts of unsolicited notifications.
+//
+static const UINT32 SAR_BENCH_NOTIFICATION_PAUSE = 200;
+
+// Small segments so the event log benchmark rotates through the ring several times.
+//
+static const UINT32 SAR_BENCH_EVENT_LOG_SEGMENT_SIZE = 64 * 1024;
+static const UINT32 SAR_BENCH_EVENT_LOG_SEGMENTS = 4;
+
+// Pair counts of the WDI_SET_SAR_STATE requests built, from one antenna up to
+// SAR_WIFI_MAX_CONFIG_SETS.
+//
+static const UINT32 SarBenchSetSarStatePairs[] = { 1, 2, 4, 8, 16, 64, 256 };
+
+// WLAN interface counts of the fan-out benchmark, the simulated driver round-trip of each
+// interface, and the most requests sent to each count (so the benchmark takes about a second.)
+//
+static const UINT32 SarBenchFanOutInterfaces[] = { 1, 2, 4, 8 };
+static const UINT32 SAR_BENCH_FAN_OUT_LATENCY = 500;
+static const size_t SAR_BENCH_FAN_OUT_REQUESTS = 100;
+
+// Interfaces in the interface version cache file the lookups search.
+//
+static const UINT32 SAR_BENCH_VERSION_CACHE_INTERFACES = 8;
+
+// Coalescing windows (0 is every set sent at once), the sets a flapping sensor makes and the
+// time between them, and the simulated driver round-trip.
+//
+static const UINT32 SarBenchCoalesceWindows[] = { 0, 5, 20, 50 };
+static const size_t SAR_BENCH_COALESCE_SETS = 200;
+static const UINT32 SAR_BENCH_COALESCE_INTERVAL = 1000;
+static const UINT32 SAR_BENCH_COALESCE_LATENCY = 500;
+
+// Version of the --json output; bumped when a suite, name or metric is renamed.
+//
+static const UINT32 SAR_BENCH_JSON_VERSION = 1;
+
+typedef struct _SAR_BENCH_RESULT
+{
+    double EncodeNs;
+    double DecodeNs;
+    double MemcpyNs;
+    UINT64 Checksum;
+} SAR_BENCH_RESULT;
+
+typedef struct _SAR_BENCH_SAMPLE
+{
+    LPCSTR Suite;
+    std::string Name;
+    LPCSTR Metric;
+    LPCSTR Unit;
+    double Value;
+} SAR_BENCH_SAMPLE;
+
+// Every figure printed, in the order printed, for --json.
+//
+static std::vector<SAR_BENCH_SAMPLE> SarBenchSamples;
+
+static
+VOID
+SarBenchRecord(
+    _In_z_ LPCSTR suite,
+    _In_ const std::string& name,
+    _In_z_ LPCSTR metric,
+    _In_z_ LPCSTR unit,
+    double value
+    )
+{
+    SarBenchSamples.push_back({ suite, name, metric, unit, value });
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchWriteJson(
+    _In_z_ LPCSTR path,
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Writes the recorded figures as a JSON object with one result per line, e.g.
+
+        {"Suite":"codec","Name":"SAR_CONFIG_HEADER","Metric":"encode","Unit":"ns","Value":1.234}
+
+    Suites, names and metrics do not depend on the platform (the SIMD kernels are reported as
+    "vector", and named under "Kernels"), so results from different builds and machines pair up.
+
+Arguments:
+
+    path - The file to create or overwrite.
+    records - The record count the benchmarks ran with.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    FILE* output = fopen(path, "w");
+
+    if (!output)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    fprintf(output,
+            "{\"SarBenchJsonVersion\":%u,\"Records\":%zu,\"Kernels\":{\"validate\":\"%s\",\"columns\":\"%s\"},\"Results\":[\n",
+            SAR_BENCH_JSON_VERSION,
+            records,
+            SarPowerTableViolationsKernel(),
+            SarColumnSummarizeKernel());
+
+    for (size_t i = 0; i < SarBenchSamples.size(); i++)
+    {
+        const SAR_BENCH_SAMPLE& sample = SarBenchSamples[i];
+
+        fprintf(output,
+                "{\"Suite\":\"%s\",\"Name\":\"%s\",\"Metric\":\"%s\",\"Unit\":\"%s\",\"Value\":%.3f}%s\n",
+                sample.Suite,
+                sample.Name.c_str(),
+                sample.Metric,
+                sample.Unit,
+                sample.Value,
+                (i + 1 < SarBenchSamples.size()) ? "," : "");
+    }
+
+    fprintf(output, "]}\n");
+
+    if (ferror(output))
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+static
+UINT64
+SarBenchNextRandom(
+    _Inout_ UINT64* state
+    )
+{
+    // xorshift64
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+template <typename T>
+static
+SAR_BENCH_RESULT
+SarBenchCodec(
+    size_t records,
+    HRESULT (*encode)(const T*, UINT8*, size_t),
+    HRESULT (*decode)(const UINT8*, size_t, T*)
+    )
+/*++
+
+Routine Description:
+
+    Times encoding, decoding and memcpy of the specified number of records of type T.
+
+Arguments:
+
+    records - Number of records to process in each phase.
+    encode - The codec's encoder for T.
+    decode - The codec's decoder for T.
+
+Return Value:
+
+    The cost of each phase in ns/record, and a checksum of the decoded data that keeps the
+    compiler from discarding the work.
+
+--*/
+{
+    SAR_BENCH_RESULT result = { 0 };
+    std::vector<T> values(SAR_BENCH_WORKING_SET);
+    std::vector<T> decoded(SAR_BENCH_WORKING_SET);
+    std::vector<UINT8> wire(SAR_BENCH_WORKING_SET * sizeof(T));
+    UINT64 random = 0x9E3779B97F4A7C15ull;
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        UINT8* pValue = (UINT8*)&values[i];
+        for (size_t b = 0; b < sizeof(T); b++)
+        {
+            pValue[b] = (UINT8)SarBenchNextRandom(&random);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+        (VOID)encode(&values[slot], wire.data() + slot * sizeof(T), sizeof(T));
+    }
+    auto encodeDone = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+        (VOID)decode(wire.data() + slot * sizeof(T), sizeof(T), &decoded[slot]);
+    }
+    auto decodeDone = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+        memcpy(wire.data() + slot * sizeof(T), &values[slot], sizeof(T));
+        memcpy(&decoded[(slot + 1) % SAR_BENCH_WORKING_SET], wire.data() + slot * sizeof(T), sizeof(T));
+    }
+    auto memcpyDone = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+        const UINT8* pDecoded = (const UINT8*)&decoded[i];
+        for (size_t b = 0; b < sizeof(T); b++)
+        {
+            result.Checksum = result.Checksum * 31 + pDecoded[b];
+        }
+    }
+
+    result.EncodeNs = std::chrono::duration<double, std::nano>(encodeDone - start).count() / records;
+    result.DecodeNs = std::chrono::duration<double, std::nano>(decodeDone - encodeDone).count() / records;
+    result.MemcpyNs = std::chrono::duration<double, std::nano>(memcpyDone - decodeDone).count() / records;
+
+    return result;
+}
+
+typedef enum _SAR_BENCH_TABLE_SHAPE
+{
+    SarBenchTableRaw,                   // Typical tables stored raw.
+    SarBenchTableTypical,               // Power falling across bands and antennas, with jitter.
+    SarBenchTableExample,               // The setconfig example table.
+    SarBenchTableRandom,                // Incompressible; stored raw.
+} SAR_BENCH_TABLE_SHAPE;
+
+typedef struct _SAR_BENCH_TABLE_RUN
+{
+    LPCSTR Name;
+    SAR_BENCH_TABLE_SHAPE Shape;
+} SAR_BENCH_TABLE_RUN;
+
+static const SAR_BENCH_TABLE_RUN SarBenchTableRuns[] =
+{
+    { "raw PowerValues",     SarBenchTableRaw },
+    { "compressed, typical", SarBenchTableTypical },
+    { "compressed, example", SarBenchTableExample },
+    { "compressed, random",  SarBenchTableRandom },
+};
+
+static
+_Check_return_
+HRESULT
+SarBenchCompressedTables(
+    _In_z_ LPCSTR name,
+    SAR_BENCH_TABLE_SHAPE shape,
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times SarEncodeConfigBlob and SarDecodeConfigBlob of the power table, the calls setconfig and
+    getconfig make, with SARTablesCompressed selecting the delta/bit-packed format (or not, for
+    the raw PowerValues baseline), and checks every table round-trips.
+
+Arguments:
+
+    name - The row's name for the report.
+    shape - The tables to encode.
+    records - Number of tables to encode and decode.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if a table did not round-trip, or the codec's failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<SAR_CONFIG_BLOBS> tables(SAR_BENCH_WORKING_SET);
+    std::vector<UINT8> images(SAR_BENCH_WORKING_SET * sizeof(SAR_POWER_TABLE));
+    std::vector<size_t> imageSizes(SAR_BENCH_WORKING_SET);
+    SAR_CONFIG_BLOBS decoded = { 0 };
+    UINT64 random = 0x2545F4914F6CDD1Dull;
+    size_t imageBytes = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point encodeDone;
+    std::chrono::steady_clock::time_point decodeDone;
+
+    for (size_t i = 0; i < tables.size(); i++)
+    {
+        SAR_CONFIG_BLOBS& blobs = tables[i];
+
+        SarConfigPopulateExample(&blobs);
+        blobs.Header.SARTablesCompressed = (shape == SarBenchTableRaw) ? 0 : SAR_TABLES_COMPRESSED_DELTA;
+
+        for (int row = 0; (shape != SarBenchTableExample) && (row < MAX_NUM_SAR_WIFI_POWER_TABLE); row++)
+        {
+            int base = 160 - 6 * row + (int)(SarBenchNextRandom(&random) % 4);
+
+            for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+            {
+                blobs.PowerTable.PowerValues[row][col] = (shape == SarBenchTableRandom) ?
+                    (UINT8)SarBenchNextRandom(&random) :
+                    (UINT8)(base - 2 * col - (int)(SarBenchNextRandom(&random) % 3));
+            }
+        }
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+
+        hr = SarEncodeConfigBlob(SarBlobPowerTable,
+                                 &tables[slot],
+                                 images.data() + slot * sizeof(SAR_POWER_TABLE),
+                                 sizeof(SAR_POWER_TABLE),
+                                 &imageSizes[slot]);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+    encodeDone = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+
+        hr = SarDecodeConfigBlob(SarBlobPowerTable,
+                                 images.data() + slot * sizeof(SAR_POWER_TABLE),
+                                 imageSizes[slot],
+                                 &decoded);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+    decodeDone = std::chrono::steady_clock::now();
+
+    for (size_t slot = 0; slot < tables.size(); slot++)
+    {
+        hr = SarDecodeConfigBlob(SarBlobPowerTable,
+                                 images.data() + slot * sizeof(SAR_POWER_TABLE),
+                                 imageSizes[slot],
+                                 &decoded);
+        if (SUCCEEDED(hr) &&
+            (0 != memcmp(&decoded.PowerTable, &tables[slot].PowerTable, sizeof(decoded.PowerTable))))
+        {
+            hr = E_UNEXPECTED;
+        }
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        imageBytes += imageSizes[slot];
+    }
+
+    printf("%-22s %12.1f %12.2f %12.2f\n",
+        name,
+        (double)imageBytes / tables.size(),
+        std::chrono::duration<double, std::nano>(encodeDone - start).count() / records,
+        std::chrono::duration<double, std::nano>(decodeDone - encodeDone).count() / records);
+
+    SarBenchRecord("table_compression", name, "size", "bytes", (double)imageBytes / tables.size());
+    SarBenchRecord("table_compression", name, "encode", "ns", std::chrono::duration<double, std::nano>(encodeDone - start).count() / records);
+    SarBenchRecord("table_compression", name, "decode", "ns", std::chrono::duration<double, std::nano>(decodeDone - encodeDone).count() / records);
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", name, (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchFirmwareStore(
+    _In_z_ LPCSTR name,
+    _In_ SarFirmwareStore* store,
+    size_t roundTrips,
+    BOOL fCompress
+    )
+/*++
+
+Routine Description:
+
+    Times batched writes and reads of the four provisioning variables and checks that what is read
+    back matches what was written.
+
+Arguments:
+
+    name - The store's name for the report.
+    store - The store to exercise.
+    roundTrips - Number of write+read round-trips.
+    fCompress - TRUE to write the power table compressed.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if the data did not round-trip, or the store's failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS written;
+    SAR_CONFIG_BLOBS read;
+    std::chrono::steady_clock::duration writeTime(0);
+    std::chrono::steady_clock::duration readTime(0);
+
+    SarConfigPopulateExample(&written);
+    if (fCompress)
+    {
+        written.Header.SARTablesCompressed = SAR_TABLES_COMPRESSED_DELTA;
+    }
+
+    for (size_t i = 0; i < roundTrips; i++)
+    {
+        written.Values.SARSafetyTimer = (UINT32)i;
+
+        auto start = std::chrono::steady_clock::now();
+        hr = store->WriteConfig(&written);
+        auto writeDone = std::chrono::steady_clock::now();
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        hr = store->ReadConfig(&read);
+        auto readDone = std::chrono::steady_clock::now();
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        writeTime += writeDone - start;
+        readTime += readDone - writeDone;
+
+        if ((read.Values.SARSafetyTimer != written.Values.SARSafetyTimer) ||
+            (0 != memcmp(&read.PowerTable, &written.PowerTable, sizeof(read.PowerTable))))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+    }
+
+    printf("%-22s %6zu %12.0f %12.0f\n",
+        name,
+        roundTrips,
+        std::chrono::duration<double, std::nano>(writeTime).count() / roundTrips,
+        std::chrono::duration<double, std::nano>(readTime).count() / roundTrips);
+
+    SarBenchRecord("firmware_store", name, "write", "ns", std::chrono::duration<double, std::nano>(writeTime).count() / roundTrips);
+    SarBenchRecord("firmware_store", name, "read", "ns", std::chrono::duration<double, std::nano>(readTime).count() / roundTrips);
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", name, (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchHistogram(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times SarStatsNow + SarHistogram::Record, the cost every timed phase pays, and checks that the
+    reported percentiles of log-uniform random latencies (100 ns to 100 ms) are within the
+    histogram's 1/32 precision of the exact percentiles.
+
+Arguments:
+
+    records - Number of values to record.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if a percentile is out of tolerance.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarHistogram histogram;
+    std::vector<UINT64> values(SAR_BENCH_WORKING_SET);
+    UINT64 seed = 0x5eed;
+    static const double fractions[] = { 0.50, 0.99, 0.999 };
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        double exponent = 2.0 + 4.0 * (double)(SarBenchNextRandom(&seed) % 1000000) / 1000000;
+        values[i] = (UINT64)pow(10.0, exponent);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++)
+    {
+        UINT64 begin = SarStatsNow();
+        histogram.Record(values[i % SAR_BENCH_WORKING_SET] + (SarStatsNow() - begin));
+    }
+    auto done = std::chrono::steady_clock::now();
+
+    printf("\nLatency histogram: %.2f ns per timed phase (two clock reads and a record)\n\n",
+        std::chrono::duration<double, std::nano>(done - start).count() / records);
+    SarBenchRecord("histogram", "timed phase", "record", "ns", std::chrono::duration<double, std::nano>(done - start).count() / records);
+    printf("%-22s %12s %12s %12s\n", "log-uniform values", "exact ns", "reported ns", "error");
+
+    // Every working-set value was recorded equally often (up to one extra pass over a prefix), so
+    // the exact percentiles of the working set are those of the recorded values.
+    std::sort(values.begin(), values.end());
+    histogram.Reset();
+    for (UINT64 value : values)
+    {
+        histogram.Record(value);
+    }
+
+    for (double fraction : fractions)
+    {
+        UINT64 exact = values[(size_t)(fraction * (values.size() - 1))];
+        UINT64 reported = histogram.Percentile(fraction);
+        double error = ((double)reported - (double)exact) / (double)exact;
+
+        printf("%-22s %12llu %12llu %11.2f%%\n",
+            (fraction == 0.50) ? "p50" : (fraction == 0.99) ? "p99" : "p999",
+            (unsigned long long)exact,
+            (unsigned long long)reported,
+            error * 100);
+        SarBenchRecord("histogram", (fraction == 0.50) ? "p50" : (fraction == 0.99) ? "p99" : "p999", "error", "%", error * 100);
+
+        if ((error < -1.0 / 32) || (error > 1.0 / 32))
+        {
+            hr = E_UNEXPECTED;
+        }
+    }
+
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchNotifications(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Posts notifications through the pipeline to a null log, in bursts with a short pause between
+    them, and reports what the posting (callback) thread pays per
+    notification and how the consumer batched them.
+
+Arguments:
+
+    records - Number of notifications to post.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if notifications were lost without being counted.
+
+--*/
+{
+    HRESULT hr = S_OK;
+#ifdef _WIN32
+    FILE* nullLog = fopen("NUL", "w");
+#else
+    FILE* nullLog = fopen("/dev/null", "w");
+#endif
+    SAR_NOTIFICATION_COUNTERS counters;
+    const size_t burst = SAR_NOTIFICATION_RING_CAPACITY / 4;
+    std::chrono::steady_clock::duration postTime(0);
+
+    if (nullLog == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    {
+        SarNotificationPipeline pipeline(nullLog);
+
+        hr = pipeline.Start();
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        // Bursts of a quarter of the ring, each followed by a pause, time only the posts.
+        for (size_t posted = 0; posted < records; posted += burst)
+        {
+            size_t count = ((records - posted) < burst) ? (records - posted) : burst;
+
+            auto start = std::chrono::steady_clock::now();
+            SarNotificationSyntheticProducer(&pipeline, count, 0, 0);
+            postTime += std::chrono::steady_clock::now() - start;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(SAR_BENCH_NOTIFICATION_PAUSE));
+        }
+
+        pipeline.Stop();
+        pipeline.GetCounters(&counters);
+
+        printf("%-22s %12.2f %12llu %12llu %12.1f\n",
+            "post",
+            std::chrono::duration<double, std::nano>(postTime).count() / records,
+            (unsigned long long)counters.Logged,
+            (unsigned long long)counters.Dropped,
+            counters.Batches ? (double)counters.Logged / counters.Batches : 0.0);
+
+        SarBenchRecord("notifications", "post", "post", "ns", std::chrono::duration<double, std::nano>(postTime).count() / records);
+        SarBenchRecord("notifications", "post", "dropped", "count", (double)counters.Dropped);
+
+        if ((counters.Received != records) || (counters.Logged + counters.Dropped != records))
+        {
+            hr = E_UNEXPECTED;
+        }
+    }
+
+exit:
+    if (nullLog != nullptr)
+    {
+        fclose(nullLog);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchEventLog(
+    _In_z_ LPCSTR basePath,
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Appends Wi-Fi SAR requests and LTE transmission state changes, one millisecond apart, to an
+    event log of small segments, then decodes what the ring kept as text and as CSV.  Reports ns
+    per event for each step and the bytes each kept event takes on disk.
+
+Arguments:
+
+    basePath - Base path of the scratch log.
+    records - Number of events to append.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if the decoder does not return what the ring should hold.
+
+--*/
+{
+    HRESULT hr = S_OK;
+#ifdef _WIN32
+    FILE* nullLog = fopen("NUL", "w");
+#else
+    FILE* nullLog = fopen("/dev/null", "w");
+#endif
+    SarEventLogWriter writer;
+    UINT64 timestamp = SarEventLogNow();
+    UINT64 segmentsWritten = 0;
+    UINT64 decoded = 0;
+    UINT64 decodedCsv = 0;
+    UINT64 diskBytes = 0;
+    UINT8 request[2];
+    std::chrono::steady_clock::duration appendTime(0);
+    std::chrono::steady_clock::duration decodeTextTime(0);
+    std::chrono::steady_clock::duration decodeCsvTime(0);
+    std::chrono::steady_clock::time_point start;
+
+    if (nullLog == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    hr = writer.Open(basePath, SAR_BENCH_EVENT_LOG_SEGMENT_SIZE, SAR_BENCH_EVENT_LOG_SEGMENTS);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++)
+    {
+        timestamp += 1000;
+
+        if ((i % 8) == 7)
+        {
+            hr = writer.Append(SarEventLteTransmissionState, timestamp, (i / 8) & 1, nullptr, 0);
+        }
+        else
+        {
+            request[0] = (UINT8)i;
+            request[1] = (UINT8)(i >> 8);
+            hr = writer.Append(SarEventWlanSarRequest, timestamp, 0, request, sizeof(request));
+        }
+
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+    writer.Close();
+    appendTime = std::chrono::steady_clock::now() - start;
+    segmentsWritten = writer.SegmentsWritten();
+
+    for (UINT32 slot = 0; slot < SAR_BENCH_EVENT_LOG_SEGMENTS; slot++)
+    {
+        SarMappedFile segment;
+
+        if (SUCCEEDED(segment.Open(SarEventLogSegmentPath(basePath, slot).c_str())))
+        {
+            diskBytes += segment.Size();
+        }
+    }
+
+    start = std::chrono::steady_clock::now();
+    hr = SarEventLogDecode(basePath, FALSE, nullLog, &decoded);
+    decodeTextTime = std::chrono::steady_clock::now() - start;
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    start = std::chrono::steady_clock::now();
+    hr = SarEventLogDecode(basePath, TRUE, nullLog, &decodedCsv);
+    decodeCsvTime = std::chrono::steady_clock::now() - start;
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    printf("%-22s %12.2f %12.2f %12.2f %12.2f %8llu\n",
+        "event log",
+        std::chrono::duration<double, std::nano>(appendTime).count() / records,
+        decoded ? std::chrono::duration<double, std::nano>(decodeTextTime).count() / decoded : 0.0,
+        decoded ? std::chrono::duration<double, std::nano>(decodeCsvTime).count() / decoded : 0.0,
+        decoded ? (double)diskBytes / decoded : 0.0,
+        (unsigned long long)segmentsWritten);
+
+    SarBenchRecord("event_log", "event log", "append", "ns", std::chrono::duration<double, std::nano>(appendTime).count() / records);
+    SarBenchRecord("event_log", "event log", "decode text", "ns", decoded ? std::chrono::duration<double, std::nano>(decodeTextTime).count() / decoded : 0.0);
+    SarBenchRecord("event_log", "event log", "decode csv", "ns", decoded ? std::chrono::duration<double, std::nano>(decodeCsvTime).count() / decoded : 0.0);
+    SarBenchRecord("event_log", "event log", "size", "bytes", decoded ? (double)diskBytes / decoded : 0.0);
+
+    // Until the ring wraps every event is kept; after that, only the newest segments' worth.
+    if ((decoded != decodedCsv) ||
+        (decoded == 0) ||
+        (decoded > records) ||
+        ((segmentsWritten <= SAR_BENCH_EVENT_LOG_SEGMENTS) && (decoded != records)))
+    {
+        hr = E_UNEXPECTED;
+    }
+
+exit:
+    for (UINT32 slot = 0; slot < SAR_BENCH_EVENT_LOG_SEGMENTS; slot++)
+    {
+        remove(SarEventLogSegmentPath(basePath, slot).c_str());
+    }
+    if (nullLog != nullptr)
+    {
+        fclose(nullLog);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchDeviceService(
+    _In_ SarDeviceService* device,
+    UINT32 clientId,
+    size_t requests
+    )
+/*++
+
+Routine Description:
+
+    Alternates Wi-Fi SAR sets and gets against the device service.  Other clients may change the
+    state between a set and the following get, so only the shape of what is read back is checked.
+
+Arguments:
+
+    device - The device service to exercise.
+    clientId - Mixed into the configuration so concurrent clients set different states.
+    requests - Number of requests to issue.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if a get returned a malformed state, or the failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[SAR_BENCH_CONFIG_SETS] = { 0 };
+    WDI_SAR_STATE state;
+    std::vector<WDI_SAR_CONFIG_SET> readSets;
+    WDI_SAR_RESULT result;
+
+    for (size_t i = 0; i + 1 < requests; i += 2)
+    {
+        for (UINT32 j = 0; j < SAR_BENCH_CONFIG_SETS; j++)
+        {
+            configSets[j].WDI_SARAntennaIndex = 1 << j;
+            configSets[j].WDI_SARBackOffIndex = (UINT32)i + clientId;
+        }
+
+        hr = SarWifiSetSarState(device, WDI_SARBACKOFF_ENABLED, clientId, configSets, SAR_BENCH_CONFIG_SETS, &result);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        hr = SarWifiGetSarState(device, &state, &readSets);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        if (readSets.size() != SAR_BENCH_CONFIG_SETS)
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+
+        for (UINT32 j = 0; j < SAR_BENCH_CONFIG_SETS; j++)
+        {
+            if (readSets[j].WDI_SARAntennaIndex != configSets[j].WDI_SARAntennaIndex)
+            {
+                hr = E_UNEXPECTED;
+                goto exit;
+            }
+        }
+    }
+
+exit:
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchServer(
+    _In_z_ LPCSTR endpoint,
+    size_t requests
+    )
+/*++
+
+Routine Description:
+
+    Times set/get traffic issued directly against a mock device service, then through a SarTool
+    server serving the same mock to increasing numbers of concurrent clients.
+
+Arguments:
+
+    endpoint - The endpoint to serve on.
+    requests - Number of requests each client issues.
+
+Return Value:
+
+    S_OK on success or the first failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarMockDeviceService device;
+    SarServer server(&device);
+
+    auto start = std::chrono::steady_clock::now();
+    hr = SarBenchDeviceService(&device, 0, requests);
+    auto done = std::chrono::steady_clock::now();
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "direct", (UINT32)hr);
+        goto exit;
+    }
+
+    printf("%-22s %6u %12.0f %12.2f\n",
+        "direct",
+        1,
+        requests / std::chrono::duration<double>(done - start).count(),
+        std::chrono::duration<double, std::micro>(done - start).count() / requests);
+    SarBenchRecord("server", "direct", "rate", "req/s", requests / std::chrono::duration<double>(done - start).count());
+    SarBenchRecord("server", "direct", "latency", "us", std::chrono::duration<double, std::micro>(done - start).count() / requests);
+
+    hr = server.Start(endpoint);
+    if (FAILED(hr))
+    {
+        printf("%-22s failed to listen on %s, hr = 0x%08x\n", "server", endpoint, (UINT32)hr);
+        goto exit;
+    }
+
+    for (UINT32 clients : SarBenchServerClients)
+    {
+        std::vector<std::thread> threads;
+        std::atomic<HRESULT> hrClients(S_OK);
+
+        start = std::chrono::steady_clock::now();
+        for (UINT32 client = 0; client < clients; client++)
+        {
+            threads.emplace_back([&, client]()
+            {
+                SarRemoteDeviceService remote;
+                HRESULT hrClient = remote.Connect(endpoint);
+                if (SUCCEEDED(hrClient))
+                {
+                    hrClient = SarBenchDeviceService(&remote, client, requests);
+                }
+
+                HRESULT expected = S_OK;
+                if (FAILED(hrClient))
+                {
+                    hrClients.compare_exchange_strong(expected, hrClient);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        done = std::chrono::steady_clock::now();
+
+        hr = hrClients;
+        if (FAILED(hr))
+        {
+            printf("%-22s failed, hr = 0x%08x\n", "server", (UINT32)hr);
+            goto exit;
+        }
+
+        // Latency is per client: each client waits for its own responses.
+        printf("%-22s %6u %12.0f %12.2f\n",
+            "server",
+            clients,
+            (requests * clients) / std::chrono::duration<double>(done - start).count(),
+            std::chrono::duration<double, std::micro>(done - start).count() / requests);
+        SarBenchRecord("server", "server x" + std::to_string(clients), "rate", "req/s", (requests * clients) / std::chrono::duration<double>(done - start).count());
+        SarBenchRecord("server", "server x" + std::to_string(clients), "latency", "us", std::chrono::duration<double, std::micro>(done - start).count() / requests);
+    }
+
+exit:
+    server.Stop();
+    return hr;
+}
+
+static
+VOID
+SarBenchPrint(
+    _In_ const SAR_STRUCT_LAYOUT* layout,
+    _In_ const SAR_BENCH_RESULT* result
+    )
+{
+    printf("%-22s %6u %12.2f %12.2f %12.2f\n",
+        layout->Name,
+        layout->WireSize,
+        result->EncodeNs,
+        result->DecodeNs,
+        result->MemcpyNs);
+
+    SarBenchRecord("codec", layout->Name, "encode", "ns", result->EncodeNs);
+    SarBenchRecord("codec", layout->Name, "decode", "ns", result->DecodeNs);
+    SarBenchRecord("codec", layout->Name, "memcpy x2", "ns", result->MemcpyNs);
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchValidation(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times SarPowerTableViolations, the validate command's kernel, against the portable
+    SarPowerTableViolationsSoftware over tables that straddle their caps, and checks both return the
+    same violation mask for every table.
+
+Arguments:
+
+    records - Number of tables to check with each kernel.
+
+Return Value:
+
+    S_OK on success, or E_UNEXPECTED if the kernels disagree.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<SAR_POWER_TABLE> tables(SAR_BENCH_WORKING_SET);
+    std::vector<SAR_POWER_TABLE> caps(SAR_BENCH_WORKING_SET);
+    UINT64 random = 0x9E3779B97F4A7C15ull;
+    UINT64 vectorMasks = 0;
+    UINT64 softwareMasks = 0;
+    size_t violations = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point vectorDone;
+    std::chrono::steady_clock::time_point softwareDone;
+
+    for (size_t slot = 0; slot < tables.size(); slot++)
+    {
+        for (UINT32 entry = 0; entry < SAR_POWER_TABLE_ENTRIES; entry++)
+        {
+            UINT8 cap = (UINT8)(96 + SarBenchNextRandom(&random) % 128);
+
+            (&caps[slot].PowerValues[0][0])[entry] = cap;
+            (&tables[slot].PowerValues[0][0])[entry] = (UINT8)(cap - 16 + (int)(SarBenchNextRandom(&random) % 20));
+        }
+
+        if (SarPowerTableViolations(&tables[slot], &caps[slot]) != SarPowerTableViolationsSoftware(&tables[slot], &caps[slot]))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+
+        for (UINT64 mask = SarPowerTableViolations(&tables[slot], &caps[slot]); mask != 0; mask &= mask - 1)
+        {
+            violations++;
+        }
+    }
+
+    // Fold the masks into a checksum so the compiler cannot drop the loops.
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+
+        vectorMasks += SarPowerTableViolations(&tables[slot], &caps[slot]);
+    }
+    vectorDone = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < records; i++)
+    {
+        size_t slot = i % SAR_BENCH_WORKING_SET;
+
+        softwareMasks += SarPowerTableViolationsSoftware(&tables[slot], &caps[slot]);
+    }
+    softwareDone = std::chrono::steady_clock::now();
+
+    if (vectorMasks != softwareMasks)
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    printf("%-22s %12.2f %12.2f\n",
+        SarPowerTableViolationsKernel(),
+        (double)violations / tables.size(),
+        std::chrono::duration<double, std::nano>(vectorDone - start).count() / records);
+    printf("%-22s %12.2f %12.2f\n",
+        "software",
+        (double)violations / tables.size(),
+        std::chrono::duration<double, std::nano>(softwareDone - vectorDone).count() / records);
+
+    SarBenchRecord("validate", "vector", "check", "ns", std::chrono::duration<double, std::nano>(vectorDone - start).count() / records);
+    SarBenchRecord("validate", "software", "check", "ns", std::chrono::duration<double, std::nano>(softwareDone - vectorDone).count() / records);
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "validation", (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchColumns(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times SarColumnSummarize, the kernel behind the columns command's aggregates, against the
+    portable SarColumnSummarizeSoftware over a column of random values of each width, and checks
+    both return the same summary.
+
+Arguments:
+
+    records - Number of values in each column.
+
+Return Value:
+
+    S_OK on success, or E_UNEXPECTED if the kernels disagree.
+
+--*/
+{
+    static const UINT32 widths[] = { 1, 2, 4 };
+
+    HRESULT hr = S_OK;
+    std::vector<UINT8> column(records * sizeof(UINT32));
+    UINT64 random = 0x9E3779B97F4A7C15ull;
+
+    for (UINT8& value : column)
+    {
+        value = (UINT8)SarBenchNextRandom(&random);
+    }
+
+    for (UINT32 width : widths)
+    {
+        SAR_COLUMN_SUMMARY vectorSummary;
+        SAR_COLUMN_SUMMARY softwareSummary;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point vectorDone;
+        std::chrono::steady_clock::time_point softwareDone;
+        double vectorNs;
+        double softwareNs;
+
+        SarColumnSummarize(column.data(), width, records, &vectorSummary);
+        vectorDone = std::chrono::steady_clock::now();
+        SarColumnSummarizeSoftware(column.data(), width, records, &softwareSummary);
+        softwareDone = std::chrono::steady_clock::now();
+
+        if ((vectorSummary.Count != softwareSummary.Count) ||
+            (vectorSummary.Min != softwareSummary.Min) ||
+            (vectorSummary.Max != softwareSummary.Max) ||
+            (vectorSummary.Sum != softwareSummary.Sum))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+
+        vectorNs = std::chrono::duration<double, std::nano>(vectorDone - start).count();
+        softwareNs = std::chrono::duration<double, std::nano>(softwareDone - vectorDone).count();
+        printf("%-22s %6u %12.3f %12.2f\n", SarColumnSummarizeKernel(), width, vectorNs / records, (double)records * width / vectorNs);
+        printf("%-22s %6u %12.3f %12.2f\n", "software", width, softwareNs / records, (double)records * width / softwareNs);
+
+        SarBenchRecord("columns", "vector u" + std::to_string(width * 8), "scan", "ns", vectorNs / records);
+        SarBenchRecord("columns", "software u" + std::to_string(width * 8), "scan", "ns", softwareNs / records);
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "columns", (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+UINT64
+SarBenchConfigChecksum(
+    _In_opt_ const SAR_CONFIG_VALUES* values,
+    _In_opt_ const SAR_POWER_TABLE* powerTable
+    )
+{
+    UINT64 checksum = 0;
+
+    if (values != nullptr)
+    {
+        checksum += values->SARSafetyTimer;
+    }
+
+    if (powerTable != nullptr)
+    {
+        for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            checksum = checksum * 31 + powerTable->PowerValues[row][row % MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE];
+        }
+    }
+
+    return checksum;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchGetConfig(
+    _In_z_ LPCSTR folder,
+    size_t reads
+    )
+/*++
+
+Routine Description:
+
+    Times the two ways of reading a folder of .bin files and a .sarc container: opening, reading
+    and decoding each file (SarConfigLoad, as batch getconfig does), and mapping the files and
+    reading the structs in place (SarMappedConfigFolder and SarContainerView, as getconfig does).
+    The example configuration is written to the folder first and removed afterwards.
+
+Arguments:
+
+    folder - An empty scratch folder.
+    reads - Number of reads through each path.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if the paths read back different configurations, or the
+    failure code.
+
+--*/
+{
+    static const LPCSTR names[] = { "folder, fread", "folder, mapped", "container, fread", "container, mapped" };
+
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS blobs;
+    SAR_POWER_TABLE powerTable;
+    std::string container = std::string(folder) + "/SarBench.sarc";
+    UINT64 checksums[ARRAYSIZE(names)] = { 0 };
+
+    SarConfigPopulateExample(&blobs);
+
+    hr = SarConfigSave(folder, &blobs);
+    if (SUCCEEDED(hr))
+    {
+        hr = SarConfigSave(container.c_str(), &blobs);
+    }
+
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    for (size_t run = 0; run < ARRAYSIZE(names); run++)
+    {
+        LPCSTR path = (run < 2) ? folder : container.c_str();
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; SUCCEEDED(hr) && (i < reads); i++)
+        {
+            if ((run % 2) == 0)
+            {
+                hr = SarConfigLoad(path, &blobs);
+                checksums[run] += SarBenchConfigChecksum(&blobs.Values, &blobs.PowerTable);
+            }
+            else if (run == 1)
+            {
+                SarMappedConfigFolder mappedFolder;
+
+                hr = mappedFolder.Open(path);
+                checksums[run] += SarBenchConfigChecksum(mappedFolder.Values(), mappedFolder.PowerTable(&powerTable));
+            }
+            else
+            {
+                SarMappedFile mappedFile;
+                SarContainerView view;
+
+                hr = mappedFile.Open(path);
+                if (SUCCEEDED(hr))
+                {
+                    hr = view.Attach(mappedFile.Data(), mappedFile.Size());
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    checksums[run] += SarBenchConfigChecksum(view.View<SAR_CONFIG_VALUES>(SarBlobValues), view.PowerTable(&powerTable));
+                }
+            }
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        if (checksums[run] != checksums[0])
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+
+        printf("%-22s %6zu %12.0f\n", names[run], reads, std::chrono::duration<double, std::nano>(done - start).count() / reads);
+        SarBenchRecord("getconfig", names[run], "read", "ns", std::chrono::duration<double, std::nano>(done - start).count() / reads);
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "getconfig", (UINT32)hr);
+    }
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        remove(SarConfigBlobPath(folder, (SAR_CONFIG_BLOB_ID)blobId).c_str());
+    }
+    remove(container.c_str());
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchFormat(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times formatting a power table as getconfig prints it, in each SarOutput format, against the
+    printf("%6.3f") loop getconfig used before it.  Output goes to the null device.
+
+Arguments:
+
+    records - Number of tables formatted in each format.
+
+Return Value:
+
+    S_OK on success, or E_FAIL if the null device could not be opened.
+
+--*/
+{
+    static const SAR_OUTPUT_FORMAT formats[] = { SarOutputText, SarOutputJson, SarOutputCsv };
+    static const LPCSTR names[] = { "text", "json", "csv" };
+
+    HRESULT hr = S_OK;
+    std::vector<SAR_POWER_TABLE> tables(SAR_BENCH_WORKING_SET);
+    UINT64 random = 0x9E3779B97F4A7C15ull;
+#ifdef _WIN32
+    FILE* nullOutput = fopen("NUL", "w");
+#else
+    FILE* nullOutput = fopen("/dev/null", "w");
+#endif
+
+    if (!nullOutput)
+    {
+        hr = E_FAIL;
+        goto exit;
+    }
+
+    for (SAR_POWER_TABLE& table : tables)
+    {
+        for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+            {
+                table.PowerValues[row][col] = (UINT8)SarBenchNextRandom(&random);
+            }
+        }
+    }
+
+    for (size_t format = 0; format < ARRAYSIZE(formats); format++)
+    {
+        SarOutput output(formats[format], nullOutput);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < records; i++)
+        {
+            output.BeginRecord("SarBench");
+            output.PowerTable("SAR_POWER_TABLE", &tables[i % SAR_BENCH_WORKING_SET]);
+            output.EndRecord();
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        printf("%-22s %12.2f\n", names[format], std::chrono::duration<double, std::nano>(done - start).count() / records);
+        SarBenchRecord("format", names[format], "power table", "ns", std::chrono::duration<double, std::nano>(done - start).count() / records);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < records; i++)
+        {
+            const SAR_POWER_TABLE& table = tables[i % SAR_BENCH_WORKING_SET];
+
+            fprintf(nullOutput, "\nSAR_POWER_TABLE\n");
+            for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+            {
+                for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+                {
+                    fprintf(nullOutput, "%6.3f", table.PowerValues[row][col] / 8.0);
+                    if ((col + 1) < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE)
+                    {
+                        fprintf(nullOutput, " - ");
+                    }
+                }
+                fprintf(nullOutput, "\n");
+            }
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        printf("%-22s %12.2f\n", "printf %6.3f", std::chrono::duration<double, std::nano>(done - start).count() / records);
+        SarBenchRecord("format", "printf", "power table", "ns", std::chrono::duration<double, std::nano>(done - start).count() / records);
+    }
+
+exit:
+    if (nullOutput != nullptr)
+    {
+        fclose(nullOutput);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchSetSarState(
+    size_t records
+    )
+/*++
+
+Routine Description:
+
+    Times building WDI_SET_SAR_STATE requests (SarWifiBuildSetSarState, including the allocation
+    SarWifiSetSarState makes for each request) for each pair count in SarBenchSetSarStatePairs,
+    and checks the last request of each decodes to what was encoded.
+
+Arguments:
+
+    records - Number of pairs encoded for each pair count.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if a request did not decode, or the failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<WDI_SAR_CONFIG_SET> configSets(SAR_WIFI_MAX_CONFIG_SETS);
+    std::vector<WDI_SAR_CONFIG_SET> decodedSets(SAR_WIFI_MAX_CONFIG_SETS);
+
+    for (UINT32 i = 0; i < SAR_WIFI_MAX_CONFIG_SETS; i++)
+    {
+        configSets[i].WDI_SARAntennaIndex = i;
+        configSets[i].WDI_SARBackOffIndex = i % MAX_NUM_SAR_WIFI_POWER_TABLE;
+    }
+
+    for (UINT32 pairs : SarBenchSetSarStatePairs)
+    {
+        size_t requests = (records / pairs) ? (records / pairs) : 1;
+        std::vector<UINT8> request;
+        WDI_SAR_STATE state;
+        double ns;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; SUCCEEDED(hr) && (i < requests); i++)
+        {
+            std::vector<UINT8> buffer;
+
+            hr = SarWifiBuildSetSarState(WDI_SARBACKOFF_ENABLED, (UINT32)i, configSets.data(), pairs, &buffer);
+            request.swap(buffer);
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        if (FAILED(SarDecodeSarState(request.data(), request.size(), &state)) ||
+            (state.NumWdiSarConfigElements != pairs) ||
+            FAILED(SarDecodeSarConfigSets(request.data() + SarStateLayout.WireSize,
+                                          request.size() - SarStateLayout.WireSize,
+                                          decodedSets.data(),
+                                          pairs)) ||
+            (0 != memcmp(decodedSets.data(), configSets.data(), pairs * sizeof(WDI_SAR_CONFIG_SET))))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+
+        ns = std::chrono::duration<double, std::nano>(done - start).count() / requests;
+        printf("%-22s %6u %6zu %12.2f %12.2f\n", "WDI_SET_SAR_STATE", pairs, request.size(), ns, ns / pairs);
+        SarBenchRecord("set_sar_state", std::to_string(pairs) + " pairs", "build", "ns", ns);
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "WDI_SET_SAR_STATE", (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchFanOut(
+    size_t requests
+    )
+/*++
+
+Routine Description:
+
+    Times one WDI_SET_SAR_STATE sent to every interface of a mock set whose interfaces each take
+    SAR_BENCH_FAN_OUT_LATENCY us per command, one interface after another and with SarWifiFanOut.
+
+Arguments:
+
+    requests - Number of requests sent to each set of interfaces.
+
+Return Value:
+
+    S_OK on success or the first failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[SAR_BENCH_CONFIG_SETS] = { 0 };
+    std::vector<UINT8> request;
+
+    hr = SarWifiBuildSetSarState(WDI_SARBACKOFF_ENABLED, 0, configSets, SAR_BENCH_CONFIG_SETS, &request);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    for (UINT32 interfaceCount : SarBenchFanOutInterfaces)
+    {
+        SarMockInterfaceSet interfaceSet(interfaceCount, SAR_BENCH_FAN_OUT_LATENCY);
+        std::vector<SAR_WIFI_INTERFACE> interfaces;
+        std::unique_ptr<SarThreadPool> pool;
+        std::vector<HRESULT> results;
+        double serialUs;
+        double fanOutUs;
+
+        hr = interfaceSet.Enumerate(&interfaces);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; SUCCEEDED(hr) && (i < requests); i++)
+        {
+            for (const SAR_WIFI_INTERFACE& wifiInterface : interfaces)
+            {
+                hr = SarWifiSendSetSarState(wifiInterface.Device.get(), request, nullptr);
+                if (FAILED(hr))
+                {
+                    break;
+                }
+            }
+        }
+        auto done = std::chrono::steady_clock::now();
+        serialUs = std::chrono::duration<double, std::micro>(done - start).count() / requests;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; SUCCEEDED(hr) && (i < requests); i++)
+        {
+            hr = SarWifiFanOut(&interfaceSet,
+                               interfaces,
+                               &pool,
+                               [&](size_t, const SAR_WIFI_INTERFACE& wifiInterface) -> HRESULT
+                               {
+                                   return SarWifiSendSetSarState(wifiInterface.Device.get(), request, nullptr);
+                               },
+                               &results);
+        }
+        done = std::chrono::steady_clock::now();
+        fanOutUs = std::chrono::duration<double, std::micro>(done - start).count() / requests;
+
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        printf("%-22s %6u %12.1f %12.1f\n", "WDI_SET_SAR_STATE", interfaceCount, serialUs, fanOutUs);
+        SarBenchRecord("fan_out", std::to_string(interfaceCount) + " interfaces", "serial", "us", serialUs);
+        SarBenchRecord("fan_out", std::to_string(interfaceCount) + " interfaces", "fan_out", "us", fanOutUs);
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "fan-out", (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+VOID
+SarBenchVersionIdentity(
+    UINT32 index,
+    _In_z_ LPCSTR driverVersion,
+    _Out_ SAR_DEVICE_IDENTITY* identity
+    )
+{
+    memset(identity, 0, sizeof(*identity));
+    identity->InterfaceGuid.Data1 = 0x5341524d;
+    identity->InterfaceGuid.Data4[7] = (UINT8)(index + 1);
+    snprintf(identity->DriverVersion, sizeof(identity->DriverVersion), "%s", driverVersion);
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchInterfaceVersionCache(
+    _In_z_ LPCSTR root,
+    size_t lookups
+    )
+/*++
+
+Routine Description:
+
+    Times lookups in an interface version cache of SAR_BENCH_VERSION_CACHE_INTERFACES interfaces,
+    and checks that a stored version is found again, that an entry for another driver version is
+    not, that stores from every interface at once (as a fan-out makes them) all survive, and that
+    malformed lines (including a damaged line for the interface) are ignored.
+
+Arguments:
+
+    root - A scratch directory for the cache file.
+    lookups - Number of lookups timed.
+
+Return Value:
+
+    S_OK on success, E_UNEXPECTED if a check failed, or the cache's failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::string path = std::string(root) + SAR_PATH_SEPARATOR + SAR_INTERFACE_VERSION_CACHE_NAME;
+    SAR_DEVICE_IDENTITY identity;
+    SAR_INTERFACE_VERSION version;
+    char szGuid[40];
+    FILE* cache = nullptr;
+    std::vector<std::thread> writers;
+    std::atomic<HRESULT> hrWriters(S_OK);
+    std::chrono::steady_clock::time_point start;
+    double lookupNs;
+
+    for (UINT32 i = 0; i < SAR_BENCH_VERSION_CACHE_INTERFACES; i++)
+    {
+        SarBenchVersionIdentity(i, "22.190.0.4", &identity);
+        hr = SarInterfaceVersionCacheStore(path.c_str(), identity, { 1, i });
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    // Every interface round-trips; a driver update misses until the new version is stored.
+    for (UINT32 i = 0; i < SAR_BENCH_VERSION_CACHE_INTERFACES; i++)
+    {
+        SarBenchVersionIdentity(i, "22.190.0.4", &identity);
+        if ((SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_OK) ||
+            (version.Major != 1) || (version.Minor != i))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+    }
+
+    SarBenchVersionIdentity(0, "22.200.0.1", &identity);
+    if (SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_FALSE)
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    hr = SarInterfaceVersionCacheStore(path.c_str(), identity, { 1, 4 });
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    if ((SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_OK) || (version.Minor != 4))
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    SarBenchVersionIdentity(0, "22.190.0.4", &identity);
+    if (SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_FALSE)
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        SarBenchVersionIdentity((UINT32)(i % SAR_BENCH_VERSION_CACHE_INTERFACES), "22.190.0.4", &identity);
+        (VOID)SarInterfaceVersionCacheLookup(path.c_str(), identity, &version);
+    }
+    lookupNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    (VOID)remove(path.c_str());
+    for (UINT32 i = 0; i < SAR_BENCH_VERSION_CACHE_INTERFACES; i++)
+    {
+        writers.emplace_back([&path, &hrWriters, i]()
+        {
+            SAR_DEVICE_IDENTITY writerIdentity;
+
+            SarBenchVersionIdentity(i, "23.0", &writerIdentity);
+            if (FAILED(SarInterfaceVersionCacheStore(path.c_str(), writerIdentity, { 1, i })))
+            {
+                hrWriters = E_FAIL;
+            }
+        });
+    }
+
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+
+    hr = hrWriters;
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    for (UINT32 i = 0; i < SAR_BENCH_VERSION_CACHE_INTERFACES; i++)
+    {
+        SarBenchVersionIdentity(i, "23.0", &identity);
+        if ((SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_OK) || (version.Minor != i))
+        {
+            hr = E_UNEXPECTED;
+            goto exit;
+        }
+    }
+
+    // A damaged cache: only the well-formed line (with a CRLF ending) may be found.
+    SarBenchVersionIdentity(0, "1.0", &identity);
+    snprintf(szGuid, sizeof(szGuid), "%08x-0000-0000-0000-000000000001", identity.InterfaceGuid.Data1);
+
+    cache = fopen(path.c_str(), "w");
+    if (cache == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    fprintf(cache, "garbage\n\n%s\n%s 1\n%s one two 1.0\n%s1 5 1.0\n%s 1 6 2.0\r\n",
+            szGuid, szGuid, szGuid, szGuid, szGuid);
+    if (fclose(cache) != 0)
+    {
+        hr = E_FAIL;
+        goto exit;
+    }
+
+    if (SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_FALSE)
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    SarBenchVersionIdentity(0, "2.0", &identity);
+    if ((SarInterfaceVersionCacheLookup(path.c_str(), identity, &version) != S_OK) ||
+        (version.Major != 1) || (version.Minor != 6))
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    printf("%-22s %6u %12.0f\n", "lookup", SAR_BENCH_VERSION_CACHE_INTERFACES, lookupNs);
+    SarBenchRecord("interface_version_cache", "lookup", "lookup", "ns", lookupNs);
+
+exit:
+    (VOID)remove(path.c_str());
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "interface version cache", (UINT32)hr);
+    }
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarBenchCoalesce(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Replays a proximity sensor that flaps between two states, one WDI_SET_SAR_STATE every
+    SAR_BENCH_COALESCE_INTERVAL us, against a mock driver that takes SAR_BENCH_COALESCE_LATENCY
+    us per command, and reports the driver calls each coalescing window costs and how long the
+    sensor's thread spends per set.
+
+Return Value:
+
+    S_OK on success or the first failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    WDI_SAR_CONFIG_SET configSets[SAR_BENCH_CONFIG_SETS] = { 0 };
+    std::vector<UINT8> requests[2];
+
+    for (UINT32 i = 0; i < ARRAYSIZE(requests); i++)
+    {
+        configSets[0].WDI_SARBackOffIndex = i;
+        hr = SarWifiBuildSetSarState(WDI_SARBACKOFF_ENABLED, 0, configSets, SAR_BENCH_CONFIG_SETS, &requests[i]);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    for (UINT32 window : SarBenchCoalesceWindows)
+    {
+        SarMockDeviceService device(SAR_BENCH_COALESCE_LATENCY);
+        std::unique_ptr<SarSetQueue> queue;
+        UINT32 lane = 0;
+        double callerUs = 0;
+
+        if (window != 0)
+        {
+            queue.reset(new SarSetQueue(window));
+            lane = queue->AddLane([&device](const std::vector<UINT8>& request) -> HRESULT
+            {
+                return SarWifiSendSetSarState(&device, request, nullptr);
+            });
+        }
+
+        for (size_t i = 0; SUCCEEDED(hr) && (i < SAR_BENCH_COALESCE_SETS); i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            if (queue)
+            {
+                queue->Submit(lane, requests[i % 2]);
+            }
+            else
+            {
+                hr = SarWifiSendSetSarState(&device, requests[i % 2], nullptr);
+            }
+
+            auto done = std::chrono::steady_clock::now();
+            callerUs += std::chrono::duration<double, std::micro>(done - start).count();
+            std::this_thread::sleep_until(start + std::chrono::microseconds(SAR_BENCH_COALESCE_INTERVAL));
+        }
+
+        if (queue)
+        {
+            hr = queue->Flush(lane);
+        }
+
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        callerUs /= SAR_BENCH_COALESCE_SETS;
+        printf("%-22s %6u %12llu %12llu %12.1f\n",
+               "WDI_SET_SAR_STATE",
+               window,
+               (unsigned long long)SAR_BENCH_COALESCE_SETS,
+               (unsigned long long)device.CommandCount(),
+               callerUs);
+        SarBenchRecord("coalesce", std::to_string(window) + " ms", "driver_calls", "calls", (double)device.CommandCount());
+        SarBenchRecord("coalesce", std::to_string(window) + " ms", "caller", "us", callerUs);
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        printf("%-22s failed, hr = 0x%08x\n", "coalesce", (UINT32)hr);
+    }
+    return hr;
+}
+
+int
+_cdecl
+main(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+{
+    size_t records = SAR_BENCH_DEFAULT_RECORDS;
+    SAR_BENCH_RESULT result;
+    UINT64 checksum = 0;
+    LPCSTR jsonPath = nullptr;
+    BOOL fUsage = FALSE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--json"))
+        {
+            if (i + 1 < argc)
+            {
+                jsonPath = argv[++i];
+            }
+            else
+            {
+                fUsage = TRUE;
+            }
+        }
+        else
+        {
+            records = strtoull(argv[i], nullptr, 10);
+            fUsage = fUsage || (records == 0);
+        }
+    }
+
+    if (fUsage)
+    {
+        printf("Usage: %s [records] [--json <file>]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu records per struct, ns/record\n\n", records);
+    printf("%-22s %6s %12s %12s %12s\n", "struct", "bytes", "encode", "decode", "memcpy x2");
+
+    result = SarBenchCodec<SAR_CONFIG_HEADER>(records, SarEncodeConfigHeader, SarDecodeConfigHeader);
+    SarBenchPrint(&SarConfigHeaderLayout, &result);
+    checksum ^= result.Checksum;
+
+    result = SarBenchCodec<SAR_CONFIG_VALUES>(records, SarEncodeConfigValues, SarDecodeConfigValues);
+    SarBenchPrint(&SarConfigValuesLayout, &result);
+    checksum ^= result.Checksum;
+
+    result = SarBenchCodec<REGION_CONFIG_VALUES>(records, SarEncodeRegionConfig, SarDecodeRegionConfig);
+    SarBenchPrint(&SarRegionConfigLayout, &result);
+    checksum ^= result.Checksum;
+
+    result = SarBenchCodec<SAR_POWER_TABLE>(records, SarEncodePowerTable, SarDecodePowerTable);
+    SarBenchPrint(&SarPowerTableLayout, &result);
+    checksum ^= result.Checksum;
+
+    result = SarBenchCodec<WDI_SAR_STATE>(records, SarEncodeSarState, SarDecodeSarState);
+    SarBenchPrint(&SarStateLayout, &result);
+    checksum ^= result.Checksum;
+
+    result = SarBenchCodec<WDI_SAR_CONFIG_SET>(records, SarEncodeSarConfigSet, SarDecodeSarConfigSet);
+    SarBenchPrint(&SarConfigSetLayout, &result);
+    checksum ^= result.Checksum;
+
+    printf("\nchecksum %016llx\n", (unsigned long long)checksum);
+
+    size_t roundTrips = (records / SAR_BENCH_ROUND_TRIP_DIVISOR) ? (records / SAR_BENCH_ROUND_TRIP_DIVISOR) : 1;
+    HRESULT hr = S_OK;
+
+    printf("\nWDI_SET_SAR_STATE requests through SarWifiBuildSetSarState, ns/request\n\n");
+    printf("%-22s %6s %6s %12s %12s\n", "request", "pairs", "bytes", "build", "per pair");
+
+    hr = SarBenchSetSarState(records);
+
+    printf("\nSAR_POWER_TABLE through SarEncodeConfigBlob/SarDecodeConfigBlob, ns/table\n\n");
+    printf("%-22s %12s %12s %12s\n", "table", "bytes", "encode", "decode");
+
+    for (const SAR_BENCH_TABLE_RUN& run : SarBenchTableRuns)
+    {
+        HRESULT hrTables = SarBenchCompressedTables(run.Name, run.Shape, records);
+        if (SUCCEEDED(hr))
+        {
+            hr = hrTables;
+        }
+    }
+
+    printf("\nSAR_POWER_TABLE formatted for getconfig, ns/table\n\n");
+    printf("%-22s %12s\n", "format", "table");
+
+    HRESULT hrFormat = SarBenchFormat(roundTrips);
+    if (SUCCEEDED(hr))
+    {
+        hr = hrFormat;
+    }
+
+    printf("\nSAR_POWER_TABLE against per-entry caps, ns/table\n\n");
+    printf("%-22s %12s %12s\n", "kernel", "over/table", "check");
+
+    HRESULT hrValidation = SarBenchValidation(records);
+    if (SUCCEEDED(hr))
+    {
+        hr = hrValidation;
+    }
+
+    printf("\nColumn scans (count, min, max and sum), ns/value\n\n");
+    printf("%-22s %6s %12s %12s\n", "kernel", "width", "scan", "GB/s");
+
+    HRESULT hrColumns = SarBenchColumns(records);
+    if (SUCCEEDED(hr))
+    {
+        hr = hrColumns;
+    }
+
+    printf("\nUEFI round-trips of all four variables, ns/batch\n\n");
+    printf("%-22s %6s %12s %12s\n", "store", "count", "write", "read");
+
+    SarMemoryFirmwareStore memoryStore;
+    HRESULT hrMemory = SarBenchFirmwareStore("memory", &memoryStore, roundTrips, FALSE);
+    HRESULT hrMemoryCompressed = SarBenchFirmwareStore("memory, compressed", &memoryStore, roundTrips, TRUE);
+    if (SUCCEEDED(hr))
+    {
+        hr = FAILED(hrMemory) ? hrMemory : hrMemoryCompressed;
+    }
+
+    printf("\ngetconfig reads of all four structs, ns/read\n\n");
+    printf("%-22s %6s %12s\n", "path", "count", "read");
+
+    HRESULT hrGetConfig = S_OK;
+#ifdef _WIN32
+    std::string configRoot = "SarBench-" + std::to_string(GetCurrentProcessId());
+    if (CreateDirectoryA(configRoot.c_str(), nullptr))
+    {
+        hrGetConfig = SarBenchGetConfig(configRoot.c_str(), roundTrips);
+        RemoveDirectoryA(configRoot.c_str());
+    }
+#else
+    char configRoot[] = "/tmp/sarbench-getconfig-XXXXXX";
+    if (mkdtemp(configRoot) != nullptr)
+    {
+        hrGetConfig = SarBenchGetConfig(configRoot, roundTrips);
+        rmdir(configRoot);
+    }
+#endif
+    if (SUCCEEDED(hr))
+    {
+        hr = hrGetConfig;
+    }
+
+#ifndef _WIN32
+    // efivarfs itself needs root and real firmware; exercise the same code against a scratch
+    // directory instead.
+    char efivarsRoot[] = "/tmp/sarbench-efivars-XXXXXX";
+    if (mkdtemp(efivarsRoot) != nullptr)
+    {
+        SarEfivarfsFirmwareStore efivarfsStore(efivarsRoot);
+        HRESULT hrEfivarfs = SarBenchFirmwareStore("efivarfs (scratch dir)", &efivarfsStore, roundTrips, FALSE);
+        HRESULT hrEfivarfsCompressed = SarBenchFirmwareStore("efivarfs, compressed", &efivarfsStore, roundTrips, TRUE);
+        if (SUCCEEDED(hr))
+        {
+            hr = FAILED(hrEfivarfs) ? hrEfivarfs : hrEfivarfsCompressed;
+        }
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            unlink(efivarfsStore.VariablePath((SAR_CONFIG_BLOB_ID)blobId).c_str());
+        }
+        rmdir(efivarsRoot);
+    }
+#endif
+
+    HRESULT hrHistogram = SarBenchHistogram(records);
+    if (SUCCEEDED(hr))
+    {
+        hr = hrHistogram;
+    }
+
+    printf("\nUnsolicited notifications, ns/post on the callback thread\n\n");
+    printf("%-22s %12s %12s %12s %12s\n", "", "ns/post", "logged", "dropped", "per batch");
+    HRESULT hrNotifications = SarBenchNotifications(roundTrips * 16);
+    if (SUCCEEDED(hr))
+    {
+        hr = hrNotifications;
+    }
+
+    printf("\nBinary event log (%u segments of %u KB), ns/event\n\n", SAR_BENCH_EVENT_LOG_SEGMENTS, SAR_BENCH_EVENT_LOG_SEGMENT_SIZE / 1024);
+    printf("%-22s %12s %12s %12s %12s %8s\n", "", "append", "decode text", "decode csv", "bytes/event", "segments");
+
+    HRESULT hrEventLog = S_OK;
+#ifdef _WIN32
+    std::string eventLogBase = "SarBench-" + std::to_string(GetCurrentProcessId());
+    hrEventLog = SarBenchEventLog(eventLogBase.c_str(), records);
+#else
+    char eventLogRoot[] = "/tmp/sarbench-eventlog-XXXXXX";
+    if (mkdtemp(eventLogRoot) != nullptr)
+    {
+        std::string eventLogBase = std::string(eventLogRoot) + "/events";
+        hrEventLog = SarBenchEventLog(eventLogBase.c_str(), records);
+        rmdir(eventLogRoot);
+    }
+#endif
+    if (SUCCEEDED(hr))
+    {
+        hr = hrEventLog;
+    }
+
+    printf("\nWi-Fi SAR set/get requests of %u pairs through the device service\n\n", SAR_BENCH_CONFIG_SETS);
+    printf("%-22s %6s %12s %12s\n", "path", "clients", "req/s", "us/req");
+
+    HRESULT hrServer = S_OK;
+#ifdef _WIN32
+    std::string endpoint = "\\\\.\\pipe\\SarBench-" + std::to_string(GetCurrentProcessId());
+    hrServer = SarBenchServer(endpoint.c_str(), roundTrips);
+#else
+    char serverRoot[] = "/tmp/sarbench-server-XXXXXX";
+    if (mkdtemp(serverRoot) != nullptr)
+    {
+        std::string endpoint = std::string(serverRoot) + "/sar.sock";
+        hrServer = SarBenchServer(endpoint.c_str(), roundTrips);
+        rmdir(serverRoot);
+    }
+#endif
+    if (SUCCEEDED(hr))
+    {
+        hr = hrServer;
+    }
+
+    printf("\nInterface version cache lookups, ns/lookup\n\n");
+    printf("%-22s %6s %12s\n", "operation", "ifaces", "time");
+
+    HRESULT hrVersionCache = S_OK;
+#ifdef _WIN32
+    std::string versionCacheRoot = "SarBench-" + std::to_string(GetCurrentProcessId());
+    if (CreateDirectoryA(versionCacheRoot.c_str(), nullptr))
+    {
+        hrVersionCache = SarBenchInterfaceVersionCache(versionCacheRoot.c_str(), roundTrips);
+        RemoveDirectoryA(versionCacheRoot.c_str());
+    }
+#else
+    char versionCacheRoot[] = "/tmp/sarbench-version-cache-XXXXXX";
+    if (mkdtemp(versionCacheRoot) != nullptr)
+    {
+        hrVersionCache = SarBenchInterfaceVersionCache(versionCacheRoot, roundTrips);
+        rmdir(versionCacheRoot);
+    }
+#endif
+    if (SUCCEEDED(hr))
+    {
+        hr = hrVersionCache;
+    }
+
+    printf("\nWi-Fi SAR sets to every WLAN interface (%u us per interface), us/set\n\n", SAR_BENCH_FAN_OUT_LATENCY);
+    printf("%-22s %6s %12s %12s\n", "request", "ifaces", "serial", "fan-out");
+
+    HRESULT hrFanOut = SarBenchFanOut(std::min(roundTrips, SAR_BENCH_FAN_OUT_REQUESTS));
+    if (SUCCEEDED(hr))
+    {
+        hr = hrFanOut;
+    }
+
+    printf("\nA sensor flapping every %u us against a %u us driver, by coalescing window\n\n",
+           SAR_BENCH_COALESCE_INTERVAL, SAR_BENCH_COALESCE_LATENCY);
+    printf("%-22s %6s %12s %12s %12s\n", "request", "ms", "sets", "driver calls", "us/set");
+
+    HRESULT hrCoalesce = SarBenchCoalesce();
+    if (SUCCEEDED(hr))
+    {
+        hr = hrCoalesce;
+    }
+
+    if (jsonPath != nullptr)
+    {
+        HRESULT hrJson = SarBenchWriteJson(jsonPath, records);
+        if (FAILED(hrJson))
+        {
+            printf("\nFailed to write %s, hr = 0x%08x\n", jsonPath, (UINT32)hrJson);
+            hr = SUCCEEDED(hr) ? hrJson : hr;
+        }
+    }
+
+    return SUCCEEDED(hr) ? 0 : 1;
+}
+
+// eof: SarBench.cpp
+//
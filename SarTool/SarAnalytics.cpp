@@ -0,0 +1,404 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarAnalytics.cpp
+
+Abstract:
+
+    Online analytics of unsolicited SAR requests.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarAnalytics.h"
+#include "SarConfigFiles.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const UINT64 SAR_NS_PER_MS = 1000000;
+
+// Weight of the newest interval in the interval EWMA.
+//
+static const double SAR_ANALYTICS_INTERVAL_ALPHA = 1.0 / 8;
+
+SarRequestAnalytics::SarRequestAnalytics(
+    _In_ FILE* stream,
+    UINT32 summaryIntervalMilliseconds,
+    UINT32 expectedIntervalMilliseconds
+    ) :
+    m_stream(stream),
+    m_summaryInterval((UINT64)summaryIntervalMilliseconds * SAR_NS_PER_MS),
+    m_expectedInterval((UINT64)expectedIntervalMilliseconds * SAR_NS_PER_MS),
+    m_burstGap((UINT64)(expectedIntervalMilliseconds ? expectedIntervalMilliseconds : SAR_ANALYTICS_DEFAULT_BURST_GAP_MS) * SAR_NS_PER_MS),
+    m_start(SarStatsNow()),
+    m_lastSummary(m_start),
+    m_opcodes(SAR_ANALYTICS_MAX_OPCODES + 1)
+{
+    for (Opcode& opcode : m_opcodes)
+    {
+        opcode.fUsed = FALSE;
+        opcode.Source = SarAnalyticsSarRequest;
+        opcode.Code = 0;
+        opcode.Count = 0;
+        opcode.CountAtSummary = 0;
+        opcode.FirstTimestamp = 0;
+        opcode.LastTimestamp = 0;
+        opcode.Rate = 0.0;
+        opcode.IntervalEwma = 0.0;
+        opcode.BurstLength = 0;
+        opcode.LongestBurst = 0;
+        opcode.Bursts = 0;
+        opcode.Early = 0;
+    }
+}
+
+SarRequestAnalytics::Opcode*
+SarRequestAnalytics::Find(
+    SAR_ANALYTICS_SOURCE source,
+    UINT32 code
+    )
+/*++
+
+Routine Description:
+
+    Finds or claims the record of an opcode.  A monitor sees a handful of opcodes, so a linear
+    scan of the small table is cheaper than hashing; once the table is full, new opcodes are
+    folded into the overflow record.
+
+--*/
+{
+    for (UINT32 i = 0; i < SAR_ANALYTICS_MAX_OPCODES; i++)
+    {
+        Opcode* opcode = &m_opcodes[i];
+
+        if (!opcode->fUsed)
+        {
+            opcode->fUsed = TRUE;
+            opcode->Source = source;
+            opcode->Code = code;
+            return opcode;
+        }
+
+        if ((opcode->Source == source) && (opcode->Code == code))
+        {
+            return opcode;
+        }
+    }
+
+    m_opcodes[SAR_ANALYTICS_MAX_OPCODES].fUsed = TRUE;
+    return &m_opcodes[SAR_ANALYTICS_MAX_OPCODES];
+}
+
+VOID
+SarRequestAnalytics::Record(
+    SAR_ANALYTICS_SOURCE source,
+    UINT32 code,
+    UINT64 timestamp
+    )
+/*++
+
+Routine Description:
+
+    Folds one request into its opcode's record in constant time.  The rate decays continuously:
+    each request adds 1/window to a rate that has decayed by exp(-elapsed/window) since the
+    previous one, so a steady stream of r requests per second converges on r.
+
+Arguments:
+
+    source - Whether code is a SAR request code or a notification code.
+    code - The opcode.
+    timestamp - When the request arrived (SarStatsNow().)
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    const double window = SAR_ANALYTICS_RATE_WINDOW_MS / 1000.0;
+    Opcode* opcode = Find(source, code);
+
+    if (opcode->Count == 0)
+    {
+        opcode->Rate = 1.0 / window;
+        opcode->BurstLength = 1;
+        opcode->LongestBurst = 1;
+        opcode->FirstTimestamp = timestamp;
+    }
+    else
+    {
+        UINT64 interval = (timestamp > opcode->LastTimestamp) ? timestamp - opcode->LastTimestamp : 0;
+
+        opcode->Rate = opcode->Rate * exp(-(interval / 1e9) / window) + 1.0 / window;
+        opcode->Intervals.Record(interval);
+
+        if (opcode->Intervals.Count() == 1)
+        {
+            opcode->IntervalEwma = (double)interval;
+        }
+        else
+        {
+            opcode->IntervalEwma += SAR_ANALYTICS_INTERVAL_ALPHA * ((double)interval - opcode->IntervalEwma);
+        }
+
+        if ((m_expectedInterval != 0) && (interval < m_expectedInterval))
+        {
+            opcode->Early++;
+        }
+
+        if (interval <= m_burstGap)
+        {
+            opcode->BurstLength++;
+            if (opcode->BurstLength == SAR_ANALYTICS_MIN_BURST)
+            {
+                opcode->Bursts++;
+            }
+            if (opcode->BurstLength > opcode->LongestBurst)
+            {
+                opcode->LongestBurst = opcode->BurstLength;
+            }
+        }
+        else
+        {
+            opcode->BurstLength = 1;
+        }
+    }
+
+    opcode->Count++;
+    if (timestamp > opcode->LastTimestamp)
+    {
+        opcode->LastTimestamp = timestamp;
+    }
+}
+
+UINT64
+SarRequestAnalytics::TimeToSummary(
+    UINT64 now
+    ) const
+{
+    UINT64 due = m_lastSummary + m_summaryInterval;
+
+    return (now >= due) ? 0 : due - now;
+}
+
+VOID
+SarRequestAnalytics::PrintSummary(
+    UINT64 now
+    )
+/*++
+
+Routine Description:
+
+    Writes one line per opcode seen so far, e.g.
+
+        unsolicited requests after 60.0 s (SARUnsolicitedUpdateTimer 1000 ms):
+          request 0x1          count 58 (+10)  rate 0.98/s  interval ewma 1001.2 ms  p50 1000.0 ms  p99 1015.0 ms  min 998.1 ms  max 1020.4 ms  bursts 0 (longest 1)  early 2
+
+    Rates are decayed to now, so an opcode that stopped arriving shows a falling rate, and divided
+    by the weight the window has accumulated since the opcode first arrived, so they are not
+    biased low while the monitor has been running for less than a few windows.  Bursts
+    are runs of at least SAR_ANALYTICS_MIN_BURST requests; "early" only appears when the expected
+    interval is known.
+
+Arguments:
+
+    now - The current SarStatsNow().
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    const double window = SAR_ANALYTICS_RATE_WINDOW_MS / 1000.0;
+    BOOL fAny = FALSE;
+
+    if (m_expectedInterval != 0)
+    {
+        fprintf(m_stream, "unsolicited requests after %.1f s (SARUnsolicitedUpdateTimer %llu ms):\n",
+                (now - m_start) / 1e9,
+                (unsigned long long)(m_expectedInterval / SAR_NS_PER_MS));
+    }
+    else
+    {
+        fprintf(m_stream, "unsolicited requests after %.1f s:\n", (now - m_start) / 1e9);
+    }
+
+    for (UINT32 i = 0; i <= SAR_ANALYTICS_MAX_OPCODES; i++)
+    {
+        Opcode* opcode = &m_opcodes[i];
+        char name[32];
+        double rate;
+        double elapsed;
+
+        if (!opcode->fUsed || (opcode->Count == 0))
+        {
+            continue;
+        }
+
+        if (i == SAR_ANALYTICS_MAX_OPCODES)
+        {
+            snprintf(name, sizeof(name), "other");
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "%s 0x%x",
+                     (opcode->Source == SarAnalyticsSarRequest) ? "request" : "notification",
+                     opcode->Code);
+        }
+
+        rate = opcode->Rate * exp(-(((now > opcode->LastTimestamp) ? now - opcode->LastTimestamp : 0) / 1e9) / window);
+        elapsed = ((now > opcode->FirstTimestamp) ? now - opcode->FirstTimestamp : 0) / 1e9;
+        if (elapsed > 0)
+        {
+            rate /= 1.0 - exp(-elapsed / window);
+        }
+
+        fprintf(m_stream,
+                "  %-20s count %llu (+%llu)  rate %.2f/s  interval ewma %.1f ms  p50 %.1f ms  p99 %.1f ms  min %.1f ms  max %.1f ms  bursts %llu (longest %u)",
+                name,
+                (unsigned long long)opcode->Count,
+                (unsigned long long)(opcode->Count - opcode->CountAtSummary),
+                rate,
+                opcode->IntervalEwma / SAR_NS_PER_MS,
+                (double)opcode->Intervals.Percentile(0.50) / SAR_NS_PER_MS,
+                (double)opcode->Intervals.Percentile(0.99) / SAR_NS_PER_MS,
+                (double)opcode->Intervals.Min() / SAR_NS_PER_MS,
+                (double)opcode->Intervals.Max() / SAR_NS_PER_MS,
+                (unsigned long long)opcode->Bursts,
+                opcode->LongestBurst);
+
+        if (m_expectedInterval != 0)
+        {
+            fprintf(m_stream, "  early %llu", (unsigned long long)opcode->Early);
+        }
+        fprintf(m_stream, "\n");
+
+        opcode->CountAtSummary = opcode->Count;
+        fAny = TRUE;
+    }
+
+    if (!fAny)
+    {
+        fprintf(m_stream, "  none\n");
+    }
+    fflush(m_stream);
+
+    m_lastSummary = now;
+}
+
+_Check_return_
+HRESULT
+SarAnalyticsTakeOptions(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ UINT32* pSummaryIntervalMilliseconds,
+    _Out_ LPCSTR* pTimer
+    )
+{
+    HRESULT hr = S_OK;
+    int kept = 0;
+    char* end;
+    double seconds;
+
+    *pSummaryIntervalMilliseconds = 0;
+    *pTimer = nullptr;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--summary")))
+        {
+            if (i + 1 < *argc)
+            {
+                // The range check also fails NaN, so the conversion below is always defined.
+                seconds = strtod(argv[i + 1], &end);
+                if ((end == argv[i + 1]) || (*end != '\0') ||
+                    !((seconds > 0) && (seconds <= SAR_ANALYTICS_MAX_SUMMARY_SECONDS)))
+                {
+                    hr = E_INVALIDARG;
+                }
+                else
+                {
+                    // A zero interval would summarize continuously.
+                    *pSummaryIntervalMilliseconds = (UINT32)ceil(seconds * 1000);
+                }
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+
+            i++;
+            continue;
+        }
+
+        if ((i > 0) && (0 == strcmp(argv[i], "--timer")))
+        {
+            if (i + 1 < *argc)
+            {
+                *pTimer = argv[i + 1];
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+
+            i++;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    // The timer only feeds the summaries.
+    if ((*pTimer != nullptr) && (*pSummaryIntervalMilliseconds == 0))
+    {
+        hr = E_INVALIDARG;
+    }
+
+    *argc = kept;
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarAnalyticsResolveTimer(
+    _In_z_ LPCSTR timer,
+    _Out_ UINT32* pMilliseconds
+    )
+{
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS blobs;
+    char* end = nullptr;
+    unsigned long milliseconds = strtoul(timer, &end, 0);
+
+    *pMilliseconds = 0;
+
+    if ((end != timer) && (*end == '\0'))
+    {
+        *pMilliseconds = (UINT32)milliseconds;
+        goto exit;
+    }
+
+    hr = SarConfigLoad(timer, &blobs);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    *pMilliseconds = blobs.Values.SARUnsolicitedUpdateTimer;
+
+exit:
+    return hr;
+}
+
+// eof: SarAnalytics.cpp
+//
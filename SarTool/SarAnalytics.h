@@ -0,0 +1,161 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarAnalytics.h
+
+Abstract:
+
+    Online analytics of unsolicited SAR requests, so a monitor can show request rates and bursts
+    (and whether the IHV driver honours SARUnsolicitedUpdateTimer) without keeping every event.
+
+    Each opcode - the request code of a SAR notification, or the notification code of any other
+    device service - gets a fixed-size record with
+
+        Count                   Requests seen, in total and since the last summary.
+        Rate                    Exponentially weighted requests per second over about
+                                SAR_ANALYTICS_RATE_WINDOW_MS.
+        Interval                EWMA and log-bucketed histogram (see SarStats.h) of the time
+                                between consecutive requests.
+        Bursts                  Runs of at least SAR_ANALYTICS_MIN_BURST requests, each arriving
+                                within the burst gap of the one before.
+        Early                   Intervals shorter than the expected SARUnsolicitedUpdateTimer.
+
+    The table holds SAR_ANALYTICS_MAX_OPCODES opcodes; any further opcodes share one overflow
+    record, so memory is constant however many distinct requests arrive.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include "SarStats.h"
+
+#include <stdio.h>
+#include <vector>
+
+static const UINT32 SAR_ANALYTICS_MAX_OPCODES = 16;
+static const UINT32 SAR_ANALYTICS_RATE_WINDOW_MS = 10000;
+static const UINT32 SAR_ANALYTICS_MIN_BURST = 4;
+
+// Burst gap used when no SARUnsolicitedUpdateTimer is given.
+//
+static const UINT32 SAR_ANALYTICS_DEFAULT_BURST_GAP_MS = 100;
+
+// The longest --summary interval accepted, in seconds (a day.)
+//
+static const double SAR_ANALYTICS_MAX_SUMMARY_SECONDS = 86400;
+
+typedef enum _SAR_ANALYTICS_SOURCE
+{
+    SarAnalyticsSarRequest,             // Keyed by the request code in the notification data.
+    SarAnalyticsNotification,           // Keyed by the notification code.
+} SAR_ANALYTICS_SOURCE;
+
+class SarRequestAnalytics
+{
+public:
+
+    // Summaries are written to stream every summaryIntervalMilliseconds.  expectedIntervalMilliseconds
+    // is the configured SARUnsolicitedUpdateTimer, or 0 if unknown.
+    //
+    SarRequestAnalytics(
+        _In_ FILE* stream,
+        UINT32 summaryIntervalMilliseconds,
+        UINT32 expectedIntervalMilliseconds
+        );
+
+    SarRequestAnalytics(const SarRequestAnalytics&) = delete;
+    SarRequestAnalytics& operator=(const SarRequestAnalytics&) = delete;
+
+    // All methods are called from one thread (the notification pipeline's consumer.)  Timestamps
+    // are SarStatsNow() values.
+    //
+    VOID
+    Record(
+        SAR_ANALYTICS_SOURCE source,
+        UINT32 code,
+        UINT64 timestamp
+        );
+
+    // Nanoseconds until the next summary is due (0 if it is overdue.)
+    //
+    UINT64
+    TimeToSummary(
+        UINT64 now
+        ) const;
+
+    VOID
+    PrintSummary(
+        UINT64 now
+        );
+
+private:
+
+    struct Opcode
+    {
+        BOOL fUsed;
+        SAR_ANALYTICS_SOURCE Source;
+        UINT32 Code;
+        UINT64 Count;
+        UINT64 CountAtSummary;
+        UINT64 FirstTimestamp;
+        UINT64 LastTimestamp;
+        double Rate;                    // Requests per second as of LastTimestamp.
+        double IntervalEwma;            // Nanoseconds.
+        UINT32 BurstLength;             // Of the run ending at LastTimestamp.
+        UINT32 LongestBurst;
+        UINT64 Bursts;
+        UINT64 Early;
+        SarHistogram Intervals;
+    };
+
+    Opcode*
+    Find(
+        SAR_ANALYTICS_SOURCE source,
+        UINT32 code
+        );
+
+    FILE* m_stream;
+    UINT64 m_summaryInterval;           // Nanoseconds.
+    UINT64 m_expectedInterval;          // Nanoseconds, or 0.
+    UINT64 m_burstGap;                  // Nanoseconds.
+    UINT64 m_start;
+    UINT64 m_lastSummary;
+    std::vector<Opcode> m_opcodes;      // SAR_ANALYTICS_MAX_OPCODES, then the overflow record.
+};
+
+// Removes "--summary <seconds>" and "--timer <milliseconds | configuration source>" from the
+// command line.  *pSummaryIntervalMilliseconds receives the summary interval, or 0 if --summary
+// was not given, and *pTimer the timer argument or nullptr.  Returns E_INVALIDARG if a value is
+// missing, the interval is not a number greater than 0 and at most
+// SAR_ANALYTICS_MAX_SUMMARY_SECONDS, or --timer is given without --summary.
+//
+_Check_return_
+HRESULT
+SarAnalyticsTakeOptions(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ UINT32* pSummaryIntervalMilliseconds,
+    _Out_ LPCSTR* pTimer
+    );
+
+// Resolves a --timer argument: either a number of milliseconds, or a configuration source (UEFI,
+// a folder of .bin files or a .sarc container) whose SARUnsolicitedUpdateTimer, in milliseconds,
+// is used.
+//
+_Check_return_
+HRESULT
+SarAnalyticsResolveTimer(
+    _In_z_ LPCSTR timer,
+    _Out_ UINT32* pMilliseconds
+    );
+
+// eof: SarAnalytics.h
+//
@@ -0,0 +1,1577 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarApi.cpp
+
+Abstract:
+
+    Sessions behind the C interface in SarApi.h.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarApi.h"
+#include "SarConfigFiles.h"
+#include "SarContainer.h"
+#include "SarDeviceService.h"
+#include "SarFanOut.h"
+#include "SarFirmwareStore.h"
+#include "SarInterfaceVersion.h"
+#include "SarServer.h"
+#include "SarSetQueue.h"
+#include "SarStats.h"
+#include "SarTableCompression.h"
+
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include "winrt\Windows.Networking.NetworkOperators.h"
+
+// link an umbrella app lib that resolves WINRT_SetRestrictedErrorInfo and other external symbols
+#pragma comment(lib, "windowsapp")
+
+using namespace winrt::Windows::Networking::NetworkOperators;
+#endif // _WIN32
+
+// The WLAN adapters of a mock session.
+//
+static const UINT32 SAR_MOCK_INTERFACE_COUNT = 2;
+
+// The SAR interface version one WLAN interface's handshake found, for the ...WifiSarAll calls.
+//
+typedef struct _SAR_SESSION_INTERFACE_VERSION
+{
+    GUID InterfaceGuid;
+    SAR_INTERFACE_VERSION Version;
+} SAR_SESSION_INTERFACE_VERSION;
+
+struct _SAR_SESSION
+{
+    SAR_SESSION_TRANSPORT Transport = SarSessionLocal;
+
+    // Wi-Fi SAR; nullptr where the transport has no Wi-Fi device (local sessions off Windows.)
+    SarDeviceService* Device = nullptr;
+    std::unique_ptr<SarDeviceService> OwnedDevice;
+
+    // Every WLAN interface, for the ...WifiSarAll calls; nullptr where the transport has none
+    // (remote sessions and local sessions off Windows.)  The workers are kept between calls.
+    SarInterfaceSet* Interfaces = nullptr;
+    std::unique_ptr<SarInterfaceSet> OwnedInterfaces;
+    std::unique_ptr<SarThreadPool> FanOutPool;
+
+    SarFirmwareStore* Store = nullptr;
+    std::unique_ptr<SarFirmwareStore> OwnedStore;
+
+    // The Wi-Fi driver's SAR interface version, from the first Wi-Fi call's handshake.  Only local
+    // sessions keep it in the cache file for later sessions.
+    std::string VersionCachePath;
+    BOOL fVersionKnown = FALSE;
+    SAR_INTERFACE_VERSION InterfaceVersion = { 0, 0 };
+
+    // The handshakes of the ...WifiSarAll calls, one per interface, made from the fan-out's
+    // workers.
+    std::mutex InterfaceVersionsLock;
+    std::vector<SAR_SESSION_INTERFACE_VERSION> InterfaceVersions;
+
+    // The mock modem.
+    BOOL MockLteBackoffEnabled = FALSE;
+    std::vector<SAR_LTE_ANTENNA> MockLteAntennas;
+
+#ifdef _WIN32
+    // The session keeps the MTA alive, so the modem can be used from any of the caller's threads,
+    // and keeps the modem's SarManager rather than looking it up for every call.
+    CO_MTA_USAGE_COOKIE MtaCookie = nullptr;
+    MobileBroadbandSarManager LteSarManager{ nullptr };
+#endif
+
+    // The coalescing queue in front of the Wi-Fi and LTE sets (SarSessionSetCoalescing), or
+    // nullptr if sets are sent at once.  Its workers use the members above, so it is declared
+    // last and is destroyed, sending any pending set, first.
+    std::unique_ptr<SarSetQueue> SetQueue;
+    UINT32 WifiLane = 0;
+    UINT32 LteLane = 0;
+
+    // Each lane's Failed count as of its last read, so a read reports a failed queued set once.
+    std::atomic<UINT64> WifiFailuresReported{ 0 };
+    std::atomic<UINT64> LteFailuresReported{ 0 };
+};
+
+// Runs the body of an API function; no C++ exception may cross the C interface.
+//
+template <typename Body>
+static
+HRESULT
+SarApiGuard(
+    Body body
+    )
+{
+    try
+    {
+        return body();
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+#ifdef _WIN32
+    catch (const winrt::hresult_error& ex)
+    {
+        return ex.code();
+    }
+#endif
+    catch (...)
+    {
+        return E_UNEXPECTED;
+    }
+}
+
+#ifdef _WIN32
+
+_Check_return_
+static
+HRESULT
+SarSessionGetLteSarManager(
+    _In_ SAR_SESSION* session,
+    BOOL fRefresh,
+    _Out_ MobileBroadbandSarManager* sarManager
+    )
+/*++
+
+Routine Description:
+
+    Returns the modem's SarManager, looking it up on first use (or when the caller found the cached
+    one no longer works, e.g. after the modem was reset.)
+
+Arguments:
+
+    session - The session.
+    fRefresh - TRUE to look the SarManager up again.
+    sarManager - Receives the SarManager.
+
+Return Value:
+
+    S_OK on success, E_POINTER if the modem has no SarManager, or the underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT64 start;
+
+    if (session->MtaCookie == nullptr)
+    {
+        hr = CoIncrementMTAUsage(&session->MtaCookie);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    if (fRefresh || !session->LteSarManager)
+    {
+        start = SarStatsNow();
+        auto modem = MobileBroadbandModem::GetDefault();
+        auto config = modem.GetCurrentConfigurationAsync().get();
+        session->LteSarManager = config.SarManager();
+        SarStatsRecord(SarStatLteGetModem, start);
+    }
+
+    if (!session->LteSarManager)
+    {
+        hr = E_POINTER;
+        goto exit;
+    }
+
+    *sarManager = session->LteSarManager;
+
+exit:
+    return hr;
+}
+
+// Runs an LTE operation against the cached SarManager, looking the SarManager up again and
+// retrying once if the operation fails.
+//
+template <typename Operation>
+static
+HRESULT
+SarSessionLteCall(
+    _In_ SAR_SESSION* session,
+    Operation operation
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fCached = (session->LteSarManager != nullptr);
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        MobileBroadbandSarManager sarManager{ nullptr };
+
+        hr = SarApiGuard([&]() { return SarSessionGetLteSarManager(session, attempt > 0, &sarManager); });
+        if (SUCCEEDED(hr))
+        {
+            hr = SarApiGuard([&]() { return operation(sarManager); });
+        }
+
+        if (SUCCEEDED(hr) || !fCached)
+        {
+            break;
+        }
+    }
+
+    return hr;
+}
+
+#endif // _WIN32
+
+_Check_return_
+static
+HRESULT
+SarSessionLearnVersion(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Learns the Wi-Fi driver's SAR interface version once per session (see SarInterfaceVersion.h),
+    so no other Wi-Fi call pays for it.
+
+Arguments:
+
+    session - A session with a Wi-Fi device.
+
+Return Value:
+
+    S_OK, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if SarTool cannot drive the driver, or the
+    failure code of WDI_GET_INTERFACE_VERSION, in which case the next call asks again.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    if (!session->fVersionKnown)
+    {
+        hr = SarWifiHandshake(session->Device,
+                              session->VersionCachePath.empty() ? nullptr : session->VersionCachePath.c_str(),
+                              &session->InterfaceVersion);
+        if (SUCCEEDED(hr) || (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH)))
+        {
+            session->fVersionKnown = TRUE;
+        }
+    }
+    else if (!SarInterfaceVersionIsCompatible(session->InterfaceVersion))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH);
+    }
+
+    return hr;
+}
+
+_Check_return_
+static
+HRESULT
+SarSessionHandshake(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Checks the driver's SAR interface version before a Wi-Fi get or set.  A SarTool server makes
+    the handshake once for all of its clients and fails their gets and sets itself, so a remote
+    session does not spend a round-trip on it.
+
+Arguments:
+
+    session - A session with a Wi-Fi device.
+
+Return Value:
+
+    As SarSessionLearnVersion; always S_OK for a remote session.
+
+--*/
+{
+    if (session->Transport == SarSessionRemote)
+    {
+        return S_OK;
+    }
+
+    return SarSessionLearnVersion(session);
+}
+
+_Check_return_
+static
+HRESULT
+SarSessionInterfaceHandshake(
+    _In_ SAR_SESSION* session,
+    _In_ const SAR_WIFI_INTERFACE& wifiInterface,
+    _Out_ SAR_WIFI_INTERFACE_SAR* interfaceSar
+    )
+/*++
+
+Routine Description:
+
+    SarSessionHandshake for one interface of a fan-out: learns the interface's SAR interface
+    version once per session, and records it in interfaceSar.  Runs on the fan-out's workers.
+
+Arguments:
+
+    session - A session with a set of interfaces.
+    wifiInterface - The interface.
+    interfaceSar - Receives the interface's version.
+
+Return Value:
+
+    S_OK, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if SarTool cannot drive the interface's
+    driver, or the failure code of WDI_GET_INTERFACE_VERSION, in which case the next call asks
+    again.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_SESSION_INTERFACE_VERSION known = { wifiInterface.InterfaceGuid, { 0, 0 } };
+    BOOL fKnown = FALSE;
+
+    {
+        std::lock_guard<std::mutex> lock(session->InterfaceVersionsLock);
+
+        for (const SAR_SESSION_INTERFACE_VERSION& interfaceVersion : session->InterfaceVersions)
+        {
+            if (0 == memcmp(&interfaceVersion.InterfaceGuid, &wifiInterface.InterfaceGuid, sizeof(GUID)))
+            {
+                known = interfaceVersion;
+                fKnown = TRUE;
+                break;
+            }
+        }
+    }
+
+    if (fKnown)
+    {
+        hr = SarInterfaceVersionIsCompatible(known.Version) ? S_OK : HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH);
+    }
+    else
+    {
+        hr = SarWifiHandshake(wifiInterface.Device.get(),
+                              session->VersionCachePath.empty() ? nullptr : session->VersionCachePath.c_str(),
+                              &known.Version);
+        if (SUCCEEDED(hr) || (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH)))
+        {
+            std::lock_guard<std::mutex> lock(session->InterfaceVersionsLock);
+
+            session->InterfaceVersions.push_back(known);
+        }
+    }
+
+    interfaceSar->InterfaceVersionMajor = known.Version.Major;
+    interfaceSar->InterfaceVersionMinor = known.Version.Minor;
+
+    return hr;
+}
+
+_Check_return_
+static
+HRESULT
+SarSessionWifiFanOut(
+    _In_ SAR_SESSION* session,
+    _Out_writes_opt_(capacity) SAR_WIFI_INTERFACE_SAR* interfaces,
+    UINT32 capacity,
+    _Out_ UINT32* count,
+    const std::function<HRESULT(const SAR_WIFI_INTERFACE& wifiInterface, SAR_WIFI_INTERFACE_SAR* interfaceSar)>& operation
+    )
+/*++
+
+Routine Description:
+
+    Runs a Wi-Fi request on every interface of the session at once (see SarFanOut.h), after each
+    interface's handshake, and copies out the interfaces' results.
+
+Arguments:
+
+    session - A session with a set of interfaces.
+    interfaces - Receives up to capacity interfaces' results.
+    capacity - Number of results interfaces can hold.
+    count - Receives the number of interfaces.
+    operation - The request, which fills in the interface's result.
+
+Return Value:
+
+    E_NOT_SUFFICIENT_BUFFER if there are more than capacity interfaces, otherwise S_OK if the
+    request succeeded on every interface, the first interface's failure, or the failure to
+    enumerate the interfaces.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<SAR_WIFI_INTERFACE> wifiInterfaces;
+    std::vector<SAR_WIFI_INTERFACE_SAR> interfaceSars;
+    std::vector<HRESULT> results;
+
+    hr = session->Interfaces->Enumerate(&wifiInterfaces);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    interfaceSars.resize(wifiInterfaces.size());
+    memset(interfaceSars.data(), 0, interfaceSars.size() * sizeof(SAR_WIFI_INTERFACE_SAR));
+
+    hr = SarWifiFanOut(session->Interfaces,
+                       wifiInterfaces,
+                       &session->FanOutPool,
+                       [&](size_t index, const SAR_WIFI_INTERFACE& wifiInterface) -> HRESULT
+                       {
+                           SAR_WIFI_INTERFACE_SAR* interfaceSar = &interfaceSars[index];
+
+                           interfaceSar->InterfaceGuid = wifiInterface.InterfaceGuid;
+
+                           // As for one interface, a driver that cannot be asked its version is
+                           // driven as before.
+                           interfaceSar->Status = SarApiGuard([&]() -> HRESULT
+                           {
+                               HRESULT interfaceHr = SarSessionInterfaceHandshake(session, wifiInterface, interfaceSar);
+
+                               if (interfaceHr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+                               {
+                                   return interfaceHr;
+                               }
+
+                               return operation(wifiInterface, interfaceSar);
+                           });
+
+                           return interfaceSar->Status;
+                       },
+                       &results);
+
+    *count = (UINT32)interfaceSars.size();
+
+    for (size_t i = 0; (i < interfaceSars.size()) && (i < capacity); i++)
+    {
+        interfaces[i] = interfaceSars[i];
+    }
+
+    return (interfaceSars.size() > capacity) ? E_NOT_SUFFICIENT_BUFFER : hr;
+}
+
+_Check_return_
+static
+HRESULT
+SarSessionSendWifiSar(
+    _In_ SAR_SESSION* session,
+    const std::vector<UINT8>& request,
+    _Out_opt_ WDI_SAR_RESULT* result
+    )
+/*++
+
+Routine Description:
+
+    Sends an encoded WDI_SET_SAR_STATE to the session's Wi-Fi device, after the session's
+    handshake.  Runs on the caller's thread, or on the coalescing queue's worker.
+
+Arguments:
+
+    session - A session with a Wi-Fi device.
+    request - The request, from SarWifiBuildSetSarState.
+    result - Optionally receives the driver's WDI_SAR_RESULT.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if SarTool cannot drive the
+    driver, or the underlying failure code.
+
+--*/
+{
+    return SarApiGuard([&]() -> HRESULT
+    {
+        HRESULT hr = SarSessionHandshake(session);
+
+        if (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+        {
+            return hr;
+        }
+
+        return SarWifiSendSetSarState(session->Device, request, result);
+    });
+}
+
+static
+BOOL
+SarSessionHasModem(
+    _In_ SAR_SESSION* session
+    )
+{
+#ifdef _WIN32
+    return (session->Transport == SarSessionMock) || (session->Transport == SarSessionLocal);
+#else
+    return (session->Transport == SarSessionMock);
+#endif
+}
+
+_Check_return_
+static
+HRESULT
+SarSessionSendLteSar(
+    _In_ SAR_SESSION* session,
+    _In_reads_(count) const SAR_LTE_ANTENNA* antennas,
+    UINT32 count
+    )
+/*++
+
+Routine Description:
+
+    Configures the LTE antennas with one SetConfigurationAsync.  The mock modem enables backoff
+    and updates (or adds) each antenna.  Runs on the caller's thread, or on the coalescing
+    queue's worker.
+
+Arguments:
+
+    session - A session with a modem.
+    antennas - The antennas and the backoff index each should use.
+    count - Number of antennas.
+
+Return Value:
+
+    S_OK on success, E_NOTIMPL if the session has no modem, or the underlying failure code.
+
+--*/
+{
+    if (session->Transport == SarSessionMock)
+    {
+        return SarApiGuard([&]() -> HRESULT
+        {
+            for (UINT32 i = 0; i < count; i++)
+            {
+                BOOL fFound = FALSE;
+
+                for (SAR_LTE_ANTENNA& antenna : session->MockLteAntennas)
+                {
+                    if (antenna.AntennaIndex == antennas[i].AntennaIndex)
+                    {
+                        antenna.SarBackoffIndex = antennas[i].SarBackoffIndex;
+                        fFound = TRUE;
+                    }
+                }
+
+                if (!fFound)
+                {
+                    session->MockLteAntennas.push_back(antennas[i]);
+                }
+            }
+
+            session->MockLteBackoffEnabled = TRUE;
+            return S_OK;
+        });
+    }
+
+#ifdef _WIN32
+    if (session->Transport == SarSessionLocal)
+    {
+        return SarSessionLteCall(session, [&](MobileBroadbandSarManager& sarManager) -> HRESULT
+        {
+            std::vector<MobileBroadbandAntennaSar> modemAntennas;
+            UINT64 start;
+
+            modemAntennas.reserve(count);
+            for (UINT32 i = 0; i < count; i++)
+            {
+                modemAntennas.emplace_back(antennas[i].AntennaIndex, antennas[i].SarBackoffIndex);
+            }
+
+            start = SarStatsNow();
+            sarManager.SetConfigurationAsync(std::move(modemAntennas)).get();
+            SarStatsRecord(SarStatLteSetConfiguration, start);
+            return S_OK;
+        });
+    }
+#endif
+
+    return E_NOTIMPL;
+}
+
+// Sends the lane's pending set, if sets are coalesced, so a read sees it.  Returns the failure of
+// the lane's last set if no read has returned it yet (failuresReported counts those that have),
+// otherwise S_OK.  A nullptr failuresReported leaves the failure to the next read.
+//
+_Check_return_
+static
+HRESULT
+SarSessionFlushLane(
+    _In_ SAR_SESSION* session,
+    UINT32 lane,
+    _Inout_opt_ std::atomic<UINT64>* failuresReported
+    )
+{
+    HRESULT hr;
+    SAR_SET_QUEUE_STATS stats = {};
+    UINT64 failuresBefore;
+
+    if (!session->SetQueue)
+    {
+        return S_OK;
+    }
+
+    hr = session->SetQueue->Flush(lane);
+    if (failuresReported == nullptr)
+    {
+        return S_OK;
+    }
+
+    // A failure a later set has since replaced is not returned; it stays in the counts.
+    session->SetQueue->GetStats(lane, &stats);
+    failuresBefore = failuresReported->exchange(stats.Failed);
+
+    return (FAILED(hr) && (stats.Failed != failuresBefore)) ? hr : S_OK;
+}
+
+UINT32
+SarApiVersion(
+    VOID
+    )
+{
+    return SAR_API_VERSION;
+}
+
+_Check_return_
+HRESULT
+SarSessionOpen(
+    SAR_SESSION_TRANSPORT transport,
+    _In_opt_z_ LPCSTR endpoint,
+    _Out_ SAR_SESSION** session
+    )
+/*++
+
+Routine Description:
+
+    Creates a session.  A remote session connects to its server here; the local devices are opened
+    on first use.
+
+Arguments:
+
+    transport - Where the session's SAR calls go.
+    endpoint - The server's endpoint (see SarTransport.h) for SarSessionRemote.
+    session - Receives the session, to be closed with SarSessionClose.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for an unknown transport or a remote session without an
+    endpoint, or the failure code from connecting to the server.
+
+--*/
+{
+    if (session == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *session = nullptr;
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        std::unique_ptr<SAR_SESSION> newSession(new SAR_SESSION());
+
+        newSession->Transport = transport;
+
+        switch (transport)
+        {
+        case SarSessionLocal:
+#ifdef _WIN32
+            newSession->Device = SarWlanDeviceServiceDefault();
+            newSession->Interfaces = SarWlanInterfaceSetDefault();
+#endif
+            newSession->Store = SarFirmwareStoreDefault();
+            newSession->VersionCachePath = SarInterfaceVersionCacheDefaultPath();
+            break;
+
+        case SarSessionMock:
+        {
+            std::vector<SAR_WIFI_INTERFACE> interfaces;
+
+            // Two adapters, so the ...WifiSarAll calls can be tested; the first is the session's
+            // Wi-Fi device.
+            newSession->OwnedInterfaces.reset(new SarMockInterfaceSet(SAR_MOCK_INTERFACE_COUNT));
+            newSession->Interfaces = newSession->OwnedInterfaces.get();
+            (VOID)newSession->Interfaces->Enumerate(&interfaces);
+            newSession->Device = interfaces[0].Device.get();
+            newSession->OwnedStore.reset(new SarMemoryFirmwareStore());
+            newSession->Store = newSession->OwnedStore.get();
+            newSession->MockLteAntennas.push_back({ 0, 0 });
+            newSession->MockLteAntennas.push_back({ 1, 0 });
+            break;
+        }
+
+        case SarSessionRemote:
+        {
+            std::unique_ptr<SarRemoteDeviceService> device(new SarRemoteDeviceService());
+            HRESULT hr;
+
+            if (endpoint == nullptr)
+            {
+                return E_INVALIDARG;
+            }
+
+            hr = device->Connect(endpoint);
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            newSession->Device = device.get();
+            newSession->OwnedDevice = std::move(device);
+            newSession->Store = SarFirmwareStoreDefault();
+            break;
+        }
+
+        default:
+            return E_INVALIDARG;
+        }
+
+        *session = newSession.release();
+        return S_OK;
+    });
+}
+
+VOID
+SarSessionClose(
+    _In_opt_ SAR_SESSION* session
+    )
+{
+    if (session == nullptr)
+    {
+        return;
+    }
+
+    // Send any pending set while the devices are still open.
+    session->SetQueue.reset();
+
+#ifdef _WIN32
+    session->LteSarManager = nullptr;
+    if (session->MtaCookie != nullptr)
+    {
+        (VOID)CoDecrementMTAUsage(session->MtaCookie);
+    }
+#endif
+
+    delete session;
+}
+
+_Check_return_
+HRESULT
+SarSessionGetWifiSar(
+    _In_ SAR_SESSION* session,
+    _Out_ WDI_SAR_STATE* state,
+    _Out_writes_opt_(capacity) WDI_SAR_CONFIG_SET* configSets,
+    UINT32 capacity
+    )
+/*++
+
+Routine Description:
+
+    Sends WDI_GET_SAR_STATE and copies out the state and its pairs.
+
+Arguments:
+
+    session - The session.
+    state - Receives the state.
+    configSets - Receives up to capacity pairs.
+    capacity - Number of pairs configSets can hold.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if the radio reported more than
+    capacity pairs, E_NOTIMPL if the session has no Wi-Fi device, or the underlying failure code.
+    A queued set's failure that no read has returned yet is returned in place of the read's
+    result.
+
+--*/
+{
+    HRESULT hr;
+    HRESULT hrFlush;
+
+    if ((session == nullptr) || (state == nullptr) || ((configSets == nullptr) && (capacity != 0)))
+    {
+        return E_POINTER;
+    }
+
+    if (session->Device == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    hrFlush = SarSessionFlushLane(session, session->WifiLane, &session->WifiFailuresReported);
+
+    hr = SarApiGuard([&]() -> HRESULT
+    {
+        std::vector<WDI_SAR_CONFIG_SET> allConfigSets;
+        HRESULT hr = SarSessionHandshake(session);
+
+        // A driver that cannot be asked its version is driven as before.
+        if (hr != HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+        {
+            hr = SarWifiGetSarState(session->Device, state, &allConfigSets);
+        }
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        for (size_t i = 0; (i < allConfigSets.size()) && (i < capacity); i++)
+        {
+            configSets[i] = allConfigSets[i];
+        }
+
+        return (allConfigSets.size() > capacity) ? E_NOT_SUFFICIENT_BUFFER : S_OK;
+    });
+
+    return FAILED(hrFlush) ? hrFlush : hr;
+}
+
+_Check_return_
+HRESULT
+SarSessionSetWifiSar(
+    _In_ SAR_SESSION* session,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(count) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 count,
+    _Out_opt_ WDI_SAR_RESULT* result
+    )
+/*++
+
+Routine Description:
+
+    Sends WDI_SET_SAR_STATE with the given state and pairs, or queues the request if sets are
+    coalesced.
+
+Arguments:
+
+    session - The session.
+    backoffState - Whether SAR backoff is enabled.
+    mimoConfigType - The MIMO configuration type.
+    configSets - The antenna and backoff index pairs.
+    count - Number of pairs.
+    result - Optionally receives the WDI_SAR_RESULT returned by the driver; WDI_SAR_SUCCESS for a
+             queued set.
+
+Return Value:
+
+    S_OK on success (or once a set is queued), E_INVALIDARG if there are too many pairs,
+    E_NOTIMPL if the session has no Wi-Fi device, or the underlying failure code.
+
+--*/
+{
+    if ((session == nullptr) || ((configSets == nullptr) && (count != 0)))
+    {
+        return E_POINTER;
+    }
+
+    if (session->Device == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        std::vector<UINT8> request;
+        HRESULT hr = SarWifiBuildSetSarState(backoffState, mimoConfigType, configSets, count, &request);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (!session->SetQueue)
+        {
+            return SarSessionSendWifiSar(session, request, result);
+        }
+
+        session->SetQueue->Submit(session->WifiLane, std::move(request));
+        if (result != nullptr)
+        {
+            *result = WDI_SAR_SUCCESS;
+        }
+        return S_OK;
+    });
+}
+
+_Check_return_
+HRESULT
+SarSessionGetWifiSarAll(
+    _In_ SAR_SESSION* session,
+    _Out_writes_opt_(capacity) SAR_WIFI_INTERFACE_SAR* interfaces,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    )
+/*++
+
+Routine Description:
+
+    Sends WDI_GET_SAR_STATE to every WLAN interface at once and copies out each interface's state
+    and pairs.
+
+Arguments:
+
+    session - The session.
+    interfaces - Receives up to capacity interfaces' states.
+    capacity - Number of states interfaces can hold.
+    count - Receives the number of interfaces.
+
+Return Value:
+
+    S_OK if every interface was read, E_NOT_SUFFICIENT_BUFFER if there are more than capacity
+    interfaces, E_NOTIMPL if the session has no set of interfaces, otherwise the first
+    interface's failure.  An interface with more pairs than it can hold is not a failure; its
+    Status is S_FALSE.  A queued set's failure that no read has returned yet is returned in place
+    of the read's result.
+
+--*/
+{
+    HRESULT hr;
+    HRESULT hrFlush;
+
+    if ((session == nullptr) || (count == nullptr) || ((interfaces == nullptr) && (capacity != 0)))
+    {
+        return E_POINTER;
+    }
+
+    *count = 0;
+
+    if (session->Interfaces == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    hrFlush = SarSessionFlushLane(session, session->WifiLane, &session->WifiFailuresReported);
+
+    hr = SarApiGuard([&]() -> HRESULT
+    {
+        return SarSessionWifiFanOut(session, interfaces, capacity, count,
+            [](const SAR_WIFI_INTERFACE& wifiInterface, SAR_WIFI_INTERFACE_SAR* interfaceSar) -> HRESULT
+            {
+                std::vector<WDI_SAR_CONFIG_SET> configSets;
+                HRESULT hr = SarWifiGetSarState(wifiInterface.Device.get(), &interfaceSar->State, &configSets);
+
+                if (FAILED(hr))
+                {
+                    return hr;
+                }
+
+                for (size_t i = 0; (i < configSets.size()) && (i < ARRAYSIZE(interfaceSar->ConfigSets)); i++)
+                {
+                    interfaceSar->ConfigSets[i] = configSets[i];
+                }
+
+                // A larger array of interfaces would not hold more pairs, so the call does not
+                // fail for them.
+                return (configSets.size() > ARRAYSIZE(interfaceSar->ConfigSets)) ? S_FALSE : S_OK;
+            });
+    });
+
+    return FAILED(hrFlush) ? hrFlush : hr;
+}
+
+_Check_return_
+HRESULT
+SarSessionSetWifiSarAll(
+    _In_ SAR_SESSION* session,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_writes_opt_(capacity) SAR_WIFI_INTERFACE_SAR* interfaces,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    )
+/*++
+
+Routine Description:
+
+    Sends the same WDI_SET_SAR_STATE to every WLAN interface at once.
+
+Arguments:
+
+    session - The session.
+    backoffState - WDI_SARBACKOFF_DISABLED or WDI_SARBACKOFF_ENABLED
+    mimoConfigType - Antenna selection bit mask.
+    configSets - The pairs.
+    configSetCount - Number of pairs.
+    interfaces - Receives up to capacity interfaces' WDI_SAR_RESULTs.
+    capacity - Number of results interfaces can hold.
+    count - Receives the number of interfaces.
+
+Return Value:
+
+    S_OK if every interface was set, E_NOT_SUFFICIENT_BUFFER if there are more than capacity
+    interfaces (all of which were set), E_NOTIMPL if the session has no set of interfaces,
+    otherwise the first interface's failure.
+
+--*/
+{
+    if ((session == nullptr) || (count == nullptr) || ((configSets == nullptr) && (configSetCount != 0)) ||
+        ((interfaces == nullptr) && (capacity != 0)))
+    {
+        return E_POINTER;
+    }
+
+    *count = 0;
+
+    if (session->Interfaces == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    // A queued set that failed is left for the next read to return.
+    (VOID)SarSessionFlushLane(session, session->WifiLane, nullptr);
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        std::vector<UINT8> request;
+        HRESULT hr;
+
+        // The request is encoded once and sent to every interface.
+        hr = SarWifiBuildSetSarState(backoffState, mimoConfigType, configSets, configSetCount, &request);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        return SarSessionWifiFanOut(session, interfaces, capacity, count,
+            [&](const SAR_WIFI_INTERFACE& wifiInterface, SAR_WIFI_INTERFACE_SAR* interfaceSar) -> HRESULT
+            {
+                return SarWifiSendSetSarState(wifiInterface.Device.get(), request, &interfaceSar->Result);
+            });
+    });
+}
+
+_Check_return_
+HRESULT
+SarSessionGetInterfaceVersion(
+    _In_ SAR_SESSION* session,
+    _Out_ UINT32* major,
+    _Out_ UINT32* minor
+    )
+/*++
+
+Routine Description:
+
+    Returns the SAR interface version of the session's Wi-Fi driver, doing the handshake if no
+    Wi-Fi call has yet.
+
+Arguments:
+
+    session - The session.
+    major - Receives the major version; 0 if the driver predates WDI_GET_INTERFACE_VERSION.
+    minor - Receives the minor version.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) (with the version returned) if
+    SarTool cannot drive the driver, E_NOTIMPL if the session has no Wi-Fi device, or the failure
+    code of WDI_GET_INTERFACE_VERSION.  A queued Wi-Fi set's failure that no read has returned
+    yet is returned in place of the handshake's result.
+
+--*/
+{
+    HRESULT hr;
+    HRESULT hrFlush;
+
+    if ((session == nullptr) || (major == nullptr) || (minor == nullptr))
+    {
+        return E_POINTER;
+    }
+
+    *major = 0;
+    *minor = 0;
+
+    if (session->Device == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    // The handshake is not made while a queued set may be making it.
+    hrFlush = SarSessionFlushLane(session, session->WifiLane, &session->WifiFailuresReported);
+
+    hr = SarApiGuard([&]() -> HRESULT
+    {
+        HRESULT hrVersion = SarSessionLearnVersion(session);
+
+        if (session->fVersionKnown)
+        {
+            *major = session->InterfaceVersion.Major;
+            *minor = session->InterfaceVersion.Minor;
+        }
+
+        return hrVersion;
+    });
+
+    return FAILED(hrFlush) ? hrFlush : hr;
+}
+
+_Check_return_
+HRESULT
+SarSessionSetCoalescing(
+    _In_ SAR_SESSION* session,
+    UINT32 windowMilliseconds
+    )
+/*++
+
+Routine Description:
+
+    Replaces the session's coalescing queue, sending whatever the old one still holds, with one
+    of the given window.
+
+Arguments:
+
+    session - The session.
+    windowMilliseconds - The coalescing window, or 0 to send every set at once.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the window is longer than
+    SAR_SET_QUEUE_MAX_WINDOW_MILLISECONDS, or the underlying failure code.
+
+--*/
+{
+    if (session == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    // The same limit as "--coalesce"; the queue is left as it was.
+    if (windowMilliseconds > SAR_SET_QUEUE_MAX_WINDOW_MILLISECONDS)
+    {
+        return E_INVALIDARG;
+    }
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        std::unique_ptr<SarSetQueue> queue;
+
+        session->SetQueue.reset();
+        session->WifiFailuresReported = 0;
+        session->LteFailuresReported = 0;
+
+        if (windowMilliseconds == 0)
+        {
+            return S_OK;
+        }
+
+        queue.reset(new SarSetQueue(windowMilliseconds));
+
+        session->WifiLane = queue->AddLane([session](const std::vector<UINT8>& request) -> HRESULT
+        {
+            WDI_SAR_RESULT result = WDI_SAR_SUCCESS;
+            HRESULT hr = SarSessionSendWifiSar(session, request, &result);
+
+            return (SUCCEEDED(hr) && (result != WDI_SAR_SUCCESS)) ? E_INVALIDARG : hr;
+        });
+
+        session->LteLane = queue->AddLane([session](const std::vector<UINT8>& request) -> HRESULT
+        {
+            std::vector<SAR_LTE_ANTENNA> antennas(request.size() / sizeof(SAR_LTE_ANTENNA));
+
+            memcpy(antennas.data(), request.data(), antennas.size() * sizeof(SAR_LTE_ANTENNA));
+            return SarSessionSendLteSar(session, antennas.data(), (UINT32)antennas.size());
+        });
+
+        session->SetQueue = std::move(queue);
+        return S_OK;
+    });
+}
+
+_Check_return_
+HRESULT
+SarSessionFlush(
+    _In_ SAR_SESSION* session
+    )
+/*++
+
+Routine Description:
+
+    Sends the pending Wi-Fi and LTE sets without waiting for their windows and waits for them.
+
+Arguments:
+
+    session - The session.
+
+Return Value:
+
+    S_OK if sets are not coalesced; otherwise the result of the last Wi-Fi set if it failed, or
+    else of the last LTE set.
+
+--*/
+{
+    HRESULT hrWifi;
+    HRESULT hrLte;
+
+    if (session == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if (!session->SetQueue)
+    {
+        return S_OK;
+    }
+
+    hrWifi = session->SetQueue->Flush(session->WifiLane);
+    hrLte = session->SetQueue->Flush(session->LteLane);
+
+    return FAILED(hrWifi) ? hrWifi : hrLte;
+}
+
+static
+VOID
+SarSessionCopyCoalescingStats(
+    _In_ SAR_SESSION* session,
+    UINT32 lane,
+    _Out_opt_ SAR_COALESCING_STATS* stats
+    )
+/*++
+
+Routine Description:
+
+    Copies one lane's counts out of the coalescing queue; zero if sets are not coalesced.
+
+Arguments:
+
+    session - The session.
+    lane - The lane.
+    stats - Optionally receives the counts.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    SAR_SET_QUEUE_STATS laneStats = {};
+
+    if (stats == nullptr)
+    {
+        return;
+    }
+
+    if (session->SetQueue)
+    {
+        session->SetQueue->GetStats(lane, &laneStats);
+    }
+
+    stats->Requests = laneStats.Requests;
+    stats->DriverCalls = laneStats.Issued;
+    stats->Coalesced = laneStats.Coalesced;
+    stats->Unchanged = laneStats.Unchanged;
+    stats->Failed = laneStats.Failed;
+}
+
+_Check_return_
+HRESULT
+SarSessionGetCoalescingStats(
+    _In_ SAR_SESSION* session,
+    _Out_opt_ SAR_COALESCING_STATS* wifiStats,
+    _Out_opt_ SAR_COALESCING_STATS* lteStats
+    )
+/*++
+
+Routine Description:
+
+    Returns the counts of the Wi-Fi and LTE coalescing queues since the window was last set.
+
+Arguments:
+
+    session - The session.
+    wifiStats - Optionally receives the Wi-Fi counts.
+    lteStats - Optionally receives the LTE counts.
+
+Return Value:
+
+    S_OK, or E_POINTER if session is nullptr.
+
+--*/
+{
+    if (session == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    SarSessionCopyCoalescingStats(session, session->WifiLane, wifiStats);
+    SarSessionCopyCoalescingStats(session, session->LteLane, lteStats);
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarSessionGetLteSar(
+    _In_ SAR_SESSION* session,
+    _Out_ BOOL* backoffEnabled,
+    _Out_writes_opt_(capacity) SAR_LTE_ANTENNA* antennas,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    )
+/*++
+
+Routine Description:
+
+    Reads whether LTE backoff is enabled and each antenna's backoff index from the modem's
+    SarManager (or the mock modem.)
+
+Arguments:
+
+    session - The session.
+    backoffEnabled - Receives TRUE if backoff is enabled.
+    antennas - Receives up to capacity antennas.
+    capacity - Number of antennas the buffer can hold.
+    count - Receives the number of antennas.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if the modem has more than
+    capacity antennas, E_NOTIMPL if the session has no modem, E_POINTER if the modem has no
+    SarManager, or the underlying failure code.  A queued set's failure that no read has
+    returned yet is returned in place of the read's result.
+
+--*/
+{
+    std::vector<SAR_LTE_ANTENNA> allAntennas;
+    HRESULT hr = S_OK;
+    HRESULT hrFlush;
+
+    if ((session == nullptr) || (backoffEnabled == nullptr) || (count == nullptr) ||
+        ((antennas == nullptr) && (capacity != 0)))
+    {
+        return E_POINTER;
+    }
+
+    *backoffEnabled = FALSE;
+    *count = 0;
+
+    hrFlush = SarSessionFlushLane(session, session->LteLane, &session->LteFailuresReported);
+
+    if (session->Transport == SarSessionMock)
+    {
+        *backoffEnabled = session->MockLteBackoffEnabled;
+        hr = SarApiGuard([&]() -> HRESULT { allAntennas = session->MockLteAntennas; return S_OK; });
+    }
+#ifdef _WIN32
+    else if (session->Transport == SarSessionLocal)
+    {
+        hr = SarSessionLteCall(session, [&](MobileBroadbandSarManager& sarManager) -> HRESULT
+        {
+            UINT64 start = SarStatsNow();
+            bool fBackoffEnabled = sarManager.IsBackoffEnabled();
+            auto modemAntennas = sarManager.Antennas();
+            SarStatsRecord(SarStatLteGetState, start);
+
+            allAntennas.clear();
+            for (auto antenna : modemAntennas)
+            {
+                allAntennas.push_back({ antenna.AntennaIndex(), antenna.SarBackoffIndex() });
+            }
+
+            *backoffEnabled = fBackoffEnabled ? TRUE : FALSE;
+            return S_OK;
+        });
+    }
+#endif
+    else
+    {
+        hr = E_NOTIMPL;
+    }
+
+    if (FAILED(hr))
+    {
+        return FAILED(hrFlush) ? hrFlush : hr;
+    }
+
+    *count = (UINT32)allAntennas.size();
+    for (UINT32 i = 0; (i < *count) && (i < capacity); i++)
+    {
+        antennas[i] = allAntennas[i];
+    }
+
+    hr = (*count > capacity) ? E_NOT_SUFFICIENT_BUFFER : S_OK;
+    return FAILED(hrFlush) ? hrFlush : hr;
+}
+
+_Check_return_
+HRESULT
+SarSessionSetLteSar(
+    _In_ SAR_SESSION* session,
+    _In_reads_(count) const SAR_LTE_ANTENNA* antennas,
+    UINT32 count
+    )
+/*++
+
+Routine Description:
+
+    Configures the LTE antennas with one SetConfigurationAsync, or queues the configuration if
+    sets are coalesced.
+
+Arguments:
+
+    session - The session.
+    antennas - The antennas and the backoff index each should use.
+    count - Number of antennas.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if count is 0, E_NOTIMPL if the session has no modem, or the
+    underlying failure code.
+
+--*/
+{
+    if ((session == nullptr) || (antennas == nullptr))
+    {
+        return E_POINTER;
+    }
+
+    if (count == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!SarSessionHasModem(session))
+    {
+        return E_NOTIMPL;
+    }
+
+    if (!session->SetQueue)
+    {
+        return SarSessionSendLteSar(session, antennas, count);
+    }
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        std::vector<UINT8> request((const UINT8*)antennas, (const UINT8*)(antennas + count));
+
+        session->SetQueue->Submit(session->LteLane, std::move(request));
+        return S_OK;
+    });
+}
+
+_Check_return_
+HRESULT
+SarSessionReadConfig(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Reads the provisioning structs from the session's firmware store ("UEFI"), a container file or
+    a folder of .bin files.  Unlike SarConfigLoad, nothing is printed.
+
+Arguments:
+
+    session - The session.
+    path - "UEFI", the container file or folder.
+    blobs - Receives the structs.
+
+Return Value:
+
+    S_OK on success or the first failure.
+
+--*/
+{
+    if ((session == nullptr) || (path == nullptr) || (blobs == nullptr))
+    {
+        return E_POINTER;
+    }
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        if (SarFirmwareIsPath(path))
+        {
+            return session->Store->ReadConfig(blobs);
+        }
+
+        if (SarContainerIsPath(path))
+        {
+            HRESULT hr = SarContainerRead(path, blobs);
+
+            if (FAILED(hr))
+            {
+                memset(blobs, 0, sizeof(*blobs));
+            }
+            return hr;
+        }
+
+        return SarConfigReadFolder(path, blobs);
+    });
+}
+
+_Check_return_
+HRESULT
+SarSessionWriteConfig(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    UINT32 flags
+    )
+/*++
+
+Routine Description:
+
+    Writes the provisioning structs to the session's firmware store ("UEFI"), a container file or
+    a folder of .bin files.
+
+Arguments:
+
+    session - The session.
+    path - "UEFI", the container file or folder.
+    blobs - The structs to write.
+    flags - 0 or SAR_WRITE_CONFIG_COMPRESS.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for unknown flags, or the first failure.
+
+--*/
+{
+    if ((session == nullptr) || (path == nullptr) || (blobs == nullptr))
+    {
+        return E_POINTER;
+    }
+
+    if ((flags & ~SAR_WRITE_CONFIG_COMPRESS) != 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    return SarApiGuard([&]() -> HRESULT
+    {
+        SAR_CONFIG_BLOBS image = *blobs;
+
+        if (flags & SAR_WRITE_CONFIG_COMPRESS)
+        {
+            image.Header.SARTablesCompressed = SAR_TABLES_COMPRESSED_DELTA;
+        }
+
+        if (SarFirmwareIsPath(path))
+        {
+            return session->Store->WriteConfig(&image);
+        }
+
+        if (SarContainerIsPath(path))
+        {
+            return SarContainerWrite(path, &image);
+        }
+
+        return SarConfigWriteFolder(path, &image);
+    });
+}
+
+// eof: SarApi.cpp
+//
@@ -0,0 +1,326 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarApi.h
+
+Abstract:
+
+    C interface to SarTool's SAR control and provisioning logic, for services that would otherwise
+    run SarTool.exe for every change.  A session keeps what each SarTool.exe run sets up again:
+    the WLAN handle and interface, the WinRT apartment and the modem's SarManager, and the
+    firmware store.  Open one session per client and keep it for as long as the client runs.
+
+    Sessions are opaque and every function takes only C types and returns an HRESULT, so callers
+    do not depend on SarTool's compiler or C++ runtime.  SAR_API_VERSION is raised when functions
+    are added; existing functions and structs do not change.
+
+    Transports:
+
+        SarSessionLocal     This machine: the WLAN driver through WlanDeviceServiceCommand and the
+                            modem through MobileBroadbandSarManager (Windows), and UEFI through the
+                            platform's firmware store (Windows or efivarfs.)
+        SarSessionMock      An in-process model of the driver, modem and firmware, for tests on any
+                            platform.
+        SarSessionRemote    Wi-Fi SAR through a SarTool server (see SarServer.h); configuration is
+                            read and written locally and LTE is not supported.
+
+    A session may be used from any thread, one call at a time.
+
+    Wi-Fi calls go to the first WLAN interface; the ...WifiSarAll calls send the same request to
+    every WLAN interface at once (see SarFanOut.h) and report each interface's result.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include "Dmf_Wlan_Public.h"
+#include "Wlan_Ihv_Config.h"
+
+#ifdef __cplusplus
+#define SAR_API_EXTERN extern "C"
+#else
+#define SAR_API_EXTERN extern
+#endif
+
+#if defined(_WIN32) && defined(SAR_API_EXPORTS)
+#define SAR_API SAR_API_EXTERN __declspec(dllexport)
+#elif defined(_WIN32) && defined(SAR_API_IMPORTS)
+#define SAR_API SAR_API_EXTERN __declspec(dllimport)
+#elif defined(__GNUC__)
+#define SAR_API SAR_API_EXTERN __attribute__((visibility("default")))
+#else
+#define SAR_API SAR_API_EXTERN
+#endif
+
+#define SAR_API_VERSION 4
+
+// Set SARTablesCompressed and store the power table compressed (see SarTableCompression.h.)
+//
+#define SAR_WRITE_CONFIG_COMPRESS   0x00000001
+
+// The complete set of provisioning structs for one device.
+//
+typedef struct _SAR_CONFIG_BLOBS
+{
+    SAR_CONFIG_HEADER Header;
+    SAR_CONFIG_VALUES Values;
+    REGION_CONFIG_VALUES Region;
+    SAR_POWER_TABLE PowerTable;
+} SAR_CONFIG_BLOBS;
+
+typedef struct _SAR_LTE_ANTENNA
+{
+    INT32 AntennaIndex;
+    INT32 SarBackoffIndex;
+} SAR_LTE_ANTENNA;
+
+// The number of pairs SarSessionGetWifiSarAll returns per interface.
+//
+#define SAR_API_MAX_INTERFACE_CONFIG_SETS 16
+
+// One WLAN interface's part of a ...WifiSarAll call.  A get fills in State and the first
+// SAR_API_MAX_INTERFACE_CONFIG_SETS of its State.NumWdiSarConfigElements pairs (Status is
+// S_FALSE if there are more); a set fills in Result.
+//
+typedef struct _SAR_WIFI_INTERFACE_SAR
+{
+    GUID InterfaceGuid;
+    HRESULT Status;                 // This interface's result.
+    UINT32 InterfaceVersionMajor;   // The driver's SAR interface version; 0.0 if not known.
+    UINT32 InterfaceVersionMinor;
+    WDI_SAR_STATE State;
+    WDI_SAR_CONFIG_SET ConfigSets[SAR_API_MAX_INTERFACE_CONFIG_SETS];
+    WDI_SAR_RESULT Result;
+} SAR_WIFI_INTERFACE_SAR;
+
+// How the coalescing queue in front of one kind of set has fared (see SarSessionSetCoalescing.)
+// Requests = DriverCalls + Coalesced + Unchanged + the set still pending; Coalesced + Unchanged
+// driver calls were saved.
+//
+typedef struct _SAR_COALESCING_STATS
+{
+    UINT64 Requests;        // Sets the session was given.
+    UINT64 DriverCalls;     // Sets sent to the driver or modem.
+    UINT64 Coalesced;       // Sets replaced by a later set in the same window.
+    UINT64 Unchanged;       // Sets skipped as identical to the last acknowledged state.
+    UINT64 Failed;          // Sets the driver or modem failed or rejected.
+} SAR_COALESCING_STATS;
+
+typedef enum _SAR_SESSION_TRANSPORT
+{
+    SarSessionLocal = 0,
+    SarSessionMock,
+    SarSessionRemote,
+} SAR_SESSION_TRANSPORT;
+
+typedef struct _SAR_SESSION SAR_SESSION;
+
+// Returns the SAR_API_VERSION the library was built with.
+//
+SAR_API
+UINT32
+SarApiVersion(
+    VOID
+    );
+
+// Opens a session.  endpoint is required for SarSessionRemote and ignored otherwise.  Devices are
+// opened on first use, so opening a session is cheap.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionOpen(
+    SAR_SESSION_TRANSPORT transport,
+    _In_opt_z_ LPCSTR endpoint,
+    _Out_ SAR_SESSION** session
+    );
+
+SAR_API
+VOID
+SarSessionClose(
+    _In_opt_ SAR_SESSION* session
+    );
+
+// Reads the Wi-Fi SAR state.  state->NumWdiSarConfigElements is the number of pairs; if it is
+// more than capacity, configSets receives the first capacity pairs and the function returns
+// E_NOT_SUFFICIENT_BUFFER.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionGetWifiSar(
+    _In_ SAR_SESSION* session,
+    _Out_ WDI_SAR_STATE* state,
+    _Out_writes_opt_(capacity) WDI_SAR_CONFIG_SET* configSets,
+    UINT32 capacity
+    );
+
+// Sets the Wi-Fi SAR state with one WDI_SET_SAR_STATE carrying all count pairs.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionSetWifiSar(
+    _In_ SAR_SESSION* session,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(count) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 count,
+    _Out_opt_ WDI_SAR_RESULT* result
+    );
+
+// Reads the Wi-Fi SAR state of every WLAN interface concurrently (SAR_API_VERSION 3.)  *count
+// receives the number of interfaces; if it is more than capacity, interfaces receives the first
+// capacity of them and the function returns E_NOT_SUFFICIENT_BUFFER.  Otherwise returns S_OK if
+// every interface succeeded (an interface with more pairs than it holds succeeds with S_FALSE),
+// or the Status of the first interface that failed.  The interfaces are enumerated once and
+// cached until one arrives or leaves.  E_NOTIMPL for remote sessions.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionGetWifiSarAll(
+    _In_ SAR_SESSION* session,
+    _Out_writes_opt_(capacity) SAR_WIFI_INTERFACE_SAR* interfaces,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    );
+
+// Sends the same WDI_SET_SAR_STATE to every WLAN interface concurrently (SAR_API_VERSION 3), so
+// the call takes as long as the slowest interface.  Every interface is set whatever capacity is;
+// results are returned as for SarSessionGetWifiSarAll.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionSetWifiSarAll(
+    _In_ SAR_SESSION* session,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_writes_opt_(capacity) SAR_WIFI_INTERFACE_SAR* interfaces,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    );
+
+// Returns the SAR interface version of the Wi-Fi driver (SAR_API_VERSION 2.)  The first Wi-Fi
+// call of a session asks the driver with WDI_GET_INTERFACE_VERSION, or finds the answer cached
+// for the interface and driver version by an earlier session (see SarInterfaceVersion.h); Wi-Fi
+// calls then fail with HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if the driver's major version
+// is not WDI_SAR_INTERFACE_VERSION_MAJOR.  0.0 is a driver that predates the opcode.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionGetInterfaceVersion(
+    _In_ SAR_SESSION* session,
+    _Out_ UINT32* major,
+    _Out_ UINT32* minor
+    );
+
+// Puts a coalescing queue in front of SarSessionSetWifiSar and SarSessionSetLteSar
+// (SAR_API_VERSION 4), for callers such as proximity sensors whose state flaps.  The first set
+// after a quiet period waits windowMilliseconds for later ones, and only the last set of the
+// window is sent; a set identical to the last state the driver or modem acknowledged is not sent
+// at all.  Queued sets return S_OK (and WDI_SAR_SUCCESS) once accepted; SarSessionFlush
+// returns how the device took them.  Reads send the pending set of their kind first; the last
+// queued set's failure, if no read has returned it yet, is returned in place of the read's result
+// (whose output is still filled in.)
+//
+// windowMilliseconds 0 sends any pending set and returns to sending every set at once; a window
+// longer than 60000 (one minute, the longest "sartool serve --coalesce" accepts) returns
+// E_INVALIDARG and leaves the queue as it was.  Changing the window restarts the counts of
+// SarSessionGetCoalescingStats.  The ...WifiSarAll calls are not queued.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionSetCoalescing(
+    _In_ SAR_SESSION* session,
+    UINT32 windowMilliseconds
+    );
+
+// Sends the pending sets without waiting for their windows and waits for them.  Returns the
+// result of the last Wi-Fi set if it failed, otherwise of the last LTE set: E_INVALIDARG if the
+// Wi-Fi driver rejected it (a WDI_SAR_RESULT other than WDI_SAR_SUCCESS.)
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionFlush(
+    _In_ SAR_SESSION* session
+    );
+
+// Returns the counts of the Wi-Fi and LTE queues; zero when sets are not coalesced.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionGetCoalescingStats(
+    _In_ SAR_SESSION* session,
+    _Out_opt_ SAR_COALESCING_STATS* wifiStats,
+    _Out_opt_ SAR_COALESCING_STATS* lteStats
+    );
+
+// Reads whether LTE backoff is enabled and each antenna's backoff index.  *count receives the
+// number of antennas; if it is more than capacity, antennas receives the first capacity of them
+// and the function returns E_NOT_SUFFICIENT_BUFFER.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionGetLteSar(
+    _In_ SAR_SESSION* session,
+    _Out_ BOOL* backoffEnabled,
+    _Out_writes_opt_(capacity) SAR_LTE_ANTENNA* antennas,
+    UINT32 capacity,
+    _Out_ UINT32* count
+    );
+
+// Configures all count LTE antennas with one SetConfigurationAsync.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionSetLteSar(
+    _In_ SAR_SESSION* session,
+    _In_reads_(count) const SAR_LTE_ANTENNA* antennas,
+    UINT32 count
+    );
+
+// Reads the provisioning structs from "UEFI", a container file (*.sarc) or a folder of .bin
+// files.  Structs that could not be read are zeroed and the first failure is returned.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionReadConfig(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+// Writes the provisioning structs to "UEFI", a container file or a folder.  flags is 0 or
+// SAR_WRITE_CONFIG_COMPRESS.
+//
+_Check_return_
+SAR_API
+HRESULT
+SarSessionWriteConfig(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    UINT32 flags
+    );
+
+// eof: SarApi.h
+//
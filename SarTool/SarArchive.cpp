@@ -0,0 +1,849 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarArchive.cpp
+
+Abstract:
+
+    Content-addressed archive of fleet configuration dumps with parallel ingest.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarArchive.h"
+#include "SarBatch.h"
+#include "SarCodec.h"
+#include "SarCrc32c.h"
+#include "SarHash.h"
+#include "SarMappedFile.h"
+#include "SarThreadPool.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <map>
+
+namespace fs = std::filesystem;
+
+static const UINT32 SAR_ARCHIVE_NO_BLOB = 0xffffffff;
+
+typedef struct _SAR_ARCHIVE_INGEST_ITEM
+{
+    HRESULT Result;
+    UINT64 Hashes[SarBlobCount];
+    size_t Sizes[SarBlobCount];
+    UINT8 Images[SarBlobCount][sizeof(SAR_CONFIG_BLOBS)];
+} SAR_ARCHIVE_INGEST_ITEM;
+
+// The header and table entries are converted field by field so the file is little-endian
+// whatever the host's byte order.
+//
+static
+VOID
+SarArchiveLoadHeader(
+    _In_reads_bytes_(sizeof(SAR_ARCHIVE_HEADER)) const UINT8* p,
+    _Out_ SAR_ARCHIVE_HEADER* header
+    )
+{
+    header->Signature = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, Signature));
+    header->FormatVersion = SarLoadLe16(p + offsetof(SAR_ARCHIVE_HEADER, FormatVersion));
+    header->Reserved = SarLoadLe16(p + offsetof(SAR_ARCHIVE_HEADER, Reserved));
+    header->BlobCount = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, BlobCount));
+    header->DeviceCount = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, DeviceCount));
+    header->NamesSize = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, NamesSize));
+    header->DataSize = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, DataSize));
+    header->TotalSize = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, TotalSize));
+    header->Crc32c = SarLoadLe32(p + offsetof(SAR_ARCHIVE_HEADER, Crc32c));
+}
+
+static
+VOID
+SarArchiveStoreHeader(
+    _Out_writes_bytes_(sizeof(SAR_ARCHIVE_HEADER)) UINT8* p,
+    const SAR_ARCHIVE_HEADER& header
+    )
+{
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, Signature), header.Signature);
+    SarStoreLe16(p + offsetof(SAR_ARCHIVE_HEADER, FormatVersion), header.FormatVersion);
+    SarStoreLe16(p + offsetof(SAR_ARCHIVE_HEADER, Reserved), header.Reserved);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, BlobCount), header.BlobCount);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, DeviceCount), header.DeviceCount);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, NamesSize), header.NamesSize);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, DataSize), header.DataSize);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, TotalSize), header.TotalSize);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_HEADER, Crc32c), header.Crc32c);
+}
+
+static
+VOID
+SarArchiveLoadBlob(
+    _In_reads_bytes_(sizeof(SAR_ARCHIVE_BLOB)) const UINT8* p,
+    _Out_ SAR_ARCHIVE_BLOB* blob
+    )
+{
+    blob->Hash = SarLoadLe64(p + offsetof(SAR_ARCHIVE_BLOB, Hash));
+    blob->Offset = SarLoadLe32(p + offsetof(SAR_ARCHIVE_BLOB, Offset));
+    blob->Size = SarLoadLe16(p + offsetof(SAR_ARCHIVE_BLOB, Size));
+    blob->BlobId = p[offsetof(SAR_ARCHIVE_BLOB, BlobId)];
+    blob->Reserved = p[offsetof(SAR_ARCHIVE_BLOB, Reserved)];
+}
+
+static
+VOID
+SarArchiveStoreBlob(
+    _Out_writes_bytes_(sizeof(SAR_ARCHIVE_BLOB)) UINT8* p,
+    const SAR_ARCHIVE_BLOB& blob
+    )
+{
+    SarStoreLe64(p + offsetof(SAR_ARCHIVE_BLOB, Hash), blob.Hash);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_BLOB, Offset), blob.Offset);
+    SarStoreLe16(p + offsetof(SAR_ARCHIVE_BLOB, Size), blob.Size);
+    p[offsetof(SAR_ARCHIVE_BLOB, BlobId)] = blob.BlobId;
+    p[offsetof(SAR_ARCHIVE_BLOB, Reserved)] = blob.Reserved;
+}
+
+static
+VOID
+SarArchiveLoadDevice(
+    _In_reads_bytes_(sizeof(SAR_ARCHIVE_DEVICE)) const UINT8* p,
+    _Out_ SAR_ARCHIVE_DEVICE* device
+    )
+{
+    device->NameOffset = SarLoadLe32(p + offsetof(SAR_ARCHIVE_DEVICE, NameOffset));
+    device->NameSize = SarLoadLe32(p + offsetof(SAR_ARCHIVE_DEVICE, NameSize));
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        device->Blobs[blobId] = SarLoadLe32(p + offsetof(SAR_ARCHIVE_DEVICE, Blobs) + blobId * sizeof(UINT32));
+    }
+}
+
+static
+VOID
+SarArchiveStoreDevice(
+    _Out_writes_bytes_(sizeof(SAR_ARCHIVE_DEVICE)) UINT8* p,
+    const SAR_ARCHIVE_DEVICE& device
+    )
+{
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_DEVICE, NameOffset), device.NameOffset);
+    SarStoreLe32(p + offsetof(SAR_ARCHIVE_DEVICE, NameSize), device.NameSize);
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        SarStoreLe32(p + offsetof(SAR_ARCHIVE_DEVICE, Blobs) + blobId * sizeof(UINT32), device.Blobs[blobId]);
+    }
+}
+
+_Check_return_
+HRESULT
+SarArchive::Open(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Maps an archive, validates its header, CRC-32C, blob table and device table, and loads it.
+
+Arguments:
+
+    path - The archive file.
+
+Return Value:
+
+    S_OK on success.
+    HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there is no archive at path.
+    HRESULT_FROM_WIN32(ERROR_BAD_FORMAT) if the file is not an archive of a known version.
+    HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if a table entry lies outside the archive or refers to
+    a blob of the wrong kind.
+    HRESULT_FROM_WIN32(ERROR_CRC) if the archive fails its CRC check.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarMappedFile mappedFile;
+    SAR_ARCHIVE_HEADER header;
+    const UINT8* data;
+    const UINT8* blobTable;
+    const UINT8* deviceTable;
+    const UINT8* names;
+    UINT64 expectedSize;
+
+    m_blobs.clear();
+    m_data.clear();
+    m_blobIndex.clear();
+    m_devices.clear();
+    m_deviceIndex.clear();
+
+    hr = mappedFile.Open(path);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    data = mappedFile.Data();
+    if ((data == nullptr) || (mappedFile.Size() < sizeof(header)))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    SarArchiveLoadHeader(data, &header);
+    if ((header.Signature != SAR_ARCHIVE_SIGNATURE) ||
+        (header.FormatVersion != SAR_ARCHIVE_FORMAT_VERSION))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    expectedSize = sizeof(header) +
+                   (UINT64)header.BlobCount * sizeof(SAR_ARCHIVE_BLOB) +
+                   (UINT64)header.DeviceCount * sizeof(SAR_ARCHIVE_DEVICE) +
+                   header.NamesSize +
+                   header.DataSize;
+    if ((header.TotalSize != expectedSize) || (header.TotalSize > mappedFile.Size()))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    if (SarCrc32c(data + sizeof(header), header.TotalSize - sizeof(header)) != header.Crc32c)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_CRC);
+        goto exit;
+    }
+
+    blobTable = data + sizeof(header);
+    deviceTable = blobTable + (size_t)header.BlobCount * sizeof(SAR_ARCHIVE_BLOB);
+    names = deviceTable + (size_t)header.DeviceCount * sizeof(SAR_ARCHIVE_DEVICE);
+    m_data.assign(names + header.NamesSize, names + header.NamesSize + header.DataSize);
+
+    m_blobs.resize(header.BlobCount);
+    for (UINT32 i = 0; i < header.BlobCount; i++)
+    {
+        SAR_ARCHIVE_BLOB& blob = m_blobs[i];
+
+        SarArchiveLoadBlob(blobTable + i * sizeof(blob), &blob);
+        if ((blob.BlobId >= SarBlobCount) ||
+            (blob.Offset > header.DataSize) ||
+            (blob.Size > header.DataSize - blob.Offset))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        m_blobIndex.emplace(blob.Hash, i);
+    }
+
+    m_devices.resize(header.DeviceCount);
+    for (UINT32 i = 0; i < header.DeviceCount; i++)
+    {
+        SAR_ARCHIVE_DEVICE device;
+
+        SarArchiveLoadDevice(deviceTable + i * sizeof(device), &device);
+        if ((device.NameOffset > header.NamesSize) || (device.NameSize > header.NamesSize - device.NameOffset))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            if ((device.Blobs[blobId] >= header.BlobCount) ||
+                (m_blobs[device.Blobs[blobId]].BlobId != blobId))
+            {
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                goto exit;
+            }
+
+            m_devices[i].Blobs[blobId] = device.Blobs[blobId];
+        }
+
+        m_devices[i].Name.assign((const char*)names + device.NameOffset, device.NameSize);
+        if (!m_deviceIndex.emplace(m_devices[i].Name, i).second)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        m_blobs.clear();
+        m_data.clear();
+        m_blobIndex.clear();
+        m_devices.clear();
+        m_deviceIndex.clear();
+    }
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarArchive::Save(
+    _In_z_ LPCSTR path
+    ) const
+/*++
+
+Routine Description:
+
+    Lays out the archive in memory and replaces the file at path with it.  Blobs are renumbered in
+    the order devices first reference them; blobs that lost their last reference are dropped.
+
+Arguments:
+
+    path - The archive file to create or replace.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_ARCHIVE_HEADER header = { 0 };
+    std::vector<UINT32> remap(m_blobs.size(), SAR_ARCHIVE_NO_BLOB);
+    std::vector<SAR_ARCHIVE_BLOB> blobs;
+    std::vector<SAR_ARCHIVE_DEVICE> devices(m_devices.size());
+    std::vector<UINT8> data;
+    std::string names;
+    std::vector<UINT8> image;
+    std::string temporaryPath = std::string(path) + ".tmp";
+    FILE* output = nullptr;
+    std::error_code ec;
+
+    for (size_t i = 0; i < m_devices.size(); i++)
+    {
+        devices[i].NameOffset = (UINT32)names.size();
+        devices[i].NameSize = (UINT32)m_devices[i].Name.size();
+        names += m_devices[i].Name;
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            UINT32 blob = m_devices[i].Blobs[blobId];
+
+            if (remap[blob] == SAR_ARCHIVE_NO_BLOB)
+            {
+                SAR_ARCHIVE_BLOB saved = m_blobs[blob];
+
+                saved.Offset = (UINT32)data.size();
+                data.insert(data.end(), m_data.begin() + m_blobs[blob].Offset, m_data.begin() + m_blobs[blob].Offset + m_blobs[blob].Size);
+
+                remap[blob] = (UINT32)blobs.size();
+                blobs.push_back(saved);
+            }
+
+            devices[i].Blobs[blobId] = remap[blob];
+        }
+    }
+
+    header.Signature = SAR_ARCHIVE_SIGNATURE;
+    header.FormatVersion = SAR_ARCHIVE_FORMAT_VERSION;
+    header.BlobCount = (UINT32)blobs.size();
+    header.DeviceCount = (UINT32)devices.size();
+    header.NamesSize = (UINT32)names.size();
+    header.DataSize = (UINT32)data.size();
+    header.TotalSize = (UINT32)(sizeof(header) +
+                                blobs.size() * sizeof(SAR_ARCHIVE_BLOB) +
+                                devices.size() * sizeof(SAR_ARCHIVE_DEVICE) +
+                                names.size() +
+                                data.size());
+
+    image.reserve(header.TotalSize);
+    image.resize(sizeof(header) + blobs.size() * sizeof(SAR_ARCHIVE_BLOB) + devices.size() * sizeof(SAR_ARCHIVE_DEVICE));
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        SarArchiveStoreBlob(image.data() + sizeof(header) + i * sizeof(SAR_ARCHIVE_BLOB), blobs[i]);
+    }
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        SarArchiveStoreDevice(image.data() + sizeof(header) + blobs.size() * sizeof(SAR_ARCHIVE_BLOB) + i * sizeof(SAR_ARCHIVE_DEVICE),
+                              devices[i]);
+    }
+    image.insert(image.end(), names.begin(), names.end());
+    image.insert(image.end(), data.begin(), data.end());
+
+    header.Crc32c = SarCrc32c(image.data() + sizeof(header), image.size() - sizeof(header));
+    SarArchiveStoreHeader(image.data(), header);
+
+    output = fopen(temporaryPath.c_str(), "wb");
+    if (!output)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (fwrite(image.data(), 1, image.size(), output) != image.size())
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+    if (FAILED(hr))
+    {
+        fs::remove(temporaryPath, ec);
+        goto exit;
+    }
+
+    // Readers see either the old archive or the new one, never a partial write.
+    fs::rename(temporaryPath, path, ec);
+    if (ec)
+    {
+        hr = SarHresultFromErrno(ec.value());
+        fs::remove(temporaryPath, ec);
+    }
+
+exit:
+    return hr;
+}
+
+UINT32
+SarArchive::Intern(
+    SAR_CONFIG_BLOB_ID blobId,
+    UINT64 hash,
+    _In_reads_bytes_(size) const UINT8* data,
+    size_t size,
+    _Inout_ size_t* pNewBlobs
+    )
+/*++
+
+Routine Description:
+
+    Returns the index of the blob with these contents, adding it if the archive does not hold it.
+    Only blobs with the same hash are compared, so the cost does not depend on how many devices or
+    blobs the archive holds.
+
+--*/
+{
+    SAR_ARCHIVE_BLOB blob = { 0 };
+    auto range = m_blobIndex.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const SAR_ARCHIVE_BLOB& candidate = m_blobs[it->second];
+
+        if ((candidate.BlobId == blobId) &&
+            (candidate.Size == size) &&
+            (0 == memcmp(m_data.data() + candidate.Offset, data, size)))
+        {
+            return it->second;
+        }
+    }
+
+    blob.Hash = hash;
+    blob.Offset = (UINT32)m_data.size();
+    blob.Size = (UINT16)size;
+    blob.BlobId = (UINT8)blobId;
+
+    m_data.insert(m_data.end(), data, data + size);
+    m_blobs.push_back(blob);
+    m_blobIndex.emplace(hash, (UINT32)(m_blobs.size() - 1));
+    (*pNewBlobs)++;
+
+    return (UINT32)(m_blobs.size() - 1);
+}
+
+VOID
+SarArchive::Ingest(
+    _In_ const std::vector<std::string>& sources,
+    UINT32 threadCount,
+    _Out_ std::vector<HRESULT>* results,
+    _Out_ SAR_ARCHIVE_INGEST_STATS* stats
+    )
+/*++
+
+Routine Description:
+
+    Reads, encodes and hashes every source in parallel, then adds the results to the archive in
+    source order.  The parallel phase does all of the I/O and hashing; the serial phase is one hash
+    lookup (and, for a blob already held, one compare) per blob.
+
+Arguments:
+
+    sources - The configurations to add (UEFI, folders or containers.)
+    threadCount - Number of worker threads; 0 selects one per hardware thread.
+    results - Receives the status of each source.
+    stats - Receives the totals for the run.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SAR_ARCHIVE_INGEST_ITEM> items(sources.size());
+    SarThreadPool pool(threadCount);
+
+    pool.ParallelFor(items.size(), [&sources, &items](size_t index)
+    {
+        SAR_ARCHIVE_INGEST_ITEM& item = items[index];
+        SAR_CONFIG_BLOBS blobs;
+
+        item.Result = SarConfigLoad(sources[index].c_str(), &blobs);
+
+        for (int blobId = 0; SUCCEEDED(item.Result) && (blobId < SarBlobCount); blobId++)
+        {
+            item.Result = SarEncodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId,
+                                              &blobs,
+                                              item.Images[blobId],
+                                              sizeof(item.Images[blobId]),
+                                              &item.Sizes[blobId]);
+            item.Hashes[blobId] = SarHash64(item.Images[blobId], item.Sizes[blobId], (UINT64)blobId);
+        }
+    });
+
+    stats->ThreadCount = pool.ThreadCount();
+    stats->Added = 0;
+    stats->Failed = 0;
+    stats->NewBlobs = 0;
+
+    results->resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        const SAR_ARCHIVE_INGEST_ITEM& item = items[i];
+        DEVICE device;
+
+        (*results)[i] = item.Result;
+        if (FAILED(item.Result))
+        {
+            stats->Failed++;
+            continue;
+        }
+
+        device.Name = sources[i];
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            device.Blobs[blobId] = Intern((SAR_CONFIG_BLOB_ID)blobId,
+                                          item.Hashes[blobId],
+                                          item.Images[blobId],
+                                          item.Sizes[blobId],
+                                          &stats->NewBlobs);
+        }
+
+        auto existing = m_deviceIndex.find(device.Name);
+        if (existing != m_deviceIndex.end())
+        {
+            m_devices[existing->second] = device;
+        }
+        else
+        {
+            m_deviceIndex.emplace(device.Name, m_devices.size());
+            m_devices.push_back(device);
+        }
+
+        stats->Added++;
+    }
+
+    stats->ElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+_Check_return_
+HRESULT
+SarArchive::Get(
+    _In_z_ LPCSTR device,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    ) const
+{
+    HRESULT hr = S_OK;
+    auto it = m_deviceIndex.find(device);
+
+    memset(blobs, 0, sizeof(*blobs));
+
+    if (it == m_deviceIndex.end())
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+    }
+
+    for (int blobId = 0; SUCCEEDED(hr) && (blobId < SarBlobCount); blobId++)
+    {
+        const SAR_ARCHIVE_BLOB& blob = m_blobs[m_devices[it->second].Blobs[blobId]];
+
+        hr = SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, m_data.data() + blob.Offset, blob.Size, blobs);
+    }
+
+    return hr;
+}
+
+VOID
+SarArchive::Configurations(
+    _Out_ std::vector<SAR_ARCHIVE_CONFIGURATION>* configurations
+    ) const
+{
+    std::map<std::array<UINT32, SarBlobCount>, size_t> groups;
+
+    configurations->clear();
+
+    for (size_t i = 0; i < m_devices.size(); i++)
+    {
+        std::array<UINT32, SarBlobCount> key;
+
+        std::copy(std::begin(m_devices[i].Blobs), std::end(m_devices[i].Blobs), key.begin());
+
+        auto inserted = groups.emplace(key, configurations->size());
+        if (inserted.second)
+        {
+            SAR_ARCHIVE_CONFIGURATION configuration;
+
+            std::copy(key.begin(), key.end(), configuration.Blobs);
+            configuration.DeviceCount = 0;
+            configuration.FirstDevice = i;
+            configurations->push_back(configuration);
+        }
+
+        (*configurations)[inserted.first->second].DeviceCount++;
+    }
+
+    std::stable_sort(configurations->begin(), configurations->end(),
+        [](const SAR_ARCHIVE_CONFIGURATION& a, const SAR_ARCHIVE_CONFIGURATION& b) { return a.DeviceCount > b.DeviceCount; });
+}
+
+static
+_Check_return_
+HRESULT
+SarArchiveAdd(
+    _In_z_ LPCSTR path,
+    _In_z_ LPCSTR source,
+    UINT32 threadCount
+    )
+{
+    HRESULT hr = S_OK;
+    SarArchive archive;
+    std::vector<std::string> sources;
+    std::vector<HRESULT> results;
+    SAR_ARCHIVE_INGEST_STATS stats = { 0 };
+
+    hr = archive.Open(path);
+    if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
+    {
+        hr = S_OK;
+    }
+    if (FAILED(hr))
+    {
+        printf("Failed to open archive %s, hr = 0x%08x\n", path, (UINT32)hr);
+        goto exit;
+    }
+
+    hr = SarBatchCollectConfigs(source, &sources);
+    if (FAILED(hr))
+    {
+        printf("Failed to enumerate targets in %s, hr = 0x%08x\n", source, (UINT32)hr);
+        goto exit;
+    }
+
+    archive.Ingest(sources, threadCount, &results, &stats);
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (FAILED(results[i]))
+        {
+            printf("FAILED 0x%08x %s\n", (UINT32)results[i], sources[i].c_str());
+        }
+    }
+
+    printf("%zu configurations (%zu added, %zu failed, %zu new blobs) on %u threads in %.3f s: %.0f configurations/s\n",
+           sources.size(),
+           stats.Added,
+           stats.Failed,
+           stats.NewBlobs,
+           stats.ThreadCount,
+           stats.ElapsedSeconds,
+           sources.size() / ((stats.ElapsedSeconds > 0) ? stats.ElapsedSeconds : 1e-9));
+
+    hr = archive.Save(path);
+    if (FAILED(hr))
+    {
+        printf("Failed to write archive %s, hr = 0x%08x\n", path, (UINT32)hr);
+        goto exit;
+    }
+
+    printf("%s: %zu devices\n", path, archive.DeviceCount());
+
+    if (stats.Failed != 0)
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+static
+_Check_return_
+HRESULT
+SarArchiveList(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Prints the archive's totals and one line per distinct configuration, e.g.
+
+         devices  header   values   region   table     first device
+            9412  3f2a61c0 07be55d2 c1a4e390 5d0e8b17  dumps/0001
+
+    where each blob is identified by the top 32 bits of its hash.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarArchive archive;
+    std::vector<SAR_ARCHIVE_CONFIGURATION> configurations;
+    size_t storedBytes = 0;
+    UINT64 dumpBytes = 0;
+
+    hr = archive.Open(path);
+    if (FAILED(hr))
+    {
+        printf("Failed to open archive %s, hr = 0x%08x\n", path, (UINT32)hr);
+        goto exit;
+    }
+
+    archive.Configurations(&configurations);
+
+    for (UINT32 blob = 0; blob < archive.BlobCount(); blob++)
+    {
+        storedBytes += archive.Blob(blob).Size;
+    }
+
+    for (const SAR_ARCHIVE_CONFIGURATION& configuration : configurations)
+    {
+        size_t configurationBytes = 0;
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            configurationBytes += archive.Blob(configuration.Blobs[blobId]).Size;
+        }
+
+        dumpBytes += (UINT64)configurationBytes * configuration.DeviceCount;
+    }
+
+    printf("%zu devices, %zu distinct configurations, %zu blobs: %zu bytes stored for %llu bytes of dumps\n\n",
+           archive.DeviceCount(),
+           configurations.size(),
+           archive.BlobCount(),
+           storedBytes,
+           (unsigned long long)dumpBytes);
+
+    printf("%8s  %-8s %-8s %-8s %-8s  %s\n", "devices", "header", "values", "region", "table", "first device");
+    for (const SAR_ARCHIVE_CONFIGURATION& configuration : configurations)
+    {
+        printf("%8zu ", configuration.DeviceCount);
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            printf(" %08x", (UINT32)(archive.Blob(configuration.Blobs[blobId]).Hash >> 32));
+        }
+        printf("  %s\n", archive.DeviceName(configuration.FirstDevice).c_str());
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarArchiveCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements the archive subcommands:
+
+        archive add <archive> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]
+        archive list <archive>
+        archive get <archive> <device> [UEFI | <path> | <file>.sarc]
+
+    get prints the device's configuration, or writes it to the destination.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the subcommand.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for a malformed command line, otherwise a failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT32 threadCount = 0;
+
+    if ((argc >= 3) && (0 == _stricmp(argv[0], "add")))
+    {
+        if (argc >= 4)
+        {
+            hr = SarThreadPoolParseThreadCount(argv[3], &threadCount);
+            if (FAILED(hr))
+            {
+                goto exit;
+            }
+        }
+
+        hr = SarArchiveAdd(argv[1], argv[2], threadCount);
+    }
+    else if ((argc >= 2) && (0 == _stricmp(argv[0], "list")))
+    {
+        hr = SarArchiveList(argv[1]);
+    }
+    else if ((argc >= 3) && (0 == _stricmp(argv[0], "get")))
+    {
+        SarArchive archive;
+        SAR_CONFIG_BLOBS blobs;
+
+        hr = archive.Open(argv[1]);
+        if (FAILED(hr))
+        {
+            printf("Failed to open archive %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+            goto exit;
+        }
+
+        hr = archive.Get(argv[2], &blobs);
+        if (FAILED(hr))
+        {
+            printf("Failed to read %s from %s, hr = 0x%08x\n", argv[2], argv[1], (UINT32)hr);
+            goto exit;
+        }
+
+        if (argc >= 4)
+        {
+            hr = SarConfigSave(argv[3], &blobs);
+            if (FAILED(hr))
+            {
+                printf("Failed to write configuration to %s, hr = 0x%08x\n", argv[3], (UINT32)hr);
+            }
+        }
+        else
+        {
+            SarConfigPrint(&blobs);
+        }
+    }
+    else
+    {
+        hr = E_INVALIDARG;
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarArchive.cpp
+//
@@ -0,0 +1,208 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarArchive.h
+
+Abstract:
+
+    Content-addressed archive of fleet configuration dumps.  Each of a device's four provisioning
+    blobs is stored in its encoded form under its SarHash64 (seeded with the blob id), once no
+    matter how many devices share it, and a device is just its name and four blob references.
+    Devices of one SKU are typically byte-identical, so the archive grows with the number of
+    distinct blobs rather than the number of devices, and two devices have the same configuration
+    exactly when they reference the same four blobs.
+
+    Layout (all fields little-endian):
+
+        SAR_ARCHIVE_HEADER
+        SAR_ARCHIVE_BLOB[BlobCount]
+        SAR_ARCHIVE_DEVICE[DeviceCount]
+        device names (NamesSize bytes, not terminated)
+        blob data (DataSize bytes)
+
+    The header carries the CRC-32C of everything after it.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static const UINT32 SAR_ARCHIVE_SIGNATURE = 0x41524153; // "SARA"
+static const UINT16 SAR_ARCHIVE_FORMAT_VERSION = 1;
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct _SAR_ARCHIVE_HEADER
+{
+    UINT32 Signature;
+    UINT16 FormatVersion;
+    UINT16 Reserved;
+    UINT32 BlobCount;
+    UINT32 DeviceCount;
+    UINT32 NamesSize;
+    UINT32 DataSize;
+    UINT32 TotalSize;
+    UINT32 Crc32c;        // CRC-32C of the rest of the archive.
+} SAR_ARCHIVE_HEADER;
+C_ASSERT(sizeof(SAR_ARCHIVE_HEADER) == 0x20);
+
+typedef struct _SAR_ARCHIVE_BLOB
+{
+    UINT64 Hash;          // SarHash64 of the data, seeded with BlobId.
+    UINT32 Offset;        // From the start of the blob data.
+    UINT16 Size;
+    UINT8 BlobId;         // SAR_CONFIG_BLOB_ID
+    UINT8 Reserved;
+} SAR_ARCHIVE_BLOB;
+C_ASSERT(sizeof(SAR_ARCHIVE_BLOB) == 0x10);
+
+typedef struct _SAR_ARCHIVE_DEVICE
+{
+    UINT32 NameOffset;    // From the start of the device names.
+    UINT32 NameSize;
+    UINT32 Blobs[SarBlobCount]; // Indexes into the SAR_ARCHIVE_BLOB table, by SAR_CONFIG_BLOB_ID.
+} SAR_ARCHIVE_DEVICE;
+C_ASSERT(sizeof(SAR_ARCHIVE_DEVICE) == 0x18);
+#pragma pack(pop)
+
+typedef struct _SAR_ARCHIVE_INGEST_STATS
+{
+    UINT32 ThreadCount;
+    size_t Added;
+    size_t Failed;
+    size_t NewBlobs;
+    double ElapsedSeconds;
+} SAR_ARCHIVE_INGEST_STATS;
+
+// A distinct configuration and the devices that share it.
+//
+typedef struct _SAR_ARCHIVE_CONFIGURATION
+{
+    UINT32 Blobs[SarBlobCount];
+    size_t DeviceCount;
+    size_t FirstDevice;
+} SAR_ARCHIVE_CONFIGURATION;
+
+class SarArchive
+{
+public:
+
+    // Replaces the contents with the archive at path.  Fails with ERROR_FILE_NOT_FOUND if there is
+    // none (the archive is then empty), or ERROR_BAD_FORMAT, ERROR_INVALID_DATA or ERROR_CRC.
+    //
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR path
+        );
+
+    // Writes the archive to a temporary file and renames it over path, leaving out blobs no device
+    // references any more.
+    //
+    _Check_return_
+    HRESULT
+    Save(
+        _In_z_ LPCSTR path
+        ) const;
+
+    // Reads every configuration in parallel and adds it under its path, replacing a device of the
+    // same name.  results receives the status of each source.
+    //
+    VOID
+    Ingest(
+        _In_ const std::vector<std::string>& sources,
+        UINT32 threadCount,
+        _Out_ std::vector<HRESULT>* results,
+        _Out_ SAR_ARCHIVE_INGEST_STATS* stats
+        );
+
+    _Check_return_
+    HRESULT
+    Get(
+        _In_z_ LPCSTR device,
+        _Out_ SAR_CONFIG_BLOBS* blobs
+        ) const;
+
+    // Groups the devices by configuration, largest group first.
+    //
+    VOID
+    Configurations(
+        _Out_ std::vector<SAR_ARCHIVE_CONFIGURATION>* configurations
+        ) const;
+
+    size_t
+    DeviceCount() const
+    {
+        return m_devices.size();
+    }
+
+    size_t
+    BlobCount() const
+    {
+        return m_blobs.size();
+    }
+
+    const std::string&
+    DeviceName(
+        size_t device
+        ) const
+    {
+        return m_devices[device].Name;
+    }
+
+    const SAR_ARCHIVE_BLOB&
+    Blob(
+        UINT32 blob
+        ) const
+    {
+        return m_blobs[blob];
+    }
+
+private:
+
+    typedef struct _DEVICE
+    {
+        std::string Name;
+        UINT32 Blobs[SarBlobCount];
+    } DEVICE;
+
+    UINT32
+    Intern(
+        SAR_CONFIG_BLOB_ID blobId,
+        UINT64 hash,
+        _In_reads_bytes_(size) const UINT8* data,
+        size_t size,
+        _Inout_ size_t* pNewBlobs
+        );
+
+    std::vector<SAR_ARCHIVE_BLOB> m_blobs;
+    std::vector<UINT8> m_data;
+    std::unordered_multimap<UINT64, UINT32> m_blobIndex;       // Hash to m_blobs index.
+    std::vector<DEVICE> m_devices;
+    std::unordered_map<std::string, size_t> m_deviceIndex;     // Name to m_devices index.
+};
+
+// Implements "archive add <archive> <source> [threads]", "archive list <archive>" and
+// "archive get <archive> <device> [<destination>]".
+//
+_Check_return_
+HRESULT
+SarArchiveCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarArchive.h
+//
@@ -0,0 +1,420 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarBatch.cpp
+
+Abstract:
+
+    Batch provisioning of many device folders on a work-stealing thread pool.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarBatch.h"
+#include "SarContainer.h"
+#include "SarCountry.h"
+#include "SarFirmwareStore.h"
+#include "SarThreadPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+static
+_Check_return_
+HRESULT
+SarBatchReadManifest(
+    _In_z_ LPCSTR manifestPath,
+    _Out_ std::vector<std::string>* folders
+    )
+/*++
+
+Routine Description:
+
+    Reads a manifest of target folders: one folder per line.  Blank lines and lines starting with
+    '#' are ignored.
+
+Arguments:
+
+    manifestPath - Path of the manifest file.
+    folders - Receives the folders in manifest order.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    std::ifstream manifest(manifestPath);
+    std::string line;
+
+    if (!manifest.is_open())
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    while (std::getline(manifest, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if ((first == std::string::npos) || (line[first] == '#'))
+        {
+            continue;
+        }
+
+        size_t last = line.find_last_not_of(" \t\r");
+        folders->push_back(line.substr(first, last - first + 1));
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarBatchCollectTargets(
+    SAR_BATCH_OPERATION operation,
+    _In_z_ LPCSTR source,
+    _Out_ std::vector<std::string>* folders
+    )
+/*++
+
+Routine Description:
+
+    Determines the device folders a batch operates on.  The source is either a manifest file listing
+    the folders or the root of a directory tree.  For a tree, getconfig visits every folder that
+    contains a WifiSARHeader.bin and every .sarc container, and setconfig visits every leaf folder.
+
+Arguments:
+
+    operation - SAR_BATCH_GETCONFIG or SAR_BATCH_SETCONFIG.
+    source - A manifest file or a directory.
+    folders - Receives the target folders.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::error_code ec;
+
+    folders->clear();
+
+    if (fs::is_regular_file(source, ec))
+    {
+        hr = SarBatchReadManifest(source, folders);
+        goto exit;
+    }
+
+    if (!fs::is_directory(source, ec))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
+        goto exit;
+    }
+
+    {
+        std::vector<fs::path> candidates;
+        candidates.push_back(fs::path(source));
+
+        for (fs::recursive_directory_iterator it(source, fs::directory_options::skip_permission_denied, ec), end;
+             !ec && (it != end);
+             it.increment(ec))
+        {
+            if (it->is_directory(ec))
+            {
+                candidates.push_back(it->path());
+            }
+            else if ((operation == SAR_BATCH_GETCONFIG) && SarContainerIsPath(it->path().string().c_str()))
+            {
+                folders->push_back(it->path().string());
+            }
+        }
+
+        if (ec)
+        {
+            hr = SarHresultFromErrno(ec.value());
+            goto exit;
+        }
+
+        for (const fs::path& candidate : candidates)
+        {
+            BOOL isTarget = FALSE;
+
+            if (operation == SAR_BATCH_GETCONFIG)
+            {
+                isTarget = fs::exists(SarConfigBlobPath(candidate.string().c_str(), SarBlobHeader), ec);
+            }
+            else
+            {
+                isTarget = TRUE;
+                for (const fs::directory_entry& entry : fs::directory_iterator(candidate, ec))
+                {
+                    if (entry.is_directory(ec))
+                    {
+                        isTarget = FALSE;
+                        break;
+                    }
+                }
+            }
+
+            if (isTarget)
+            {
+                folders->push_back(candidate.string());
+            }
+        }
+    }
+
+    std::sort(folders->begin(), folders->end());
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarBatchCollectConfigs(
+    _In_z_ LPCSTR source,
+    _Out_ std::vector<std::string>* paths
+    )
+{
+    std::error_code ec;
+
+    if (SarFirmwareIsPath(source) ||
+        SarContainerIsPath(source) ||
+        fs::exists(SarConfigBlobPath(source, SarBlobHeader), ec))
+    {
+        paths->assign(1, std::string(source));
+        return S_OK;
+    }
+
+    return SarBatchCollectTargets(SAR_BATCH_GETCONFIG, source, paths);
+}
+
+VOID
+SarBatchRun(
+    SAR_BATCH_OPERATION operation,
+    _Inout_ std::vector<SAR_BATCH_ITEM>* items,
+    UINT32 threadCount,
+    _Out_ SAR_BATCH_STATS* stats
+    )
+/*++
+
+Routine Description:
+
+    Reads (getconfig, from a folder or a container) or writes (setconfig) the four provisioning
+    blobs of every item in parallel.
+    Each item's Result receives its status; for getconfig its Blobs receive the decoded structs and
+    for setconfig its Blobs supply the structs to write.
+
+Arguments:
+
+    operation - SAR_BATCH_GETCONFIG or SAR_BATCH_SETCONFIG.
+    items - The folders to process.
+    threadCount - Number of worker threads; 0 selects one per hardware thread.
+    stats - Receives the totals for the run.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    auto start = std::chrono::steady_clock::now();
+
+    SarThreadPool pool(threadCount);
+
+    pool.ParallelFor(items->size(), [operation, items](size_t index)
+    {
+        SAR_BATCH_ITEM& item = (*items)[index];
+
+        if (operation == SAR_BATCH_GETCONFIG)
+        {
+            item.Result = SarConfigLoad(item.Folder.c_str(), &item.Blobs);
+        }
+        else
+        {
+            item.Result = SarConfigWriteFolder(item.Folder.c_str(), &item.Blobs);
+        }
+    });
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    stats->ThreadCount = pool.ThreadCount();
+    stats->ElapsedSeconds = std::chrono::duration<double>(elapsed).count();
+    stats->Succeeded = 0;
+    stats->Failed = 0;
+    for (const SAR_BATCH_ITEM& item : *items)
+    {
+        if (SUCCEEDED(item.Result))
+        {
+            stats->Succeeded++;
+        }
+        else
+        {
+            stats->Failed++;
+        }
+    }
+}
+
+_Check_return_
+HRESULT
+SarBatchCommand(
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "batch {getconfig | setconfig} {<manifest> | <directory>} [threads]".  Prints one
+    status line per folder followed by the overall throughput.  A JSON or CSV getconfig instead
+    writes every configuration read as a full record to stdout, and the failures and throughput to
+    stderr, so stdout can be loaded as is.
+
+Arguments:
+
+    format - Text, JSON or CSV output.
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the operation.
+
+Return Value:
+
+    S_OK if every folder succeeded, E_INVALIDARG for a malformed command line, otherwise E_FAIL.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_BATCH_OPERATION operation;
+    UINT32 threadCount = 0;
+    std::vector<std::string> folders;
+    std::vector<SAR_BATCH_ITEM> items;
+    SAR_BATCH_STATS stats = { 0 };
+    SAR_CONFIG_BLOBS exampleBlobs;
+    SarOutput output(format);
+    FILE* status = stdout;
+
+    if (argc < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (0 == _stricmp(argv[0], "getconfig"))
+    {
+        operation = SAR_BATCH_GETCONFIG;
+    }
+    else if (0 == _stricmp(argv[0], "setconfig"))
+    {
+        operation = SAR_BATCH_SETCONFIG;
+    }
+    else
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (argc >= 3)
+    {
+        hr = SarThreadPoolParseThreadCount(argv[2], &threadCount);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    hr = SarBatchCollectTargets(operation, argv[1], &folders);
+    if (FAILED(hr))
+    {
+        printf("Failed to enumerate targets in %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+        goto exit;
+    }
+
+    SarConfigPopulateExample(&exampleBlobs);
+
+    items.resize(folders.size());
+    for (size_t i = 0; i < folders.size(); i++)
+    {
+        items[i].Folder = std::move(folders[i]);
+        items[i].Result = S_OK;
+        items[i].Blobs = exampleBlobs;
+    }
+
+    SarBatchRun(operation, &items, threadCount, &stats);
+
+    if ((operation == SAR_BATCH_GETCONFIG) && (format != SarOutputText))
+    {
+        status = stderr;
+    }
+
+    for (const SAR_BATCH_ITEM& item : items)
+    {
+        if (FAILED(item.Result))
+        {
+            fprintf(status, "FAILED 0x%08x %s\n", (UINT32)item.Result, item.Folder.c_str());
+        }
+        else if (status == stderr)
+        {
+            SarConfigFormat(&output,
+                            item.Folder.c_str(),
+                            &item.Blobs.Header,
+                            &item.Blobs.Values,
+                            &item.Blobs.Region,
+                            &item.Blobs.PowerTable);
+        }
+        else if (operation == SAR_BATCH_GETCONFIG)
+        {
+            const SAR_COUNTRY* country = SarCountryFind(item.Blobs.Region.GeoCountryString.AsciiChars);
+
+            printf("OK     0x%08x %s ProductID=0x%02x Version=0x%02x Revision=0x%02x GeoCountryString=0x%04x Domain=%s\n",
+                   (UINT32)item.Result,
+                   item.Folder.c_str(),
+                   item.Blobs.Header.ProductID,
+                   item.Blobs.Header.Version,
+                   item.Blobs.Header.Revision,
+                   item.Blobs.Region.GeoCountryString.AsciiChars,
+                   SarRegulatoryDomainName((country != nullptr) ? country->Domain : SarDomainOther));
+        }
+        else
+        {
+            printf("OK     0x%08x %s\n", (UINT32)item.Result, item.Folder.c_str());
+        }
+    }
+
+    {
+        double seconds = (stats.ElapsedSeconds > 0) ? stats.ElapsedSeconds : 1e-9;
+        double bytes = (double)items.size() * sizeof(SAR_CONFIG_BLOBS);
+
+        fprintf(status,
+                "\n%zu folders (%zu succeeded, %zu failed) on %u threads in %.3f s: %.0f folders/s, %.1f KB/s\n",
+                items.size(),
+                stats.Succeeded,
+                stats.Failed,
+                stats.ThreadCount,
+                stats.ElapsedSeconds,
+                items.size() / seconds,
+                bytes / 1024.0 / seconds);
+    }
+
+    if (stats.Failed != 0)
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarBatch.cpp
+//
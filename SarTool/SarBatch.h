@@ -0,0 +1,82 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarBatch.h
+
+Abstract:
+
+    Batch provisioning: runs getconfig/setconfig against many device folders at once on a
+    work-stealing thread pool and reports per-folder status plus overall throughput.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+#include <vector>
+
+typedef enum _SAR_BATCH_OPERATION
+{
+    SAR_BATCH_GETCONFIG = 0,
+    SAR_BATCH_SETCONFIG = 1,
+} SAR_BATCH_OPERATION;
+
+typedef struct _SAR_BATCH_ITEM
+{
+    std::string Folder;
+    HRESULT Result;
+    SAR_CONFIG_BLOBS Blobs;
+} SAR_BATCH_ITEM;
+
+typedef struct _SAR_BATCH_STATS
+{
+    UINT32 ThreadCount;
+    size_t Succeeded;
+    size_t Failed;
+    double ElapsedSeconds;
+} SAR_BATCH_STATS;
+
+_Check_return_
+HRESULT
+SarBatchCollectTargets(
+    SAR_BATCH_OPERATION operation,
+    _In_z_ LPCSTR source,
+    _Out_ std::vector<std::string>* folders
+    );
+
+// Collects the configurations a command-line source names: the source itself if it is UEFI, a
+// container or a folder holding a header, otherwise the getconfig targets of the manifest or tree.
+//
+_Check_return_
+HRESULT
+SarBatchCollectConfigs(
+    _In_z_ LPCSTR source,
+    _Out_ std::vector<std::string>* paths
+    );
+
+VOID
+SarBatchRun(
+    SAR_BATCH_OPERATION operation,
+    _Inout_ std::vector<SAR_BATCH_ITEM>* items,
+    UINT32 threadCount,
+    _Out_ SAR_BATCH_STATS* stats
+    );
+
+_Check_return_
+HRESULT
+SarBatchCommand(
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarBatch.h
+//
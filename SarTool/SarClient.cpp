@@ -0,0 +1,817 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarClient.cpp
+
+Abstract:
+
+    The getconfig, setconfig, diffconfig, getsar and setsar commands on top of a SarApi.h session.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarClient.h"
+#include "SarConfigFiles.h"
+#include "SarContainer.h"
+#include "SarDeviceService.h"
+#include "SarFields.h"
+#include "SarFirmwareStore.h"
+#include "SarMappedFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define SPEW_EACH_BYTE Yeah!
+#endif
+
+// The number of LTE antennas the first SarSessionGetLteSar makes room for.
+//
+static const UINT32 SAR_LTE_TYPICAL_ANTENNAS = 8;
+
+// The number of WLAN interfaces the first SarSessionGetWifiSarAll makes room for, and the most
+// whose results "setsar wifi --all" prints.
+//
+static const UINT32 SAR_WIFI_TYPICAL_INTERFACES = 16;
+
+_Check_return_
+HRESULT
+SarGetConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    SAR_OUTPUT_FORMAT format
+    )
+/*++
+
+Routine Description:
+
+    Reads config from binary PROVISION files or a provisioning container on the local filesystem or
+    from UEFI, and prints it.
+
+Arguments:
+
+    session - The session whose firmware store holds UEFI.
+    path - "UEFI", the path of a container file (*.sarc) or the path to the folder containing the
+           .bin files containing provisioning info.
+    format - Text, JSON or CSV output.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarOutput output(format);
+
+    if (SarFirmwareIsPath(path))
+    {
+        // All four variables are read in one batch; any that could not be read are printed as
+        // zeroes.
+        SAR_CONFIG_BLOBS blobs;
+
+        hr = SarSessionReadConfig(session, path, &blobs);
+        if (FAILED(hr))
+        {
+            printf("Failed to read configuration from %s, hr = 0x%08x\n", path, (UINT32)hr);
+        }
+
+        SarConfigFormat(&output, path, &blobs.Header, &blobs.Values, &blobs.Region, &blobs.PowerTable);
+    }
+    else if (SarContainerIsPath(path))
+    {
+        // The whole config is in one file: map it once and print the structs straight from the
+        // mapped sections.  Only a compressed power table is copied out, as it is decoded.
+        SarMappedFile mappedFile;
+        SarContainerView container;
+        SAR_POWER_TABLE powerTable;
+
+        hr = mappedFile.Open(path);
+        if (SUCCEEDED(hr))
+        {
+            hr = container.Attach(mappedFile.Data(), mappedFile.Size());
+        }
+
+        if (FAILED(hr))
+        {
+            printf("Failed to read configuration from %s, hr = 0x%08x\n", path, (UINT32)hr);
+            goto exit;
+        }
+
+        SarConfigFormat(&output,
+                        path,
+                        container.View<SAR_CONFIG_HEADER>(SarBlobHeader),
+                        container.View<SAR_CONFIG_VALUES>(SarBlobValues),
+                        container.View<REGION_CONFIG_VALUES>(SarBlobRegion),
+                        container.PowerTable(&powerTable));
+    }
+    else
+    {
+        // The specified path is a folder.  We look for hard-coded file names that match the UEFI
+        // variable names.  Each file is memory-mapped and the structs are printed straight from
+        // the mapped views.
+        SarMappedConfigFolder mappedFolder;
+        SAR_POWER_TABLE powerTable;
+
+        hr = mappedFolder.Open(path);
+        if (FAILED(hr))
+        {
+            printf("Failed to read configuration from %s, hr = 0x%08x\n", path, (UINT32)hr);
+        }
+
+#ifdef SPEW_EACH_BYTE
+        const SarMappedFile& powerTableFile = mappedFolder.File(SarBlobPowerTable);
+
+        // The raw dump would corrupt JSON or CSV output.
+        if (format == SarOutputText)
+        {
+            printf("\nSAR_POWER_TABLE rawData \n");
+            for (size_t i = 0; i < powerTableFile.Size(); i++)
+            {
+                if (i % MAX_NUM_SAR_WIFI_POWER_TABLE == 0)
+                {
+                    printf("\n");
+                }
+                printf("%02x ", powerTableFile.Data()[i]);
+            }
+            printf("\n");
+        }
+#endif
+
+        SarConfigFormat(&output,
+                        path,
+                        mappedFolder.Header(),
+                        mappedFolder.Values(),
+                        mappedFolder.Region(),
+                        mappedFolder.PowerTable(&powerTable));
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarSetConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_opt_z_ LPCSTR source,
+    BOOL fCompress
+    )
+/*++
+
+Routine Description:
+
+    Writes config to a set of binary provisioning files, a provisioning container or directly to
+    UEFI.
+
+Arguments:
+
+    session - The session whose firmware store holds UEFI.
+    path - "UEFI", the path of a container file (*.sarc) or the path to the folder where the .bin
+           files should be written.
+    source - nullptr to write the example config, otherwise "UEFI", a container file or a folder to
+             copy the config from (e.g. to convert between the container and the legacy four-file
+             layout.)
+    fCompress - TRUE to set SARTablesCompressed and write the power table compressed.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS blobs;
+
+    if (source == nullptr)
+    {
+        // Populate the example SAR_CONFIG_HEADER, SAR_CONFIG_VALUES, REGION_CONFIG_VALUES and
+        // SAR_POWER_TABLE.
+        SarConfigPopulateExample(&blobs);
+    }
+    else
+    {
+        hr = SarSessionReadConfig(session, source, &blobs);
+        if (FAILED(hr))
+        {
+            printf("Failed to read configuration from %s, hr = 0x%08x\n", source, (UINT32)hr);
+            goto exit;
+        }
+    }
+
+    // Write to UEFI, a container, or write each struct to the file named after its UEFI variable.
+    hr = SarSessionWriteConfig(session, path, &blobs, fCompress ? SAR_WRITE_CONFIG_COMPRESS : 0);
+    if (FAILED(hr))
+    {
+        printf("Failed to write configuration to %s, hr = 0x%08x\n", path, (UINT32)hr);
+    }
+
+exit:
+    return hr;
+}
+
+template <typename T>
+static
+UINT32
+SarDiffStruct(
+    _In_ const T& a,
+    _In_ const T& b
+    )
+/*++
+
+Routine Description:
+
+    Prints each field of a struct that differs between two configurations.
+
+Arguments:
+
+    a - The struct from the first configuration.
+    b - The struct from the second configuration.
+
+Return Value:
+
+    The number of fields that differ.
+
+--*/
+{
+    return SarFieldsDiff(a, b, [](const SAR_FIELD_DESCRIPTOR& field, UINT32 aValue, UINT32 bValue)
+    {
+        printf("%s.%s: 0x%0*x -> 0x%0*x\n",
+               SarFieldTable<T>::Name,
+               field.Name,
+               field.Width * 2,
+               aValue,
+               field.Width * 2,
+               bValue);
+    });
+}
+
+_Check_return_
+HRESULT
+SarDiffConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_z_ LPCSTR otherPath
+    )
+/*++
+
+Routine Description:
+
+    Reads two configurations and prints every field and power table entry that differs, as
+    "<struct>.<field>: 0x<first> -> 0x<second>".
+
+Arguments:
+
+    session - The session whose firmware store holds UEFI.
+    path - "UEFI", a container file (*.sarc) or a folder of .bin files.
+    otherPath - The configuration to compare it with, in any of the same forms.
+
+Return Value:
+
+    S_OK on success (whether or not the configurations differ) or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONFIG_BLOBS blobs;
+    SAR_CONFIG_BLOBS otherBlobs;
+    UINT32 differences = 0;
+
+    hr = SarSessionReadConfig(session, path, &blobs);
+    if (FAILED(hr))
+    {
+        printf("Failed to read configuration from %s, hr = 0x%08x\n", path, (UINT32)hr);
+        goto exit;
+    }
+
+    hr = SarSessionReadConfig(session, otherPath, &otherBlobs);
+    if (FAILED(hr))
+    {
+        printf("Failed to read configuration from %s, hr = 0x%08x\n", otherPath, (UINT32)hr);
+        goto exit;
+    }
+
+    differences += SarDiffStruct(blobs.Header, otherBlobs.Header);
+    differences += SarDiffStruct(blobs.Values, otherBlobs.Values);
+    differences += SarDiffStruct(blobs.Region, otherBlobs.Region);
+
+    for (UINT32 row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+    {
+        for (UINT32 column = 0; column < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; column++)
+        {
+            UINT8 value = blobs.PowerTable.PowerValues[row][column];
+            UINT8 otherValue = otherBlobs.PowerTable.PowerValues[row][column];
+
+            if (value != otherValue)
+            {
+                printf("SAR_POWER_TABLE.PowerValues[%u][%u]: 0x%02x -> 0x%02x\n", row, column, value, otherValue);
+                differences++;
+            }
+        }
+    }
+
+    if (differences == 0)
+    {
+        printf("The configurations are identical\n");
+    }
+    else
+    {
+        printf("%u difference(s)\n", differences);
+    }
+
+exit:
+    return hr;
+}
+
+static
+VOID
+SarPrintWifiFailure(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR request,
+    HRESULT hr
+    )
+/*++
+
+Routine Description:
+
+    Reports a failed Wi-Fi request, naming the driver's SAR interface version if that is why.
+
+Arguments:
+
+    session - The session the request was sent on.
+    request - The request's opcode name.
+    hr - The failure.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    UINT32 major = 0;
+    UINT32 minor = 0;
+
+    if (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+    {
+        (VOID)SarSessionGetInterfaceVersion(session, &major, &minor);
+        printf("The WLAN driver implements SAR interface version %u.%u, but SarTool was built for %d.%d\r\n",
+            major,
+            minor,
+            WDI_SAR_INTERFACE_VERSION_MAJOR,
+            WDI_SAR_INTERFACE_VERSION_MINOR);
+    }
+
+    printf("%s failed, hr = 0x%08x\r\n", request, (UINT32)hr);
+}
+
+_Check_return_
+static
+HRESULT
+SarWifiSarAllCommand(
+    _In_ SAR_SESSION* session,
+    BOOL fGet,
+    SAR_OUTPUT_FORMAT format,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount
+    )
+/*++
+
+Routine Description:
+
+    Gets or sets the SAR configuration on every WLAN interface at once and prints each interface's
+    outcome, with the interface GUID as its Source in JSON and CSV.
+
+Arguments:
+
+    session - The session.
+    fGet - TRUE if we should get the config; FALSE if we should set the config.
+    format - Text, JSON or CSV output.
+    backoffState - For a set, WDI_SARBACKOFF_DISABLED or WDI_SARBACKOFF_ENABLED.
+    mimoConfigType - For a set, the antenna selection bit mask.
+    configSets - For a set, the pairs.
+    configSetCount - For a set, the number of pairs.
+
+Return Value:
+
+    S_OK if every interface succeeded, otherwise the first interface's failure or the failure to
+    enumerate the interfaces.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarOutput output(format);
+    std::vector<SAR_WIFI_INTERFACE_SAR> interfaces(SAR_WIFI_TYPICAL_INTERFACES);
+    UINT32 count = 0;
+    LPCSTR request = fGet ? "WDI_GET_SAR_STATE" : "WDI_SET_SAR_STATE";
+
+    if (fGet)
+    {
+        hr = SarSessionGetWifiSarAll(session, interfaces.data(), (UINT32)interfaces.size(), &count);
+        if ((hr == E_NOT_SUFFICIENT_BUFFER) && (count > interfaces.size()))
+        {
+            interfaces.resize(count);
+            hr = SarSessionGetWifiSarAll(session, interfaces.data(), (UINT32)interfaces.size(), &count);
+        }
+    }
+    else
+    {
+        // Every interface is set however many results there is room for.
+        hr = SarSessionSetWifiSarAll(session,
+                                     backoffState,
+                                     mimoConfigType,
+                                     configSets,
+                                     configSetCount,
+                                     interfaces.data(),
+                                     (UINT32)interfaces.size(),
+                                     &count);
+        if (hr == E_NOT_SUFFICIENT_BUFFER)
+        {
+            printf("%u WLAN interfaces were set; the results of the first %u follow\r\n", count, (UINT32)interfaces.size());
+            hr = S_OK;
+        }
+    }
+
+    if (count == 0)
+    {
+        printf("%s failed, hr = 0x%08x\r\n", request, (UINT32)hr);
+        goto exit;
+    }
+
+    interfaces.resize(std::min<size_t>(count, interfaces.size()));
+
+    for (const SAR_WIFI_INTERFACE_SAR& interfaceSar : interfaces)
+    {
+        const GUID& guid = interfaceSar.InterfaceGuid;
+        char szGuid[39];
+        UINT32 returned = std::min<UINT32>(interfaceSar.State.NumWdiSarConfigElements, SAR_API_MAX_INTERFACE_CONFIG_SETS);
+
+        snprintf(szGuid, sizeof(szGuid), "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+            guid.Data1, guid.Data2, guid.Data3,
+            guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+            guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+
+        // A state with more pairs than were returned (S_FALSE) is still printed, as far as it goes.
+        if (FAILED(interfaceSar.Status))
+        {
+            if (interfaceSar.Status == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+            {
+                printf("Interface %s: the WLAN driver implements SAR interface version %u.%u, but SarTool was built for %d.%d\r\n",
+                    szGuid,
+                    interfaceSar.InterfaceVersionMajor,
+                    interfaceSar.InterfaceVersionMinor,
+                    WDI_SAR_INTERFACE_VERSION_MAJOR,
+                    WDI_SAR_INTERFACE_VERSION_MINOR);
+            }
+
+            printf("Interface %s: %s failed, hr = 0x%08x\r\n", szGuid, request, (UINT32)interfaceSar.Status);
+            continue;
+        }
+
+        if (format != SarOutputText)
+        {
+            output.BeginRecord(szGuid);
+            if (fGet)
+            {
+                SarFieldsFormat(&output, interfaceSar.State);
+                output.BeginList("ConfigSets");
+                for (UINT32 i = 0; i < returned; i++)
+                {
+                    output.BeginGroup(nullptr, nullptr);
+                    SarFieldsFormat(&output, interfaceSar.ConfigSets[i]);
+                    output.EndGroup();
+                }
+                output.EndList();
+            }
+            else
+            {
+                output.Field("WDI_SAR_RESULT", (UINT32)interfaceSar.Result, 0);
+            }
+            output.EndRecord();
+            continue;
+        }
+
+        printf("Interface %s:\r\n", szGuid);
+
+        if (!fGet)
+        {
+            printf("WlanDeviceServiceCommand WDI_SAR_RESULT = %u\r\n", (UINT32)interfaceSar.Result);
+            continue;
+        }
+
+        printf("WlanDeviceServiceCommand SarBackoffStatus %u, MIMOConfigType=%u, NumWdiSarConfigElements=%u\r\n",
+            (UINT32)interfaceSar.State.SarBackoffStatus,
+            interfaceSar.State.MIMOConfigType,
+            interfaceSar.State.NumWdiSarConfigElements);
+
+        for (UINT32 i = 0; i < returned; i++)
+        {
+            printf("    WDI_SARAntennaIndex %u, WDI_SARBackOffIndex=%u\r\n",
+                interfaceSar.ConfigSets[i].WDI_SARAntennaIndex,
+                interfaceSar.ConfigSets[i].WDI_SARBackOffIndex);
+        }
+
+        if (returned < interfaceSar.State.NumWdiSarConfigElements)
+        {
+            printf("    ... %u more\r\n", interfaceSar.State.NumWdiSarConfigElements - returned);
+        }
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiSarCommand(
+    _In_ SAR_SESSION* session,
+    BOOL fGet,
+    BOOL fAllInterfaces,
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Gets or sets the SAR configuration on the Wi-Fi radio and prints the outcome, as the lines
+    below in text or as one record in JSON or CSV.
+
+Arguments:
+
+    session - The session.
+    fGet - TRUE if we should get the config; FALSE if we should set the config.
+    fAllInterfaces - TRUE to get or set every WLAN interface rather than the first.
+    format - Text, JSON or CSV output.
+    argc - Count of arguments after "wifi".
+    argv - Array of arguments after "wifi": for a set, {on | off} [MIMO config] and then
+           {AntennaIndex PowerTableIndex} pairs.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the arguments are invalid, or the underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarOutput output(format);
+
+    if (fGet && fAllInterfaces)
+    {
+        hr = SarWifiSarAllCommand(session, TRUE, format, WDI_SARBACKOFF_DISABLED, 0, nullptr, 0);
+    }
+    else if (fGet)
+    {
+        WDI_SAR_STATE state;
+        std::vector<WDI_SAR_CONFIG_SET> configSets(SAR_WIFI_TYPICAL_CONFIG_SETS);
+
+        hr = SarSessionGetWifiSar(session, &state, configSets.data(), (UINT32)configSets.size());
+        if (hr == E_NOT_SUFFICIENT_BUFFER)
+        {
+            configSets.resize(state.NumWdiSarConfigElements);
+            hr = SarSessionGetWifiSar(session, &state, configSets.data(), (UINT32)configSets.size());
+        }
+
+        if (FAILED(hr))
+        {
+            SarPrintWifiFailure(session, "WDI_GET_SAR_STATE", hr);
+            goto exit;
+        }
+
+        configSets.resize(state.NumWdiSarConfigElements);
+
+        if (format != SarOutputText)
+        {
+            output.BeginRecord(nullptr);
+            SarFieldsFormat(&output, state);
+            output.BeginList("ConfigSets");
+            for (const WDI_SAR_CONFIG_SET& configSet : configSets)
+            {
+                output.BeginGroup(nullptr, nullptr);
+                SarFieldsFormat(&output, configSet);
+                output.EndGroup();
+            }
+            output.EndList();
+            output.EndRecord();
+            goto exit;
+        }
+
+        printf("WlanDeviceServiceCommand SarBackoffStatus %u, MIMOConfigType=%u, NumWdiSarConfigElements=%u\r\n",
+            (UINT32)state.SarBackoffStatus,
+            state.MIMOConfigType,
+            state.NumWdiSarConfigElements);
+
+        for (size_t i = 0; i < configSets.size(); i++)
+        {
+            printf("    WDI_SARAntennaIndex %u, WDI_SARBackOffIndex=%u\r\n",
+                configSets[i].WDI_SARAntennaIndex,
+                configSets[i].WDI_SARBackOffIndex);
+        }
+    }
+    else
+    {
+        WDI_SAR_BACKOFF_STATE backoffState;
+        UINT32 mimoConfigType = 0;
+        std::vector<WDI_SAR_CONFIG_SET> configSets;
+        UINT32 configSetCount;
+        WDI_SAR_RESULT result = WDI_SAR_SUCCESS;
+
+        // verify 1st arg is "On" or "on" or "oFf" or "OFF", etc.
+        if ((argc >= 1) && (0 == _stricmp(argv[0], "on")))
+        {
+            // verify 2nd arg is numerical MIMO config value, followed by at least one pair
+            if (argc < 4)
+            {
+                hr = E_INVALIDARG;
+                goto exit;
+            }
+
+            backoffState = WDI_SARBACKOFF_ENABLED;
+            mimoConfigType = strtoul(argv[1], nullptr, 16);
+            if (format == SarOutputText)
+            {
+                printf("mimoConfigType = %u\n", mimoConfigType);
+            }
+            argc -= 2;
+            argv += 2;
+        }
+        else if ((argc >= 1) && (0 == _stricmp(argv[0], "off")))
+        {
+            backoffState = WDI_SARBACKOFF_DISABLED;
+            argc -= 1;
+            argv += 1;
+        }
+        else
+        {
+            hr = E_INVALIDARG;
+            goto exit;
+        }
+
+        configSetCount = (UINT32)(argc / 2);
+        if (configSetCount > SAR_WIFI_MAX_CONFIG_SETS)
+        {
+            printf("\nERROR: at most %u {AntennaIndex, PowerTableIndex} pairs are supported\n", SAR_WIFI_MAX_CONFIG_SETS);
+            hr = E_INVALIDARG;
+            goto exit;
+        }
+
+        configSets.resize(configSetCount);
+        for (UINT32 i = 0; i < configSetCount; i++)
+        {
+            configSets[i].WDI_SARAntennaIndex = strtoul(argv[2 * i], nullptr, 16);
+            configSets[i].WDI_SARBackOffIndex = (UINT32)atoi(argv[2 * i + 1]);
+        }
+
+        if (fAllInterfaces)
+        {
+            hr = SarWifiSarAllCommand(session, FALSE, format, backoffState, mimoConfigType, configSets.data(), configSetCount);
+            goto exit;
+        }
+
+        hr = SarSessionSetWifiSar(session, backoffState, mimoConfigType, configSets.data(), configSetCount, &result);
+        if (FAILED(hr))
+        {
+            SarPrintWifiFailure(session, "WDI_SET_SAR_STATE", hr);
+            goto exit;
+        }
+
+        if (format != SarOutputText)
+        {
+            output.BeginRecord(nullptr);
+            output.Field("WDI_SAR_RESULT", (UINT32)result, 0);
+            output.EndRecord();
+            goto exit;
+        }
+
+        printf("WlanDeviceServiceCommand WDI_SAR_RESULT = %u\r\n", (UINT32)result);
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarLteSarCommand(
+    _In_ SAR_SESSION* session,
+    BOOL fGet,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Gets or sets the SAR configuration on the LTE radio (on Windows, through the
+    MobileBroadbandSarManager WinRT API.)
+
+Arguments:
+
+    session - The session.
+    fGet - TRUE if we should get the config; FALSE if we should set the config.
+    argc - Count of arguments after "lte".
+    argv - Array of arguments after "lte": for a set, {AntennaIndex PowerTableIndex} pairs.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the arguments are invalid, or the underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    if (fGet)
+    {
+        BOOL fBackoffEnabled = FALSE;
+        std::vector<SAR_LTE_ANTENNA> antennas(SAR_LTE_TYPICAL_ANTENNAS);
+        UINT32 antennaCount = 0;
+
+        hr = SarSessionGetLteSar(session, &fBackoffEnabled, antennas.data(), (UINT32)antennas.size(), &antennaCount);
+        if (hr == E_NOT_SUFFICIENT_BUFFER)
+        {
+            antennas.resize(antennaCount);
+            hr = SarSessionGetLteSar(session, &fBackoffEnabled, antennas.data(), (UINT32)antennas.size(), &antennaCount);
+        }
+
+        if (hr == E_POINTER)
+        {
+            printf("\nERROR: couldn't get valid SarManager.\n");
+            goto exit;
+        }
+
+        if (FAILED(hr))
+        {
+            printf("Failed to get the LTE SAR configuration, hr = 0x%08x\n", (UINT32)hr);
+            goto exit;
+        }
+
+        printf("\r\n");
+
+        if (fBackoffEnabled)
+        {
+            printf("Backoff is ENabled.\r\n");
+        }
+        else
+        {
+            printf("Backoff is DISabled\r\n.");
+        }
+
+        printf("\r\n");
+
+        // Iterate over antennas and determine what their current config is.
+        for (UINT32 i = 0; i < antennaCount; i++)
+        {
+            printf("AntennaIndex 0x%08x configed to use BackoffIndex %u\r\n",
+                (UINT32)antennas[i].AntennaIndex,
+                (UINT32)antennas[i].SarBackoffIndex);
+        }
+    }
+    else
+    {
+        std::vector<SAR_LTE_ANTENNA> antennas;
+        int antennaPairs = argc / 2;
+
+        if (antennaPairs < 1)
+        {
+            printf("\nERROR: invalid set of {AntennaIndex, PowerTableIndex} pairs\n");
+            hr = E_INVALIDARG;
+            goto exit;
+        }
+
+        // All antennas are configured with one call.
+        antennas.resize(antennaPairs);
+        for (int i = 0; i < antennaPairs; i++)
+        {
+            printf("\n setting {AntennaIndex=%s, PowerTableIndex=%s}\n", argv[2 * i], argv[2 * i + 1]);
+            antennas[i].AntennaIndex = atoi(argv[2 * i]);
+            antennas[i].SarBackoffIndex = atoi(argv[2 * i + 1]);
+        }
+
+        hr = SarSessionSetLteSar(session, antennas.data(), (UINT32)antennas.size());
+        if (hr == E_POINTER)
+        {
+            printf("\nERROR: couldn't get valid SarManager.\n");
+        }
+        else if (FAILED(hr))
+        {
+            printf("Failed to set the LTE SAR configuration, hr = 0x%08x\n", (UINT32)hr);
+        }
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarClient.cpp
+//
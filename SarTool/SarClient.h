@@ -0,0 +1,88 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarClient.h
+
+Abstract:
+
+    The getconfig, setconfig, diffconfig, getsar and setsar commands, as clients of a SarApi.h
+    session.  The commands parse arguments and print; everything they do to a device goes through
+    the session, so SarTool.exe takes the same path as a service that links the library.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarApi.h"
+#include "SarOutput.h"
+
+// "getconfig {UEFI | <path> | <file>.sarc}".  UEFI is read through the session; a container or
+// folder is mapped and printed in place.
+//
+_Check_return_
+HRESULT
+SarGetConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    SAR_OUTPUT_FORMAT format
+    );
+
+// "setconfig [--compress] {UEFI | <path> | <file>.sarc} [source]".  source is nullptr to write
+// the example configuration.
+//
+_Check_return_
+HRESULT
+SarSetConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_opt_z_ LPCSTR source,
+    BOOL fCompress
+    );
+
+// "diffconfig {UEFI | <path> | <file>.sarc} {UEFI | <path> | <file>.sarc}".  Prints the fields
+// that differ, as described by SarFields.h, and the power table entries that differ.
+//
+_Check_return_
+HRESULT
+SarDiffConfigCommand(
+    _In_ SAR_SESSION* session,
+    _In_z_ LPCSTR path,
+    _In_z_ LPCSTR otherPath
+    );
+
+// "getsar wifi" / "setsar wifi {on | off} [MIMO config] {AntennaIndex PowerTableIndex} ...".
+// argv starts after "wifi".  fAllInterfaces ("--all") sends the request to every WLAN interface
+// at once and prints each interface's result.  Returns E_INVALIDARG for bad arguments so the
+// caller can print its usage.
+//
+_Check_return_
+HRESULT
+SarWifiSarCommand(
+    _In_ SAR_SESSION* session,
+    BOOL fGet,
+    BOOL fAllInterfaces,
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// "getsar lte" / "setsar lte {AntennaIndex PowerTableIndex} ...".  argv starts after "lte".
+//
+_Check_return_
+HRESULT
+SarLteSarCommand(
+    _In_ SAR_SESSION* session,
+    BOOL fGet,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarClient.h
+//
@@ -0,0 +1,604 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCodec.cpp
+
+Abstract:
+
+    Platform-neutral, endian-explicit encoding and decoding of the WDI SAR structs.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarCodec.h"
+#include "SarTableCompression.h"
+
+#include <string.h>
+
+template <typename T>
+static
+VOID
+SarFieldsEncode(
+    _In_ const T& value,
+    _Out_writes_bytes_(sizeof(T)) UINT8* buffer
+    )
+/*++
+
+Routine Description:
+
+    Stores each field of value little-endian at its offset in buffer.  SarCodec.h checks that
+    the SarFields.h offsets are the wire offsets, so this is the whole wire image except for any
+    padding.
+
+--*/
+{
+    SarFieldsForEach<T>([&](auto index)
+    {
+        constexpr SAR_FIELD_DESCRIPTOR field = SarFieldTable<T>::Fields[decltype(index)::value];
+        UINT32 fieldValue = SarFieldGet<T, decltype(index)::value>(value);
+
+        if constexpr (field.Width == 1)
+        {
+            buffer[field.Offset] = (UINT8)fieldValue;
+        }
+        else if constexpr (field.Width == 2)
+        {
+            SarStoreLe16(buffer + field.Offset, (UINT16)fieldValue);
+        }
+        else
+        {
+            SarStoreLe32(buffer + field.Offset, fieldValue);
+        }
+    });
+}
+
+template <typename T>
+static
+VOID
+SarFieldsDecode(
+    _In_reads_bytes_(sizeof(T)) const UINT8* buffer,
+    _Out_ T* value
+    )
+{
+    SarFieldsForEach<T>([&](auto index)
+    {
+        constexpr SAR_FIELD_DESCRIPTOR field = SarFieldTable<T>::Fields[decltype(index)::value];
+        UINT32 fieldValue;
+
+        if constexpr (field.Width == 1)
+        {
+            fieldValue = buffer[field.Offset];
+        }
+        else if constexpr (field.Width == 2)
+        {
+            fieldValue = SarLoadLe16(buffer + field.Offset);
+        }
+        else
+        {
+            fieldValue = SarLoadLe32(buffer + field.Offset);
+        }
+
+        SarFieldSet<T, decltype(index)::value>(*value, fieldValue);
+    });
+}
+
+_Check_return_
+HRESULT
+SarEncodeConfigHeader(
+    _In_ const SAR_CONFIG_HEADER* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes a SAR_CONFIG_HEADER.  Every field is a single byte, so the wire image is the fields
+    in declaration order.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarConfigHeaderLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarConfigHeaderLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsEncode(*value, buffer);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeConfigHeader(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ SAR_CONFIG_HEADER* value
+    )
+{
+    if (size < SarConfigHeaderLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsDecode(buffer, value);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeConfigValues(
+    _In_ const SAR_CONFIG_VALUES* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes a SAR_CONFIG_VALUES.  The three timers are unaligned 32-bit little-endian values.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarConfigValuesLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarConfigValuesLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsEncode(*value, buffer);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeConfigValues(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ SAR_CONFIG_VALUES* value
+    )
+{
+    if (size < SarConfigValuesLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsDecode(buffer, value);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeRegionConfig(
+    _In_ const REGION_CONFIG_VALUES* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes a REGION_CONFIG_VALUES.  The two trailing pad bytes are written as zero.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarRegionConfigLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarRegionConfigLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsEncode(*value, buffer);
+    buffer[0x0a] = 0;
+    buffer[0x0b] = 0;
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeRegionConfig(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ REGION_CONFIG_VALUES* value
+    )
+{
+    if (size < SarRegionConfigLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    memset(value, 0, sizeof(*value));
+    SarFieldsDecode(buffer, value);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodePowerTable(
+    _In_ const SAR_POWER_TABLE* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes a SAR_POWER_TABLE: the power values row by row, one byte each.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarPowerTableLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarPowerTableLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    memcpy(buffer, value->PowerValues, SarPowerTableLayout.WireSize);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodePowerTable(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ SAR_POWER_TABLE* value
+    )
+{
+    if (size < SarPowerTableLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    memcpy(value->PowerValues, buffer, SarPowerTableLayout.WireSize);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeSarState(
+    _In_ const WDI_SAR_STATE* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes the WDI_SAR_STATE that starts every SET_SAR/GET_SAR buffer.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarStateLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarStateLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsEncode(*value, buffer);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeSarState(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ WDI_SAR_STATE* value
+    )
+{
+    if (size < SarStateLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsDecode(buffer, value);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeSarConfigSet(
+    _In_ const WDI_SAR_CONFIG_SET* value,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes one antenna/backoff-index pair of a SET_SAR/GET_SAR buffer.
+
+Arguments:
+
+    value - The struct to encode.
+    buffer - Receives SarConfigSetLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size < SarConfigSetLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsEncode(*value, buffer);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeSarConfigSet(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ WDI_SAR_CONFIG_SET* value
+    )
+{
+    if (size < SarConfigSetLayout.WireSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    SarFieldsDecode(buffer, value);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeSarConfigSets(
+    _In_reads_(count) const WDI_SAR_CONFIG_SET* values,
+    UINT32 count,
+    _Out_writes_bytes_(size) UINT8* buffer,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Encodes the antenna/backoff-index pairs that follow the WDI_SAR_STATE of a SET_SAR/GET_SAR
+    buffer.
+
+Arguments:
+
+    values - The pairs to encode.
+    count - Number of pairs.
+    buffer - Receives count * SarConfigSetLayout.WireSize bytes.
+    size - Size of buffer in bytes.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small.
+
+--*/
+{
+    if (size / SarConfigSetLayout.WireSize < count)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        SarFieldsEncode(values[i], buffer);
+        buffer += SarConfigSetLayout.WireSize;
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecodeSarConfigSets(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_writes_(count) WDI_SAR_CONFIG_SET* values,
+    UINT32 count
+    )
+{
+    if (size / SarConfigSetLayout.WireSize < count)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        SarFieldsDecode(buffer, &values[i]);
+        buffer += SarConfigSetLayout.WireSize;
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEncodeConfigBlob(
+    SAR_CONFIG_BLOB_ID blobId,
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_writes_bytes_to_(size, *pImageSize) UINT8* buffer,
+    size_t size,
+    _Out_ size_t* pImageSize
+    )
+/*++
+
+Routine Description:
+
+    Encodes one of the provisioning structs into its UEFI variable/.bin file image.  The power
+    table is compressed if the header asks for it and it shrinks; otherwise every image is
+    SarConfigBlobLayouts[blobId]->WireSize bytes.
+
+Arguments:
+
+    blobId - The struct to encode.
+    blobs - The provisioning structs.
+    buffer - Receives the image.
+    size - Size of buffer in bytes.
+    pImageSize - Receives the size of the image.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small or E_INVALIDARG for an
+    unknown blobId.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    *pImageSize = 0;
+
+    switch (blobId)
+    {
+    case SarBlobHeader:
+        hr = SarEncodeConfigHeader(&blobs->Header, buffer, size);
+        break;
+    case SarBlobValues:
+        hr = SarEncodeConfigValues(&blobs->Values, buffer, size);
+        break;
+    case SarBlobRegion:
+        hr = SarEncodeRegionConfig(&blobs->Region, buffer, size);
+        break;
+    case SarBlobPowerTable:
+        if (blobs->Header.SARTablesCompressed == SAR_TABLES_COMPRESSED_DELTA)
+        {
+            hr = SarCompressPowerTable(&blobs->PowerTable, buffer, size, pImageSize);
+            if (hr == S_OK)
+            {
+                goto exit;
+            }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = SarEncodePowerTable(&blobs->PowerTable, buffer, size);
+        }
+        break;
+    default:
+        hr = E_INVALIDARG;
+        break;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        *pImageSize = SarConfigBlobLayouts[blobId]->WireSize;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarDecodeConfigBlob(
+    SAR_CONFIG_BLOB_ID blobId,
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Inout_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Decodes one of the provisioning structs from its UEFI variable/.bin file image.  The other
+    structs in blobs are left untouched.  A power table image shorter than the raw table is
+    decompressed.
+
+Arguments:
+
+    blobId - The struct to decode.
+    buffer - The encoded image.
+    size - Size of buffer in bytes.
+    blobs - Receives the decoded struct.
+
+Return Value:
+
+    S_OK on success, E_NOT_SUFFICIENT_BUFFER if buffer is too small, ERROR_INVALID_DATA for a
+    damaged compressed power table or E_INVALIDARG for an unknown blobId.
+
+--*/
+{
+    switch (blobId)
+    {
+    case SarBlobHeader:
+        return SarDecodeConfigHeader(buffer, size, &blobs->Header);
+    case SarBlobValues:
+        return SarDecodeConfigValues(buffer, size, &blobs->Values);
+    case SarBlobRegion:
+        return SarDecodeRegionConfig(buffer, size, &blobs->Region);
+    case SarBlobPowerTable:
+        if (SarIsCompressedPowerTable(buffer, size))
+        {
+            return SarDecompressPowerTable(buffer, size, &blobs->PowerTable);
+        }
+        return SarDecodePowerTable(buffer, size, &blobs->PowerTable);
+    default:
+        return E_INVALIDARG;
+    }
+}
+
+// eof: SarCodec.cpp
+//
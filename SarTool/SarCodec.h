@@ -0,0 +1,284 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCodec.h
+
+Abstract:
+
+    Platform-neutral, endian-explicit encoding and decoding of the WDI SAR structs.
+
+    The wire format of each struct is the little-endian, packed layout described by the IHV doc
+    (and produced by the #pragma pack(1) definitions on Windows.)  The layout of every struct is
+    captured in a constexpr descriptor table that is checked at compile time against the native
+    definitions and the SarFields.h descriptors.  The encoders/decoders are generated from those
+    descriptors and assemble each field byte by byte, so they produce the same bytes on any host
+    regardless of its endianness or struct packing.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+#include "SarFields.h"
+
+// Describes one field of a struct's wire layout.  Arrays are described by Count > 1.
+//
+typedef struct _SAR_FIELD_LAYOUT
+{
+    const char* Name;
+    UINT32 Offset;
+    UINT32 Width;       // Bytes per element: 1, 2 or 4.
+    UINT32 Count;
+} SAR_FIELD_LAYOUT;
+
+typedef struct _SAR_STRUCT_LAYOUT
+{
+    const char* Name;
+    UINT32 WireSize;
+    const SAR_FIELD_LAYOUT* Fields;
+    UINT32 FieldCount;
+} SAR_STRUCT_LAYOUT;
+
+static constexpr SAR_FIELD_LAYOUT SarConfigHeaderFields[] =
+{
+    { "Size",                0x00, 1, 1 },
+    { "HeaderOffset1",       0x01, 1, 1 },
+    { "HeaderOffset2",       0x02, 1, 1 },
+    { "WLANTechnology",      0x03, 1, 1 },
+    { "ProductID",           0x04, 1, 1 },
+    { "Version",             0x05, 1, 1 },
+    { "Revision",            0x06, 1, 1 },
+    { "NumberSARTables",     0x07, 1, 1 },
+    { "SARTablesCompressed", 0x08, 1, 1 },
+    { "SARTimersFormat",     0x09, 1, 1 },
+    { "ReservedA",           0x0a, 1, 1 },
+    { "ReservedB",           0x0b, 1, 1 },
+    { "ReservedC",           0x0c, 1, 1 },
+    { "ReservedD",           0x0d, 1, 1 },
+    { "ReservedE",           0x0e, 1, 1 },
+    { "ReservedF",           0x0f, 1, 1 },
+};
+
+static constexpr SAR_FIELD_LAYOUT SarConfigValuesFields[] =
+{
+    { "Size",                            0x00, 1, 1 },
+    { "SARSafetyTimer",                  0x01, 4, 1 },
+    { "SARSafetyRequestResponseTimeout", 0x05, 4, 1 },
+    { "SARUnsolicitedUpdateTimer",       0x09, 4, 1 },
+    { "SARState",                        0x0d, 1, 1 },
+    { "SleepModeState",                  0x0e, 1, 1 },
+    { "SARPowerOnState",                 0x0f, 1, 1 },
+    { "SARPowerOnStateAfterFailure",     0x10, 1, 1 },
+    { "SARSafetyTableIndex",             0x11, 1, 1 },
+    { "SleepModeStateIndexTable",        0x12, 1, 1 },
+};
+
+// REGION_CONFIG_VALUES is not packed, so it has always been stored with two trailing pad bytes.
+//
+static constexpr SAR_FIELD_LAYOUT SarRegionConfigFields[] =
+{
+    { "GeoCountryString.AsciiChars", 0x00, 2, 1 },
+    { "GeoCountryString.Reserved",   0x02, 2, 1 },
+    { "GeoLocationValue",            0x04, 4, 1 },
+    { "DynamicGeoState",             0x08, 1, 1 },
+    { "DynamicGeoType",              0x09, 1, 1 },
+};
+
+static constexpr SAR_FIELD_LAYOUT SarPowerTableFields[] =
+{
+    { "PowerValues", 0x00, 1, MAX_NUM_SAR_WIFI_POWER_TABLE * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE },
+};
+
+static constexpr SAR_FIELD_LAYOUT SarStateFields[] =
+{
+    { "SarBackoffStatus",        0x00, 4, 1 },
+    { "MIMOConfigType",          0x04, 4, 1 },
+    { "NumWdiSarConfigElements", 0x08, 4, 1 },
+};
+
+static constexpr SAR_FIELD_LAYOUT SarConfigSetFields[] =
+{
+    { "WDI_SARAntennaIndex", 0x00, 4, 1 },
+    { "WDI_SARBackOffIndex", 0x04, 4, 1 },
+};
+
+static constexpr SAR_STRUCT_LAYOUT SarConfigHeaderLayout = { "SAR_CONFIG_HEADER",    0x10, SarConfigHeaderFields, ARRAYSIZE(SarConfigHeaderFields) };
+static constexpr SAR_STRUCT_LAYOUT SarConfigValuesLayout = { "SAR_CONFIG_VALUES",    0x13, SarConfigValuesFields, ARRAYSIZE(SarConfigValuesFields) };
+static constexpr SAR_STRUCT_LAYOUT SarRegionConfigLayout = { "REGION_CONFIG_VALUES", 0x0c, SarRegionConfigFields, ARRAYSIZE(SarRegionConfigFields) };
+static constexpr SAR_STRUCT_LAYOUT SarPowerTableLayout   = { "SAR_POWER_TABLE",      0x3c, SarPowerTableFields,   ARRAYSIZE(SarPowerTableFields) };
+static constexpr SAR_STRUCT_LAYOUT SarStateLayout        = { "WDI_SAR_STATE",        0x0c, SarStateFields,        ARRAYSIZE(SarStateFields) };
+static constexpr SAR_STRUCT_LAYOUT SarConfigSetLayout    = { "WDI_SAR_CONFIG_SET",   0x08, SarConfigSetFields,    ARRAYSIZE(SarConfigSetFields) };
+
+// The wire layout of each provisioning blob, indexed by SAR_CONFIG_BLOB_ID.
+//
+static constexpr const SAR_STRUCT_LAYOUT* SarConfigBlobLayouts[SarBlobCount] =
+{
+    &SarConfigHeaderLayout,
+    &SarConfigValuesLayout,
+    &SarRegionConfigLayout,
+    &SarPowerTableLayout,
+};
+
+constexpr
+bool
+SarLayoutIsConsistent(
+    const SAR_STRUCT_LAYOUT& layout
+    )
+/*++
+
+Routine Description:
+
+    Compile-time check that a layout's fields are in order, do not overlap and fit in WireSize.
+
+--*/
+{
+    UINT32 nextOffset = 0;
+
+    for (UINT32 i = 0; i < layout.FieldCount; i++)
+    {
+        const SAR_FIELD_LAYOUT& field = layout.Fields[i];
+
+        if ((field.Offset < nextOffset) ||
+            ((field.Width != 1) && (field.Width != 2) && (field.Width != 4)) ||
+            (field.Count == 0))
+        {
+            return false;
+        }
+
+        nextOffset = field.Offset + field.Width * field.Count;
+    }
+
+    return nextOffset <= layout.WireSize;
+}
+
+static_assert(SarLayoutIsConsistent(SarConfigHeaderLayout), "SAR_CONFIG_HEADER layout");
+static_assert(SarLayoutIsConsistent(SarConfigValuesLayout), "SAR_CONFIG_VALUES layout");
+static_assert(SarLayoutIsConsistent(SarRegionConfigLayout), "REGION_CONFIG_VALUES layout");
+static_assert(SarLayoutIsConsistent(SarPowerTableLayout), "SAR_POWER_TABLE layout");
+static_assert(SarLayoutIsConsistent(SarStateLayout), "WDI_SAR_STATE layout");
+static_assert(SarLayoutIsConsistent(SarConfigSetLayout), "WDI_SAR_CONFIG_SET layout");
+
+// The wire sizes match the sizes of the native structs that SarTool has always written, so files
+// and UEFI variables produced before the codec existed still decode.
+//
+C_ASSERT(SarConfigHeaderLayout.WireSize == sizeof(SAR_CONFIG_HEADER));
+C_ASSERT(SarConfigValuesLayout.WireSize == sizeof(SAR_CONFIG_VALUES));
+C_ASSERT(SarRegionConfigLayout.WireSize == sizeof(REGION_CONFIG_VALUES));
+C_ASSERT(SarPowerTableLayout.WireSize == sizeof(SAR_POWER_TABLE));
+C_ASSERT(SarStateLayout.WireSize == sizeof(WDI_SAR_STATE));
+C_ASSERT(SarConfigSetLayout.WireSize == sizeof(WDI_SAR_CONFIG_SET));
+
+template <typename T>
+constexpr
+bool
+SarFieldsMatchLayout(
+    const SAR_STRUCT_LAYOUT& layout
+    )
+/*++
+
+Routine Description:
+
+    Compile-time check that the SarFields.h descriptors of a struct are its wire layout, field
+    for field, so the encoders and decoders can be generated from them.
+
+--*/
+{
+    if (layout.FieldCount != SarFieldCount<T>)
+    {
+        return false;
+    }
+
+    for (UINT32 i = 0; i < layout.FieldCount; i++)
+    {
+        if ((layout.Fields[i].Offset != SarFieldTable<T>::Fields[i].Offset) ||
+            (layout.Fields[i].Width != SarFieldTable<T>::Fields[i].Width) ||
+            (layout.Fields[i].Count != 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static_assert(SarFieldsMatchLayout<SAR_CONFIG_HEADER>(SarConfigHeaderLayout), "SAR_CONFIG_HEADER fields");
+static_assert(SarFieldsMatchLayout<SAR_CONFIG_VALUES>(SarConfigValuesLayout), "SAR_CONFIG_VALUES fields");
+static_assert(SarFieldsMatchLayout<REGION_CONFIG_VALUES>(SarRegionConfigLayout), "REGION_CONFIG_VALUES fields");
+static_assert(SarFieldsMatchLayout<WDI_SAR_STATE>(SarStateLayout), "WDI_SAR_STATE fields");
+static_assert(SarFieldsMatchLayout<WDI_SAR_CONFIG_SET>(SarConfigSetLayout), "WDI_SAR_CONFIG_SET fields");
+
+//
+// Little-endian load/store helpers.
+//
+
+inline UINT16 SarLoadLe16(const UINT8* p) { return (UINT16)(p[0] | (p[1] << 8)); }
+inline UINT32 SarLoadLe32(const UINT8* p) { return (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24); }
+inline UINT64 SarLoadLe64(const UINT8* p) { return (UINT64)SarLoadLe32(p) | ((UINT64)SarLoadLe32(p + 4) << 32); }
+
+inline VOID SarStoreLe16(UINT8* p, UINT16 v) { p[0] = (UINT8)v; p[1] = (UINT8)(v >> 8); }
+inline VOID SarStoreLe32(UINT8* p, UINT32 v) { p[0] = (UINT8)v; p[1] = (UINT8)(v >> 8); p[2] = (UINT8)(v >> 16); p[3] = (UINT8)(v >> 24); }
+inline VOID SarStoreLe64(UINT8* p, UINT64 v) { SarStoreLe32(p, (UINT32)v); SarStoreLe32(p + 4, (UINT32)(v >> 32)); }
+
+//
+// Encoders write exactly <Layout>.WireSize bytes; decoders read exactly that many.  Both fail with
+// E_NOT_SUFFICIENT_BUFFER if the buffer is smaller.
+//
+
+_Check_return_ HRESULT SarEncodeConfigHeader(_In_ const SAR_CONFIG_HEADER* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeConfigHeader(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ SAR_CONFIG_HEADER* value);
+
+_Check_return_ HRESULT SarEncodeConfigValues(_In_ const SAR_CONFIG_VALUES* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeConfigValues(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ SAR_CONFIG_VALUES* value);
+
+_Check_return_ HRESULT SarEncodeRegionConfig(_In_ const REGION_CONFIG_VALUES* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeRegionConfig(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ REGION_CONFIG_VALUES* value);
+
+_Check_return_ HRESULT SarEncodePowerTable(_In_ const SAR_POWER_TABLE* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodePowerTable(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ SAR_POWER_TABLE* value);
+
+_Check_return_ HRESULT SarEncodeSarState(_In_ const WDI_SAR_STATE* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeSarState(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ WDI_SAR_STATE* value);
+
+_Check_return_ HRESULT SarEncodeSarConfigSet(_In_ const WDI_SAR_CONFIG_SET* value, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeSarConfigSet(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_ WDI_SAR_CONFIG_SET* value);
+
+// The payload of WDI_SET_SAR_STATE and WDI_GET_SAR_STATE is a WDI_SAR_STATE followed by
+// NumWdiSarConfigElements pairs.  These encode/decode the count pairs that follow the state.
+//
+inline size_t SarStatePayloadSize(UINT32 configSetCount) { return SarStateLayout.WireSize + (size_t)configSetCount * SarConfigSetLayout.WireSize; }
+
+_Check_return_ HRESULT SarEncodeSarConfigSets(_In_reads_(count) const WDI_SAR_CONFIG_SET* values, UINT32 count, _Out_writes_bytes_(size) UINT8* buffer, size_t size);
+_Check_return_ HRESULT SarDecodeSarConfigSets(_In_reads_bytes_(size) const UINT8* buffer, size_t size, _Out_writes_(count) WDI_SAR_CONFIG_SET* values, UINT32 count);
+
+// Encode/decode one of the four provisioning blobs by id.  The power table image is shorter than
+// its WireSize when blobs->Header.SARTablesCompressed selects compression (see
+// SarTableCompression.h); the decoder recognizes such an image by its size.
+//
+_Check_return_
+HRESULT
+SarEncodeConfigBlob(
+    SAR_CONFIG_BLOB_ID blobId,
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_writes_bytes_to_(size, *pImageSize) UINT8* buffer,
+    size_t size,
+    _Out_ size_t* pImageSize
+    );
+
+_Check_return_
+HRESULT
+SarDecodeConfigBlob(
+    SAR_CONFIG_BLOB_ID blobId,
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Inout_ SAR_CONFIG_BLOBS* blobs
+    );
+
+// eof: SarCodec.h
+//
@@ -0,0 +1,1272 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarColumns.cpp
+
+Abstract:
+
+    Columnar fleet export, the vector column scans and the columns command.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarColumns.h"
+#include "SarCountry.h"
+#include "SarCrc32c.h"
+#include "SarFields.h"
+#include "SarThreadPool.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <unordered_map>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define SAR_COLUMNS_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SAR_COLUMNS_NEON
+#ifdef _MSC_VER
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+typedef struct _SAR_COLUMN_FIELD
+{
+    LPCSTR Name;
+    UINT16 Offset;        // Within SAR_CONFIG_BLOBS.
+    UINT8 Width;
+} SAR_COLUMN_FIELD;
+
+template <typename T>
+static
+constexpr
+UINT32
+SarColumnFieldsAppend(
+    _Inout_ std::array<SAR_COLUMN_FIELD, SAR_COLUMN_SCALAR_COUNT>& fields,
+    UINT32 column,
+    size_t base
+    )
+{
+    for (const SAR_FIELD_DESCRIPTOR& field : SarFieldTable<T>::Fields)
+    {
+        fields[column].Name = field.ColumnName;
+        fields[column].Offset = (UINT16)(base + field.Offset);
+        fields[column].Width = field.Width;
+        column++;
+    }
+
+    return column;
+}
+
+static
+constexpr
+std::array<SAR_COLUMN_FIELD, SAR_COLUMN_SCALAR_COUNT>
+SarColumnFieldsBuild()
+/*++
+
+Routine Description:
+
+    Lays out the scalar columns at compile time: every field SarFields.h describes for
+    SAR_CONFIG_HEADER, SAR_CONFIG_VALUES and REGION_CONFIG_VALUES, in that order.
+
+--*/
+{
+    std::array<SAR_COLUMN_FIELD, SAR_COLUMN_SCALAR_COUNT> fields = {};
+    UINT32 column = 0;
+
+    column = SarColumnFieldsAppend<SAR_CONFIG_HEADER>(fields, column, offsetof(SAR_CONFIG_BLOBS, Header));
+    column = SarColumnFieldsAppend<SAR_CONFIG_VALUES>(fields, column, offsetof(SAR_CONFIG_BLOBS, Values));
+    column = SarColumnFieldsAppend<REGION_CONFIG_VALUES>(fields, column, offsetof(SAR_CONFIG_BLOBS, Region));
+
+    return fields;
+}
+
+C_ASSERT(SarFieldCount<SAR_CONFIG_HEADER> + SarFieldCount<SAR_CONFIG_VALUES> + SarFieldCount<REGION_CONFIG_VALUES> == SAR_COLUMN_SCALAR_COUNT);
+
+static constexpr std::array<SAR_COLUMN_FIELD, SAR_COLUMN_SCALAR_COUNT> SarColumnFields = SarColumnFieldsBuild();
+static_assert(SarColumnFields[SAR_COLUMN_GEO_COUNTRY_STRING].Offset == offsetof(SAR_CONFIG_BLOBS, Region.GeoCountryString.AsciiChars),
+              "SAR_COLUMN_GEO_COUNTRY_STRING must name GeoCountryString");
+
+static
+UINT32
+SarColumnOffset(
+    UINT32 column
+    )
+{
+    return (column < SAR_COLUMN_SCALAR_COUNT) ? SarColumnFields[column].Offset :
+                                                 (UINT32)offsetof(SAR_CONFIG_BLOBS, PowerTable) + (column - SAR_COLUMN_POWER_FIRST);
+}
+
+static
+size_t
+SarColumnsAlign(
+    size_t offset
+    )
+{
+    return (offset + SAR_COLUMNS_ALIGNMENT - 1) & ~(size_t)(SAR_COLUMNS_ALIGNMENT - 1);
+}
+
+VOID
+SarColumnName(
+    UINT32 column,
+    _Out_writes_(size) char* name,
+    size_t size
+    )
+{
+    if (column < SAR_COLUMN_SCALAR_COUNT)
+    {
+        snprintf(name, size, "%s", SarColumnFields[column].Name);
+    }
+    else
+    {
+        snprintf(name, size, "PowerValues[%u][%u]",
+                 (column - SAR_COLUMN_POWER_FIRST) / MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE,
+                 (column - SAR_COLUMN_POWER_FIRST) % MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE);
+    }
+}
+
+_Check_return_
+HRESULT
+SarColumnFind(
+    _In_z_ LPCSTR name,
+    _Out_ UINT32* column
+    )
+{
+    char columnName[32];
+
+    *column = 0;
+
+    if (0 == _stricmp(name, "Country"))
+    {
+        *column = SAR_COLUMN_GEO_COUNTRY_STRING;
+        return S_OK;
+    }
+
+    for (UINT32 i = 0; i < SAR_COLUMN_COUNT; i++)
+    {
+        SarColumnName(i, columnName, sizeof(columnName));
+        if (0 == _stricmp(name, columnName))
+        {
+            *column = i;
+            return S_OK;
+        }
+    }
+
+    return E_INVALIDARG;
+}
+
+UINT32
+SarColumnWidth(
+    UINT32 column
+    )
+{
+    return (column < SAR_COLUMN_SCALAR_COUNT) ? SarColumnFields[column].Width : 1;
+}
+
+VOID
+SarColumnSetValue(
+    _Inout_ SAR_CONFIG_BLOBS* blobs,
+    UINT32 column,
+    UINT32 value
+    )
+{
+    UINT8* field = (UINT8*)blobs + SarColumnOffset(column);
+
+    switch (SarColumnWidth(column))
+    {
+    case 1:
+        *field = (UINT8)value;
+        break;
+
+    case 2:
+    {
+        UINT16 value16 = (UINT16)value;
+
+        memcpy(field, &value16, sizeof(value16));
+        break;
+    }
+
+    default:
+        memcpy(field, &value, sizeof(value));
+        break;
+    }
+}
+
+template <typename T>
+static
+VOID
+SarSummarizeScalar(
+    _In_ const UINT8* values,
+    size_t first,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    for (size_t i = first; i < count; i++)
+    {
+        T value;
+
+        memcpy(&value, values + i * sizeof(T), sizeof(T));
+        summary->Min = (std::min)(summary->Min, (UINT32)value);
+        summary->Max = (std::max)(summary->Max, (UINT32)value);
+        summary->Sum += value;
+    }
+}
+
+#if defined(SAR_COLUMNS_SSE2)
+
+// Each kernel folds the blocks it covers into summary and returns the number of values covered;
+// the caller finishes the remainder with SarSummarizeScalar.
+//
+static
+size_t
+SarSummarizeVector8(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i minimum = _mm_set1_epi8((char)0xff);
+    __m128i maximum = zero;
+    __m128i sum = zero;
+    UINT8 lanes[2][16];
+    UINT64 sums[2];
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(values + i));
+
+        minimum = _mm_min_epu8(minimum, block);
+        maximum = _mm_max_epu8(maximum, block);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(block, zero));
+    }
+
+    _mm_storeu_si128((__m128i*)lanes[0], minimum);
+    _mm_storeu_si128((__m128i*)lanes[1], maximum);
+    _mm_storeu_si128((__m128i*)sums, sum);
+    for (UINT32 lane = 0; (i != 0) && (lane < 16); lane++)
+    {
+        summary->Min = (std::min)(summary->Min, (UINT32)lanes[0][lane]);
+        summary->Max = (std::max)(summary->Max, (UINT32)lanes[1][lane]);
+    }
+    summary->Sum += sums[0] + sums[1];
+
+    return i;
+}
+
+static
+size_t
+SarSummarizeVector16(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    // SSE2 only compares signed 16-bit lanes, so values are biased by 0x8000 for min/max.  The sum
+    // adds the low and high bytes of each lane separately with SAD.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    __m128i minimum = _mm_set1_epi16(0x7fff);
+    __m128i maximum = bias;
+    __m128i lowSum = zero;
+    __m128i highSum = zero;
+    UINT16 lanes[2][8];
+    UINT64 sums[2][2];
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(values + i * sizeof(UINT16)));
+        __m128i biased = _mm_xor_si128(block, bias);
+
+        minimum = _mm_min_epi16(minimum, biased);
+        maximum = _mm_max_epi16(maximum, biased);
+        lowSum = _mm_add_epi64(lowSum, _mm_sad_epu8(_mm_and_si128(block, lowBytes), zero));
+        highSum = _mm_add_epi64(highSum, _mm_sad_epu8(_mm_srli_epi16(block, 8), zero));
+    }
+
+    _mm_storeu_si128((__m128i*)lanes[0], _mm_xor_si128(minimum, bias));
+    _mm_storeu_si128((__m128i*)lanes[1], _mm_xor_si128(maximum, bias));
+    _mm_storeu_si128((__m128i*)sums[0], lowSum);
+    _mm_storeu_si128((__m128i*)sums[1], highSum);
+    for (UINT32 lane = 0; (i != 0) && (lane < 8); lane++)
+    {
+        summary->Min = (std::min)(summary->Min, (UINT32)lanes[0][lane]);
+        summary->Max = (std::max)(summary->Max, (UINT32)lanes[1][lane]);
+    }
+    summary->Sum += sums[0][0] + sums[0][1] + ((sums[1][0] + sums[1][1]) << 8);
+
+    return i;
+}
+
+static
+size_t
+SarSummarizeVector32(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    // As above, biased by 0x80000000 for the signed compare, and blended with and/andnot since
+    // SSE2 has no 32-bit min/max.  Each lane is widened to 64 bits for the sum.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32((int)0x80000000);
+    __m128i minimum = _mm_set1_epi32(0x7fffffff);
+    __m128i maximum = bias;
+    __m128i sum = zero;
+    UINT32 lanes[2][4];
+    UINT64 sums[2];
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(values + i * sizeof(UINT32)));
+        __m128i biased = _mm_xor_si128(block, bias);
+        __m128i lower = _mm_cmpgt_epi32(minimum, biased);
+        __m128i higher = _mm_cmpgt_epi32(biased, maximum);
+
+        minimum = _mm_or_si128(_mm_and_si128(lower, biased), _mm_andnot_si128(lower, minimum));
+        maximum = _mm_or_si128(_mm_and_si128(higher, biased), _mm_andnot_si128(higher, maximum));
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(block, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(block, zero));
+    }
+
+    _mm_storeu_si128((__m128i*)lanes[0], _mm_xor_si128(minimum, bias));
+    _mm_storeu_si128((__m128i*)lanes[1], _mm_xor_si128(maximum, bias));
+    _mm_storeu_si128((__m128i*)sums, sum);
+    for (UINT32 lane = 0; (i != 0) && (lane < 4); lane++)
+    {
+        summary->Min = (std::min)(summary->Min, lanes[0][lane]);
+        summary->Max = (std::max)(summary->Max, lanes[1][lane]);
+    }
+    summary->Sum += sums[0] + sums[1];
+
+    return i;
+}
+
+#elif defined(SAR_COLUMNS_NEON)
+
+static
+size_t
+SarSummarizeVector8(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    uint8x16_t minimum = vdupq_n_u8(0xff);
+    uint8x16_t maximum = vdupq_n_u8(0);
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        uint8x16_t block = vld1q_u8(values + i);
+
+        minimum = vminq_u8(minimum, block);
+        maximum = vmaxq_u8(maximum, block);
+        sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(block)));
+    }
+
+    if (i != 0)
+    {
+        summary->Min = (std::min)(summary->Min, (UINT32)vminvq_u8(minimum));
+        summary->Max = (std::max)(summary->Max, (UINT32)vmaxvq_u8(maximum));
+        summary->Sum += vaddvq_u64(sum);
+    }
+
+    return i;
+}
+
+static
+size_t
+SarSummarizeVector16(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    uint16x8_t minimum = vdupq_n_u16(0xffff);
+    uint16x8_t maximum = vdupq_n_u16(0);
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        uint16x8_t block = vreinterpretq_u16_u8(vld1q_u8(values + i * sizeof(UINT16)));
+
+        minimum = vminq_u16(minimum, block);
+        maximum = vmaxq_u16(maximum, block);
+        sum = vpadalq_u32(sum, vpaddlq_u16(block));
+    }
+
+    if (i != 0)
+    {
+        summary->Min = (std::min)(summary->Min, (UINT32)vminvq_u16(minimum));
+        summary->Max = (std::max)(summary->Max, (UINT32)vmaxvq_u16(maximum));
+        summary->Sum += vaddvq_u64(sum);
+    }
+
+    return i;
+}
+
+static
+size_t
+SarSummarizeVector32(
+    _In_ const UINT8* values,
+    size_t count,
+    _Inout_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    uint32x4_t minimum = vdupq_n_u32(0xffffffff);
+    uint32x4_t maximum = vdupq_n_u32(0);
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        uint32x4_t block = vreinterpretq_u32_u8(vld1q_u8(values + i * sizeof(UINT32)));
+
+        minimum = vminq_u32(minimum, block);
+        maximum = vmaxq_u32(maximum, block);
+        sum = vpadalq_u32(sum, block);
+    }
+
+    if (i != 0)
+    {
+        summary->Min = (std::min)(summary->Min, (UINT32)vminvq_u32(minimum));
+        summary->Max = (std::max)(summary->Max, (UINT32)vmaxvq_u32(maximum));
+        summary->Sum += vaddvq_u64(sum);
+    }
+
+    return i;
+}
+
+#endif
+
+VOID
+SarColumnSummarizeSoftware(
+    _In_ const void* values,
+    UINT32 width,
+    size_t count,
+    _Out_ SAR_COLUMN_SUMMARY* summary
+    )
+{
+    const UINT8* bytes = static_cast<const UINT8*>(values);
+
+    summary->Count = count;
+    summary->Min = 0xffffffff;
+    summary->Max = 0;
+    summary->Sum = 0;
+
+    switch (width)
+    {
+    case 1:
+        SarSummarizeScalar<UINT8>(bytes, 0, count, summary);
+        break;
+    case 2:
+        SarSummarizeScalar<UINT16>(bytes, 0, count, summary);
+        break;
+    default:
+        SarSummarizeScalar<UINT32>(bytes, 0, count, summary);
+        break;
+    }
+}
+
+VOID
+SarColumnSummarize(
+    _In_ const void* values,
+    UINT32 width,
+    size_t count,
+    _Out_ SAR_COLUMN_SUMMARY* summary
+    )
+/*++
+
+Routine Description:
+
+    Summarizes a column with the vector kernel for its width, 16 bytes per step, and finishes the
+    last partial block with the scalar loop.
+
+Arguments:
+
+    values - The column values, little-endian.
+    width - 1, 2 or 4 bytes per value.
+    count - Number of values.
+    summary - Receives the count, minimum, maximum and sum.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+#if defined(SAR_COLUMNS_SSE2) || defined(SAR_COLUMNS_NEON)
+    const UINT8* bytes = static_cast<const UINT8*>(values);
+
+    summary->Count = count;
+    summary->Min = 0xffffffff;
+    summary->Max = 0;
+    summary->Sum = 0;
+
+    switch (width)
+    {
+    case 1:
+        SarSummarizeScalar<UINT8>(bytes, SarSummarizeVector8(bytes, count, summary), count, summary);
+        break;
+    case 2:
+        SarSummarizeScalar<UINT16>(bytes, SarSummarizeVector16(bytes, count, summary), count, summary);
+        break;
+    default:
+        SarSummarizeScalar<UINT32>(bytes, SarSummarizeVector32(bytes, count, summary), count, summary);
+        break;
+    }
+#else
+    SarColumnSummarizeSoftware(values, width, count, summary);
+#endif
+}
+
+LPCSTR
+SarColumnSummarizeKernel()
+{
+#if defined(SAR_COLUMNS_SSE2)
+    return "SSE2";
+#elif defined(SAR_COLUMNS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+_Check_return_
+HRESULT
+SarColumnsWrite(
+    _In_z_ LPCSTR path,
+    _In_ const std::vector<SAR_BATCH_ITEM>& items,
+    UINT32 threadCount
+    )
+/*++
+
+Routine Description:
+
+    Sorts the configurations that were read successfully by GeoCountryString, lays out one aligned
+    column per field, fills the columns in parallel (one column per work item) and writes the file
+    with a single write.
+
+Arguments:
+
+    path - The columnar file to create or overwrite.
+    items - The results of a batch getconfig.
+    threadCount - Number of worker threads; 0 selects one per hardware thread.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE) if the columns would not fit in a
+    4 GB file, or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_COLUMNS_HEADER header = { 0 };
+    std::vector<const SAR_BATCH_ITEM*> rows;
+    std::vector<SAR_COLUMN_DESCRIPTOR> columns(SAR_COLUMN_COUNT);
+    std::vector<SAR_COLUMN_GROUP> groups;
+    std::vector<UINT8> image;
+    FILE* output = nullptr;
+    size_t offset;
+
+    for (const SAR_BATCH_ITEM& item : items)
+    {
+        if (SUCCEEDED(item.Result))
+        {
+            rows.push_back(&item);
+        }
+    }
+
+    std::sort(rows.begin(), rows.end(), [](const SAR_BATCH_ITEM* a, const SAR_BATCH_ITEM* b)
+    {
+        if (a->Blobs.Region.GeoCountryString.AsciiChars != b->Blobs.Region.GeoCountryString.AsciiChars)
+        {
+            return a->Blobs.Region.GeoCountryString.AsciiChars < b->Blobs.Region.GeoCountryString.AsciiChars;
+        }
+        return a->Folder < b->Folder;
+    });
+
+    for (UINT32 row = 0; row < (UINT32)rows.size(); row++)
+    {
+        UINT16 code = rows[row]->Blobs.Region.GeoCountryString.AsciiChars;
+
+        if (groups.empty() || (groups.back().GeoCountryString != code))
+        {
+            SAR_COLUMN_GROUP group = { 0 };
+
+            group.GeoCountryString = code;
+            group.FirstRow = row;
+            groups.push_back(group);
+        }
+        groups.back().RowCount++;
+    }
+
+    offset = SarColumnsAlign(sizeof(header) +
+                             columns.size() * sizeof(SAR_COLUMN_DESCRIPTOR) +
+                             groups.size() * sizeof(SAR_COLUMN_GROUP));
+    for (UINT32 column = 0; column < SAR_COLUMN_COUNT; column++)
+    {
+        columns[column].Column = (UINT16)column;
+        columns[column].Width = (UINT8)SarColumnWidth(column);
+        columns[column].Offset = (UINT32)offset;
+        offset = SarColumnsAlign(offset + rows.size() * columns[column].Width);
+    }
+
+    if (offset > 0xffffffff)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+        goto exit;
+    }
+
+    header.Signature = SAR_COLUMNS_SIGNATURE;
+    header.FormatVersion = SAR_COLUMNS_FORMAT_VERSION;
+    header.ColumnCount = (UINT16)SAR_COLUMN_COUNT;
+    header.RowCount = (UINT32)rows.size();
+    header.GroupCount = (UINT32)groups.size();
+    header.TotalSize = (UINT32)offset;
+
+    image.resize(offset);
+    memcpy(image.data() + sizeof(header), columns.data(), columns.size() * sizeof(SAR_COLUMN_DESCRIPTOR));
+    if (!groups.empty())
+    {
+        memcpy(image.data() + sizeof(header) + columns.size() * sizeof(SAR_COLUMN_DESCRIPTOR),
+               groups.data(),
+               groups.size() * sizeof(SAR_COLUMN_GROUP));
+    }
+
+    {
+        SarThreadPool pool(threadCount);
+
+        pool.ParallelFor(SAR_COLUMN_COUNT, [&rows, &columns, &image](size_t column)
+        {
+            UINT8* destination = image.data() + columns[column].Offset;
+            UINT32 source = SarColumnOffset((UINT32)column);
+            UINT32 width = columns[column].Width;
+
+            for (const SAR_BATCH_ITEM* row : rows)
+            {
+                memcpy(destination, reinterpret_cast<const UINT8*>(&row->Blobs) + source, width);
+                destination += width;
+            }
+        });
+    }
+
+    header.Crc32c = SarCrc32c(image.data() + sizeof(header), image.size() - sizeof(header));
+    memcpy(image.data(), &header, sizeof(header));
+
+    output = fopen(path, "wb");
+    if (!output)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (fwrite(image.data(), 1, image.size(), output) != image.size())
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+SarColumnsView::SarColumnsView() :
+    m_columns(nullptr),
+    m_groups(nullptr),
+    m_rowCount(0),
+    m_groupCount(0)
+{
+}
+
+_Check_return_
+HRESULT
+SarColumnsView::Open(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Maps a columnar file and validates its header, CRC-32C, column descriptors and country groups.
+
+Arguments:
+
+    path - The columnar file.
+
+Return Value:
+
+    S_OK on success.
+    HRESULT_FROM_WIN32(ERROR_BAD_FORMAT) if the file is not a columnar file of a known version.
+    HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if a column or group refers outside the file.
+    HRESULT_FROM_WIN32(ERROR_CRC) if the file fails its CRC check.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_COLUMNS_HEADER header;
+    const UINT8* data;
+    UINT64 tablesSize;
+    UINT32 nextRow = 0;
+
+    m_columns = nullptr;
+    m_groups = nullptr;
+    m_rowCount = 0;
+    m_groupCount = 0;
+
+    hr = m_file.Open(path);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    data = m_file.Data();
+    if ((data == nullptr) || (m_file.Size() < sizeof(header)))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    if ((header.Signature != SAR_COLUMNS_SIGNATURE) ||
+        (header.FormatVersion != SAR_COLUMNS_FORMAT_VERSION) ||
+        (header.ColumnCount != SAR_COLUMN_COUNT))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    tablesSize = sizeof(header) +
+                 (UINT64)header.ColumnCount * sizeof(SAR_COLUMN_DESCRIPTOR) +
+                 (UINT64)header.GroupCount * sizeof(SAR_COLUMN_GROUP);
+    if ((header.TotalSize < tablesSize) || (header.TotalSize > m_file.Size()))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    if (SarCrc32c(data + sizeof(header), header.TotalSize - sizeof(header)) != header.Crc32c)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_CRC);
+        goto exit;
+    }
+
+    m_columns = reinterpret_cast<const SAR_COLUMN_DESCRIPTOR*>(data + sizeof(header));
+    m_groups = reinterpret_cast<const SAR_COLUMN_GROUP*>(m_columns + header.ColumnCount);
+
+    for (UINT32 column = 0; column < SAR_COLUMN_COUNT; column++)
+    {
+        if ((m_columns[column].Column != column) ||
+            (m_columns[column].Width != SarColumnWidth(column)) ||
+            (m_columns[column].Offset % SAR_COLUMNS_ALIGNMENT != 0) ||
+            (m_columns[column].Offset < tablesSize) ||
+            ((UINT64)m_columns[column].Offset + (UINT64)header.RowCount * m_columns[column].Width > header.TotalSize))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+    }
+
+    // The groups must cover the rows in order, with no gaps or overlaps.
+    for (UINT32 group = 0; group < header.GroupCount; group++)
+    {
+        if ((m_groups[group].FirstRow != nextRow) ||
+            (m_groups[group].RowCount == 0) ||
+            (m_groups[group].RowCount > header.RowCount - nextRow))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+        nextRow += m_groups[group].RowCount;
+    }
+
+    if (nextRow != header.RowCount)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    m_rowCount = header.RowCount;
+    m_groupCount = header.GroupCount;
+
+exit:
+    if (FAILED(hr))
+    {
+        m_columns = nullptr;
+        m_groups = nullptr;
+        m_file.Close();
+    }
+    return hr;
+}
+
+VOID
+SarColumnsView::Summarize(
+    UINT32 column,
+    UINT32 first,
+    UINT32 count,
+    _Out_ SAR_COLUMN_SUMMARY* summary
+    ) const
+{
+    const SAR_COLUMN_DESCRIPTOR* descriptor = &m_columns[column];
+
+    SarColumnSummarize(m_file.Data() + descriptor->Offset + (size_t)first * descriptor->Width,
+                       descriptor->Width,
+                       count,
+                       summary);
+}
+
+VOID
+SarColumnsView::Histogram(
+    UINT32 column,
+    _Out_ std::map<UINT32, UINT64>* histogram
+    ) const
+/*++
+
+Routine Description:
+
+    Counts each distinct value of a column.  Byte columns are counted into four interleaved
+    256-entry tables, so consecutive equal values do not serialize on one counter; wider columns
+    go through a hash table.
+
+Arguments:
+
+    column - The column.
+    histogram - Receives the count of each value present.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    const SAR_COLUMN_DESCRIPTOR* descriptor = &m_columns[column];
+    const UINT8* values = m_file.Data() + descriptor->Offset;
+
+    histogram->clear();
+
+    if (descriptor->Width == 1)
+    {
+        std::vector<UINT64> counts(4 * 256);
+        UINT32 row = 0;
+
+        for (; row + 4 <= m_rowCount; row += 4)
+        {
+            counts[values[row]]++;
+            counts[256 + values[row + 1]]++;
+            counts[512 + values[row + 2]]++;
+            counts[768 + values[row + 3]]++;
+        }
+        for (; row < m_rowCount; row++)
+        {
+            counts[values[row]]++;
+        }
+
+        for (UINT32 value = 0; value < 256; value++)
+        {
+            UINT64 count = counts[value] + counts[256 + value] + counts[512 + value] + counts[768 + value];
+
+            if (count != 0)
+            {
+                (*histogram)[value] = count;
+            }
+        }
+    }
+    else
+    {
+        std::unordered_map<UINT32, UINT64> counts;
+
+        for (UINT32 row = 0; row < m_rowCount; row++)
+        {
+            UINT32 value = 0;
+
+            memcpy(&value, values + (size_t)row * descriptor->Width, descriptor->Width);
+            counts[value]++;
+        }
+
+        histogram->insert(counts.begin(), counts.end());
+    }
+}
+
+static
+VOID
+SarColumnFormatValue(
+    UINT32 column,
+    UINT32 value,
+    _Out_writes_(16) char* text
+    )
+{
+    if (column == SAR_COLUMN_GEO_COUNTRY_STRING)
+    {
+        SarFormatCountryCode((UINT16)value, text);
+    }
+    else if (column >= SAR_COLUMN_POWER_FIRST)
+    {
+        snprintf(text, 16, "%.3f", value / 8.0);
+    }
+    else
+    {
+        snprintf(text, 16, "%u", value);
+    }
+}
+
+static
+VOID
+SarColumnsPrintSummary(
+    LPCSTR label,
+    UINT32 column,
+    _In_ const SAR_COLUMN_SUMMARY* summary
+    )
+{
+    char minimum[16];
+    char maximum[16];
+    char mean[16];
+
+    SarColumnFormatValue(column, summary->Min, minimum);
+    SarColumnFormatValue(column, summary->Max, maximum);
+
+    // The mean of a country code is not a country.
+    if (column == SAR_COLUMN_GEO_COUNTRY_STRING)
+    {
+        snprintf(mean, sizeof(mean), "-");
+    }
+    else if (column >= SAR_COLUMN_POWER_FIRST)
+    {
+        snprintf(mean, sizeof(mean), "%.3f", (double)summary->Sum / summary->Count / 8.0);
+    }
+    else
+    {
+        snprintf(mean, sizeof(mean), "%.2f", (double)summary->Sum / summary->Count);
+    }
+
+    printf("%-32s %10llu %12s %12s %14s\n",
+           label,
+           (unsigned long long)summary->Count,
+           (summary->Count != 0) ? minimum : "-",
+           (summary->Count != 0) ? maximum : "-",
+           (summary->Count != 0) ? mean : "-");
+}
+
+static
+VOID
+SarColumnsPrintPowerTable(
+    _In_ const SarColumnsView& view
+    )
+/*++
+
+Routine Description:
+
+    Prints the fleet mean of each SAR_POWER_TABLE entry, in dBm, with the mean of each row.
+
+Arguments:
+
+    view - The columnar file.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    printf("\nSAR_POWER_TABLE mean, dBm\n\n%-6s", "row");
+    for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+    {
+        printf("   column %d", col);
+    }
+    printf("   row mean\n");
+
+    for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+    {
+        UINT64 rowSum = 0;
+
+        printf("%-6d", row);
+        for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+        {
+            SAR_COLUMN_SUMMARY summary;
+
+            view.Summarize(SAR_COLUMN_POWER_FIRST + row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE + col,
+                           0,
+                           view.RowCount(),
+                           &summary);
+            rowSum += summary.Sum;
+            printf(" %10.3f", (double)summary.Sum / summary.Count / 8.0);
+        }
+        printf(" %10.3f\n", (double)rowSum / ((UINT64)view.RowCount() * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE) / 8.0);
+    }
+}
+
+static
+_Check_return_
+HRESULT
+SarColumnsExport(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "columns export <column file> {UEFI | <path> | <file>.sarc | <manifest> |
+    <directory>} [threads]".  Reads every configuration in parallel as batch getconfig does and
+    writes the columnar file.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the column file.
+
+Return Value:
+
+    S_OK if every configuration was exported, E_INVALIDARG for a malformed command line, otherwise
+    E_FAIL or the failure code from writing the file.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT32 threadCount = 0;
+    std::vector<std::string> paths;
+    std::vector<SAR_BATCH_ITEM> items;
+    SAR_BATCH_STATS stats = { 0 };
+
+    if (argc < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (argc >= 3)
+    {
+        hr = SarThreadPoolParseThreadCount(argv[2], &threadCount);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    hr = SarBatchCollectConfigs(argv[1], &paths);
+    if (FAILED(hr))
+    {
+        printf("Failed to enumerate targets in %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+        goto exit;
+    }
+
+    items.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        items[i].Folder = std::move(paths[i]);
+        items[i].Result = S_OK;
+    }
+
+    SarBatchRun(SAR_BATCH_GETCONFIG, &items, threadCount, &stats);
+
+    for (const SAR_BATCH_ITEM& item : items)
+    {
+        if (FAILED(item.Result))
+        {
+            printf("FAILED 0x%08x %s\n", (UINT32)item.Result, item.Folder.c_str());
+        }
+    }
+
+    hr = SarColumnsWrite(argv[0], items, threadCount);
+    if (FAILED(hr))
+    {
+        printf("Failed to write %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    printf("%zu devices exported (%zu failed) on %u threads in %.3f s: %.0f devices/s\n",
+           stats.Succeeded,
+           stats.Failed,
+           stats.ThreadCount,
+           stats.ElapsedSeconds,
+           items.size() / ((stats.ElapsedSeconds > 0) ? stats.ElapsedSeconds : 1e-9));
+
+    if (stats.Failed != 0)
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarColumnsCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements the columns command:
+
+        columns export <column file> <source> [threads]
+        columns stats <column file> [<field> ...]       count, min, max and mean of each field
+                                                        (all of them, and the power table means,
+                                                        when none are named)
+        columns histogram <column file> <field>         devices per distinct value
+        columns bycountry <column file> <field>         count, min, max and mean per country
+
+    Each query prints the time taken to open the file and scan the columns.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the subcommand.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for a malformed command line, or the failure code from opening
+    the file.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarColumnsView view;
+    std::vector<UINT32> columns;
+    std::map<UINT32, UINT64> histogram;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    char name[32];
+    char value[16];
+    BOOL fAll;
+
+    if (argc < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (0 == _stricmp(argv[0], "export"))
+    {
+        hr = SarColumnsExport(argc - 1, &argv[1]);
+        goto exit;
+    }
+
+    if ((0 != _stricmp(argv[0], "stats")) &&
+        (0 != _stricmp(argv[0], "histogram")) &&
+        (0 != _stricmp(argv[0], "bycountry")))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    for (int i = 2; i < argc; i++)
+    {
+        UINT32 column;
+
+        hr = SarColumnFind(argv[i], &column);
+        if (FAILED(hr))
+        {
+            printf("Unrecognized field '%s'\n", argv[i]);
+            goto exit;
+        }
+        columns.push_back(column);
+    }
+
+    fAll = columns.empty();
+    if ((0 != _stricmp(argv[0], "stats")) && (columns.size() != 1))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    hr = view.Open(argv[1]);
+    if (FAILED(hr))
+    {
+        printf("Failed to open %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+        goto exit;
+    }
+
+    if (0 == _stricmp(argv[0], "stats"))
+    {
+        for (UINT32 column = 0; fAll && (column < SAR_COLUMN_SCALAR_COUNT); column++)
+        {
+            columns.push_back(column);
+        }
+
+        printf("%-32s %10s %12s %12s %14s\n", "field", "devices", "min", "max", "mean");
+        for (UINT32 column : columns)
+        {
+            SAR_COLUMN_SUMMARY summary;
+
+            view.Summarize(column, 0, view.RowCount(), &summary);
+            SarColumnName(column, name, sizeof(name));
+            SarColumnsPrintSummary(name, column, &summary);
+        }
+
+        if (fAll && (view.RowCount() != 0))
+        {
+            SarColumnsPrintPowerTable(view);
+        }
+    }
+    else if (0 == _stricmp(argv[0], "histogram"))
+    {
+        view.Histogram(columns[0], &histogram);
+
+        SarColumnName(columns[0], name, sizeof(name));
+        printf("%-16s %10s %8s\n", name, "devices", "share");
+        for (const std::pair<const UINT32, UINT64>& bucket : histogram)
+        {
+            SarColumnFormatValue(columns[0], bucket.first, value);
+            printf("%-16s %10llu %7.2f%%\n",
+                   value,
+                   (unsigned long long)bucket.second,
+                   100.0 * bucket.second / view.RowCount());
+        }
+    }
+    else
+    {
+        SarColumnName(columns[0], name, sizeof(name));
+        printf("%-32s %10s %12s %12s %14s\n", name, "devices", "min", "max", "mean");
+        for (UINT32 group = 0; group < view.GroupCount(); group++)
+        {
+            const SAR_COLUMN_GROUP* countryGroup = view.Group(group);
+            const SAR_COUNTRY* country = SarCountryFind(countryGroup->GeoCountryString);
+            SAR_COLUMN_SUMMARY summary;
+            char label[64];
+
+            SarFormatCountryCode(countryGroup->GeoCountryString, value);
+            snprintf(label, sizeof(label), "%s %s", value, (country != nullptr) ? country->Name : "");
+            view.Summarize(columns[0], countryGroup->FirstRow, countryGroup->RowCount, &summary);
+            SarColumnsPrintSummary(label, columns[0], &summary);
+        }
+    }
+
+    printf("\n%u devices, %u countries, %s kernel (%.3f ms)\n",
+           view.RowCount(),
+           view.GroupCount(),
+           SarColumnSummarizeKernel(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+exit:
+    return hr;
+}
+
+// eof: SarColumns.cpp
+//
@@ -0,0 +1,237 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarColumns.h
+
+Abstract:
+
+    Columnar export of a fleet's configurations for fleet-wide statistics, such as the spread of
+    SARSafetyTimer or the average power of each SAR_POWER_TABLE row.  Every field of
+    SAR_CONFIG_HEADER, SAR_CONFIG_VALUES and REGION_CONFIG_VALUES, and each of the 60 power table
+    entries, is stored as its own contiguous array, so an aggregate over one field reads only that
+    field's bytes and runs as a vector scan instead of a walk over packed structs.
+
+    Layout (all fields little-endian):
+
+        SAR_COLUMNS_HEADER
+        SAR_COLUMN_DESCRIPTOR[ColumnCount]      in SAR_COLUMN order
+        SAR_COLUMN_GROUP[GroupCount]            one per GeoCountryString, in code order
+        columns                                 RowCount values of the column's width each, every
+                                                column starting on a 64-byte boundary
+
+    Rows are sorted by GeoCountryString (then by device path), so a group-by-country aggregate is a
+    scan of one contiguous row range per country.  Device paths are not stored; the index (see
+    SarIndex.h) answers which devices match.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarBatch.h"
+#include "SarMappedFile.h"
+
+#include <map>
+#include <vector>
+
+static const UINT32 SAR_COLUMNS_SIGNATURE = 0x4c4f4353; // "SCOL"
+static const UINT16 SAR_COLUMNS_FORMAT_VERSION = 1;
+static const UINT32 SAR_COLUMNS_ALIGNMENT = 64;
+
+// Columns 0 .. SAR_COLUMN_SCALAR_COUNT - 1 are the fields of SAR_CONFIG_HEADER, SAR_CONFIG_VALUES
+// and REGION_CONFIG_VALUES in declaration order; the rest are SAR_POWER_TABLE.PowerValues in row
+// order, 1/8 dBm each.
+//
+static const UINT32 SAR_COLUMN_SCALAR_COUNT = 31;
+static const UINT32 SAR_COLUMN_GEO_COUNTRY_STRING = 26;
+static const UINT32 SAR_COLUMN_POWER_FIRST = SAR_COLUMN_SCALAR_COUNT;
+static const UINT32 SAR_COLUMN_COUNT = SAR_COLUMN_SCALAR_COUNT + MAX_NUM_SAR_WIFI_POWER_TABLE * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct _SAR_COLUMNS_HEADER
+{
+    UINT32 Signature;
+    UINT16 FormatVersion;
+    UINT16 ColumnCount;
+    UINT32 RowCount;
+    UINT32 GroupCount;
+    UINT32 TotalSize;
+    UINT32 Crc32c;        // CRC-32C of the rest of the file.
+    UINT64 Reserved;
+} SAR_COLUMNS_HEADER;
+C_ASSERT(sizeof(SAR_COLUMNS_HEADER) == 0x20);
+
+typedef struct _SAR_COLUMN_DESCRIPTOR
+{
+    UINT16 Column;
+    UINT8 Width;          // 1, 2 or 4 bytes per value.
+    UINT8 Reserved;
+    UINT32 Offset;        // From the start of the file, a multiple of SAR_COLUMNS_ALIGNMENT.
+} SAR_COLUMN_DESCRIPTOR;
+C_ASSERT(sizeof(SAR_COLUMN_DESCRIPTOR) == 0x08);
+
+typedef struct _SAR_COLUMN_GROUP
+{
+    UINT16 GeoCountryString;
+    UINT16 Reserved;
+    UINT32 FirstRow;
+    UINT32 RowCount;
+} SAR_COLUMN_GROUP;
+C_ASSERT(sizeof(SAR_COLUMN_GROUP) == 0x0c);
+#pragma pack(pop)
+
+typedef struct _SAR_COLUMN_SUMMARY
+{
+    UINT64 Count;
+    UINT32 Min;           // 0xffffffff and 0 when Count is 0.
+    UINT32 Max;
+    UINT64 Sum;
+} SAR_COLUMN_SUMMARY;
+
+// Writes the column name, e.g. "SARSafetyTimer", "Values.Size" or "PowerValues[3][1]".
+//
+VOID
+SarColumnName(
+    UINT32 column,
+    _Out_writes_(size) char* name,
+    size_t size
+    );
+
+// Finds a column by name, ignoring case; "Country" is accepted for GeoCountryString.
+//
+_Check_return_
+HRESULT
+SarColumnFind(
+    _In_z_ LPCSTR name,
+    _Out_ UINT32* column
+    );
+
+UINT32
+SarColumnWidth(
+    UINT32 column
+    );
+
+// Stores value in a column of one configuration, truncated to the column's width.
+//
+VOID
+SarColumnSetValue(
+    _Inout_ SAR_CONFIG_BLOBS* blobs,
+    UINT32 column,
+    UINT32 value
+    );
+
+// Computes the count, minimum, maximum and sum of count values of width bytes each, with SSE2
+// (x86/x64) or NEON (ARM64) where available.
+//
+VOID
+SarColumnSummarize(
+    _In_ const void* values,
+    UINT32 width,
+    size_t count,
+    _Out_ SAR_COLUMN_SUMMARY* summary
+    );
+
+// The portable implementation, exposed so callers can compare it with the vector path.
+//
+VOID
+SarColumnSummarizeSoftware(
+    _In_ const void* values,
+    UINT32 width,
+    size_t count,
+    _Out_ SAR_COLUMN_SUMMARY* summary
+    );
+
+LPCSTR
+SarColumnSummarizeKernel();
+
+// Writes a columnar file of the configurations read by a batch getconfig; failed items are left out.
+//
+_Check_return_
+HRESULT
+SarColumnsWrite(
+    _In_z_ LPCSTR path,
+    _In_ const std::vector<SAR_BATCH_ITEM>& items,
+    UINT32 threadCount
+    );
+
+// Maps a columnar file and validates it.
+//
+class SarColumnsView
+{
+public:
+
+    SarColumnsView();
+
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR path
+        );
+
+    UINT32
+    RowCount() const
+    {
+        return m_rowCount;
+    }
+
+    UINT32
+    GroupCount() const
+    {
+        return m_groupCount;
+    }
+
+    const SAR_COLUMN_GROUP*
+    Group(
+        UINT32 group
+        ) const
+    {
+        return &m_groups[group];
+    }
+
+    // Summarizes rows first .. first + count - 1 of a column.
+    //
+    VOID
+    Summarize(
+        UINT32 column,
+        UINT32 first,
+        UINT32 count,
+        _Out_ SAR_COLUMN_SUMMARY* summary
+        ) const;
+
+    // Counts the rows holding each distinct value of a column.
+    //
+    VOID
+    Histogram(
+        UINT32 column,
+        _Out_ std::map<UINT32, UINT64>* histogram
+        ) const;
+
+private:
+
+    SarMappedFile m_file;
+    const SAR_COLUMN_DESCRIPTOR* m_columns;
+    const SAR_COLUMN_GROUP* m_groups;
+    UINT32 m_rowCount;
+    UINT32 m_groupCount;
+};
+
+// Implements "columns export <column file> <source> [threads]", "columns stats <column file>
+// [<field> ...]", "columns histogram <column file> <field>" and "columns bycountry <column file>
+// <field>".
+//
+_Check_return_
+HRESULT
+SarColumnsCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarColumns.h
+//
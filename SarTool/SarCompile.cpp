@@ -0,0 +1,599 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCompile.cpp
+
+Abstract:
+
+    The SKU spec compiler and the compile command.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarCompile.h"
+#include "SarColumns.h"
+#include "SarCountry.h"
+#include "SarHash.h"
+#include "SarThreadPool.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+// Seeds the hash of a SKU compiled to a container rather than a folder, so changing the layout
+// rebuilds every SKU.
+//
+static const UINT64 SAR_COMPILE_CONTAINER_SEED = 0x53415243;    // "SARC"
+
+static const UINT32 SAR_COMPILE_POWER_ENTRIES = MAX_NUM_SAR_WIFI_POWER_TABLE * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+
+static
+std::string
+SarCompileTrim(
+    _In_ const std::string& text
+    )
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    size_t last = text.find_last_not_of(" \t\r");
+
+    return (first == std::string::npos) ? std::string() : text.substr(first, last - first + 1);
+}
+
+static
+BOOL
+SarCompileIsSkuName(
+    _In_ const std::string& name
+    )
+{
+    if (name.empty() || (name == ".") || (name == ".."))
+    {
+        return FALSE;
+    }
+
+    for (char c : name)
+    {
+        if (!isalnum((unsigned char)c) && (c != '-') && (c != '_') && (c != '.'))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+_Check_return_
+static
+HRESULT
+SarCompileParseField(
+    _In_ const std::string& name,
+    _Out_ SAR_COMPILE_ASSIGNMENT* assignment
+    )
+/*++
+
+Routine Description:
+
+    Resolves a field name to the columns it assigns: a scalar field, one power table entry
+    ("PowerValues[2][4]"), one row ("PowerValues[2]") or the whole table ("PowerValues").
+
+Arguments:
+
+    name - The field name.
+    assignment - Receives FirstColumn and ColumnCount.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the field is not recognized.
+
+--*/
+{
+    static const char rowPrefix[] = "PowerValues[";
+    const size_t rowPrefixLength = sizeof(rowPrefix) - 1;
+
+    if (0 == _stricmp(name.c_str(), "PowerValues"))
+    {
+        assignment->FirstColumn = SAR_COLUMN_POWER_FIRST;
+        assignment->ColumnCount = SAR_COMPILE_POWER_ENTRIES;
+        return S_OK;
+    }
+
+    if ((name.size() > rowPrefixLength) &&
+        (0 == _strnicmp(name.c_str(), rowPrefix, rowPrefixLength)) &&
+        (name.back() == ']') &&
+        (name.find('[', rowPrefixLength) == std::string::npos))
+    {
+        std::string rowText = name.substr(rowPrefixLength, name.size() - rowPrefixLength - 1);
+        char* end = nullptr;
+        unsigned long row = strtoul(rowText.c_str(), &end, 10);
+
+        if (rowText.empty() || (*end != '\0') || (row >= MAX_NUM_SAR_WIFI_POWER_TABLE))
+        {
+            return E_INVALIDARG;
+        }
+
+        assignment->FirstColumn = SAR_COLUMN_POWER_FIRST + (UINT32)row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+        assignment->ColumnCount = MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+        return S_OK;
+    }
+
+    assignment->ColumnCount = 1;
+    return SarColumnFind(name.c_str(), &assignment->FirstColumn);
+}
+
+_Check_return_
+static
+HRESULT
+SarCompileParseValue(
+    UINT32 column,
+    _In_ const std::string& text,
+    _Out_ UINT32* value
+    )
+{
+    UINT32 width = SarColumnWidth(column);
+    UINT64 limit = (width >= 4) ? 0xffffffffull : ((1ull << (8 * width)) - 1);
+    unsigned long long parsed;
+    char* end = nullptr;
+
+    *value = 0;
+
+    if ((column == SAR_COLUMN_GEO_COUNTRY_STRING) &&
+        (text.size() == 2) && isalpha((unsigned char)text[0]) && isalpha((unsigned char)text[1]))
+    {
+        UINT16 country = (UINT16)((toupper((unsigned char)text[0]) << 8) | toupper((unsigned char)text[1]));
+
+        if (SarCountryIndex(country) == SAR_COUNTRY_NONE)
+        {
+            return E_INVALIDARG;
+        }
+
+        *value = country;
+        return S_OK;
+    }
+
+    parsed = strtoull(text.c_str(), &end, 0);
+    if (text.empty() || (text[0] == '-') || (*end != '\0') || (parsed > limit))
+    {
+        return E_INVALIDARG;
+    }
+
+    *value = (UINT32)parsed;
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarCompileParse(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_COMPILE_SPEC* spec
+    )
+/*++
+
+Routine Description:
+
+    Reads a SKU spec (see SarCompile.h.)
+
+Arguments:
+
+    path - The spec.
+    spec - Receives the base assignments and each SKU's overrides, in file order.
+
+Return Value:
+
+    S_OK on success, ERROR_FILE_NOT_FOUND or ERROR_INVALID_DATA (after printing the offending
+    line.)
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::ifstream file(path);
+    std::string line;
+    UINT32 lineNumber = 0;
+    std::unordered_map<std::string, UINT32> skuLines;
+
+    spec->Base.clear();
+    spec->Skus.clear();
+
+    if (!file.is_open())
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        goto exit;
+    }
+
+    while (std::getline(file, line))
+    {
+        std::string text = SarCompileTrim(line.substr(0, line.find('#')));
+        SAR_COMPILE_ASSIGNMENT assignment;
+        std::istringstream tokens;
+        std::string name;
+        std::string token;
+        size_t equals;
+
+        lineNumber++;
+
+        if (text.empty())
+        {
+            continue;
+        }
+
+        if (text[0] == '[')
+        {
+            SAR_COMPILE_SKU sku;
+
+            sku.Name = SarCompileTrim(text.substr(1, text.size() - 1 - ((text.back() == ']') ? 1 : 0)));
+            if ((text.back() != ']') || !SarCompileIsSkuName(sku.Name))
+            {
+                printf("%s(%u): '%s' is not a SKU name (letters, digits, '-', '_' and '.')\n", path, lineNumber, text.c_str());
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                goto exit;
+            }
+
+            if (!skuLines.emplace(sku.Name, lineNumber).second)
+            {
+                printf("%s(%u): SKU %s is already defined on line %u\n", path, lineNumber, sku.Name.c_str(), skuLines[sku.Name]);
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                goto exit;
+            }
+
+            spec->Skus.push_back(std::move(sku));
+            continue;
+        }
+
+        equals = text.find('=');
+        name = SarCompileTrim(text.substr(0, equals));
+        if ((equals == std::string::npos) || FAILED(SarCompileParseField(name, &assignment)))
+        {
+            printf("%s(%u): expected '<field> = <value>', where <field> is a SAR_CONFIG_HEADER, SAR_CONFIG_VALUES or REGION_CONFIG_VALUES field or PowerValues\n",
+                   path, lineNumber);
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        assignment.Line = lineNumber;
+        tokens.str(text.substr(equals + 1));
+        while (tokens >> token)
+        {
+            UINT32 column = assignment.FirstColumn + (UINT32)(assignment.Values.size() % assignment.ColumnCount);
+            UINT32 value;
+
+            if (FAILED(SarCompileParseValue(column, token, &value)))
+            {
+                printf("%s(%u): '%s' is not a valid value for %s\n", path, lineNumber, token.c_str(), name.c_str());
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                goto exit;
+            }
+
+            assignment.Values.push_back(value);
+        }
+
+        // A table takes one value, one per column or one per entry; a row one or one per column.
+        if ((assignment.Values.size() != 1) &&
+            (assignment.Values.size() != assignment.ColumnCount) &&
+            ((assignment.ColumnCount != SAR_COMPILE_POWER_ENTRIES) ||
+             (assignment.Values.size() != MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE)))
+        {
+            printf("%s(%u): %s takes %s, not %zu\n",
+                   path,
+                   lineNumber,
+                   name.c_str(),
+                   (assignment.ColumnCount == 1) ? "one value" :
+                   (assignment.ColumnCount == MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE) ? "1 or 5 values" : "1, 5 or 60 values",
+                   assignment.Values.size());
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        if (spec->Skus.empty())
+        {
+            spec->Base.push_back(std::move(assignment));
+        }
+        else
+        {
+            spec->Skus.back().Assignments.push_back(std::move(assignment));
+        }
+    }
+
+exit:
+    return hr;
+}
+
+static
+VOID
+SarCompileApply(
+    _In_ const std::vector<SAR_COMPILE_ASSIGNMENT>& assignments,
+    _Inout_ SAR_CONFIG_BLOBS* blobs
+    )
+{
+    for (const SAR_COMPILE_ASSIGNMENT& assignment : assignments)
+    {
+        for (UINT32 i = 0; i < assignment.ColumnCount; i++)
+        {
+            SarColumnSetValue(blobs, assignment.FirstColumn + i, assignment.Values[i % assignment.Values.size()]);
+        }
+    }
+}
+
+VOID
+SarCompileSku(
+    _In_ const SAR_COMPILE_SPEC& spec,
+    _In_ const SAR_COMPILE_SKU& sku,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+{
+    memset(blobs, 0, sizeof(*blobs));
+
+    // The sizes and offsets setconfig's example uses; a spec may still override them.
+    blobs->Header.Size = sizeof(SAR_CONFIG_HEADER) + 2 * sizeof(SAR_CONFIG_VALUES);
+    blobs->Header.HeaderOffset1 = sizeof(SAR_CONFIG_HEADER);
+    blobs->Header.HeaderOffset2 = sizeof(SAR_CONFIG_HEADER) + sizeof(SAR_CONFIG_VALUES);
+    blobs->Values.Size = sizeof(SAR_CONFIG_VALUES);
+
+    SarCompileApply(spec.Base, blobs);
+    SarCompileApply(sku.Assignments, blobs);
+}
+
+_Check_return_
+static
+HRESULT
+SarCompileCreateDirectory(
+    _In_z_ LPCSTR path
+    )
+{
+#ifdef _WIN32
+    if (!CreateDirectoryA(path, nullptr) && (GetLastError() != ERROR_ALREADY_EXISTS))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+#else
+    if ((mkdir(path, 0755) != 0) && (errno != EEXIST))
+    {
+        return SarHresultFromErrno(errno);
+    }
+#endif
+
+    return S_OK;
+}
+
+static
+BOOL
+SarCompileFileExists(
+    _In_ const std::string& path
+    )
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == nullptr)
+    {
+        return FALSE;
+    }
+
+    fclose(file);
+    return TRUE;
+}
+
+_Check_return_
+HRESULT
+SarCompileCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "compile <spec> <output directory> [threads] [--container] [--force]".  Compiles
+    every SKU in parallel and writes it to <output directory>\<SKU>\ as four .bin files, or to
+    <output directory>\<SKU>.sarc with --container.
+
+    Each SKU's compiled structs are hashed (XXH64) and the hashes kept in sarcompile.cache in the
+    output directory; a SKU whose hash is unchanged and whose output still exists is not written
+    again, so editing one SKU rewrites only that SKU and editing the base only the SKUs it changes.
+    --force writes every SKU.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the spec.
+
+Return Value:
+
+    S_OK if every SKU compiled, E_INVALIDARG for a malformed command line, otherwise E_FAIL or the
+    failure code from reading the spec.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_COMPILE_SPEC spec;
+    LPCSTR paths[2] = { nullptr, nullptr };
+    int pathCount = 0;
+    UINT32 threadCount = 0;
+    BOOL fContainer = FALSE;
+    BOOL fForce = FALSE;
+    std::string cachePath;
+    std::unordered_map<std::string, UINT64> cache;
+    std::vector<UINT64> hashes;
+    std::vector<HRESULT> results;
+    std::vector<BOOL> built;
+    size_t builtCount = 0;
+    size_t failedCount = 0;
+    FILE* cacheFile = nullptr;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--container"))
+        {
+            fContainer = TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--force"))
+        {
+            fForce = TRUE;
+        }
+        else if (pathCount < 2)
+        {
+            paths[pathCount++] = argv[i];
+        }
+        else
+        {
+            hr = SarThreadPoolParseThreadCount(argv[i], &threadCount);
+            if (FAILED(hr))
+            {
+                goto exit;
+            }
+        }
+    }
+
+    if (pathCount < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    hr = SarCompileParse(paths[0], &spec);
+    if (FAILED(hr))
+    {
+        printf("Failed to read spec %s, hr = 0x%08x\n", paths[0], (UINT32)hr);
+        goto exit;
+    }
+
+    if (spec.Skus.empty())
+    {
+        printf("%s defines no SKUs; start each with a [<SKU name>] line\n", paths[0]);
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    hr = SarCompileCreateDirectory(paths[1]);
+    if (FAILED(hr))
+    {
+        printf("Failed to create %s, hr = 0x%08x\n", paths[1], (UINT32)hr);
+        goto exit;
+    }
+
+    cachePath = std::string(paths[1]) + SAR_PATH_SEPARATOR + SAR_COMPILE_CACHE_NAME;
+    {
+        std::ifstream cacheInput(cachePath);
+        std::string line;
+
+        while (std::getline(cacheInput, line))
+        {
+            std::istringstream tokens(line);
+            std::string hashText;
+            std::string name;
+
+            if (tokens >> hashText >> name)
+            {
+                cache[name] = strtoull(hashText.c_str(), nullptr, 16);
+            }
+        }
+    }
+
+    hashes.resize(spec.Skus.size());
+    results.resize(spec.Skus.size(), S_OK);
+    built.resize(spec.Skus.size(), FALSE);
+    {
+        SarThreadPool pool(threadCount);
+
+        pool.ParallelFor(spec.Skus.size(), [&](size_t index)
+        {
+            const SAR_COMPILE_SKU& sku = spec.Skus[index];
+            std::string output = std::string(paths[1]) + SAR_PATH_SEPARATOR + sku.Name;
+            SAR_CONFIG_BLOBS blobs;
+            auto cached = cache.find(sku.Name);
+
+            SarCompileSku(spec, sku, &blobs);
+            hashes[index] = SarHash64(&blobs, sizeof(blobs), fContainer ? SAR_COMPILE_CONTAINER_SEED : 0);
+
+            if (fContainer)
+            {
+                output += ".sarc";
+            }
+
+            if (!fForce &&
+                (cached != cache.end()) &&
+                (cached->second == hashes[index]) &&
+                SarCompileFileExists(fContainer ? output : SarConfigBlobPath(output.c_str(), SarBlobHeader)))
+            {
+                return;
+            }
+
+            results[index] = fContainer ? S_OK : SarCompileCreateDirectory(output.c_str());
+            if (SUCCEEDED(results[index]))
+            {
+                results[index] = SarConfigSave(output.c_str(), &blobs);
+            }
+
+            built[index] = TRUE;
+        });
+    }
+
+    for (size_t i = 0; i < spec.Skus.size(); i++)
+    {
+        if (FAILED(results[i]))
+        {
+            printf("FAILED 0x%08x %s\n", (UINT32)results[i], spec.Skus[i].Name.c_str());
+            failedCount++;
+        }
+        else if (built[i])
+        {
+            printf("built %s\n", spec.Skus[i].Name.c_str());
+            builtCount++;
+        }
+    }
+
+    // SKUs that failed are left out so the next run retries them.
+    cacheFile = fopen(cachePath.c_str(), "w");
+    if (cacheFile == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        printf("Failed to write %s, hr = 0x%08x\n", cachePath.c_str(), (UINT32)hr);
+        goto exit;
+    }
+
+    for (size_t i = 0; i < spec.Skus.size(); i++)
+    {
+        if (SUCCEEDED(results[i]))
+        {
+            fprintf(cacheFile, "%016llx %s\n", (unsigned long long)hashes[i], spec.Skus[i].Name.c_str());
+        }
+    }
+
+    if ((fclose(cacheFile) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu SKUs: %zu built, %zu up to date, %zu failed in %.3f s\n",
+           spec.Skus.size(),
+           builtCount,
+           spec.Skus.size() - builtCount - failedCount,
+           failedCount,
+           seconds);
+
+    if (failedCount != 0)
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarCompile.cpp
+//
@@ -0,0 +1,100 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCompile.h
+
+Abstract:
+
+    Compiles a SKU spec into the provisioning structs of every SKU it lists.
+
+    A spec is a text file of "<field> = <value>" assignments.  Assignments before the first
+    "[<SKU name>]" line are the base shared by every SKU; those after it override the base for
+    that SKU only.  '#' starts a comment:
+
+        # Base
+        WLANTechnology = 3
+        ProductID = 0x4
+        SARSafetyTimer = 0xabcdef01
+        Country = US
+        PowerValues = 64 60 56 52 48        # 1/8 dBm: one value, one per column or all 60
+
+        [Contoso-EU]
+        Country = DE
+        PowerValues[2] = 40 40 38 36 36     # one row
+        PowerValues[2][4] = 34              # one entry
+
+    Fields are named as in the columnar fleet file (see SarColumns.h): every field of
+    SAR_CONFIG_HEADER, SAR_CONFIG_VALUES and REGION_CONFIG_VALUES, "Country" for
+    GeoCountryString (a two-letter code or a number) and PowerValues.  A SKU starts from zeroes
+    with the header and values Size and offsets filled in, not from the setconfig example.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+#include <string>
+#include <vector>
+
+// Cache file in the output directory: one line per SKU, "<XXH64 of its structs> <SKU name>".
+//
+#define SAR_COMPILE_CACHE_NAME "sarcompile.cache"
+
+typedef struct _SAR_COMPILE_ASSIGNMENT
+{
+    UINT32 Line;
+    UINT32 FirstColumn;             // SAR_COLUMN order (see SarColumns.h.)
+    UINT32 ColumnCount;             // 1, or the power table entries the assignment covers.
+    std::vector<UINT32> Values;     // 1 or ColumnCount values; a single value fills every column.
+} SAR_COMPILE_ASSIGNMENT;
+
+typedef struct _SAR_COMPILE_SKU
+{
+    std::string Name;
+    std::vector<SAR_COMPILE_ASSIGNMENT> Assignments;
+} SAR_COMPILE_SKU;
+
+typedef struct _SAR_COMPILE_SPEC
+{
+    std::vector<SAR_COMPILE_ASSIGNMENT> Base;
+    std::vector<SAR_COMPILE_SKU> Skus;
+} SAR_COMPILE_SPEC;
+
+// Parses a spec.  Prints "<path>(<line>): ..." and returns HRESULT_FROM_WIN32(ERROR_INVALID_DATA)
+// for the first malformed line.
+//
+_Check_return_
+HRESULT
+SarCompileParse(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_COMPILE_SPEC* spec
+    );
+
+// Applies the base and then the SKU's overrides.
+//
+VOID
+SarCompileSku(
+    _In_ const SAR_COMPILE_SPEC& spec,
+    _In_ const SAR_COMPILE_SKU& sku,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+// Implements "compile <spec> <output directory> [threads] [--container] [--force]".
+//
+_Check_return_
+HRESULT
+SarCompileCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarCompile.h
+//
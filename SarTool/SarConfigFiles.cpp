@@ -0,0 +1,493 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarConfigFiles.cpp
+
+Abstract:
+
+    Platform-neutral helpers to populate, read, write and print the four provisioning blobs.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarConfigFiles.h"
+#include "SarCodec.h"
+#include "SarContainer.h"
+#include "SarFirmwareStore.h"
+#include "SarFields.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const SAR_CONFIG_BLOB_INFO SarConfigBlobInfo[SarBlobCount] =
+{
+    { WifiSARHeader,    &WDI_SAR_UEFI_COMMON_PARAMS, offsetof(SAR_CONFIG_BLOBS, Header),     sizeof(SAR_CONFIG_HEADER) },
+    { WifiSARConfig,    &WDI_SAR_UEFI_COMMON_PARAMS, offsetof(SAR_CONFIG_BLOBS, Values),     sizeof(SAR_CONFIG_VALUES) },
+    { WifiRegionConfig, &WDI_SAR_UEFI_IHV_PARAMS,    offsetof(SAR_CONFIG_BLOBS, Region),     sizeof(REGION_CONFIG_VALUES) },
+    { WifiSARTable,     &WDI_SAR_UEFI_IHV_PARAMS,    offsetof(SAR_CONFIG_BLOBS, PowerTable), sizeof(SAR_POWER_TABLE) },
+};
+
+std::string
+SarConfigBlobPath(
+    _In_z_ LPCSTR folder,
+    SAR_CONFIG_BLOB_ID blobId
+    )
+/*++
+
+Routine Description:
+
+    Builds the path of the .bin file that holds the specified blob.  The file names match the
+    UEFI variable names (e.g. "<folder>\WifiSARHeader.bin".)
+
+Arguments:
+
+    folder - The folder containing the provisioning files.
+    blobId - The blob whose path is requested.
+
+Return Value:
+
+    The full path of the file.
+
+--*/
+{
+    std::string fullPath(folder);
+
+    if (!fullPath.empty() && (fullPath.back() != SAR_PATH_SEPARATOR) && (fullPath.back() != '/'))
+    {
+        fullPath += SAR_PATH_SEPARATOR;
+    }
+
+    // The UEFI variable names are plain ASCII.
+    for (LPCWSTR pName = SarConfigBlobInfo[blobId].Name; *pName != L'\0'; pName++)
+    {
+        fullPath += (char)*pName;
+    }
+    fullPath += ".bin";
+
+    return fullPath;
+}
+
+VOID
+SarConfigPopulateExample(
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Fills in the example configuration that setconfig writes to UEFI or to disk.
+
+Arguments:
+
+    blobs - Receives the example SAR_CONFIG_HEADER, SAR_CONFIG_VALUES, REGION_CONFIG_VALUES and
+            SAR_POWER_TABLE.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    memset(blobs, 0, sizeof(*blobs));
+
+    // Populate an example SAR_CONFIG_HEADER.
+    SAR_CONFIG_HEADER& sarConfigHeader = blobs->Header;
+
+    sarConfigHeader.Size = sizeof(sarConfigHeader) + 2 * sizeof(SAR_CONFIG_VALUES);
+    sarConfigHeader.HeaderOffset1 = sizeof(SAR_CONFIG_HEADER);
+    sarConfigHeader.HeaderOffset2 = sizeof(SAR_CONFIG_HEADER) + sizeof(SAR_CONFIG_VALUES);
+    sarConfigHeader.WLANTechnology = WDI_802_11_AD;
+    sarConfigHeader.ProductID = 0x4;
+    sarConfigHeader.Version = 0x5;
+    sarConfigHeader.Revision = 0x6;
+    sarConfigHeader.NumberSARTables = 0x7;
+    sarConfigHeader.SARTablesCompressed = 0x8;
+    sarConfigHeader.SARTimersFormat = 0x9;
+    sarConfigHeader.ReservedA = 0xa;
+    sarConfigHeader.ReservedB = 0xb;
+    sarConfigHeader.ReservedC = 0xc;
+    sarConfigHeader.ReservedD = 0xd;
+    sarConfigHeader.ReservedE = 0xe;
+    sarConfigHeader.ReservedF = 0xf;
+
+    // The header should occupy 16 bytes in the output file.
+    C_ASSERT(sizeof(SAR_CONFIG_HEADER) == 0x10);
+
+    // Populate an example SAR_CONFIG_VALUES structure.
+    SAR_CONFIG_VALUES& sarConfigValues = blobs->Values;
+
+    sarConfigValues.Size = sizeof(sarConfigValues);
+    sarConfigValues.SARSafetyTimer = 0xabcdef01;
+    sarConfigValues.SARSafetyRequestResponseTimeout = 0xbbbbbbbb;
+    sarConfigValues.SARUnsolicitedUpdateTimer = 0xcccccccc;
+    sarConfigValues.SARState = 0x55;
+    sarConfigValues.SleepModeState = 0x44;
+    sarConfigValues.SARPowerOnState = 0x33;
+    sarConfigValues.SARPowerOnStateAfterFailure = 0x22;
+    sarConfigValues.SARSafetyTableIndex = 0x11;
+    sarConfigValues.SleepModeStateIndexTable = 0x05;
+
+    // The values struct should occupy 19 bytes in the output file.
+    C_ASSERT(sizeof(SAR_CONFIG_VALUES) == 0x13);
+
+    // Populate a REGION_CONFIG_VALUES and SAR_POWER_TABLE (i.e. the IHV-only structs
+    //  defined in Wlan_Ihv_Config.h)
+    //
+    REGION_CONFIG_VALUES& regionConfigValues = blobs->Region;
+    regionConfigValues.GeoCountryString.AsciiChars = 0x5048; // 'PH' == Philippines!
+    regionConfigValues.GeoLocationValue = 0x11111111;
+    regionConfigValues.DynamicGeoState = WDI_DYNAMIC_GEO_VALUE_ENABLED;
+    regionConfigValues.DynamicGeoType = WDI_DYNAMIC_GEO_TYPE_DYNAMIC_THEN_STATIC;
+
+    SAR_POWER_TABLE& sarPowerTable = blobs->PowerTable;
+    for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+    {
+        for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+        {
+            // Uniquely number each entry in sarPowerTable.PowerValues.
+            sarPowerTable.PowerValues[row][col] = (UINT8)(1 + col + (row*MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE));
+        }
+    }
+}
+
+_Check_return_
+HRESULT
+SarConfigWriteFolder(
+    _In_z_ LPCSTR folder,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Encodes each provisioning blob to its own .bin file in the specified folder.
+
+Arguments:
+
+    folder - The folder where the .bin files should be written.
+    blobs - The structs to write.
+
+Return Value:
+
+    S_OK on success or the failure code of the first file that could not be written.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 image[sizeof(SAR_CONFIG_BLOBS)];
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        std::string fullPath = SarConfigBlobPath(folder, (SAR_CONFIG_BLOB_ID)blobId);
+        size_t blobSize = 0;
+
+        hr = SarEncodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, blobs, image, sizeof(image), &blobSize);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        FILE* output = fopen(fullPath.c_str(), "wb");
+        if (!output)
+        {
+            hr = SarHresultFromErrno(errno);
+            goto exit;
+        }
+
+        size_t written = fwrite(image, 1, blobSize, output);
+        int closeResult = fclose(output);
+        if ((written != blobSize) || (closeResult != 0))
+        {
+            hr = E_FAIL;
+            goto exit;
+        }
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarConfigReadFolder(
+    _In_z_ LPCSTR folder,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Reads and decodes each provisioning blob from its .bin file in the specified folder.  Every
+    file is read with a single fread.  Missing or short files leave the corresponding struct (or
+    its tail) zeroed.
+
+Arguments:
+
+    folder - The folder containing the .bin files.
+    blobs - Receives the structs.
+
+Return Value:
+
+    S_OK on success, otherwise the failure code of the first file that was missing or too short.
+    All files are read regardless.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    memset(blobs, 0, sizeof(*blobs));
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        std::string fullPath = SarConfigBlobPath(folder, (SAR_CONFIG_BLOB_ID)blobId);
+        size_t blobSize = SarConfigBlobLayouts[blobId]->WireSize;
+        UINT8 image[sizeof(SAR_CONFIG_BLOBS)] = { 0 };
+        HRESULT hrBlob = S_OK;
+
+        FILE* input = fopen(fullPath.c_str(), "rb");
+        if (!input)
+        {
+            hrBlob = SarHresultFromErrno(errno);
+        }
+        else
+        {
+            size_t bytesRead = fread(image, 1, blobSize, input);
+            fclose(input);
+
+            // A short file decodes as if its tail were zero, unless it is a compressed power table.
+            if (FAILED(SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, image, bytesRead, blobs)))
+            {
+                hrBlob = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                (VOID)SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, image, blobSize, blobs);
+            }
+        }
+
+        if (SUCCEEDED(hr) && FAILED(hrBlob))
+        {
+            hr = hrBlob;
+        }
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarConfigLoad(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Reads the provisioning structs from UEFI (path is "UEFI"), a container file (path ends in
+    ".sarc") or a folder of .bin files.
+
+Arguments:
+
+    path - "UEFI", the container file or folder.
+    blobs - Receives the structs.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    if (SarFirmwareIsPath(path))
+    {
+        HRESULT results[SarBlobCount];
+        HRESULT hr = SarFirmwareStoreDefault()->ReadConfig(blobs, results);
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            if (FAILED(results[blobId]))
+            {
+                printf("Failed to read %ls from UEFI, hr = 0x%08x\n", SarConfigBlobInfo[blobId].Name, (UINT32)results[blobId]);
+            }
+        }
+
+        return hr;
+    }
+
+    if (SarContainerIsPath(path))
+    {
+        return SarContainerRead(path, blobs);
+    }
+
+    return SarConfigReadFolder(path, blobs);
+}
+
+_Check_return_
+HRESULT
+SarConfigSave(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Writes the provisioning structs to UEFI (path is "UEFI"), a container file (path ends in
+    ".sarc") or a folder of .bin files.
+
+Arguments:
+
+    path - "UEFI", the container file or folder.
+    blobs - The structs to write.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    if (SarFirmwareIsPath(path))
+    {
+        HRESULT results[SarBlobCount];
+        HRESULT hr = SarFirmwareStoreDefault()->WriteConfig(blobs, results);
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            if (FAILED(results[blobId]))
+            {
+                printf("Failed to write %ls to UEFI, hr = 0x%08x\n", SarConfigBlobInfo[blobId].Name, (UINT32)results[blobId]);
+            }
+        }
+
+        return hr;
+    }
+
+    if (SarContainerIsPath(path))
+    {
+        return SarContainerWrite(path, blobs);
+    }
+
+    return SarConfigWriteFolder(path, blobs);
+}
+
+VOID
+SarConfigPrint(
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Prints the contents of the four provisioning structs to the screen.
+
+Arguments:
+
+    blobs - The structs to print.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    SarConfigPrintViews(&blobs->Header, &blobs->Values, &blobs->Region, &blobs->PowerTable);
+}
+
+VOID
+SarConfigPrintViews(
+    _In_opt_ const SAR_CONFIG_HEADER* pHeader,
+    _In_opt_ const SAR_CONFIG_VALUES* pValues,
+    _In_opt_ const REGION_CONFIG_VALUES* pRegion,
+    _In_opt_ const SAR_POWER_TABLE* pPowerTable
+    )
+/*++
+
+Routine Description:
+
+    Prints the provisioning structs to the screen from wherever they live (e.g. views into mapped
+    files.)  A missing struct is printed as all zeroes.
+
+Arguments:
+
+    pHeader - The SAR_CONFIG_HEADER or NULL.
+    pValues - The SAR_CONFIG_VALUES or NULL.
+    pRegion - The REGION_CONFIG_VALUES or NULL.
+    pPowerTable - The SAR_POWER_TABLE or NULL.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    SarOutput output(SarOutputText);
+
+    SarConfigFormat(&output, nullptr, pHeader, pValues, pRegion, pPowerTable);
+}
+
+VOID
+SarConfigFormat(
+    _Inout_ SarOutput* output,
+    _In_opt_z_ LPCSTR source,
+    _In_opt_ const SAR_CONFIG_HEADER* pHeader,
+    _In_opt_ const SAR_CONFIG_VALUES* pValues,
+    _In_opt_ const REGION_CONFIG_VALUES* pRegion,
+    _In_opt_ const SAR_POWER_TABLE* pPowerTable
+    )
+/*++
+
+Routine Description:
+
+    Writes the provisioning structs as one record: in text as getconfig prints them, or as one
+    JSON object or CSV row.
+
+Arguments:
+
+    output - The formatter.
+    source - The path the structs were read from, or NULL.
+    pHeader - The SAR_CONFIG_HEADER or NULL.
+    pValues - The SAR_CONFIG_VALUES or NULL.
+    pRegion - The REGION_CONFIG_VALUES or NULL.
+    pPowerTable - The SAR_POWER_TABLE or NULL.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    static const SAR_CONFIG_BLOBS zeroBlobs = { 0 };
+
+    const SAR_CONFIG_HEADER& sarConfigHeader = pHeader ? *pHeader : zeroBlobs.Header;
+    const SAR_CONFIG_VALUES& sarConfigValues = pValues ? *pValues : zeroBlobs.Values;
+    const REGION_CONFIG_VALUES& regionConfigValues = pRegion ? *pRegion : zeroBlobs.Region;
+    const SAR_POWER_TABLE& sarPowerTable = pPowerTable ? *pPowerTable : zeroBlobs.PowerTable;
+
+    output->BeginRecord(source);
+
+    // The contents of the SAR_CONFIG_HEADER.
+    output->BeginGroup("SAR_CONFIG_HEADER", "");
+    SarFieldsFormat(output, sarConfigHeader);
+    output->EndGroup();
+
+    // The contents of the SAR_CONFIG_VALUES.
+    output->BeginGroup("SAR_CONFIG_VALUES", "SAR_CONFIG_VALUES 1");
+    SarFieldsFormat(output, sarConfigValues);
+    output->EndGroup();
+
+    // REGION_CONFIG_VALUES and SAR_POWER_TABLE (i.e. the IHV-only structs defined in Wlan_Ihv_Config.h)
+    //
+    output->BeginGroup("REGION_CONFIG_VALUES", "REGION_CONFIG_VALUES");
+    SarFieldsFormat(output, regionConfigValues);
+    output->EndGroup();
+
+    output->PowerTable("SAR_POWER_TABLE", &sarPowerTable);
+
+    output->EndRecord();
+}
+
+// eof: SarConfigFiles.cpp
+//
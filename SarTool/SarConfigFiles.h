@@ -0,0 +1,142 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarConfigFiles.h
+
+Abstract:
+
+    Platform-neutral helpers to populate, read, write and print the four provisioning blobs
+    (SAR_CONFIG_HEADER, SAR_CONFIG_VALUES, REGION_CONFIG_VALUES and SAR_POWER_TABLE) that SarTool
+    stores either in UEFI or as a folder of .bin files named after the UEFI variables.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include <stddef.h>
+#include <string>
+
+#include "Dmf_Wlan_Public.h"
+#include "Wlan_Ihv_Config.h"
+#include "SarApi.h"         // SAR_CONFIG_BLOBS
+#include "SarOutput.h"
+
+typedef enum _SAR_CONFIG_BLOB_ID
+{
+    SarBlobHeader = 0,
+    SarBlobValues = 1,
+    SarBlobRegion = 2,
+    SarBlobPowerTable = 3,
+    SarBlobCount = 4,
+} SAR_CONFIG_BLOB_ID;
+
+// Describes where each blob lives: its UEFI variable (and .bin file) name, the UEFI GUID it is
+// stored under and its location inside SAR_CONFIG_BLOBS.
+//
+typedef struct _SAR_CONFIG_BLOB_INFO
+{
+    LPCWSTR Name;
+    const GUID* VendorGuid;
+    size_t Offset;
+    size_t Size;
+} SAR_CONFIG_BLOB_INFO;
+
+extern const SAR_CONFIG_BLOB_INFO SarConfigBlobInfo[SarBlobCount];
+
+inline
+UINT8*
+SarConfigBlobData(
+    _In_ SAR_CONFIG_BLOBS* blobs,
+    SAR_CONFIG_BLOB_ID blobId
+    )
+{
+    return (UINT8*)blobs + SarConfigBlobInfo[blobId].Offset;
+}
+
+inline
+const UINT8*
+SarConfigBlobData(
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    SAR_CONFIG_BLOB_ID blobId
+    )
+{
+    return (const UINT8*)blobs + SarConfigBlobInfo[blobId].Offset;
+}
+
+std::string
+SarConfigBlobPath(
+    _In_z_ LPCSTR folder,
+    SAR_CONFIG_BLOB_ID blobId
+    );
+
+VOID
+SarConfigPopulateExample(
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+_Check_return_
+HRESULT
+SarConfigWriteFolder(
+    _In_z_ LPCSTR folder,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    );
+
+_Check_return_
+HRESULT
+SarConfigReadFolder(
+    _In_z_ LPCSTR folder,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+// Load/save from UEFI ("UEFI") or either file layout: a container file (".sarc") or a folder of
+// .bin files.
+//
+_Check_return_
+HRESULT
+SarConfigLoad(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+_Check_return_
+HRESULT
+SarConfigSave(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    );
+
+VOID
+SarConfigPrint(
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    );
+
+VOID
+SarConfigPrintViews(
+    _In_opt_ const SAR_CONFIG_HEADER* pHeader,
+    _In_opt_ const SAR_CONFIG_VALUES* pValues,
+    _In_opt_ const REGION_CONFIG_VALUES* pRegion,
+    _In_opt_ const SAR_POWER_TABLE* pPowerTable
+    );
+
+// Writes the four structs as one record of output; a missing struct is written as all zeroes.
+//
+VOID
+SarConfigFormat(
+    _Inout_ SarOutput* output,
+    _In_opt_z_ LPCSTR source,
+    _In_opt_ const SAR_CONFIG_HEADER* pHeader,
+    _In_opt_ const SAR_CONFIG_VALUES* pValues,
+    _In_opt_ const REGION_CONFIG_VALUES* pRegion,
+    _In_opt_ const SAR_POWER_TABLE* pPowerTable
+    );
+
+// eof: SarConfigFiles.h
+//
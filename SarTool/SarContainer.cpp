@@ -0,0 +1,372 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarContainer.cpp
+
+Abstract:
+
+    Single-file SAR provisioning container with an offsets table and per-section CRC-32C.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarContainer.h"
+#include "SarCodec.h"
+#include "SarCrc32c.h"
+#include "SarMappedFile.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+SarContainerView::SarContainerView()
+{
+    memset(m_sections, 0, sizeof(m_sections));
+    memset(m_sizes, 0, sizeof(m_sizes));
+}
+
+_Check_return_
+HRESULT
+SarContainerView::Attach(
+    _In_reads_bytes_(size) const UINT8* data,
+    size_t size
+    )
+/*++
+
+Routine Description:
+
+    Validates the container header, the section table and every section's bounds and CRC-32C.
+
+Arguments:
+
+    data - The container image.
+    size - Size of the image in bytes.
+
+Return Value:
+
+    S_OK on success.
+    HRESULT_FROM_WIN32(ERROR_BAD_FORMAT) if the image is not a container of a known version.
+    HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the table or a section lies outside the image.
+    HRESULT_FROM_WIN32(ERROR_CRC) if the table or a section fails its CRC check.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONTAINER_HEADER header;
+    const UINT8* pTable;
+    size_t tableSize;
+    const UINT8* pSection;
+
+    memset(m_sections, 0, sizeof(m_sections));
+    memset(m_sizes, 0, sizeof(m_sizes));
+
+    if ((data == nullptr) || (size < sizeof(header)))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    header.Signature = SarLoadLe32(data + offsetof(SAR_CONTAINER_HEADER, Signature));
+    header.FormatVersion = SarLoadLe16(data + offsetof(SAR_CONTAINER_HEADER, FormatVersion));
+    header.SectionCount = SarLoadLe16(data + offsetof(SAR_CONTAINER_HEADER, SectionCount));
+    header.TotalSize = SarLoadLe32(data + offsetof(SAR_CONTAINER_HEADER, TotalSize));
+    header.TableCrc32c = SarLoadLe32(data + offsetof(SAR_CONTAINER_HEADER, TableCrc32c));
+    if ((header.Signature != SAR_CONTAINER_SIGNATURE) ||
+        (header.FormatVersion != SAR_CONTAINER_FORMAT_VERSION))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    tableSize = (size_t)header.SectionCount * sizeof(SAR_CONTAINER_SECTION);
+    if ((header.TotalSize > size) || ((size_t)header.TotalSize < sizeof(header) + tableSize))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    pTable = data + sizeof(header);
+    if (SarCrc32c(pTable, tableSize) != header.TableCrc32c)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_CRC);
+        goto exit;
+    }
+
+    for (UINT16 i = 0; i < header.SectionCount; i++)
+    {
+        SAR_CONTAINER_SECTION section;
+
+        pSection = pTable + i * sizeof(section);
+        section.SectionId = SarLoadLe32(pSection + offsetof(SAR_CONTAINER_SECTION, SectionId));
+        section.Offset = SarLoadLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Offset));
+        section.Size = SarLoadLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Size));
+        section.Crc32c = SarLoadLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Crc32c));
+
+        if ((section.Offset > header.TotalSize) || (section.Size > header.TotalSize - section.Offset))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        if (SarCrc32c(data + section.Offset, section.Size) != section.Crc32c)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_CRC);
+            goto exit;
+        }
+
+        // Sections this version does not know about are skipped.
+        if (section.SectionId < SarBlobCount)
+        {
+            m_sections[section.SectionId] = data + section.Offset;
+            m_sizes[section.SectionId] = section.Size;
+        }
+    }
+
+exit:
+    if (FAILED(hr))
+    {
+        memset(m_sections, 0, sizeof(m_sections));
+        memset(m_sizes, 0, sizeof(m_sizes));
+    }
+    return hr;
+}
+
+const UINT8*
+SarContainerView::Section(
+    SAR_CONFIG_BLOB_ID blobId,
+    _Out_opt_ size_t* pSize
+    ) const
+{
+    if (pSize != nullptr)
+    {
+        *pSize = m_sizes[blobId];
+    }
+
+    return m_sections[blobId];
+}
+
+BOOL
+SarContainerIsPath(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Determines whether a getconfig/setconfig path names a container (i.e. ends in ".sarc")
+    rather than a folder of .bin files.
+
+Arguments:
+
+    path - The path specified by the user.
+
+Return Value:
+
+    TRUE if the path names a container.
+
+--*/
+{
+    size_t pathLength = strlen(path);
+    size_t extensionLength = sizeof(SAR_CONTAINER_EXTENSION) - 1;
+
+    return (pathLength > extensionLength) &&
+           (0 == _stricmp(path + pathLength - extensionLength, SAR_CONTAINER_EXTENSION));
+}
+
+_Check_return_
+HRESULT
+SarContainerBuild(
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_ std::vector<UINT8>* image
+    )
+/*++
+
+Routine Description:
+
+    Encodes the four provisioning structs into a container image.
+
+Arguments:
+
+    blobs - The structs to pack.
+    image - Receives the container image.
+
+Return Value:
+
+    S_OK on success or the failure code from encoding a struct.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_CONTAINER_SECTION sections[SarBlobCount] = { 0 };
+    UINT8 blobImages[SarBlobCount][sizeof(SAR_CONFIG_BLOBS)];
+    size_t offset = sizeof(SAR_CONTAINER_HEADER) + sizeof(sections);
+    UINT8* pHeader;
+    UINT8* pSection;
+
+    // The power table section is shorter when it is compressed, so the structs are encoded before
+    // the sections are laid out.
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        size_t blobSize = 0;
+
+        hr = SarEncodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, blobs, blobImages[blobId], sizeof(blobImages[blobId]), &blobSize);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        offset = (offset + SAR_CONTAINER_ALIGNMENT - 1) & ~((size_t)SAR_CONTAINER_ALIGNMENT - 1);
+
+        sections[blobId].SectionId = (UINT32)blobId;
+        sections[blobId].Offset = (UINT32)offset;
+        sections[blobId].Size = (UINT32)blobSize;
+        sections[blobId].Crc32c = SarCrc32c(blobImages[blobId], blobSize);
+
+        offset += sections[blobId].Size;
+    }
+
+    image->assign(offset, 0);
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        memcpy(image->data() + sections[blobId].Offset, blobImages[blobId], sections[blobId].Size);
+
+        pSection = image->data() + sizeof(SAR_CONTAINER_HEADER) + blobId * sizeof(SAR_CONTAINER_SECTION);
+        SarStoreLe32(pSection + offsetof(SAR_CONTAINER_SECTION, SectionId), sections[blobId].SectionId);
+        SarStoreLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Offset), sections[blobId].Offset);
+        SarStoreLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Size), sections[blobId].Size);
+        SarStoreLe32(pSection + offsetof(SAR_CONTAINER_SECTION, Crc32c), sections[blobId].Crc32c);
+    }
+
+    // The table's CRC covers its bytes as stored.
+    pHeader = image->data();
+    SarStoreLe32(pHeader + offsetof(SAR_CONTAINER_HEADER, Signature), SAR_CONTAINER_SIGNATURE);
+    SarStoreLe16(pHeader + offsetof(SAR_CONTAINER_HEADER, FormatVersion), SAR_CONTAINER_FORMAT_VERSION);
+    SarStoreLe16(pHeader + offsetof(SAR_CONTAINER_HEADER, SectionCount), SarBlobCount);
+    SarStoreLe32(pHeader + offsetof(SAR_CONTAINER_HEADER, TotalSize), (UINT32)offset);
+    SarStoreLe32(pHeader + offsetof(SAR_CONTAINER_HEADER, TableCrc32c),
+                 SarCrc32c(pHeader + sizeof(SAR_CONTAINER_HEADER), sizeof(sections)));
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarContainerWrite(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Writes the provisioning structs to a container file with a single write.
+
+Arguments:
+
+    path - The container file to create or overwrite.
+    blobs - The structs to write.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<UINT8> image;
+    FILE* output = nullptr;
+
+    hr = SarContainerBuild(blobs, &image);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    output = fopen(path, "wb");
+    if (!output)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (fwrite(image.data(), 1, image.size(), output) != image.size())
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarContainerRead(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    )
+/*++
+
+Routine Description:
+
+    Maps a container file, validates it and decodes its sections into the provisioning structs.
+
+Arguments:
+
+    path - The container file.
+    blobs - Receives the structs.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if a section is missing or too short,
+    or the failure code from mapping or validating the container.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarMappedFile mappedFile;
+    SarContainerView container;
+
+    memset(blobs, 0, sizeof(*blobs));
+
+    hr = mappedFile.Open(path);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    hr = container.Attach(mappedFile.Data(), mappedFile.Size());
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        size_t sectionSize = 0;
+        const UINT8* pSection = container.Section((SAR_CONFIG_BLOB_ID)blobId, &sectionSize);
+
+        if ((pSection == nullptr) ||
+            FAILED(SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, pSection, sectionSize, blobs)))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarContainer.cpp
+//
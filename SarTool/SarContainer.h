@@ -0,0 +1,154 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarContainer.h
+
+Abstract:
+
+    Single-file SAR provisioning container.  Packs SAR_CONFIG_HEADER, SAR_CONFIG_VALUES,
+    REGION_CONFIG_VALUES and SAR_POWER_TABLE behind an offsets table so a consumer loads the whole
+    configuration with one read (or one mapping) instead of four opens and four reads.
+
+    Layout (all fields little-endian):
+
+        SAR_CONTAINER_HEADER
+        SAR_CONTAINER_SECTION[SectionCount]
+        section data, each section starting on a SAR_CONTAINER_ALIGNMENT boundary
+
+    Each section carries the CRC-32C of its data and the header carries the CRC-32C of the section
+    table, so a truncated or corrupted container is rejected before any struct is handed out.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+#include "SarTableCompression.h"
+
+#include <vector>
+
+static const UINT32 SAR_CONTAINER_SIGNATURE = 0x43524153; // "SARC"
+static const UINT16 SAR_CONTAINER_FORMAT_VERSION = 1;
+static const UINT32 SAR_CONTAINER_ALIGNMENT = 8;
+
+// The file extension that selects the container layout for getconfig/setconfig.
+//
+static const char SAR_CONTAINER_EXTENSION[] = ".sarc";
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct _SAR_CONTAINER_HEADER
+{
+    UINT32 Signature;
+    UINT16 FormatVersion;
+    UINT16 SectionCount;
+    UINT32 TotalSize;
+    UINT32 TableCrc32c;   // CRC-32C of the SAR_CONTAINER_SECTION table.
+} SAR_CONTAINER_HEADER;
+C_ASSERT(sizeof(SAR_CONTAINER_HEADER) == 0x10);
+
+typedef struct _SAR_CONTAINER_SECTION
+{
+    UINT32 SectionId;     // SAR_CONFIG_BLOB_ID
+    UINT32 Offset;        // From the start of the container.
+    UINT32 Size;
+    UINT32 Crc32c;        // CRC-32C of the section data.
+} SAR_CONTAINER_SECTION;
+C_ASSERT(sizeof(SAR_CONTAINER_SECTION) == 0x10);
+#pragma pack(pop)
+
+// Validates a container image held in memory (e.g. a mapped file) and hands out views of its
+// sections.  The image must outlive the view.
+//
+class SarContainerView
+{
+public:
+
+    SarContainerView();
+
+    _Check_return_
+    HRESULT
+    Attach(
+        _In_reads_bytes_(size) const UINT8* data,
+        size_t size
+        );
+
+    // Returns the section data or nullptr if the container has no such section.
+    //
+    const UINT8*
+    Section(
+        SAR_CONFIG_BLOB_ID blobId,
+        _Out_opt_ size_t* pSize = nullptr
+        ) const;
+
+    template <typename T>
+    const T*
+    View(
+        SAR_CONFIG_BLOB_ID blobId
+        ) const
+    {
+        size_t size = 0;
+        const UINT8* pSection = Section(blobId, &size);
+
+        if ((pSection == nullptr) || (size < sizeof(T)) || ((((size_t)pSection) % alignof(T)) != 0))
+        {
+            return nullptr;
+        }
+
+        return reinterpret_cast<const T*>(pSection);
+    }
+
+    // Views a raw power table section in place; a compressed one is decompressed into *decoded.
+    //
+    const SAR_POWER_TABLE*
+    PowerTable(
+        _Out_ SAR_POWER_TABLE* decoded
+        ) const
+    {
+        size_t size = 0;
+        const UINT8* pSection = Section(SarBlobPowerTable, &size);
+
+        return SarPowerTableView(pSection, size, decoded);
+    }
+
+private:
+
+    const UINT8* m_sections[SarBlobCount];
+    size_t m_sizes[SarBlobCount];
+};
+
+BOOL
+SarContainerIsPath(
+    _In_z_ LPCSTR path
+    );
+
+_Check_return_
+HRESULT
+SarContainerBuild(
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_ std::vector<UINT8>* image
+    );
+
+_Check_return_
+HRESULT
+SarContainerWrite(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_CONFIG_BLOBS* blobs
+    );
+
+_Check_return_
+HRESULT
+SarContainerRead(
+    _In_z_ LPCSTR path,
+    _Out_ SAR_CONFIG_BLOBS* blobs
+    );
+
+// eof: SarContainer.h
+//
@@ -0,0 +1,442 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCountry.cpp
+
+Abstract:
+
+    The ISO 3166-1 country table and its compile-time perfect hash.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarCountry.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+constexpr
+UINT16
+SarCountryCode(
+    const char (&letters)[3]
+    )
+{
+    return (UINT16)(((UINT8)letters[0] << 8) | (UINT8)letters[1]);
+}
+
+// Sorted by code; a country's index is its position here.  Names follow ISO 3166-1 (short common
+// names where one exists), transliterated to ASCII.
+//
+static constexpr SAR_COUNTRY SarCountries[] =
+{
+    { SarCountryCode("AD"), SarDomainEtsi,    "Andorra" },
+    { SarCountryCode("AE"), SarDomainOther,   "United Arab Emirates" },
+    { SarCountryCode("AF"), SarDomainOther,   "Afghanistan" },
+    { SarCountryCode("AG"), SarDomainOther,   "Antigua and Barbuda" },
+    { SarCountryCode("AI"), SarDomainOther,   "Anguilla" },
+    { SarCountryCode("AL"), SarDomainEtsi,    "Albania" },
+    { SarCountryCode("AM"), SarDomainOther,   "Armenia" },
+    { SarCountryCode("AO"), SarDomainOther,   "Angola" },
+    { SarCountryCode("AQ"), SarDomainOther,   "Antarctica" },
+    { SarCountryCode("AR"), SarDomainOther,   "Argentina" },
+    { SarCountryCode("AS"), SarDomainFcc,     "American Samoa" },
+    { SarCountryCode("AT"), SarDomainEtsi,    "Austria" },
+    { SarCountryCode("AU"), SarDomainAcma,    "Australia" },
+    { SarCountryCode("AW"), SarDomainOther,   "Aruba" },
+    { SarCountryCode("AX"), SarDomainEtsi,    "Aland Islands" },
+    { SarCountryCode("AZ"), SarDomainOther,   "Azerbaijan" },
+    { SarCountryCode("BA"), SarDomainEtsi,    "Bosnia and Herzegovina" },
+    { SarCountryCode("BB"), SarDomainOther,   "Barbados" },
+    { SarCountryCode("BD"), SarDomainOther,   "Bangladesh" },
+    { SarCountryCode("BE"), SarDomainEtsi,    "Belgium" },
+    { SarCountryCode("BF"), SarDomainOther,   "Burkina Faso" },
+    { SarCountryCode("BG"), SarDomainEtsi,    "Bulgaria" },
+    { SarCountryCode("BH"), SarDomainOther,   "Bahrain" },
+    { SarCountryCode("BI"), SarDomainOther,   "Burundi" },
+    { SarCountryCode("BJ"), SarDomainOther,   "Benin" },
+    { SarCountryCode("BL"), SarDomainOther,   "Saint Barthelemy" },
+    { SarCountryCode("BM"), SarDomainOther,   "Bermuda" },
+    { SarCountryCode("BN"), SarDomainOther,   "Brunei Darussalam" },
+    { SarCountryCode("BO"), SarDomainOther,   "Bolivia" },
+    { SarCountryCode("BQ"), SarDomainOther,   "Bonaire, Sint Eustatius and Saba" },
+    { SarCountryCode("BR"), SarDomainAnatel,  "Brazil" },
+    { SarCountryCode("BS"), SarDomainOther,   "Bahamas" },
+    { SarCountryCode("BT"), SarDomainOther,   "Bhutan" },
+    { SarCountryCode("BV"), SarDomainOther,   "Bouvet Island" },
+    { SarCountryCode("BW"), SarDomainOther,   "Botswana" },
+    { SarCountryCode("BY"), SarDomainOther,   "Belarus" },
+    { SarCountryCode("BZ"), SarDomainOther,   "Belize" },
+    { SarCountryCode("CA"), SarDomainIsed,    "Canada" },
+    { SarCountryCode("CC"), SarDomainOther,   "Cocos (Keeling) Islands" },
+    { SarCountryCode("CD"), SarDomainOther,   "Congo, The Democratic Republic of the" },
+    { SarCountryCode("CF"), SarDomainOther,   "Central African Republic" },
+    { SarCountryCode("CG"), SarDomainOther,   "Congo" },
+    { SarCountryCode("CH"), SarDomainEtsi,    "Switzerland" },
+    { SarCountryCode("CI"), SarDomainOther,   "Cote d'Ivoire" },
+    { SarCountryCode("CK"), SarDomainOther,   "Cook Islands" },
+    { SarCountryCode("CL"), SarDomainOther,   "Chile" },
+    { SarCountryCode("CM"), SarDomainOther,   "Cameroon" },
+    { SarCountryCode("CN"), SarDomainSrrc,    "China" },
+    { SarCountryCode("CO"), SarDomainOther,   "Colombia" },
+    { SarCountryCode("CR"), SarDomainOther,   "Costa Rica" },
+    { SarCountryCode("CU"), SarDomainOther,   "Cuba" },
+    { SarCountryCode("CV"), SarDomainOther,   "Cabo Verde" },
+    { SarCountryCode("CW"), SarDomainOther,   "Curacao" },
+    { SarCountryCode("CX"), SarDomainOther,   "Christmas Island" },
+    { SarCountryCode("CY"), SarDomainEtsi,    "Cyprus" },
+    { SarCountryCode("CZ"), SarDomainEtsi,    "Czechia" },
+    { SarCountryCode("DE"), SarDomainEtsi,    "Germany" },
+    { SarCountryCode("DJ"), SarDomainOther,   "Djibouti" },
+    { SarCountryCode("DK"), SarDomainEtsi,    "Denmark" },
+    { SarCountryCode("DM"), SarDomainOther,   "Dominica" },
+    { SarCountryCode("DO"), SarDomainOther,   "Dominican Republic" },
+    { SarCountryCode("DZ"), SarDomainOther,   "Algeria" },
+    { SarCountryCode("EC"), SarDomainOther,   "Ecuador" },
+    { SarCountryCode("EE"), SarDomainEtsi,    "Estonia" },
+    { SarCountryCode("EG"), SarDomainOther,   "Egypt" },
+    { SarCountryCode("EH"), SarDomainOther,   "Western Sahara" },
+    { SarCountryCode("ER"), SarDomainOther,   "Eritrea" },
+    { SarCountryCode("ES"), SarDomainEtsi,    "Spain" },
+    { SarCountryCode("ET"), SarDomainOther,   "Ethiopia" },
+    { SarCountryCode("FI"), SarDomainEtsi,    "Finland" },
+    { SarCountryCode("FJ"), SarDomainOther,   "Fiji" },
+    { SarCountryCode("FK"), SarDomainOther,   "Falkland Islands (Malvinas)" },
+    { SarCountryCode("FM"), SarDomainOther,   "Micronesia, Federated States of" },
+    { SarCountryCode("FO"), SarDomainOther,   "Faroe Islands" },
+    { SarCountryCode("FR"), SarDomainEtsi,    "France" },
+    { SarCountryCode("GA"), SarDomainOther,   "Gabon" },
+    { SarCountryCode("GB"), SarDomainEtsi,    "United Kingdom" },
+    { SarCountryCode("GD"), SarDomainOther,   "Grenada" },
+    { SarCountryCode("GE"), SarDomainOther,   "Georgia" },
+    { SarCountryCode("GF"), SarDomainEtsi,    "French Guiana" },
+    { SarCountryCode("GG"), SarDomainOther,   "Guernsey" },
+    { SarCountryCode("GH"), SarDomainOther,   "Ghana" },
+    { SarCountryCode("GI"), SarDomainOther,   "Gibraltar" },
+    { SarCountryCode("GL"), SarDomainOther,   "Greenland" },
+    { SarCountryCode("GM"), SarDomainOther,   "Gambia" },
+    { SarCountryCode("GN"), SarDomainOther,   "Guinea" },
+    { SarCountryCode("GP"), SarDomainEtsi,    "Guadeloupe" },
+    { SarCountryCode("GQ"), SarDomainOther,   "Equatorial Guinea" },
+    { SarCountryCode("GR"), SarDomainEtsi,    "Greece" },
+    { SarCountryCode("GS"), SarDomainOther,   "South Georgia and the South Sandwich Islands" },
+    { SarCountryCode("GT"), SarDomainOther,   "Guatemala" },
+    { SarCountryCode("GU"), SarDomainFcc,     "Guam" },
+    { SarCountryCode("GW"), SarDomainOther,   "Guinea-Bissau" },
+    { SarCountryCode("GY"), SarDomainOther,   "Guyana" },
+    { SarCountryCode("HK"), SarDomainOther,   "Hong Kong" },
+    { SarCountryCode("HM"), SarDomainOther,   "Heard Island and McDonald Islands" },
+    { SarCountryCode("HN"), SarDomainOther,   "Honduras" },
+    { SarCountryCode("HR"), SarDomainEtsi,    "Croatia" },
+    { SarCountryCode("HT"), SarDomainOther,   "Haiti" },
+    { SarCountryCode("HU"), SarDomainEtsi,    "Hungary" },
+    { SarCountryCode("ID"), SarDomainOther,   "Indonesia" },
+    { SarCountryCode("IE"), SarDomainEtsi,    "Ireland" },
+    { SarCountryCode("IL"), SarDomainOther,   "Israel" },
+    { SarCountryCode("IM"), SarDomainOther,   "Isle of Man" },
+    { SarCountryCode("IN"), SarDomainWpc,     "India" },
+    { SarCountryCode("IO"), SarDomainOther,   "British Indian Ocean Territory" },
+    { SarCountryCode("IQ"), SarDomainOther,   "Iraq" },
+    { SarCountryCode("IR"), SarDomainOther,   "Iran" },
+    { SarCountryCode("IS"), SarDomainEtsi,    "Iceland" },
+    { SarCountryCode("IT"), SarDomainEtsi,    "Italy" },
+    { SarCountryCode("JE"), SarDomainOther,   "Jersey" },
+    { SarCountryCode("JM"), SarDomainOther,   "Jamaica" },
+    { SarCountryCode("JO"), SarDomainOther,   "Jordan" },
+    { SarCountryCode("JP"), SarDomainMic,     "Japan" },
+    { SarCountryCode("KE"), SarDomainOther,   "Kenya" },
+    { SarCountryCode("KG"), SarDomainOther,   "Kyrgyzstan" },
+    { SarCountryCode("KH"), SarDomainOther,   "Cambodia" },
+    { SarCountryCode("KI"), SarDomainOther,   "Kiribati" },
+    { SarCountryCode("KM"), SarDomainOther,   "Comoros" },
+    { SarCountryCode("KN"), SarDomainOther,   "Saint Kitts and Nevis" },
+    { SarCountryCode("KP"), SarDomainOther,   "North Korea" },
+    { SarCountryCode("KR"), SarDomainKc,      "South Korea" },
+    { SarCountryCode("KW"), SarDomainOther,   "Kuwait" },
+    { SarCountryCode("KY"), SarDomainOther,   "Cayman Islands" },
+    { SarCountryCode("KZ"), SarDomainOther,   "Kazakhstan" },
+    { SarCountryCode("LA"), SarDomainOther,   "Laos" },
+    { SarCountryCode("LB"), SarDomainOther,   "Lebanon" },
+    { SarCountryCode("LC"), SarDomainOther,   "Saint Lucia" },
+    { SarCountryCode("LI"), SarDomainEtsi,    "Liechtenstein" },
+    { SarCountryCode("LK"), SarDomainOther,   "Sri Lanka" },
+    { SarCountryCode("LR"), SarDomainOther,   "Liberia" },
+    { SarCountryCode("LS"), SarDomainOther,   "Lesotho" },
+    { SarCountryCode("LT"), SarDomainEtsi,    "Lithuania" },
+    { SarCountryCode("LU"), SarDomainEtsi,    "Luxembourg" },
+    { SarCountryCode("LV"), SarDomainEtsi,    "Latvia" },
+    { SarCountryCode("LY"), SarDomainOther,   "Libya" },
+    { SarCountryCode("MA"), SarDomainOther,   "Morocco" },
+    { SarCountryCode("MC"), SarDomainEtsi,    "Monaco" },
+    { SarCountryCode("MD"), SarDomainOther,   "Moldova" },
+    { SarCountryCode("ME"), SarDomainEtsi,    "Montenegro" },
+    { SarCountryCode("MF"), SarDomainOther,   "Saint Martin (French part)" },
+    { SarCountryCode("MG"), SarDomainOther,   "Madagascar" },
+    { SarCountryCode("MH"), SarDomainOther,   "Marshall Islands" },
+    { SarCountryCode("MK"), SarDomainEtsi,    "North Macedonia" },
+    { SarCountryCode("ML"), SarDomainOther,   "Mali" },
+    { SarCountryCode("MM"), SarDomainOther,   "Myanmar" },
+    { SarCountryCode("MN"), SarDomainOther,   "Mongolia" },
+    { SarCountryCode("MO"), SarDomainOther,   "Macao" },
+    { SarCountryCode("MP"), SarDomainFcc,     "Northern Mariana Islands" },
+    { SarCountryCode("MQ"), SarDomainEtsi,    "Martinique" },
+    { SarCountryCode("MR"), SarDomainOther,   "Mauritania" },
+    { SarCountryCode("MS"), SarDomainOther,   "Montserrat" },
+    { SarCountryCode("MT"), SarDomainEtsi,    "Malta" },
+    { SarCountryCode("MU"), SarDomainOther,   "Mauritius" },
+    { SarCountryCode("MV"), SarDomainOther,   "Maldives" },
+    { SarCountryCode("MW"), SarDomainOther,   "Malawi" },
+    { SarCountryCode("MX"), SarDomainOther,   "Mexico" },
+    { SarCountryCode("MY"), SarDomainOther,   "Malaysia" },
+    { SarCountryCode("MZ"), SarDomainOther,   "Mozambique" },
+    { SarCountryCode("NA"), SarDomainOther,   "Namibia" },
+    { SarCountryCode("NC"), SarDomainOther,   "New Caledonia" },
+    { SarCountryCode("NE"), SarDomainOther,   "Niger" },
+    { SarCountryCode("NF"), SarDomainOther,   "Norfolk Island" },
+    { SarCountryCode("NG"), SarDomainOther,   "Nigeria" },
+    { SarCountryCode("NI"), SarDomainOther,   "Nicaragua" },
+    { SarCountryCode("NL"), SarDomainEtsi,    "Netherlands" },
+    { SarCountryCode("NO"), SarDomainEtsi,    "Norway" },
+    { SarCountryCode("NP"), SarDomainOther,   "Nepal" },
+    { SarCountryCode("NR"), SarDomainOther,   "Nauru" },
+    { SarCountryCode("NU"), SarDomainOther,   "Niue" },
+    { SarCountryCode("NZ"), SarDomainOther,   "New Zealand" },
+    { SarCountryCode("OM"), SarDomainOther,   "Oman" },
+    { SarCountryCode("PA"), SarDomainOther,   "Panama" },
+    { SarCountryCode("PE"), SarDomainOther,   "Peru" },
+    { SarCountryCode("PF"), SarDomainOther,   "French Polynesia" },
+    { SarCountryCode("PG"), SarDomainOther,   "Papua New Guinea" },
+    { SarCountryCode("PH"), SarDomainOther,   "Philippines" },
+    { SarCountryCode("PK"), SarDomainOther,   "Pakistan" },
+    { SarCountryCode("PL"), SarDomainEtsi,    "Poland" },
+    { SarCountryCode("PM"), SarDomainOther,   "Saint Pierre and Miquelon" },
+    { SarCountryCode("PN"), SarDomainOther,   "Pitcairn" },
+    { SarCountryCode("PR"), SarDomainFcc,     "Puerto Rico" },
+    { SarCountryCode("PS"), SarDomainOther,   "Palestine, State of" },
+    { SarCountryCode("PT"), SarDomainEtsi,    "Portugal" },
+    { SarCountryCode("PW"), SarDomainOther,   "Palau" },
+    { SarCountryCode("PY"), SarDomainOther,   "Paraguay" },
+    { SarCountryCode("QA"), SarDomainOther,   "Qatar" },
+    { SarCountryCode("RE"), SarDomainEtsi,    "Reunion" },
+    { SarCountryCode("RO"), SarDomainEtsi,    "Romania" },
+    { SarCountryCode("RS"), SarDomainEtsi,    "Serbia" },
+    { SarCountryCode("RU"), SarDomainOther,   "Russian Federation" },
+    { SarCountryCode("RW"), SarDomainOther,   "Rwanda" },
+    { SarCountryCode("SA"), SarDomainOther,   "Saudi Arabia" },
+    { SarCountryCode("SB"), SarDomainOther,   "Solomon Islands" },
+    { SarCountryCode("SC"), SarDomainOther,   "Seychelles" },
+    { SarCountryCode("SD"), SarDomainOther,   "Sudan" },
+    { SarCountryCode("SE"), SarDomainEtsi,    "Sweden" },
+    { SarCountryCode("SG"), SarDomainOther,   "Singapore" },
+    { SarCountryCode("SH"), SarDomainOther,   "Saint Helena, Ascension and Tristan da Cunha" },
+    { SarCountryCode("SI"), SarDomainEtsi,    "Slovenia" },
+    { SarCountryCode("SJ"), SarDomainOther,   "Svalbard and Jan Mayen" },
+    { SarCountryCode("SK"), SarDomainEtsi,    "Slovakia" },
+    { SarCountryCode("SL"), SarDomainOther,   "Sierra Leone" },
+    { SarCountryCode("SM"), SarDomainEtsi,    "San Marino" },
+    { SarCountryCode("SN"), SarDomainOther,   "Senegal" },
+    { SarCountryCode("SO"), SarDomainOther,   "Somalia" },
+    { SarCountryCode("SR"), SarDomainOther,   "Suriname" },
+    { SarCountryCode("SS"), SarDomainOther,   "South Sudan" },
+    { SarCountryCode("ST"), SarDomainOther,   "Sao Tome and Principe" },
+    { SarCountryCode("SV"), SarDomainOther,   "El Salvador" },
+    { SarCountryCode("SX"), SarDomainOther,   "Sint Maarten (Dutch part)" },
+    { SarCountryCode("SY"), SarDomainOther,   "Syria" },
+    { SarCountryCode("SZ"), SarDomainOther,   "Eswatini" },
+    { SarCountryCode("TC"), SarDomainOther,   "Turks and Caicos Islands" },
+    { SarCountryCode("TD"), SarDomainOther,   "Chad" },
+    { SarCountryCode("TF"), SarDomainOther,   "French Southern Territories" },
+    { SarCountryCode("TG"), SarDomainOther,   "Togo" },
+    { SarCountryCode("TH"), SarDomainOther,   "Thailand" },
+    { SarCountryCode("TJ"), SarDomainOther,   "Tajikistan" },
+    { SarCountryCode("TK"), SarDomainOther,   "Tokelau" },
+    { SarCountryCode("TL"), SarDomainOther,   "Timor-Leste" },
+    { SarCountryCode("TM"), SarDomainOther,   "Turkmenistan" },
+    { SarCountryCode("TN"), SarDomainOther,   "Tunisia" },
+    { SarCountryCode("TO"), SarDomainOther,   "Tonga" },
+    { SarCountryCode("TR"), SarDomainEtsi,    "Turkiye" },
+    { SarCountryCode("TT"), SarDomainOther,   "Trinidad and Tobago" },
+    { SarCountryCode("TV"), SarDomainOther,   "Tuvalu" },
+    { SarCountryCode("TW"), SarDomainNcc,     "Taiwan" },
+    { SarCountryCode("TZ"), SarDomainOther,   "Tanzania" },
+    { SarCountryCode("UA"), SarDomainOther,   "Ukraine" },
+    { SarCountryCode("UG"), SarDomainOther,   "Uganda" },
+    { SarCountryCode("UM"), SarDomainFcc,     "United States Minor Outlying Islands" },
+    { SarCountryCode("US"), SarDomainFcc,     "United States" },
+    { SarCountryCode("UY"), SarDomainOther,   "Uruguay" },
+    { SarCountryCode("UZ"), SarDomainOther,   "Uzbekistan" },
+    { SarCountryCode("VA"), SarDomainEtsi,    "Holy See (Vatican City State)" },
+    { SarCountryCode("VC"), SarDomainOther,   "Saint Vincent and the Grenadines" },
+    { SarCountryCode("VE"), SarDomainOther,   "Venezuela" },
+    { SarCountryCode("VG"), SarDomainOther,   "Virgin Islands, British" },
+    { SarCountryCode("VI"), SarDomainFcc,     "Virgin Islands, U.S." },
+    { SarCountryCode("VN"), SarDomainOther,   "Vietnam" },
+    { SarCountryCode("VU"), SarDomainOther,   "Vanuatu" },
+    { SarCountryCode("WF"), SarDomainOther,   "Wallis and Futuna" },
+    { SarCountryCode("WS"), SarDomainOther,   "Samoa" },
+    { SarCountryCode("YE"), SarDomainOther,   "Yemen" },
+    { SarCountryCode("YT"), SarDomainEtsi,    "Mayotte" },
+    { SarCountryCode("ZA"), SarDomainOther,   "South Africa" },
+    { SarCountryCode("ZM"), SarDomainOther,   "Zambia" },
+    { SarCountryCode("ZW"), SarDomainOther,   "Zimbabwe" },
+};
+
+static const UINT32 SAR_COUNTRY_LETTERS = 26;
+static const UINT32 SAR_COUNTRY_SLOTS = SAR_COUNTRY_LETTERS * SAR_COUNTRY_LETTERS;
+static const UINT8 SAR_COUNTRY_EMPTY_SLOT = 0xff;
+
+C_ASSERT(ARRAYSIZE(SarCountries) == SAR_COUNTRY_COUNT);
+C_ASSERT(SAR_COUNTRY_COUNT < SAR_COUNTRY_EMPTY_SLOT);
+
+// Slot of a code whose letters are both 'A'-'Z'.  Distinct codes get distinct slots, which is what
+// makes the hash perfect.
+//
+constexpr
+UINT32
+SarCountrySlot(
+    UINT16 code
+    )
+{
+    return ((UINT32)(code >> 8) - 'A') * SAR_COUNTRY_LETTERS + ((UINT32)(code & 0xff) - 'A');
+}
+
+constexpr
+BOOL
+SarCountryTableIsValid()
+{
+    for (UINT32 i = 0; i < SAR_COUNTRY_COUNT; i++)
+    {
+        UINT32 first = (UINT32)(SarCountries[i].Code >> 8) - 'A';
+        UINT32 second = (UINT32)(SarCountries[i].Code & 0xff) - 'A';
+
+        if ((first >= SAR_COUNTRY_LETTERS) || (second >= SAR_COUNTRY_LETTERS) ||
+            ((i > 0) && (SarCountries[i - 1].Code >= SarCountries[i].Code)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// Codes must be upper-case letters and strictly ascending, so each slot is filled at most once.
+//
+static_assert(SarCountryTableIsValid(), "SarCountries must be sorted, unique, upper-case ISO 3166-1 codes");
+
+typedef struct _SAR_COUNTRY_SLOT_TABLE
+{
+    UINT8 Index[SAR_COUNTRY_SLOTS];
+} SAR_COUNTRY_SLOT_TABLE;
+
+constexpr
+SAR_COUNTRY_SLOT_TABLE
+SarBuildCountrySlots()
+{
+    SAR_COUNTRY_SLOT_TABLE table = {};
+
+    for (UINT32 slot = 0; slot < SAR_COUNTRY_SLOTS; slot++)
+    {
+        table.Index[slot] = SAR_COUNTRY_EMPTY_SLOT;
+    }
+
+    for (UINT32 i = 0; i < SAR_COUNTRY_COUNT; i++)
+    {
+        table.Index[SarCountrySlot(SarCountries[i].Code)] = (UINT8)i;
+    }
+
+    return table;
+}
+
+static constexpr SAR_COUNTRY_SLOT_TABLE SarCountrySlots = SarBuildCountrySlots();
+
+static_assert(SarCountrySlots.Index[SarCountrySlot(SarCountryCode("PH"))] != SAR_COUNTRY_EMPTY_SLOT, "PH is in the table");
+static_assert(SarCountrySlots.Index[SarCountrySlot(SarCountryCode("ZZ"))] == SAR_COUNTRY_EMPTY_SLOT, "ZZ is not");
+
+UINT32
+SarCountryIndex(
+    UINT16 code
+    )
+{
+    UINT32 first = (UINT32)(code >> 8) - 'A';
+    UINT32 second = (UINT32)(code & 0xff) - 'A';
+    UINT8 index;
+
+    if ((first >= SAR_COUNTRY_LETTERS) || (second >= SAR_COUNTRY_LETTERS))
+    {
+        return SAR_COUNTRY_NONE;
+    }
+
+    index = SarCountrySlots.Index[first * SAR_COUNTRY_LETTERS + second];
+
+    return (index == SAR_COUNTRY_EMPTY_SLOT) ? SAR_COUNTRY_NONE : index;
+}
+
+const SAR_COUNTRY*
+SarCountryAt(
+    UINT32 index
+    )
+{
+    return &SarCountries[index];
+}
+
+const SAR_COUNTRY*
+SarCountryFind(
+    UINT16 code
+    )
+{
+    UINT32 index = SarCountryIndex(code);
+
+    return (index == SAR_COUNTRY_NONE) ? nullptr : &SarCountries[index];
+}
+
+LPCSTR
+SarRegulatoryDomainName(
+    SAR_REGULATORY_DOMAIN domain
+    )
+{
+    static const LPCSTR s_names[] =
+    {
+        "other",
+        "FCC",
+        "ISED",
+        "ETSI",
+        "MIC",
+        "KC",
+        "SRRC",
+        "NCC",
+        "ACMA",
+        "ANATEL",
+        "WPC",
+    };
+
+    C_ASSERT(ARRAYSIZE(s_names) == SarDomainCount);
+
+    return ((UINT32)domain < SarDomainCount) ? s_names[domain] : s_names[SarDomainOther];
+}
+
+VOID
+SarFormatCountryCode(
+    UINT16 code,
+    _Out_writes_(8) char* text
+    )
+{
+    char first = (char)(code >> 8);
+    char second = (char)(code & 0xff);
+
+    if (isprint((unsigned char)first) && isprint((unsigned char)second))
+    {
+        snprintf(text, 8, "%c%c", first, second);
+    }
+    else
+    {
+        snprintf(text, 8, "0x%04x", code);
+    }
+}
+
+// eof: SarCountry.cpp
+//
@@ -0,0 +1,90 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCountry.h
+
+Abstract:
+
+    ISO 3166-1 country codes as packed in REGION_CONFIG_VALUES.GeoCountryString.AsciiChars (first
+    letter in the high byte, so 0x5048 is "PH").
+
+    Every country has a dense index, 0 to SAR_COUNTRY_COUNT - 1, that callers use to keep per-country
+    data (cap tables, fleet counts) in flat arrays.  The code-to-index map is a perfect hash built at
+    compile time: the two letters form a base-26 slot with exactly one candidate country, so a lookup
+    is two subtractions, a range check and one table load, and nothing is initialized at run time.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+typedef enum _SAR_REGULATORY_DOMAIN
+{
+    SarDomainOther = 0,
+    SarDomainFcc,                       // United States and its territories.
+    SarDomainIsed,                      // Canada.
+    SarDomainEtsi,                      // EU/EEA, UK, Switzerland and CE-marking neighbours.
+    SarDomainMic,                       // Japan.
+    SarDomainKc,                        // South Korea.
+    SarDomainSrrc,                      // China.
+    SarDomainNcc,                       // Taiwan.
+    SarDomainAcma,                      // Australia.
+    SarDomainAnatel,                    // Brazil.
+    SarDomainWpc,                       // India.
+    SarDomainCount
+} SAR_REGULATORY_DOMAIN;
+
+typedef struct _SAR_COUNTRY
+{
+    UINT16 Code;                        // GeoCountryString.AsciiChars.
+    SAR_REGULATORY_DOMAIN Domain;
+    LPCSTR Name;
+} SAR_COUNTRY;
+
+static const UINT32 SAR_COUNTRY_COUNT = 249;
+static const UINT32 SAR_COUNTRY_NONE = 0xffffffff;
+
+// Returns the index of a country, or SAR_COUNTRY_NONE if code is not an ISO 3166-1 code.
+//
+UINT32
+SarCountryIndex(
+    UINT16 code
+    );
+
+// Returns the country at an index below SAR_COUNTRY_COUNT.
+//
+const SAR_COUNTRY*
+SarCountryAt(
+    UINT32 index
+    );
+
+// Returns the country for a code, or nullptr.
+//
+const SAR_COUNTRY*
+SarCountryFind(
+    UINT16 code
+    );
+
+LPCSTR
+SarRegulatoryDomainName(
+    SAR_REGULATORY_DOMAIN domain
+    );
+
+// Formats a code as its two letters when they are printable, otherwise as hex.
+//
+VOID
+SarFormatCountryCode(
+    UINT16 code,
+    _Out_writes_(8) char* text
+    );
+
+// eof: SarCountry.h
+//
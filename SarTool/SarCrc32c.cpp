@@ -0,0 +1,276 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCrc32c.cpp
+
+Abstract:
+
+    CRC-32C (Castagnoli) with hardware acceleration where available.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarCrc32c.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAR_CRC32C_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SAR_CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define SAR_CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SAR_CRC32C_ARM64
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SAR_CRC32C_TARGET
+#else
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define SAR_CRC32C_TARGET __attribute__((target("+crc")))
+#endif
+#endif
+
+// The reflected Castagnoli polynomial.
+static const UINT32 SAR_CRC32C_POLYNOMIAL = 0x82F63B78;
+
+typedef struct _SAR_CRC32C_TABLE
+{
+    UINT32 Entries[256];
+} SAR_CRC32C_TABLE;
+
+static
+constexpr
+SAR_CRC32C_TABLE
+SarBuildCrc32cTable()
+{
+    SAR_CRC32C_TABLE table = {};
+
+    for (UINT32 i = 0; i < 256; i++)
+    {
+        UINT32 crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? ((crc >> 1) ^ SAR_CRC32C_POLYNOMIAL) : (crc >> 1);
+        }
+        table.Entries[i] = crc;
+    }
+
+    return table;
+}
+
+static constexpr SAR_CRC32C_TABLE s_crc32cTable = SarBuildCrc32cTable();
+
+UINT32
+SarCrc32cSoftware(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT32 crc
+    )
+/*++
+
+Routine Description:
+
+    Table-driven CRC-32C, one byte at a time.
+
+Arguments:
+
+    data - The buffer.
+    size - Size of the buffer in bytes.
+    crc - 0, or the result of a previous call to continue from.
+
+Return Value:
+
+    The CRC-32C.
+
+--*/
+{
+    const UINT8* pData = (const UINT8*)data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = s_crc32cTable.Entries[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+#if defined(SAR_CRC32C_X86) || defined(SAR_CRC32C_ARM64)
+
+static
+SAR_CRC32C_TARGET
+UINT32
+SarCrc32cHardware(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT32 crc
+    )
+/*++
+
+Routine Description:
+
+    CRC-32C using the CPU's CRC32C instructions, eight bytes at a time.
+
+Arguments:
+
+    data - The buffer.
+    size - Size of the buffer in bytes.
+    crc - 0, or the result of a previous call to continue from.
+
+Return Value:
+
+    The CRC-32C.
+
+--*/
+{
+    const UINT8* pData = (const UINT8*)data;
+
+    crc = ~crc;
+
+#if defined(SAR_CRC32C_X86) && (defined(_M_X64) || defined(__x86_64__))
+    while (size >= sizeof(UINT64))
+    {
+        UINT64 chunk;
+        memcpy(&chunk, pData, sizeof(chunk));
+        crc = (UINT32)_mm_crc32_u64(crc, chunk);
+        pData += sizeof(chunk);
+        size -= sizeof(chunk);
+    }
+#elif defined(SAR_CRC32C_X86)
+    while (size >= sizeof(UINT32))
+    {
+        UINT32 chunk;
+        memcpy(&chunk, pData, sizeof(chunk));
+        crc = _mm_crc32_u32(crc, chunk);
+        pData += sizeof(chunk);
+        size -= sizeof(chunk);
+    }
+#else
+    while (size >= sizeof(UINT64))
+    {
+        UINT64 chunk;
+        memcpy(&chunk, pData, sizeof(chunk));
+        crc = __crc32cd(crc, chunk);
+        pData += sizeof(chunk);
+        size -= sizeof(chunk);
+    }
+#endif
+
+    while (size > 0)
+    {
+#ifdef SAR_CRC32C_X86
+        crc = _mm_crc32_u8(crc, *pData);
+#else
+        crc = __crc32cb(crc, *pData);
+#endif
+        pData++;
+        size--;
+    }
+
+    return ~crc;
+}
+
+static
+BOOL
+SarCpuHasCrc32c()
+/*++
+
+Routine Description:
+
+    Determines whether the CPU implements the CRC32C instructions.
+
+Arguments:
+
+    VOID
+
+Return Value:
+
+    TRUE if SarCrc32cHardware may be used.
+
+--*/
+{
+#if defined(SAR_CRC32C_X86)
+    // CPUID leaf 1, ECX bit 20 == SSE4.2.
+#ifdef _MSC_VER
+    int cpuInfo[4] = { 0 };
+    __cpuid(cpuInfo, 1);
+    return (cpuInfo[2] & (1 << 20)) ? TRUE : FALSE;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return FALSE;
+    }
+    return (ecx & bit_SSE4_2) ? TRUE : FALSE;
+#endif
+#else
+#ifdef _WIN32
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) ? TRUE : FALSE;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) ? TRUE : FALSE;
+#endif
+#endif
+}
+
+#endif // SAR_CRC32C_X86 || SAR_CRC32C_ARM64
+
+BOOL
+SarCrc32cIsAccelerated()
+{
+#if defined(SAR_CRC32C_X86) || defined(SAR_CRC32C_ARM64)
+    static const BOOL s_fAccelerated = SarCpuHasCrc32c();
+    return s_fAccelerated;
+#else
+    return FALSE;
+#endif
+}
+
+UINT32
+SarCrc32c(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT32 crc
+    )
+/*++
+
+Routine Description:
+
+    Computes the CRC-32C of the buffer using the fastest implementation the CPU supports.
+
+Arguments:
+
+    data - The buffer.
+    size - Size of the buffer in bytes.
+    crc - 0, or the result of a previous call to continue from.
+
+Return Value:
+
+    The CRC-32C.
+
+--*/
+{
+#if defined(SAR_CRC32C_X86) || defined(SAR_CRC32C_ARM64)
+    if (SarCrc32cIsAccelerated())
+    {
+        return SarCrc32cHardware(data, size, crc);
+    }
+#endif
+
+    return SarCrc32cSoftware(data, size, crc);
+}
+
+// eof: SarCrc32c.cpp
+//
@@ -0,0 +1,49 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarCrc32c.h
+
+Abstract:
+
+    CRC-32C (Castagnoli) used to protect the sections of a SAR provisioning container.  Uses the
+    SSE4.2 CRC32 instruction on x86/x64 and the ARMv8 CRC32C instructions on ARM64 when the CPU
+    supports them, and a table-driven implementation otherwise.  All paths produce identical results.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include <stddef.h>
+
+// Computes (or continues) the CRC-32C of the buffer.  Pass 0 as crc for a new checksum, or a
+// previous result to extend it.
+//
+UINT32
+SarCrc32c(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT32 crc = 0
+    );
+
+// The portable implementation, exposed so callers can compare it with the accelerated path.
+//
+UINT32
+SarCrc32cSoftware(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT32 crc = 0
+    );
+
+BOOL
+SarCrc32cIsAccelerated();
+
+// eof: SarCrc32c.h
+//
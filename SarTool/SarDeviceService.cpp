@@ -0,0 +1,821 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarDeviceService.cpp
+
+Abstract:
+
+    The WDI SAR device service and the Wi-Fi SAR get/set logic built on it.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarDeviceService.h"
+#include "SarCodec.h"
+#include "SarStats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <wlanapi.h>
+#endif
+
+_Check_return_
+HRESULT
+SarDeviceService::Command(
+    DWORD opcode,
+    _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+    DWORD inSize,
+    _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+    DWORD outSize,
+    _Out_ DWORD* bytesReturned
+    )
+{
+    UINT64 start = SarStatsNow();
+    HRESULT hr = ExecuteCommand(opcode, inBuffer, inSize, outBuffer, outSize, bytesReturned);
+
+    SarStatsRecord(SarStatFromOpcode(opcode), start);
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarDeviceService::Identify(
+    _Out_ SAR_DEVICE_IDENTITY* identity
+    )
+{
+    memset(identity, 0, sizeof(*identity));
+    return E_NOTIMPL;
+}
+
+#ifdef _WIN32
+
+// The setup class of network adapters; each adapter's key records its NetCfgInstanceId (the
+// GUID WLAN calls the interface) and the DriverVersion of its driver.
+//
+static const char SAR_NET_CLASS_KEY[] = "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e972-e325-11ce-bfc1-08002be10318}";
+
+_Check_return_
+static
+HRESULT
+SarWlanReadDriverVersion(
+    _In_ const GUID& interfaceGuid,
+    _Out_writes_z_(size) char* driverVersion,
+    DWORD size
+    )
+/*++
+
+Routine Description:
+
+    Reads the DriverVersion of the network adapter behind a WLAN interface.
+
+Arguments:
+
+    interfaceGuid - The WLAN interface.
+    driverVersion - Receives the version, e.g. "22.190.0.4".
+    size - Size of driverVersion in bytes.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_NOT_FOUND) if no adapter has the interface's GUID,
+    or the underlying failure code.
+
+--*/
+{
+    HRESULT hr = HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+    HKEY hClassKey = NULL;
+    char szGuid[39];
+    char subkeyName[256];
+    DWORD dwResult;
+
+    driverVersion[0] = '\0';
+
+    snprintf(szGuid, sizeof(szGuid), "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+        interfaceGuid.Data1, interfaceGuid.Data2, interfaceGuid.Data3,
+        interfaceGuid.Data4[0], interfaceGuid.Data4[1], interfaceGuid.Data4[2], interfaceGuid.Data4[3],
+        interfaceGuid.Data4[4], interfaceGuid.Data4[5], interfaceGuid.Data4[6], interfaceGuid.Data4[7]);
+
+    dwResult = RegOpenKeyExA(HKEY_LOCAL_MACHINE, SAR_NET_CLASS_KEY, 0, KEY_READ, &hClassKey);
+    if (dwResult != ERROR_SUCCESS)
+    {
+        hr = HRESULT_FROM_WIN32(dwResult);
+        goto exit;
+    }
+
+    for (DWORD index = 0; ; index++)
+    {
+        DWORD subkeyNameLength = ARRAYSIZE(subkeyName);
+        char instanceId[64];
+        DWORD instanceIdSize = sizeof(instanceId);
+
+        dwResult = RegEnumKeyExA(hClassKey, index, subkeyName, &subkeyNameLength, NULL, NULL, NULL, NULL);
+        if (dwResult != ERROR_SUCCESS)
+        {
+            break;
+        }
+
+        // Keys that are not adapters (e.g. "Properties") have no NetCfgInstanceId.
+        dwResult = RegGetValueA(hClassKey, subkeyName, "NetCfgInstanceId", RRF_RT_REG_SZ, NULL, instanceId, &instanceIdSize);
+        if ((dwResult != ERROR_SUCCESS) || (0 != _stricmp(instanceId, szGuid)))
+        {
+            continue;
+        }
+
+        dwResult = RegGetValueA(hClassKey, subkeyName, "DriverVersion", RRF_RT_REG_SZ, NULL, driverVersion, &size);
+        hr = HRESULT_FROM_WIN32(dwResult);
+        break;
+    }
+
+exit:
+    if (hClassKey != NULL)
+    {
+        RegCloseKey(hClassKey);
+    }
+    if (FAILED(hr))
+    {
+        driverVersion[0] = '\0';
+    }
+    return hr;
+}
+
+SarWlanDeviceService::SarWlanDeviceService() :
+    m_hClient(NULL),
+    m_fFixedInterface(FALSE)
+{
+    memset(&m_interfaceGuid, 0, sizeof(m_interfaceGuid));
+    m_driverVersion[0] = '\0';
+}
+
+SarWlanDeviceService::SarWlanDeviceService(
+    const GUID& interfaceGuid
+    ) :
+    m_hClient(NULL),
+    m_fFixedInterface(TRUE),
+    m_interfaceGuid(interfaceGuid)
+{
+    m_driverVersion[0] = '\0';
+}
+
+SarWlanDeviceService::~SarWlanDeviceService()
+{
+    if (m_hClient != NULL)
+    {
+        WlanCloseHandle(m_hClient, NULL);
+    }
+}
+
+_Check_return_
+HRESULT
+SarWlanDeviceService::Open(
+    _Out_ HANDLE* phClient,
+    _Out_ GUID* pInterfaceGuid
+    )
+/*++
+
+Routine Description:
+
+    Returns the cached WLAN handle and interface GUID, opening the handle and (unless the service
+    was given its interface) enumerating the interfaces if this is the first use (or the previous
+    session was reset.)
+
+Arguments:
+
+    phClient - Receives the WLAN handle.
+    pInterfaceGuid - Receives the GUID of the interface to send commands to.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    DWORD dwMaxClient = 2;
+    DWORD dwCurVersion = 0;
+    DWORD dwResult = 0;
+    PWLAN_INTERFACE_INFO_LIST pInterfaceList = NULL;
+    UINT64 start;
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_hClient == NULL)
+    {
+        HANDLE hClient = NULL;
+
+        start = SarStatsNow();
+        dwResult = WlanOpenHandle(dwMaxClient, NULL, &dwCurVersion, &hClient);
+        SarStatsRecord(SarStatWlanOpenHandle, start);
+        if (dwResult != ERROR_SUCCESS)
+        {
+            hr = HRESULT_FROM_WIN32(dwResult);
+            goto exit;
+        }
+
+        if (!m_fFixedInterface)
+        {
+            start = SarStatsNow();
+            dwResult = WlanEnumInterfaces(hClient, nullptr, &pInterfaceList);
+            SarStatsRecord(SarStatWlanEnumInterfaces, start);
+            if ((dwResult == ERROR_SUCCESS) && (pInterfaceList->dwNumberOfItems == 0))
+            {
+                dwResult = ERROR_NOT_FOUND;
+            }
+
+            if (dwResult != ERROR_SUCCESS)
+            {
+                WlanCloseHandle(hClient, NULL);
+                hr = HRESULT_FROM_WIN32(dwResult);
+                goto exit;
+            }
+
+            m_interfaceGuid = pInterfaceList->InterfaceInfo[pInterfaceList->dwIndex].InterfaceGuid;
+        }
+
+        m_hClient = hClient;
+
+        // Read again whenever the session is reopened, as a driver restart may be an update.
+        (VOID)SarWlanReadDriverVersion(m_interfaceGuid, m_driverVersion, sizeof(m_driverVersion));
+    }
+
+    *phClient = m_hClient;
+    *pInterfaceGuid = m_interfaceGuid;
+
+exit:
+    if (pInterfaceList != NULL)
+    {
+        WlanFreeMemory(pInterfaceList);
+    }
+    return hr;
+}
+
+VOID
+SarWlanDeviceService::Reset(
+    HANDLE hClient
+    )
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    // Another thread may already have replaced the session.
+    if (m_hClient == hClient)
+    {
+        WlanCloseHandle(m_hClient, NULL);
+        m_hClient = NULL;
+    }
+}
+
+_Check_return_
+HRESULT
+SarWlanDeviceService::ExecuteCommand(
+    DWORD opcode,
+    _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+    DWORD inSize,
+    _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+    DWORD outSize,
+    _Out_ DWORD* bytesReturned
+    )
+{
+    HRESULT hr = S_OK;
+
+    *bytesReturned = 0;
+
+#if (NTDDI_WIN10_RS4 && (NTDDI_VERSION >= NTDDI_WIN10_RS4))
+    GUID deviceServiceGuid = WDI_SAR_DEVICE_SERVICE;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        HANDLE hClient = NULL;
+        GUID interfaceGuid;
+        DWORD dwResult;
+
+        hr = Open(&hClient, &interfaceGuid);
+        if (FAILED(hr))
+        {
+            break;
+        }
+
+        dwResult = WlanDeviceServiceCommand(hClient,
+                                            &interfaceGuid,
+                                            &deviceServiceGuid,
+                                            opcode,
+                                            inSize,
+                                            const_cast<PVOID>(inBuffer),
+                                            outSize,
+                                            outBuffer,
+                                            bytesReturned);
+        hr = HRESULT_FROM_WIN32(dwResult);
+
+        if ((dwResult != ERROR_INVALID_HANDLE) && (dwResult != ERROR_NOT_FOUND))
+        {
+            break;
+        }
+
+        // The cached session is stale; open a new one and retry once.
+        Reset(hClient);
+    }
+#else
+    UNREFERENCED_PARAMETER(opcode);
+    UNREFERENCED_PARAMETER(inBuffer);
+    UNREFERENCED_PARAMETER(inSize);
+    UNREFERENCED_PARAMETER(outBuffer);
+    UNREFERENCED_PARAMETER(outSize);
+    printf("\n\n--->>>> Compiled against an RS3 SDK or older - so WlanDeviceServiceCommand is not defined\n\n\n");
+    hr = E_NOTIMPL;
+#endif
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWlanDeviceService::Identify(
+    _Out_ SAR_DEVICE_IDENTITY* identity
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hClient = NULL;
+
+    memset(identity, 0, sizeof(*identity));
+
+    hr = Open(&hClient, &identity->InterfaceGuid);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if (m_driverVersion[0] == '\0')
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+            goto exit;
+        }
+
+        strcpy_s(identity->DriverVersion, sizeof(identity->DriverVersion), m_driverVersion);
+    }
+
+exit:
+    return hr;
+}
+
+SarDeviceService*
+SarWlanDeviceServiceDefault()
+{
+    static SarWlanDeviceService s_device;
+    return &s_device;
+}
+
+#endif // _WIN32
+
+SarMockDeviceService::SarMockDeviceService(
+    UINT32 latencyMicroseconds,
+    UINT8 interfaceIndex
+    ) :
+    m_latencyMicroseconds(latencyMicroseconds),
+    m_interfaceIndex(interfaceIndex),
+    m_commandCount(0)
+{
+    memset(&m_state, 0, sizeof(m_state));
+}
+
+_Check_return_
+HRESULT
+SarMockDeviceService::Identify(
+    _Out_ SAR_DEVICE_IDENTITY* identity
+    )
+{
+    // {5341524D-4F43-4B00-8000-0000000000<interfaceIndex + 1>}
+    static const GUID mockInterfaceGuid = { 0x5341524d, 0x4f43, 0x4b00, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 } };
+
+    memset(identity, 0, sizeof(*identity));
+    identity->InterfaceGuid = mockInterfaceGuid;
+    identity->InterfaceGuid.Data4[7] = (UINT8)(m_interfaceIndex + 1);
+    snprintf(identity->DriverVersion, sizeof(identity->DriverVersion), "mock-%d.%d",
+             WDI_SAR_INTERFACE_VERSION_MAJOR, WDI_SAR_INTERFACE_VERSION_MINOR);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarMockDeviceService::ExecuteCommand(
+    DWORD opcode,
+    _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+    DWORD inSize,
+    _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+    DWORD outSize,
+    _Out_ DWORD* bytesReturned
+    )
+/*++
+
+Routine Description:
+
+    Models the IHV driver's side of the SAR device service: WDI_SET_SAR_STATE stores the state and
+    its pairs and returns a WDI_SAR_RESULT, WDI_GET_SAR_STATE returns them, and
+    WDI_GET_INTERFACE_VERSION returns the version this tool was built against.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    const UINT8* pIn = (const UINT8*)inBuffer;
+    UINT8* pOut = (UINT8*)outBuffer;
+
+    *bytesReturned = 0;
+
+    if (m_latencyMicroseconds != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(m_latencyMicroseconds));
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_commandCount++;
+
+    switch (opcode)
+    {
+    case WDI_SET_SAR_STATE:
+    {
+        WDI_SAR_STATE state;
+        std::vector<WDI_SAR_CONFIG_SET> configSets;
+
+        if ((pIn == nullptr) || FAILED(SarDecodeSarState(pIn, inSize, &state)) ||
+            (inSize < SarStatePayloadSize(state.NumWdiSarConfigElements)))
+        {
+            hr = E_INVALIDARG;
+            break;
+        }
+
+        configSets.resize(state.NumWdiSarConfigElements);
+        (VOID)SarDecodeSarConfigSets(pIn + SarStateLayout.WireSize,
+                                     inSize - SarStateLayout.WireSize,
+                                     configSets.data(),
+                                     state.NumWdiSarConfigElements);
+
+        m_state = state;
+        m_configSets.swap(configSets);
+
+        if ((pOut != nullptr) && (outSize >= sizeof(UINT32)))
+        {
+            SarStoreLe32(pOut, WDI_SAR_SUCCESS);
+            *bytesReturned = sizeof(UINT32);
+        }
+        break;
+    }
+
+    case WDI_GET_SAR_STATE:
+    {
+        DWORD required = (DWORD)SarStatePayloadSize((UINT32)m_configSets.size());
+
+        if ((pOut == nullptr) || (outSize < required))
+        {
+            *bytesReturned = required;
+            hr = E_NOT_SUFFICIENT_BUFFER;
+            break;
+        }
+
+        (VOID)SarEncodeSarState(&m_state, pOut, outSize);
+        (VOID)SarEncodeSarConfigSets(m_configSets.data(),
+                                     (UINT32)m_configSets.size(),
+                                     pOut + SarStateLayout.WireSize,
+                                     outSize - SarStateLayout.WireSize);
+        *bytesReturned = required;
+        break;
+    }
+
+    case WDI_GET_INTERFACE_VERSION:
+        if ((pOut == nullptr) || (outSize < 2 * sizeof(UINT32)))
+        {
+            hr = E_NOT_SUFFICIENT_BUFFER;
+            break;
+        }
+
+        SarStoreLe32(pOut, WDI_SAR_INTERFACE_VERSION_MAJOR);
+        SarStoreLe32(pOut + sizeof(UINT32), WDI_SAR_INTERFACE_VERSION_MINOR);
+        *bytesReturned = 2 * sizeof(UINT32);
+        break;
+
+    default:
+        hr = HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        break;
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiBuildSetSarState(
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_ std::vector<UINT8>* buffer
+    )
+/*++
+
+Routine Description:
+
+    Encodes a WDI_SAR_STATE followed by all of its {AntennaIndex, BackoffIndex} pairs, as sent
+    with WDI_SET_SAR_STATE.
+
+Arguments:
+
+    backoffState - WDI_SARBACKOFF_DISABLED or WDI_SARBACKOFF_ENABLED
+    mimoConfigType - Antenna selection bit mask.
+    configSets - The pairs.
+    configSetCount - Number of pairs; at most SAR_WIFI_MAX_CONFIG_SETS.
+    buffer - Receives the encoded request.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if there are too many pairs.
+
+--*/
+{
+    WDI_SAR_STATE state;
+
+    if (configSetCount > SAR_WIFI_MAX_CONFIG_SETS)
+    {
+        return E_INVALIDARG;
+    }
+
+    state.SarBackoffStatus = backoffState;
+    state.MIMOConfigType = mimoConfigType;
+    state.NumWdiSarConfigElements = configSetCount;
+
+    buffer->resize(SarStatePayloadSize(configSetCount));
+    (VOID)SarEncodeSarState(&state, buffer->data(), buffer->size());
+    (VOID)SarEncodeSarConfigSets(configSets,
+                                 configSetCount,
+                                 buffer->data() + SarStateLayout.WireSize,
+                                 buffer->size() - SarStateLayout.WireSize);
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarWifiSetSarState(
+    _In_ SarDeviceService* device,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_opt_ WDI_SAR_RESULT* pResult
+    )
+/*++
+
+Routine Description:
+
+    Encodes a WDI_SAR_STATE followed by all of its {AntennaIndex, BackoffIndex} pairs and sends it
+    to the driver with a single WDI_SET_SAR_STATE.
+
+Arguments:
+
+    device - The device service.
+    backoffState - WDI_SARBACKOFF_DISABLED or WDI_SARBACKOFF_ENABLED
+    mimoConfigType - Antenna selection bit mask.
+    configSets - The pairs.
+    configSetCount - Number of pairs; at most SAR_WIFI_MAX_CONFIG_SETS.
+    pResult - Optionally receives the WDI_SAR_RESULT returned by the driver.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if there are too many pairs, or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<UINT8> inBuffer;
+
+    hr = SarWifiBuildSetSarState(backoffState, mimoConfigType, configSets, configSetCount, &inBuffer);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    hr = SarWifiSendSetSarState(device, inBuffer, pResult);
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiSendSetSarState(
+    _In_ SarDeviceService* device,
+    const std::vector<UINT8>& request,
+    _Out_opt_ WDI_SAR_RESULT* pResult
+    )
+/*++
+
+Routine Description:
+
+    Sends a WDI_SET_SAR_STATE request built by SarWifiBuildSetSarState.
+
+Arguments:
+
+    device - The device service.
+    request - The encoded request.
+    pResult - Optionally receives the WDI_SAR_RESULT returned by the driver.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 outBuffer[sizeof(UINT32)] = { 0 };
+    DWORD bytesReturned = 0;
+
+    hr = device->Command(WDI_SET_SAR_STATE,
+                         request.data(),
+                         (DWORD)request.size(),
+                         outBuffer,
+                         sizeof(outBuffer),
+                         &bytesReturned);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    if (pResult != nullptr)
+    {
+        *pResult = (bytesReturned == sizeof(UINT32)) ? (WDI_SAR_RESULT)SarLoadLe32(outBuffer) : WDI_SAR_SUCCESS;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiGetSarState(
+    _In_ SarDeviceService* device,
+    _Out_ WDI_SAR_STATE* state,
+    _Out_ std::vector<WDI_SAR_CONFIG_SET>* configSets
+    )
+/*++
+
+Routine Description:
+
+    Sends WDI_GET_SAR_STATE and decodes the returned WDI_SAR_STATE and every pair that follows it.
+    The first attempt makes room for SAR_WIFI_TYPICAL_CONFIG_SETS pairs; if the driver needs more
+    (it fails with ERROR_INSUFFICIENT_BUFFER or ERROR_MORE_DATA, or returns a state counting more
+    pairs than fit), the command is sent once more with a buffer sized for all of them.
+
+Arguments:
+
+    device - The device service.
+    state - Receives the state.
+    configSets - Receives the pairs.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the driver returned less than the
+    state and the pairs it counts (or more than SAR_WIFI_MAX_CONFIG_SETS pairs), or the underlying
+    failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<UINT8> outBuffer(SarStatePayloadSize(SAR_WIFI_TYPICAL_CONFIG_SETS));
+    DWORD bytesReturned = 0;
+
+    memset(state, 0, sizeof(*state));
+    configSets->clear();
+
+    for (int attempt = 0; ; attempt++)
+    {
+        size_t required;
+
+        hr = device->Command(WDI_GET_SAR_STATE,
+                             nullptr,
+                             0,
+                             outBuffer.data(),
+                             (DWORD)outBuffer.size(),
+                             &bytesReturned);
+        if ((hr == E_NOT_SUFFICIENT_BUFFER) || (hr == HRESULT_FROM_WIN32(ERROR_MORE_DATA)))
+        {
+            // Not every driver reports the size it needs; fall back to the largest valid state.
+            required = (bytesReturned > outBuffer.size()) ? bytesReturned : SarStatePayloadSize(SAR_WIFI_MAX_CONFIG_SETS);
+        }
+        else if (FAILED(hr))
+        {
+            goto exit;
+        }
+        else if ((bytesReturned > outBuffer.size()) ||
+                 FAILED(SarDecodeSarState(outBuffer.data(), bytesReturned, state)) ||
+                 (state->NumWdiSarConfigElements > SAR_WIFI_MAX_CONFIG_SETS))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+        else
+        {
+            required = SarStatePayloadSize(state->NumWdiSarConfigElements);
+            if ((bytesReturned >= required) || (required <= outBuffer.size()))
+            {
+                break;
+            }
+        }
+
+        if ((attempt != 0) || (required > SarStatePayloadSize(SAR_WIFI_MAX_CONFIG_SETS)))
+        {
+            hr = FAILED(hr) ? hr : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        outBuffer.resize(required);
+    }
+
+    configSets->resize(state->NumWdiSarConfigElements);
+    if (FAILED(SarDecodeSarConfigSets(outBuffer.data() + SarStateLayout.WireSize,
+                                      bytesReturned - SarStateLayout.WireSize,
+                                      configSets->data(),
+                                      state->NumWdiSarConfigElements)))
+    {
+        configSets->clear();
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiGetInterfaceVersion(
+    _In_ SarDeviceService* device,
+    _Out_ SAR_INTERFACE_VERSION* version
+    )
+/*++
+
+Routine Description:
+
+    Sends WDI_GET_INTERFACE_VERSION and decodes the major and minor version the driver implements.
+
+Arguments:
+
+    device - The device service.
+    version - Receives the version; 0.0 if the driver does not support the opcode.
+
+Return Value:
+
+    S_OK on success, S_FALSE if the driver fails the opcode as unsupported,
+    HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if it returns fewer than 8 bytes, or the underlying
+    failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 outBuffer[2 * sizeof(UINT32)] = { 0 };
+    DWORD bytesReturned = 0;
+
+    version->Major = 0;
+    version->Minor = 0;
+
+    hr = device->Command(WDI_GET_INTERFACE_VERSION,
+                         nullptr,
+                         0,
+                         outBuffer,
+                         sizeof(outBuffer),
+                         &bytesReturned);
+    if ((hr == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED)) || (hr == HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER)))
+    {
+        // Drivers written before the opcode was defined.
+        hr = S_FALSE;
+        goto exit;
+    }
+
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    if (bytesReturned < sizeof(outBuffer))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    version->Major = SarLoadLe32(outBuffer);
+    version->Minor = SarLoadLe32(outBuffer + sizeof(UINT32));
+
+exit:
+    return hr;
+}
+
+// eof: SarDeviceService.cpp
+//
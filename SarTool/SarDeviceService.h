@@ -0,0 +1,291 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarDeviceService.h
+
+Abstract:
+
+    The WDI SAR device service: the opcode/buffer interface that WlanDeviceServiceCommand exposes
+    to the IHV's WLAN driver.
+
+    SarDeviceService abstracts the transport so the same SAR get/set logic runs against
+
+        SarWlanDeviceService        The driver, via WlanDeviceServiceCommand (Windows.)  The WLAN
+                                    handle and interface GUID are opened once and cached.  The
+                                    interface is the first one WLAN enumerates unless one is
+                                    given (see SarFanOut.h for every interface.)
+        SarMockDeviceService        An in-process model of the driver for tests and load tests.
+        SarRemoteDeviceService      A SarTool server (see SarServer.h.)
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <mutex>
+#include <vector>
+
+#include "Dmf_Wlan_Public.h"
+
+// Upper bound on the {AntennaIndex, BackoffIndex} pairs in one WDI_SAR_STATE, so a corrupt
+// NumWdiSarConfigElements cannot drive an arbitrarily large buffer.
+//
+static const UINT32 SAR_WIFI_MAX_CONFIG_SETS = 256;
+
+// The number of pairs WDI_GET_SAR_STATE's first attempt makes room for (a 4x4 MIMO radio on two
+// bands); a radio reporting more is queried again with a buffer sized for all of them.
+//
+static const UINT32 SAR_WIFI_TYPICAL_CONFIG_SETS = 8;
+
+// The interface and driver a device service sends commands to.  Facts learned from the driver,
+// such as its SAR interface version, are cached under this identity (see SarInterfaceVersion.h.)
+//
+typedef struct _SAR_DEVICE_IDENTITY
+{
+    GUID InterfaceGuid;
+    char DriverVersion[64];         // e.g. "22.190.0.4"; changes when the driver is updated.
+} SAR_DEVICE_IDENTITY;
+
+// The reply to WDI_GET_INTERFACE_VERSION; 0.0 for a driver that predates the opcode.
+//
+typedef struct _SAR_INTERFACE_VERSION
+{
+    UINT32 Major;
+    UINT32 Minor;
+} SAR_INTERFACE_VERSION;
+
+class SarDeviceService
+{
+public:
+
+    virtual ~SarDeviceService() {}
+
+    // Issues one device-service command; same contract as WlanDeviceServiceCommand.  Every
+    // command is timed into its opcode's latency histogram (see SarStats.h.)
+    //
+    _Check_return_
+    HRESULT
+    Command(
+        DWORD opcode,
+        _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+        DWORD inSize,
+        _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+        DWORD outSize,
+        _Out_ DWORD* bytesReturned
+        );
+
+    // Identifies the interface and driver that commands go to.  Fails with E_NOTIMPL where that
+    // is not known (e.g. behind a server), so nothing is cached for the device across sessions.
+    //
+    _Check_return_
+    virtual
+    HRESULT
+    Identify(
+        _Out_ SAR_DEVICE_IDENTITY* identity
+        );
+
+protected:
+
+    // Implemented by each device service to carry out Command.
+    //
+    _Check_return_
+    virtual
+    HRESULT
+    ExecuteCommand(
+        DWORD opcode,
+        _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+        DWORD inSize,
+        _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+        DWORD outSize,
+        _Out_ DWORD* bytesReturned
+        ) = 0;
+};
+
+#ifdef _WIN32
+
+class SarWlanDeviceService : public SarDeviceService
+{
+public:
+
+    SarWlanDeviceService();
+
+    // Sends every command to interfaceGuid rather than the first interface WLAN enumerates.
+    //
+    explicit
+    SarWlanDeviceService(
+        const GUID& interfaceGuid
+        );
+
+    ~SarWlanDeviceService();
+
+    SarWlanDeviceService(const SarWlanDeviceService&) = delete;
+    SarWlanDeviceService& operator=(const SarWlanDeviceService&) = delete;
+
+    // The interface GUID and the DriverVersion of its network adapter, read from the registry
+    // when the interface is picked.
+    //
+    _Check_return_
+    HRESULT
+    Identify(
+        _Out_ SAR_DEVICE_IDENTITY* identity
+        ) override;
+
+protected:
+
+    // Opens the WLAN handle and picks the interface on first use; a command that fails because
+    // the handle or interface went away (e.g. the driver restarted) reopens once and retries.
+    //
+    _Check_return_
+    HRESULT
+    ExecuteCommand(
+        DWORD opcode,
+        _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+        DWORD inSize,
+        _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+        DWORD outSize,
+        _Out_ DWORD* bytesReturned
+        ) override;
+
+private:
+
+    _Check_return_
+    HRESULT
+    Open(
+        _Out_ HANDLE* phClient,
+        _Out_ GUID* pInterfaceGuid
+        );
+
+    VOID
+    Reset(
+        HANDLE hClient
+        );
+
+    std::mutex m_lock;
+    HANDLE m_hClient;
+    BOOL m_fFixedInterface;
+    GUID m_interfaceGuid;
+    char m_driverVersion[64];       // Empty if it could not be read.
+};
+
+// The process-wide WLAN device service, shared by every command so the WLAN session is only set
+// up once.
+//
+SarDeviceService*
+SarWlanDeviceServiceDefault();
+
+#endif // _WIN32
+
+class SarMockDeviceService : public SarDeviceService
+{
+public:
+
+    // latencyMicroseconds simulates the driver's round-trip time on every command.
+    // interfaceIndex distinguishes the interface GUIDs of several mock adapters.
+    //
+    SarMockDeviceService(
+        UINT32 latencyMicroseconds = 0,
+        UINT8 interfaceIndex = 0
+        );
+
+    UINT64
+    CommandCount() const
+    {
+        return m_commandCount;
+    }
+
+    _Check_return_
+    HRESULT
+    Identify(
+        _Out_ SAR_DEVICE_IDENTITY* identity
+        ) override;
+
+protected:
+
+    _Check_return_
+    HRESULT
+    ExecuteCommand(
+        DWORD opcode,
+        _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+        DWORD inSize,
+        _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+        DWORD outSize,
+        _Out_ DWORD* bytesReturned
+        ) override;
+
+private:
+
+    std::mutex m_lock;
+    UINT32 m_latencyMicroseconds;
+    UINT8 m_interfaceIndex;
+    UINT64 m_commandCount;
+    WDI_SAR_STATE m_state;
+    std::vector<WDI_SAR_CONFIG_SET> m_configSets;
+};
+
+// Encodes the WDI_SET_SAR_STATE input: a WDI_SAR_STATE followed by its pairs.  Returns
+// E_INVALIDARG for more than SAR_WIFI_MAX_CONFIG_SETS pairs.
+//
+_Check_return_
+HRESULT
+SarWifiBuildSetSarState(
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_ std::vector<UINT8>* buffer
+    );
+
+// Sends WDI_SET_SAR_STATE with any number of pairs (up to SAR_WIFI_MAX_CONFIG_SETS) in one
+// request.  pResult, if specified, receives the WDI_SAR_RESULT the driver returned.
+//
+_Check_return_
+HRESULT
+SarWifiSetSarState(
+    _In_ SarDeviceService* device,
+    WDI_SAR_BACKOFF_STATE backoffState,
+    UINT32 mimoConfigType,
+    _In_reads_(configSetCount) const WDI_SAR_CONFIG_SET* configSets,
+    UINT32 configSetCount,
+    _Out_opt_ WDI_SAR_RESULT* pResult
+    );
+
+// Sends a request built by SarWifiBuildSetSarState, e.g. the same request to several interfaces.
+//
+_Check_return_
+HRESULT
+SarWifiSendSetSarState(
+    _In_ SarDeviceService* device,
+    const std::vector<UINT8>& request,
+    _Out_opt_ WDI_SAR_RESULT* pResult
+    );
+
+// Sends WDI_GET_SAR_STATE and decodes the state and all NumWdiSarConfigElements of its pairs.
+//
+_Check_return_
+HRESULT
+SarWifiGetSarState(
+    _In_ SarDeviceService* device,
+    _Out_ WDI_SAR_STATE* state,
+    _Out_ std::vector<WDI_SAR_CONFIG_SET>* configSets
+    );
+
+// Sends WDI_GET_INTERFACE_VERSION.  Returns S_FALSE with version 0.0 if the driver does not
+// support the opcode.
+//
+_Check_return_
+HRESULT
+SarWifiGetInterfaceVersion(
+    _In_ SarDeviceService* device,
+    _Out_ SAR_INTERFACE_VERSION* version
+    );
+
+// eof: SarDeviceService.h
+//
@@ -0,0 +1,909 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarEventLog.cpp
+
+Abstract:
+
+    Rotating binary log of unsolicited SAR events, and its decoder.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarEventLog.h"
+#include "SarCodec.h"
+#include "SarMappedFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+// Type byte, delta, opcode and blob size at their longest.
+//
+static const UINT32 SAR_EVENT_LOG_MAX_RECORD = 1 + 10 + 5 + 5 + SAR_EVENT_LOG_MAX_BLOB;
+
+static const char SAR_EVENT_LOG_EXTENSION[] = ".sarlog";
+
+static
+UINT32
+SarEncodeVarint(
+    _Out_writes_(10) UINT8* p,
+    UINT64 value
+    )
+{
+    UINT32 length = 0;
+
+    while (value >= 0x80)
+    {
+        p[length++] = (UINT8)(value | 0x80);
+        value >>= 7;
+    }
+    p[length++] = (UINT8)value;
+
+    return length;
+}
+
+static
+BOOL
+SarDecodeVarint(
+    _In_reads_(size) const UINT8* data,
+    size_t size,
+    _Inout_ size_t* offset,
+    _Out_ UINT64* value
+    )
+{
+    UINT64 result = 0;
+
+    for (UINT32 shift = 0; (shift < 64) && (*offset < size); shift += 7)
+    {
+        UINT8 byte = data[(*offset)++];
+
+        result |= (UINT64)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+UINT64
+SarEventLogNow()
+{
+    return (UINT64)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string
+SarEventLogSegmentPath(
+    _In_z_ LPCSTR basePath,
+    UINT32 slot
+    )
+{
+    return std::string(basePath) + "." + std::to_string(slot) + SAR_EVENT_LOG_EXTENSION;
+}
+
+static
+BOOL
+SarEventLogReadHeader(
+    _In_z_ LPCSTR path,
+    _Out_ UINT64* pSequence
+    )
+{
+    FILE* file = fopen(path, "rb");
+    UINT8 header[sizeof(SAR_EVENT_LOG_SEGMENT_HEADER)];
+    BOOL fValid = FALSE;
+
+    if (file == nullptr)
+    {
+        return FALSE;
+    }
+
+    if ((fread(header, 1, sizeof(header), file) == sizeof(header)) &&
+        (SarLoadLe32(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Signature)) == SAR_EVENT_LOG_SIGNATURE))
+    {
+        *pSequence = SarLoadLe64(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Sequence));
+        fValid = TRUE;
+    }
+
+    fclose(file);
+    return fValid;
+}
+
+SarEventLogWriter::SarEventLogWriter() :
+    m_segmentSize(0),
+    m_segmentCount(0),
+    m_file(nullptr),
+    m_nextSequence(0),
+    m_segmentUsed(0),
+    m_lastTimestamp(0),
+    m_eventCount(0),
+    m_segmentsWritten(0),
+    m_bufferUsed(0)
+{
+}
+
+SarEventLogWriter::~SarEventLogWriter()
+{
+    Close();
+}
+
+_Check_return_
+HRESULT
+SarEventLogWriter::Open(
+    _In_z_ LPCSTR basePath,
+    UINT32 segmentSize,
+    UINT32 segmentCount
+    )
+/*++
+
+Routine Description:
+
+    Prepares to log to basePath.  The existing segments are scanned so a restarted monitor carries
+    on after the newest one (overwriting the oldest) rather than starting again at slot 0.  The
+    first segment file is opened by the first Append.
+
+Arguments:
+
+    basePath - Path and name prefix of the segment files.
+    segmentSize - Bytes per segment file.
+    segmentCount - Number of segment files kept.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for an unusable size or count.
+
+--*/
+{
+    UINT64 sequence;
+    BOOL fFound = FALSE;
+
+    if ((segmentSize < SAR_EVENT_LOG_MIN_SEGMENT_SIZE) ||
+        (segmentCount == 0) ||
+        (segmentCount > SAR_EVENT_LOG_MAX_SEGMENT_COUNT))
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_basePath = basePath;
+    m_segmentSize = segmentSize;
+    m_segmentCount = segmentCount;
+    m_nextSequence = 0;
+    m_eventCount = 0;
+    m_segmentsWritten = 0;
+    m_buffer.resize(SAR_EVENT_LOG_BUFFER_SIZE);
+    m_bufferUsed = 0;
+
+    for (UINT32 slot = 0; slot < segmentCount; slot++)
+    {
+        if (SarEventLogReadHeader(SarEventLogSegmentPath(basePath, slot).c_str(), &sequence) &&
+            (!fFound || (sequence >= m_nextSequence)))
+        {
+            m_nextSequence = sequence + 1;
+            fFound = TRUE;
+        }
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEventLogWriter::WriteBuffer()
+{
+    HRESULT hr = S_OK;
+
+    if ((m_bufferUsed != 0) && (fwrite(m_buffer.data(), 1, m_bufferUsed, m_file) != m_bufferUsed))
+    {
+        hr = SarHresultFromErrno(errno);
+        if (SUCCEEDED(hr))
+        {
+            hr = E_FAIL;
+        }
+    }
+
+    m_bufferUsed = 0;
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarEventLogWriter::Rotate(
+    UINT64 timestamp
+    )
+/*++
+
+Routine Description:
+
+    Finishes the open segment and truncates the slot of the next one, which holds the oldest
+    segment once the ring has wrapped.
+
+Arguments:
+
+    timestamp - The first event of the new segment; becomes its BaseTimestamp.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::string path;
+    UINT8* header;
+
+    if (m_file != nullptr)
+    {
+        hr = WriteBuffer();
+        fclose(m_file);
+        m_file = nullptr;
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    path = SarEventLogSegmentPath(m_basePath.c_str(), (UINT32)(m_nextSequence % m_segmentCount));
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    header = m_buffer.data();
+    memset(header, 0, sizeof(SAR_EVENT_LOG_SEGMENT_HEADER));
+    SarStoreLe32(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Signature), SAR_EVENT_LOG_SIGNATURE);
+    SarStoreLe16(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Version), SAR_EVENT_LOG_VERSION);
+    SarStoreLe16(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, HeaderSize), sizeof(SAR_EVENT_LOG_SEGMENT_HEADER));
+    SarStoreLe32(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, SegmentSize), m_segmentSize);
+    SarStoreLe64(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Sequence), m_nextSequence);
+    SarStoreLe64(header + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, BaseTimestamp), timestamp);
+
+    m_bufferUsed = sizeof(SAR_EVENT_LOG_SEGMENT_HEADER);
+    m_segmentUsed = sizeof(SAR_EVENT_LOG_SEGMENT_HEADER);
+    m_lastTimestamp = timestamp;
+    m_nextSequence++;
+    m_segmentsWritten++;
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarEventLogWriter::Append(
+    SAR_EVENT_TYPE type,
+    UINT64 timestamp,
+    UINT32 opcode,
+    _In_reads_bytes_opt_(blobSize) const VOID* blob,
+    UINT32 blobSize
+    )
+/*++
+
+Routine Description:
+
+    Encodes one event into the buffer, rotating first if it would not fit in the open segment.
+    Timestamps that go backwards (e.g. the wall clock was set back) are logged as a zero delta.
+
+Arguments:
+
+    type - The kind of event.
+    timestamp - When it happened, in UTC microseconds since 1970 (see SarEventLogNow.)
+    opcode - The notification code or transmission state.
+    blob - The event data, if any.
+    blobSize - Size of blob, at most SAR_EVENT_LOG_MAX_BLOB.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for a bad event, E_UNEXPECTED if the log is not open, or
+    underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 record[SAR_EVENT_LOG_MAX_RECORD];
+    UINT32 length;
+
+    if ((type == 0) || (type >= SarEventTypeMax) || (blobSize > SAR_EVENT_LOG_MAX_BLOB) ||
+        ((blob == nullptr) && (blobSize != 0)))
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_buffer.empty())
+    {
+        hr = E_UNEXPECTED;
+        goto exit;
+    }
+
+    for (;;)
+    {
+        if (m_file == nullptr)
+        {
+            hr = Rotate(timestamp);
+            if (FAILED(hr))
+            {
+                goto exit;
+            }
+        }
+
+        if (timestamp < m_lastTimestamp)
+        {
+            timestamp = m_lastTimestamp;
+        }
+
+        length = 0;
+        record[length++] = (UINT8)type;
+        length += SarEncodeVarint(record + length, timestamp - m_lastTimestamp);
+        length += SarEncodeVarint(record + length, opcode);
+        length += SarEncodeVarint(record + length, blobSize);
+        if (blobSize != 0)
+        {
+            memcpy(record + length, blob, blobSize);
+            length += blobSize;
+        }
+
+        if (m_segmentUsed + length <= m_segmentSize)
+        {
+            break;
+        }
+
+        // Segment full: the record is re-encoded against the new segment's base timestamp.
+        hr = Rotate(timestamp);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    if (m_bufferUsed + length > m_buffer.size())
+    {
+        hr = WriteBuffer();
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    memcpy(m_buffer.data() + m_bufferUsed, record, length);
+    m_bufferUsed += length;
+    m_segmentUsed += length;
+    m_lastTimestamp = timestamp;
+    m_eventCount++;
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarEventLogWriter::Flush()
+{
+    HRESULT hr = S_OK;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_file != nullptr)
+    {
+        hr = WriteBuffer();
+        fflush(m_file);
+    }
+
+    return hr;
+}
+
+VOID
+SarEventLogWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_file != nullptr)
+    {
+        (VOID)WriteBuffer();
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+SarEventLogReader::SarEventLogReader() :
+    m_data(nullptr),
+    m_size(0),
+    m_offset(0),
+    m_timestamp(0)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+_Check_return_
+HRESULT
+SarEventLogReader::Attach(
+    _In_reads_bytes_(size) const UINT8* data,
+    size_t size
+    )
+{
+    if ((size < sizeof(SAR_EVENT_LOG_SEGMENT_HEADER)) ||
+        (SarLoadLe32(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Signature)) != SAR_EVENT_LOG_SIGNATURE))
+    {
+        return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+    }
+
+    m_header.Signature = SAR_EVENT_LOG_SIGNATURE;
+    m_header.Version = SarLoadLe16(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Version));
+    m_header.HeaderSize = SarLoadLe16(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, HeaderSize));
+    m_header.SegmentSize = SarLoadLe32(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, SegmentSize));
+    m_header.Reserved = 0;
+    m_header.Sequence = SarLoadLe64(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, Sequence));
+    m_header.BaseTimestamp = SarLoadLe64(data + offsetof(SAR_EVENT_LOG_SEGMENT_HEADER, BaseTimestamp));
+
+    if ((m_header.Version != SAR_EVENT_LOG_VERSION) ||
+        (m_header.HeaderSize < sizeof(SAR_EVENT_LOG_SEGMENT_HEADER)) ||
+        (m_header.HeaderSize > size))
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    m_data = data;
+    m_size = size;
+    m_offset = m_header.HeaderSize;
+    m_timestamp = m_header.BaseTimestamp;
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEventLogReader::Next(
+    _Out_ SAR_EVENT* event
+    )
+{
+    size_t offset = m_offset;
+    UINT64 delta;
+    UINT64 opcode;
+    UINT64 blobSize;
+    UINT8 type;
+
+    // A segment ends at the end of the file, or at zero fill if the file was preallocated.
+    if ((offset >= m_size) || (m_data[offset] == 0))
+    {
+        return S_FALSE;
+    }
+
+    type = m_data[offset++];
+
+    if ((type >= SarEventTypeMax) ||
+        !SarDecodeVarint(m_data, m_size, &offset, &delta) ||
+        !SarDecodeVarint(m_data, m_size, &offset, &opcode) ||
+        !SarDecodeVarint(m_data, m_size, &offset, &blobSize) ||
+        (opcode > 0xFFFFFFFF) ||
+        (blobSize > SAR_EVENT_LOG_MAX_BLOB) ||
+        (blobSize > m_size - offset))
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    m_timestamp += delta;
+
+    event->Timestamp = m_timestamp;
+    event->Type = (SAR_EVENT_TYPE)type;
+    event->Opcode = (UINT32)opcode;
+    event->Blob = m_data + offset;
+    event->BlobSize = (UINT32)blobSize;
+
+    m_offset = offset + (size_t)blobSize;
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarEventLogTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ LPCSTR* basePath
+    )
+{
+    HRESULT hr = S_OK;
+    int kept = 0;
+
+    *basePath = nullptr;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--log")))
+        {
+            if (i + 1 < *argc)
+            {
+                *basePath = argv[i + 1];
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+
+            i++;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return hr;
+}
+
+static const char s_hexDigits[] = "0123456789abcdef";
+
+static
+char*
+SarFormatDigits(
+    _Out_writes_(width) char* p,
+    UINT32 value,
+    UINT32 width
+    )
+{
+    for (UINT32 i = width; i > 0; i--)
+    {
+        p[i - 1] = (char)('0' + (value % 10));
+        value /= 10;
+    }
+
+    return p + width;
+}
+
+static
+VOID
+SarAppendTimestamp(
+    _Inout_ std::string* output,
+    UINT64 timestamp
+    )
+/*++
+
+Routine Description:
+
+    Appends an ISO 8601 UTC time with microseconds, e.g. 2024-01-31T23:59:59.123456Z.  The date
+    is computed directly from the day number (proleptic Gregorian) rather than through gmtime,
+    which is neither thread-safe nor fast.
+
+--*/
+{
+    char text[32];
+    char* p = text;
+    UINT64 seconds = timestamp / 1000000;
+    INT64 days = (INT64)(seconds / 86400);
+    UINT32 secondOfDay = (UINT32)(seconds % 86400);
+
+    // Shift the epoch to 0000-03-01 so leap days fall at the end of each 400-year era.
+    INT64 z = days + 719468;
+    INT64 era = z / 146097;
+    UINT32 dayOfEra = (UINT32)(z - era * 146097);
+    UINT32 yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    UINT32 dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    UINT32 monthIndex = (5 * dayOfYear + 2) / 153;
+    UINT32 day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    UINT32 month = (monthIndex < 10) ? monthIndex + 3 : monthIndex - 9;
+    UINT32 year = (UINT32)(yearOfEra + era * 400) + ((month <= 2) ? 1 : 0);
+
+    p = SarFormatDigits(p, year, 4);
+    *p++ = '-';
+    p = SarFormatDigits(p, month, 2);
+    *p++ = '-';
+    p = SarFormatDigits(p, day, 2);
+    *p++ = 'T';
+    p = SarFormatDigits(p, secondOfDay / 3600, 2);
+    *p++ = ':';
+    p = SarFormatDigits(p, (secondOfDay / 60) % 60, 2);
+    *p++ = ':';
+    p = SarFormatDigits(p, secondOfDay % 60, 2);
+    *p++ = '.';
+    p = SarFormatDigits(p, (UINT32)(timestamp % 1000000), 6);
+    *p++ = 'Z';
+
+    output->append(text, p - text);
+}
+
+static
+VOID
+SarAppendHex(
+    _Inout_ std::string* output,
+    _In_reads_(size) const UINT8* data,
+    UINT32 size
+    )
+{
+    for (UINT32 i = 0; i < size; i++)
+    {
+        output->push_back(s_hexDigits[data[i] >> 4]);
+        output->push_back(s_hexDigits[data[i] & 0xf]);
+    }
+}
+
+static
+VOID
+SarAppendEvent(
+    _Inout_ std::string* output,
+    _In_ const SAR_EVENT* event,
+    BOOL fCsv
+    )
+/*++
+
+Routine Description:
+
+    Appends one event as a line of text, e.g.
+
+        2024-01-31T23:59:59.123456Z wlan-sar opcode=0x1 size=2 data=0100
+        2024-01-31T23:59:59.123456Z wlan service={...} opcode=0x5 size=4 data=01020304
+        2024-01-31T23:59:59.123456Z lte-tx transmitting
+
+    or as a CSV row of timestamp,event,service,opcode,size,data.
+
+--*/
+{
+    const UINT8* data = event->Blob;
+    UINT32 size = event->BlobSize;
+    char service[40] = "";
+    char number[32];
+    LPCSTR name;
+
+    switch (event->Type)
+    {
+    case SarEventWlanSarRequest:
+        name = "wlan-sar";
+        break;
+
+    case SarEventWlanNotification:
+        name = "wlan";
+        if (size >= 16)
+        {
+            snprintf(service, sizeof(service),
+                     "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+                     SarLoadLe32(data), SarLoadLe16(data + 4), SarLoadLe16(data + 6),
+                     data[8], data[9], data[10], data[11], data[12], data[13], data[14], data[15]);
+            data += 16;
+            size -= 16;
+        }
+        break;
+
+    default:
+        name = "lte-tx";
+        break;
+    }
+
+    SarAppendTimestamp(output, event->Timestamp);
+
+    if (fCsv)
+    {
+        snprintf(number, sizeof(number), ",0x%x,%u,", event->Opcode, size);
+        output->push_back(',');
+        output->append(name);
+        output->push_back(',');
+        output->append(service);
+        output->append(number);
+        SarAppendHex(output, data, size);
+    }
+    else if (event->Type == SarEventLteTransmissionState)
+    {
+        output->append(event->Opcode ? " lte-tx transmitting" : " lte-tx not transmitting");
+    }
+    else
+    {
+        output->push_back(' ');
+        output->append(name);
+        if (service[0] != '\0')
+        {
+            output->append(" service=");
+            output->append(service);
+        }
+        snprintf(number, sizeof(number), " opcode=0x%x size=%u data=", event->Opcode, size);
+        output->append(number);
+        SarAppendHex(output, data, size);
+    }
+
+    output->push_back('\n');
+}
+
+static
+BOOL
+SarEventLogIsSegmentPath(
+    _In_z_ LPCSTR path
+    )
+{
+    size_t length = strlen(path);
+    size_t extension = sizeof(SAR_EVENT_LOG_EXTENSION) - 1;
+
+    return (length > extension) && (0 == _stricmp(path + length - extension, SAR_EVENT_LOG_EXTENSION));
+}
+
+_Check_return_
+HRESULT
+SarEventLogDecode(
+    _In_z_ LPCSTR path,
+    BOOL fCsv,
+    _In_ FILE* stream,
+    _Out_opt_ UINT64* pEventCount
+    )
+/*++
+
+Routine Description:
+
+    Decodes a whole log (or a single segment) oldest segment first.  Each segment is mapped, decoded
+    into a text buffer that is written out every SAR_EVENT_LOG_BUFFER_SIZE bytes, and unmapped
+    before the next, so memory stays constant however large the log is.  A damaged segment is
+    reported on stderr and skipped from the damaged record on.
+
+Arguments:
+
+    path - The log's base path, or the path of one .sarlog segment.
+    fCsv - TRUE for CSV, FALSE for text.
+    stream - Receives the decoded events.
+    pEventCount - Optionally receives the number of events decoded.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if there are no segments, or
+    underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<std::pair<UINT64, std::string>> segments;
+    std::string output;
+    UINT64 eventCount = 0;
+    UINT64 sequence;
+
+    if (SarEventLogIsSegmentPath(path))
+    {
+        segments.emplace_back(0, path);
+    }
+    else
+    {
+        // Slots are filled in order, so the first missing one ends the log.
+        for (UINT32 slot = 0; slot < SAR_EVENT_LOG_MAX_SEGMENT_COUNT; slot++)
+        {
+            std::string segmentPath = SarEventLogSegmentPath(path, slot);
+
+            if (!SarEventLogReadHeader(segmentPath.c_str(), &sequence))
+            {
+                break;
+            }
+            segments.emplace_back(sequence, segmentPath);
+        }
+
+        if (segments.empty())
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+            goto exit;
+        }
+
+        std::sort(segments.begin(), segments.end());
+    }
+
+    output.reserve(SAR_EVENT_LOG_BUFFER_SIZE + SAR_EVENT_LOG_MAX_RECORD * 2 + 256);
+
+    if (fCsv)
+    {
+        output.append("timestamp,event,service,opcode,size,data\n");
+    }
+
+    for (const auto& segment : segments)
+    {
+        SarMappedFile mappedFile;
+        SarEventLogReader reader;
+        SAR_EVENT event;
+        HRESULT hrNext;
+
+        hr = mappedFile.Open(segment.second.c_str());
+        if (SUCCEEDED(hr))
+        {
+            hr = reader.Attach(mappedFile.Data(), mappedFile.Size());
+        }
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+
+        while ((hrNext = reader.Next(&event)) == S_OK)
+        {
+            SarAppendEvent(&output, &event, fCsv);
+            eventCount++;
+
+            if (output.size() >= SAR_EVENT_LOG_BUFFER_SIZE)
+            {
+                fwrite(output.data(), 1, output.size(), stream);
+                output.clear();
+            }
+        }
+
+        if (FAILED(hrNext))
+        {
+            fprintf(stderr, "%s: damaged record after %llu events; skipping the rest of the segment\n",
+                    segment.second.c_str(),
+                    (unsigned long long)eventCount);
+        }
+    }
+
+    fwrite(output.data(), 1, output.size(), stream);
+    fflush(stream);
+
+exit:
+    if (pEventCount != nullptr)
+    {
+        *pEventCount = eventCount;
+    }
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarEventLogDecodeCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Decodes a log to stdout and reports the number of events on stderr.
+
+Arguments:
+
+    argc - Count of arguments after "decodelog".
+    argv - The log's base path or a segment, optionally followed by "text" or "csv".
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG for bad arguments, or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    BOOL fCsv = FALSE;
+    UINT64 eventCount = 0;
+
+    if ((argc < 1) || (argc > 2))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (argc == 2)
+    {
+        if (0 == _stricmp(argv[1], "csv"))
+        {
+            fCsv = TRUE;
+        }
+        else if (0 != _stricmp(argv[1], "text"))
+        {
+            hr = E_INVALIDARG;
+            goto exit;
+        }
+    }
+
+    hr = SarEventLogDecode(argv[0], fCsv, stdout, &eventCount);
+    if (FAILED(hr))
+    {
+        fprintf(stderr, "Failed to decode %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    fprintf(stderr, "Decoded %llu events.\n", (unsigned long long)eventCount);
+
+exit:
+    return hr;
+}
+
+// eof: SarEventLog.cpp
+//
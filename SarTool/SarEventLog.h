@@ -0,0 +1,256 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarEventLog.h
+
+Abstract:
+
+    Compact binary log of unsolicited SAR events, for monitors that run for days.
+
+    The log is a ring of fixed-size segment files, <base>.<slot>.sarlog, written in turn; when the
+    current segment is full the writer reopens the oldest slot, so the log never takes more than
+    SegmentSize * SegmentCount bytes of disk and one fixed buffer of memory.  Every segment is
+    self-contained and can be decoded on its own:
+
+        SAR_EVENT_LOG_SEGMENT_HEADER
+        record, record, ...
+
+    A record is a type byte followed by LEB128 varints:
+
+        Type                    SAR_EVENT_TYPE (never 0)
+        TimestampDelta          Microseconds since the previous record (or the segment's BaseTimestamp)
+        Opcode                  Notification code, or 1/0 for transmitting/not transmitting
+        BlobSize, Blob          Notification data (prefixed with the device service GUID for
+                                SarEventWlanNotification)
+
+    so a Wi-Fi SAR request takes about 8 bytes.  A record never spans segments, and a record torn
+    by a crash ends the segment for the decoder.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const UINT32 SAR_EVENT_LOG_SIGNATURE = 0x4c524153;   // "SARL"
+static const UINT16 SAR_EVENT_LOG_VERSION = 1;
+
+static const UINT32 SAR_EVENT_LOG_DEFAULT_SEGMENT_SIZE = 1024 * 1024;
+static const UINT32 SAR_EVENT_LOG_DEFAULT_SEGMENT_COUNT = 8;
+static const UINT32 SAR_EVENT_LOG_MIN_SEGMENT_SIZE = 4096;
+static const UINT32 SAR_EVENT_LOG_MAX_SEGMENT_COUNT = 1024;
+
+// Largest blob one record carries, and the bytes buffered between writes to the segment file.
+//
+static const UINT32 SAR_EVENT_LOG_MAX_BLOB = 1024;
+static const UINT32 SAR_EVENT_LOG_BUFFER_SIZE = 64 * 1024;
+
+typedef enum _SAR_EVENT_TYPE
+{
+    SarEventWlanSarRequest = 1,         // WDI SAR device service notification.
+    SarEventWlanNotification = 2,       // Any other device service; the blob starts with its GUID.
+    SarEventLteTransmissionState = 3,   // MobileBroadbandSarManager TransmissionStateChanged.
+    SarEventTypeMax
+} SAR_EVENT_TYPE;
+
+#pragma pack(push, 1)
+typedef struct _SAR_EVENT_LOG_SEGMENT_HEADER
+{
+    UINT32 Signature;
+    UINT16 Version;
+    UINT16 HeaderSize;
+    UINT32 SegmentSize;
+    UINT32 Reserved;
+    UINT64 Sequence;                    // Increases by one per segment written, across restarts.
+    UINT64 BaseTimestamp;               // UTC microseconds since 1970.
+} SAR_EVENT_LOG_SEGMENT_HEADER;
+#pragma pack(pop)
+
+C_ASSERT(sizeof(SAR_EVENT_LOG_SEGMENT_HEADER) == 32);
+
+typedef struct _SAR_EVENT
+{
+    UINT64 Timestamp;                   // UTC microseconds since 1970.
+    SAR_EVENT_TYPE Type;
+    UINT32 Opcode;
+    const UINT8* Blob;                  // Points into the segment being decoded.
+    UINT32 BlobSize;
+} SAR_EVENT;
+
+class SarEventLogWriter
+{
+public:
+
+    SarEventLogWriter();
+    ~SarEventLogWriter();
+
+    SarEventLogWriter(const SarEventLogWriter&) = delete;
+    SarEventLogWriter& operator=(const SarEventLogWriter&) = delete;
+
+    // Continues after the newest segment already present for basePath, if any.
+    //
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR basePath,
+        UINT32 segmentSize = SAR_EVENT_LOG_DEFAULT_SEGMENT_SIZE,
+        UINT32 segmentCount = SAR_EVENT_LOG_DEFAULT_SEGMENT_COUNT
+        );
+
+    // Buffers one event; safe to call from any thread.  The event reaches the file when the
+    // buffer fills, the segment rotates, or Flush is called.
+    //
+    _Check_return_
+    HRESULT
+    Append(
+        SAR_EVENT_TYPE type,
+        UINT64 timestamp,
+        UINT32 opcode,
+        _In_reads_bytes_opt_(blobSize) const VOID* blob,
+        UINT32 blobSize
+        );
+
+    _Check_return_
+    HRESULT
+    Flush();
+
+    VOID
+    Close();
+
+    UINT64
+    EventCount() const
+    {
+        return m_eventCount;
+    }
+
+    UINT64
+    SegmentsWritten() const
+    {
+        return m_segmentsWritten;
+    }
+
+private:
+
+    _Check_return_
+    HRESULT
+    Rotate(
+        UINT64 timestamp
+        );
+
+    _Check_return_
+    HRESULT
+    WriteBuffer();
+
+    std::mutex m_lock;
+    std::string m_basePath;
+    UINT32 m_segmentSize;
+    UINT32 m_segmentCount;
+    FILE* m_file;
+    UINT64 m_nextSequence;
+    UINT32 m_segmentUsed;               // Bytes of the open segment, including the buffer.
+    UINT64 m_lastTimestamp;
+    UINT64 m_eventCount;
+    UINT64 m_segmentsWritten;
+    std::vector<UINT8> m_buffer;        // SAR_EVENT_LOG_BUFFER_SIZE bytes, allocated by Open.
+    UINT32 m_bufferUsed;
+};
+
+// Iterates over the records of one segment held in memory.
+//
+class SarEventLogReader
+{
+public:
+
+    SarEventLogReader();
+
+    _Check_return_
+    HRESULT
+    Attach(
+        _In_reads_bytes_(size) const UINT8* data,
+        size_t size
+        );
+
+    const SAR_EVENT_LOG_SEGMENT_HEADER*
+    Header() const
+    {
+        return &m_header;
+    }
+
+    // Returns S_OK with the next event, S_FALSE at the end of the segment, or
+    // HRESULT_FROM_WIN32(ERROR_INVALID_DATA) at a torn or corrupt record.
+    //
+    _Check_return_
+    HRESULT
+    Next(
+        _Out_ SAR_EVENT* event
+        );
+
+private:
+
+    SAR_EVENT_LOG_SEGMENT_HEADER m_header;
+    const UINT8* m_data;
+    size_t m_size;
+    size_t m_offset;
+    UINT64 m_timestamp;
+};
+
+// The current time as a SAR_EVENT timestamp.
+//
+UINT64
+SarEventLogNow();
+
+// Path of the segment file in a slot.
+//
+std::string
+SarEventLogSegmentPath(
+    _In_z_ LPCSTR basePath,
+    UINT32 slot
+    );
+
+// Removes "--log <base path>" from the command line.  *basePath receives the base path, or
+// nullptr if the option was not given.  Returns E_INVALIDARG if the path is missing.
+//
+_Check_return_
+HRESULT
+SarEventLogTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ LPCSTR* basePath
+    );
+
+// Implements "decodelog {<base path> | <segment>.sarlog} [csv]": writes every event of the log,
+// oldest first, to stdout as text or CSV.  argv starts after "decodelog".  Returns E_INVALIDARG
+// for bad arguments so the caller can print its usage.
+//
+_Check_return_
+HRESULT
+SarEventLogDecodeCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// Decodes every segment of the log into stream in the given format; used by SarEventLogDecodeCommand.
+//
+_Check_return_
+HRESULT
+SarEventLogDecode(
+    _In_z_ LPCSTR path,
+    BOOL fCsv,
+    _In_ FILE* stream,
+    _Out_opt_ UINT64* pEventCount
+    );
+
+// eof: SarEventLog.h
+//
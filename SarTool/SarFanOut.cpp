@@ -0,0 +1,321 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarFanOut.cpp
+
+Abstract:
+
+    Interface sets and the fan-out of Wi-Fi SAR requests to every WLAN interface.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarFanOut.h"
+#include "SarStats.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <wlanapi.h>
+#endif
+
+#ifdef _WIN32
+
+static
+VOID
+WINAPI
+SarWlanInterfaceSetNotification(
+    _In_ PWLAN_NOTIFICATION_DATA pNotData,
+    _In_opt_ PVOID pCtxt
+    )
+/*++
+
+Routine Description:
+
+    WLAN notification callback: an interface arriving or leaving makes the set enumerate again.
+
+Arguments:
+
+    pNotData - The notification.
+    pCtxt - The SarWlanInterfaceSet.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    if ((pCtxt != nullptr) &&
+        (pNotData->NotificationSource == WLAN_NOTIFICATION_SOURCE_ACM) &&
+        ((pNotData->NotificationCode == wlan_notification_acm_interface_arrival) ||
+         (pNotData->NotificationCode == wlan_notification_acm_interface_removal)))
+    {
+        ((SarWlanInterfaceSet*)pCtxt)->Invalidate();
+    }
+}
+
+SarWlanInterfaceSet::SarWlanInterfaceSet() :
+    m_hClient(NULL),
+    m_fStale(TRUE)
+{
+}
+
+SarWlanInterfaceSet::~SarWlanInterfaceSet()
+{
+    if (m_hClient != NULL)
+    {
+        (VOID)WlanRegisterNotification(m_hClient, WLAN_NOTIFICATION_SOURCE_NONE, TRUE, NULL, NULL, NULL, NULL);
+        WlanCloseHandle(m_hClient, NULL);
+    }
+}
+
+_Check_return_
+HRESULT
+SarWlanInterfaceSet::Enumerate(
+    _Out_ std::vector<SAR_WIFI_INTERFACE>* interfaces
+    )
+/*++
+
+Routine Description:
+
+    Returns the cached interfaces, enumerating them if this is the first use or an interface has
+    arrived or left since.
+
+Arguments:
+
+    interfaces - Receives the interfaces.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_NOT_FOUND) if there are no WLAN interfaces, or the
+    underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    DWORD dwMaxClient = 2;
+    DWORD dwCurVersion = 0;
+    DWORD dwResult = 0;
+    PWLAN_INTERFACE_INFO_LIST pInterfaceList = NULL;
+    std::vector<SAR_WIFI_INTERFACE> enumerated;
+    UINT64 start;
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    interfaces->clear();
+
+    if (m_hClient == NULL)
+    {
+        start = SarStatsNow();
+        dwResult = WlanOpenHandle(dwMaxClient, NULL, &dwCurVersion, &m_hClient);
+        SarStatsRecord(SarStatWlanOpenHandle, start);
+        if (dwResult != ERROR_SUCCESS)
+        {
+            m_hClient = NULL;
+            hr = HRESULT_FROM_WIN32(dwResult);
+            goto exit;
+        }
+
+        // Without the notifications the set is still refreshed when a command finds its
+        // interface gone.
+        (VOID)WlanRegisterNotification(m_hClient,
+                                       WLAN_NOTIFICATION_SOURCE_ACM,
+                                       TRUE,
+                                       SarWlanInterfaceSetNotification,
+                                       this,
+                                       NULL,
+                                       NULL);
+        m_fStale = TRUE;
+    }
+
+    // Clear the flag first, so an interface arriving during the enumeration repeats it next time.
+    if (m_fStale.exchange(FALSE))
+    {
+        start = SarStatsNow();
+        dwResult = WlanEnumInterfaces(m_hClient, nullptr, &pInterfaceList);
+        SarStatsRecord(SarStatWlanEnumInterfaces, start);
+        if (dwResult != ERROR_SUCCESS)
+        {
+            m_fStale = TRUE;
+            hr = HRESULT_FROM_WIN32(dwResult);
+            goto exit;
+        }
+
+        for (DWORD i = 0; i < pInterfaceList->dwNumberOfItems; i++)
+        {
+            SAR_WIFI_INTERFACE wifiInterface;
+
+            wifiInterface.InterfaceGuid = pInterfaceList->InterfaceInfo[i].InterfaceGuid;
+
+            for (const SAR_WIFI_INTERFACE& known : m_interfaces)
+            {
+                if (0 == memcmp(&known.InterfaceGuid, &wifiInterface.InterfaceGuid, sizeof(GUID)))
+                {
+                    wifiInterface.Device = known.Device;
+                    break;
+                }
+            }
+
+            if (!wifiInterface.Device)
+            {
+                wifiInterface.Device = std::make_shared<SarWlanDeviceService>(wifiInterface.InterfaceGuid);
+            }
+
+            enumerated.push_back(wifiInterface);
+        }
+
+        m_interfaces.swap(enumerated);
+    }
+
+    if (m_interfaces.empty())
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+        goto exit;
+    }
+
+    *interfaces = m_interfaces;
+
+exit:
+    if (pInterfaceList != NULL)
+    {
+        WlanFreeMemory(pInterfaceList);
+    }
+    return hr;
+}
+
+SarInterfaceSet*
+SarWlanInterfaceSetDefault()
+{
+    static SarWlanInterfaceSet s_interfaces;
+    return &s_interfaces;
+}
+
+#endif // _WIN32
+
+SarMockInterfaceSet::SarMockInterfaceSet(
+    UINT32 interfaceCount,
+    UINT32 latencyMicroseconds
+    )
+{
+    for (UINT32 i = 0; (i < interfaceCount) && (i < 255); i++)
+    {
+        SAR_WIFI_INTERFACE wifiInterface;
+        SAR_DEVICE_IDENTITY identity;
+
+        wifiInterface.Device = std::make_shared<SarMockDeviceService>(latencyMicroseconds, (UINT8)i);
+        (VOID)wifiInterface.Device->Identify(&identity);
+        wifiInterface.InterfaceGuid = identity.InterfaceGuid;
+        m_interfaces.push_back(wifiInterface);
+    }
+}
+
+_Check_return_
+HRESULT
+SarMockInterfaceSet::Enumerate(
+    _Out_ std::vector<SAR_WIFI_INTERFACE>* interfaces
+    )
+{
+    *interfaces = m_interfaces;
+    return m_interfaces.empty() ? HRESULT_FROM_WIN32(ERROR_NOT_FOUND) : S_OK;
+}
+
+_Check_return_
+HRESULT
+SarWifiFanOut(
+    _In_ SarInterfaceSet* interfaceSet,
+    const std::vector<SAR_WIFI_INTERFACE>& interfaces,
+    _Inout_ std::unique_ptr<SarThreadPool>* pool,
+    const std::function<HRESULT(size_t index, const SAR_WIFI_INTERFACE& wifiInterface)>& operation,
+    _Out_ std::vector<HRESULT>* results
+    )
+/*++
+
+Routine Description:
+
+    Runs the operation on every interface concurrently and collects each interface's result.
+
+Arguments:
+
+    interfaceSet - The set the interfaces were enumerated from.
+    interfaces - The interfaces.
+    pool - The caller's pool of workers, kept across fan-outs.
+    operation - The request to run on one interface.
+    results - Receives the operation's result for each interface.
+
+Return Value:
+
+    S_OK if the operation succeeded on every interface, otherwise the first interface's failure.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    results->assign(interfaces.size(), S_OK);
+
+    if (interfaces.size() == 1)
+    {
+        (*results)[0] = operation(0, interfaces[0]);
+    }
+    else if (interfaces.size() > 1)
+    {
+        if (!*pool || ((*pool)->ThreadCount() < interfaces.size()))
+        {
+            pool->reset(new SarThreadPool((UINT32)interfaces.size()));
+        }
+
+        (*pool)->ParallelFor(interfaces.size(), [&](size_t i)
+        {
+            (*results)[i] = operation(i, interfaces[i]);
+        });
+    }
+
+    for (HRESULT result : *results)
+    {
+        // The device service retries a stale handle itself; an interface that is still not
+        // found has been removed.
+        if ((result == HRESULT_FROM_WIN32(ERROR_NOT_FOUND)) ||
+            (result == HRESULT_FROM_WIN32(ERROR_INVALID_HANDLE)))
+        {
+            interfaceSet->Invalidate();
+        }
+
+        if (FAILED(result) && SUCCEEDED(hr))
+        {
+            hr = result;
+        }
+    }
+
+    return hr;
+}
+
+BOOL
+SarFanOutTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    )
+{
+    BOOL fFound = FALSE;
+    int kept = 0;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--all")))
+        {
+            fFound = TRUE;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return fFound;
+}
+
+// eof: SarFanOut.cpp
+//
@@ -0,0 +1,177 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarFanOut.h
+
+Abstract:
+
+    Sends the same Wi-Fi SAR request to every WLAN interface at once, for systems with more than
+    one adapter (docks, USB Wi-Fi test rigs.)
+
+    A SarInterfaceSet enumerates the interfaces and keeps a device service for each.  The
+    enumeration is cached between calls, and so is each interface's device service with its WLAN
+    handle, until the set is invalidated:
+
+        SarWlanInterfaceSet     The WLAN interfaces (Windows.)  Invalidated by the interface
+                                arrival and removal notifications of the WLAN auto-configuration
+                                module, and by a command that finds its interface gone.
+        SarMockInterfaceSet     A fixed number of SarMockDeviceService adapters.
+
+    SarWifiFanOut runs a request on a worker per interface, so a fan-out takes as long as the
+    slowest interface rather than the sum of them, and reports each interface's own result.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarDeviceService.h"
+#include "SarThreadPool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One WLAN interface and the device service that sends commands to it.  The set keeps the
+// device service alive for as long as a caller holds the entry, even across an invalidation.
+//
+typedef struct _SAR_WIFI_INTERFACE
+{
+    GUID InterfaceGuid;
+    std::shared_ptr<SarDeviceService> Device;
+} SAR_WIFI_INTERFACE;
+
+class SarInterfaceSet
+{
+public:
+
+    virtual ~SarInterfaceSet() {}
+
+    // Returns the interfaces, enumerating them only if this is the first call or the set has been
+    // invalidated since the last one.  Fails with HRESULT_FROM_WIN32(ERROR_NOT_FOUND) if there
+    // are none.
+    //
+    _Check_return_
+    virtual
+    HRESULT
+    Enumerate(
+        _Out_ std::vector<SAR_WIFI_INTERFACE>* interfaces
+        ) = 0;
+
+    // Makes the next Enumerate enumerate the interfaces again.
+    //
+    virtual
+    VOID
+    Invalidate() = 0;
+};
+
+#ifdef _WIN32
+
+class SarWlanInterfaceSet : public SarInterfaceSet
+{
+public:
+
+    SarWlanInterfaceSet();
+    ~SarWlanInterfaceSet();
+
+    SarWlanInterfaceSet(const SarWlanInterfaceSet&) = delete;
+    SarWlanInterfaceSet& operator=(const SarWlanInterfaceSet&) = delete;
+
+    // Opens a WLAN handle and registers for interface arrival and removal on first use.  A
+    // re-enumeration keeps the device service (and its open WLAN handle) of every interface that
+    // is still present.
+    //
+    _Check_return_
+    HRESULT
+    Enumerate(
+        _Out_ std::vector<SAR_WIFI_INTERFACE>* interfaces
+        ) override;
+
+    VOID
+    Invalidate() override
+    {
+        m_fStale = TRUE;
+    }
+
+private:
+
+    std::mutex m_lock;
+    HANDLE m_hClient;
+    std::atomic<BOOL> m_fStale;
+    std::vector<SAR_WIFI_INTERFACE> m_interfaces;
+};
+
+// The process-wide set of WLAN interfaces, shared by every session so the interfaces are only
+// enumerated when they change.
+//
+SarInterfaceSet*
+SarWlanInterfaceSetDefault();
+
+#endif // _WIN32
+
+class SarMockInterfaceSet : public SarInterfaceSet
+{
+public:
+
+    // interfaceCount mock adapters (at most 255), each simulating latencyMicroseconds per command.
+    //
+    SarMockInterfaceSet(
+        UINT32 interfaceCount,
+        UINT32 latencyMicroseconds = 0
+        );
+
+    _Check_return_
+    HRESULT
+    Enumerate(
+        _Out_ std::vector<SAR_WIFI_INTERFACE>* interfaces
+        ) override;
+
+    // The mock adapters never change.
+    //
+    VOID
+    Invalidate() override
+    {
+    }
+
+private:
+
+    std::vector<SAR_WIFI_INTERFACE> m_interfaces;
+};
+
+// Runs operation(index, interfaces[index]) for every interface enumerated from the set, each on
+// its own worker of *pool (created, or created again with more workers, if it has fewer workers
+// than there are interfaces; a single interface is run on the calling thread.)  operation
+// writes its outcome into the caller's slot [index].
+//
+// results receives each interface's HRESULT.  Returns S_OK if every interface succeeded,
+// otherwise the failure of the first interface that failed.  An interface that has gone away
+// invalidates the set, so the next Enumerate finds the interfaces again.
+//
+_Check_return_
+HRESULT
+SarWifiFanOut(
+    _In_ SarInterfaceSet* interfaceSet,
+    const std::vector<SAR_WIFI_INTERFACE>& interfaces,
+    _Inout_ std::unique_ptr<SarThreadPool>* pool,
+    const std::function<HRESULT(size_t index, const SAR_WIFI_INTERFACE& wifiInterface)>& operation,
+    _Out_ std::vector<HRESULT>* results
+    );
+
+// Removes "--all" from the command line.  Returns TRUE if it was given.
+//
+BOOL
+SarFanOutTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    );
+
+// eof: SarFanOut.h
+//
@@ -0,0 +1,325 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarFields.h
+
+Abstract:
+
+    Compile-time field descriptors for the scalar SAR structs of Dmf_Wlan_Public.h and
+    Wlan_Ihv_Config.h.
+
+    Each struct has one constexpr table giving every field's name, offset, width and how getconfig
+    prints it.  getconfig, the codec, the columnar fleet file and diffconfig are all generated from
+    these tables by the templates below, which unroll over the table at compile time: each field
+    becomes a fixed-width load or store at a constant offset, with no lookup at run time.
+
+    The tables are checked against the struct definitions, so a field added to a struct by a new
+    version of the IHV doc breaks the build until it is described here.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+typedef enum _SAR_FIELD_FORMAT
+{
+    SarFieldHex = 0,                // A number, printed in HexDigits hex digits (0: decimal.)
+    SarFieldCountry,                // GeoCountryString.AsciiChars, printed as its two-letter code.
+    SarFieldHidden,                 // Not printed by getconfig (e.g. reserved halves of a field.)
+} SAR_FIELD_FORMAT;
+
+typedef struct _SAR_FIELD_DESCRIPTOR
+{
+    LPCSTR Name;                    // As getconfig prints it.
+    LPCSTR ColumnName;              // In the columnar fleet file and compile specs.
+    UINT16 Offset;                  // Within the struct; the same on the wire (see SarCodec.h.)
+    UINT8 Width;                    // 1, 2 or 4 bytes.
+    UINT8 HexDigits;
+    SAR_FIELD_FORMAT Format;
+} SAR_FIELD_DESCRIPTOR;
+
+#define SAR_FIELD_NAMED(name, columnName, type, member, format, hexDigits) \
+    { name, columnName, (UINT16)offsetof(type, member), (UINT8)sizeof(((type*)nullptr)->member), hexDigits, format }
+
+#define SAR_FIELD(type, member, format, hexDigits) \
+    SAR_FIELD_NAMED(#member, #member, type, member, format, hexDigits)
+
+// Specialized for each described struct with its Name and its Fields in offset order.
+//
+template <typename T>
+struct SarFieldTable;
+
+template <>
+struct SarFieldTable<SAR_CONFIG_HEADER>
+{
+    static constexpr LPCSTR Name = "SAR_CONFIG_HEADER";
+    static constexpr SAR_FIELD_DESCRIPTOR Fields[] =
+    {
+        SAR_FIELD_NAMED("Size", "Header.Size", SAR_CONFIG_HEADER, Size, SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, HeaderOffset1,       SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, HeaderOffset2,       SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, WLANTechnology,      SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ProductID,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, Version,             SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, Revision,            SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, NumberSARTables,     SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, SARTablesCompressed, SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, SARTimersFormat,     SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedA,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedB,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedC,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedD,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedE,           SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_HEADER, ReservedF,           SarFieldHex, 2),
+    };
+};
+
+template <>
+struct SarFieldTable<SAR_CONFIG_VALUES>
+{
+    static constexpr LPCSTR Name = "SAR_CONFIG_VALUES";
+    static constexpr SAR_FIELD_DESCRIPTOR Fields[] =
+    {
+        SAR_FIELD_NAMED("Size", "Values.Size", SAR_CONFIG_VALUES, Size, SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARSafetyTimer,                  SarFieldHex, 8),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARSafetyRequestResponseTimeout, SarFieldHex, 8),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARUnsolicitedUpdateTimer,       SarFieldHex, 8),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARState,                        SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SleepModeState,                  SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARPowerOnState,                 SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARPowerOnStateAfterFailure,     SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SARSafetyTableIndex,             SarFieldHex, 2),
+        SAR_FIELD(SAR_CONFIG_VALUES, SleepModeStateIndexTable,        SarFieldHex, 2),
+    };
+};
+
+// GeoCountryString is two 16-bit halves; only AsciiChars is printed, as "GeoCountryString".
+//
+template <>
+struct SarFieldTable<REGION_CONFIG_VALUES>
+{
+    static constexpr LPCSTR Name = "REGION_CONFIG_VALUES";
+    static constexpr SAR_FIELD_DESCRIPTOR Fields[] =
+    {
+        SAR_FIELD_NAMED("GeoCountryString", "GeoCountryString", REGION_CONFIG_VALUES, GeoCountryString.AsciiChars, SarFieldCountry, 4),
+        SAR_FIELD_NAMED("GeoCountryString.Reserved", "GeoCountryString.Reserved", REGION_CONFIG_VALUES, GeoCountryString.Reserved, SarFieldHidden, 4),
+        SAR_FIELD(REGION_CONFIG_VALUES, GeoLocationValue, SarFieldHex, 8),
+        SAR_FIELD(REGION_CONFIG_VALUES, DynamicGeoState,  SarFieldHex, 2),
+        SAR_FIELD(REGION_CONFIG_VALUES, DynamicGeoType,   SarFieldHex, 2),
+    };
+};
+
+template <>
+struct SarFieldTable<WDI_SAR_STATE>
+{
+    static constexpr LPCSTR Name = "WDI_SAR_STATE";
+    static constexpr SAR_FIELD_DESCRIPTOR Fields[] =
+    {
+        SAR_FIELD(WDI_SAR_STATE, SarBackoffStatus,        SarFieldHex, 0),
+        SAR_FIELD(WDI_SAR_STATE, MIMOConfigType,          SarFieldHex, 0),
+        SAR_FIELD(WDI_SAR_STATE, NumWdiSarConfigElements, SarFieldHex, 0),
+    };
+};
+
+template <>
+struct SarFieldTable<WDI_SAR_CONFIG_SET>
+{
+    static constexpr LPCSTR Name = "WDI_SAR_CONFIG_SET";
+    static constexpr SAR_FIELD_DESCRIPTOR Fields[] =
+    {
+        SAR_FIELD(WDI_SAR_CONFIG_SET, WDI_SARAntennaIndex, SarFieldHex, 0),
+        SAR_FIELD(WDI_SAR_CONFIG_SET, WDI_SARBackOffIndex, SarFieldHex, 0),
+    };
+};
+
+template <typename T>
+constexpr size_t SarFieldCount = ARRAYSIZE(SarFieldTable<T>::Fields);
+
+template <typename T>
+constexpr
+bool
+SarFieldsCoverStruct()
+/*++
+
+Routine Description:
+
+    Compile-time check that a table describes every byte of its struct: the fields are in order,
+    1, 2 or 4 bytes wide, and separated only by the padding the compiler puts before a field or at
+    the end of the struct.
+
+--*/
+{
+    UINT32 nextOffset = 0;
+
+    for (const SAR_FIELD_DESCRIPTOR& field : SarFieldTable<T>::Fields)
+    {
+        if ((field.Offset < nextOffset) ||
+            (field.Offset - nextOffset >= field.Width) ||
+            ((field.Width != 1) && (field.Width != 2) && (field.Width != 4)))
+        {
+            return false;
+        }
+
+        nextOffset = field.Offset + field.Width;
+    }
+
+    return ((nextOffset + alignof(T) - 1) / alignof(T)) * alignof(T) == sizeof(T);
+}
+
+static_assert(SarFieldsCoverStruct<SAR_CONFIG_HEADER>(), "SAR_CONFIG_HEADER has a field that SarFields.h does not describe");
+static_assert(SarFieldsCoverStruct<SAR_CONFIG_VALUES>(), "SAR_CONFIG_VALUES has a field that SarFields.h does not describe");
+static_assert(SarFieldsCoverStruct<REGION_CONFIG_VALUES>(), "REGION_CONFIG_VALUES has a field that SarFields.h does not describe");
+static_assert(SarFieldsCoverStruct<WDI_SAR_STATE>(), "WDI_SAR_STATE has a field that SarFields.h does not describe");
+static_assert(SarFieldsCoverStruct<WDI_SAR_CONFIG_SET>(), "WDI_SAR_CONFIG_SET has a field that SarFields.h does not describe");
+
+//
+// Field access.  I is the index of the field in SarFieldTable<T>::Fields, so the offset and width
+// are constants and each access compiles to a single load or store.
+//
+
+template <typename T, size_t I>
+inline
+UINT32
+SarFieldGet(
+    _In_ const T& value
+    )
+{
+    constexpr SAR_FIELD_DESCRIPTOR field = SarFieldTable<T>::Fields[I];
+    const UINT8* p = reinterpret_cast<const UINT8*>(&value) + field.Offset;
+
+    if constexpr (field.Width == 1)
+    {
+        return *p;
+    }
+    else if constexpr (field.Width == 2)
+    {
+        UINT16 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    else
+    {
+        UINT32 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+}
+
+template <typename T, size_t I>
+inline
+VOID
+SarFieldSet(
+    _Inout_ T& value,
+    UINT32 fieldValue
+    )
+{
+    constexpr SAR_FIELD_DESCRIPTOR field = SarFieldTable<T>::Fields[I];
+    UINT8* p = reinterpret_cast<UINT8*>(&value) + field.Offset;
+
+    if constexpr (field.Width == 1)
+    {
+        *p = (UINT8)fieldValue;
+    }
+    else if constexpr (field.Width == 2)
+    {
+        UINT16 v = (UINT16)fieldValue;
+        memcpy(p, &v, sizeof(v));
+    }
+    else
+    {
+        memcpy(p, &fieldValue, sizeof(fieldValue));
+    }
+}
+
+// Calls fn(std::integral_constant<size_t, I>()) for each field I of T, in order.  fn is usually a
+// generic lambda that passes decltype(index)::value on to SarFieldGet/SarFieldSet.
+//
+template <typename T, typename Fn, size_t... I>
+inline
+VOID
+SarFieldsForEach(
+    _In_ Fn&& fn,
+    std::index_sequence<I...>
+    )
+{
+    (fn(std::integral_constant<size_t, I>()), ...);
+}
+
+template <typename T, typename Fn>
+inline
+VOID
+SarFieldsForEach(
+    _In_ Fn&& fn
+    )
+{
+    SarFieldsForEach<T>(fn, std::make_index_sequence<SarFieldCount<T>>());
+}
+
+// Writes every printed field of value to the current record or group of output.
+//
+template <typename T>
+inline
+VOID
+SarFieldsFormat(
+    _Inout_ SarOutput* output,
+    _In_ const T& value
+    )
+{
+    SarFieldsForEach<T>([&](auto index)
+    {
+        constexpr SAR_FIELD_DESCRIPTOR field = SarFieldTable<T>::Fields[decltype(index)::value];
+
+        if constexpr (field.Format == SarFieldHex)
+        {
+            output->Field(field.Name, SarFieldGet<T, decltype(index)::value>(value), field.HexDigits);
+        }
+        else if constexpr (field.Format == SarFieldCountry)
+        {
+            output->Country(field.Name, (UINT16)SarFieldGet<T, decltype(index)::value>(value));
+        }
+    });
+}
+
+// Calls fn(field, aValue, bValue) for each field whose value differs between a and b, and
+// returns the number of such fields.
+//
+template <typename T, typename Fn>
+inline
+UINT32
+SarFieldsDiff(
+    _In_ const T& a,
+    _In_ const T& b,
+    _In_ Fn&& fn
+    )
+{
+    UINT32 differences = 0;
+
+    SarFieldsForEach<T>([&](auto index)
+    {
+        UINT32 aValue = SarFieldGet<T, decltype(index)::value>(a);
+        UINT32 bValue = SarFieldGet<T, decltype(index)::value>(b);
+
+        if (aValue != bValue)
+        {
+            fn(SarFieldTable<T>::Fields[decltype(index)::value], aValue, bValue);
+            differences++;
+        }
+    });
+
+    return differences;
+}
+
+// eof: SarFields.h
+//
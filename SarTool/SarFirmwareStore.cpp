@@ -0,0 +1,652 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarFirmwareStore.cpp
+
+Abstract:
+
+    Firmware (UEFI) variable backends for the four provisioning variables.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarFirmwareStore.h"
+#include "SarCodec.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+_Check_return_
+HRESULT
+SarFirmwareStore::ReadConfig(
+    _Out_ SAR_CONFIG_BLOBS* blobs,
+    _Out_writes_opt_(SarBlobCount) HRESULT* results
+    )
+/*++
+
+Routine Description:
+
+    Reads all four provisioning variables in one batch and decodes them.  A missing or short
+    variable leaves the corresponding struct (or its tail) zeroed.
+
+Arguments:
+
+    blobs - Receives the structs.
+    results - Optionally receives the outcome for each variable.
+
+Return Value:
+
+    S_OK on success, HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if a variable was shorter than its
+    struct, otherwise the first failure reported by the backend.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 images[SarBlobCount][sizeof(SAR_CONFIG_BLOBS)];
+    SAR_FIRMWARE_VARIABLE variables[SarBlobCount];
+
+    memset(blobs, 0, sizeof(*blobs));
+    memset(images, 0, sizeof(images));
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        variables[blobId].BlobId = (SAR_CONFIG_BLOB_ID)blobId;
+        variables[blobId].Data = images[blobId];
+        variables[blobId].Size = SarConfigBlobLayouts[blobId]->WireSize;
+        variables[blobId].Transferred = 0;
+        variables[blobId].Result = S_OK;
+    }
+
+    hr = ReadVariables(variables, SarBlobCount);
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        if (SUCCEEDED(variables[blobId].Result))
+        {
+            // A short variable decodes as if its tail were zero, unless it is a compressed power
+            // table.
+            if (FAILED(SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, images[blobId], variables[blobId].Transferred, blobs)))
+            {
+                variables[blobId].Result = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                (VOID)SarDecodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, images[blobId], variables[blobId].Size, blobs);
+            }
+        }
+
+        if (SUCCEEDED(hr) && FAILED(variables[blobId].Result))
+        {
+            hr = variables[blobId].Result;
+        }
+
+        if (results != nullptr)
+        {
+            results[blobId] = variables[blobId].Result;
+        }
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarFirmwareStore::WriteConfig(
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_writes_opt_(SarBlobCount) HRESULT* results
+    )
+/*++
+
+Routine Description:
+
+    Encodes the four provisioning structs and writes them to their variables in one batch.
+
+Arguments:
+
+    blobs - The structs to write.
+    results - Optionally receives the outcome for each variable.
+
+Return Value:
+
+    S_OK on success, otherwise the first failure.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT8 images[SarBlobCount][sizeof(SAR_CONFIG_BLOBS)];
+    SAR_FIRMWARE_VARIABLE variables[SarBlobCount];
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        variables[blobId].BlobId = (SAR_CONFIG_BLOB_ID)blobId;
+        variables[blobId].Data = images[blobId];
+        variables[blobId].Transferred = 0;
+        variables[blobId].Result = SarEncodeConfigBlob((SAR_CONFIG_BLOB_ID)blobId, blobs, images[blobId], sizeof(images[blobId]), &variables[blobId].Size);
+
+        if (FAILED(variables[blobId].Result))
+        {
+            hr = variables[blobId].Result;
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteVariables(variables, SarBlobCount);
+    }
+
+    if (results != nullptr)
+    {
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            results[blobId] = variables[blobId].Result;
+        }
+    }
+
+    return hr;
+}
+
+#ifdef _WIN32
+
+static
+_Check_return_
+HRESULT
+SarEnableFirmwarePrivilege()
+/*++
+
+Routine Description:
+
+    Attempts to enable the SE_SYSTEM_ENVIRONMENT_NAME privilege in our process token.  Otherwise,
+    Get/SetFirmwareEnvironmentVariable API's will not succeed.
+
+Arguments:
+
+    VOID
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HANDLE           hToken = NULL;
+    TOKEN_PRIVILEGES tokenPrivileges = { 0 };
+    HRESULT          hr = S_OK;
+
+    // Get the token for this process.
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+        printf("OpenProcessToken() failed, hr = 0x%x\n", hr);
+        goto exit;
+    }
+
+    // Get the LUID for the UEFI-access privilege.
+    if (!LookupPrivilegeValue(NULL, SE_SYSTEM_ENVIRONMENT_NAME, &tokenPrivileges.Privileges[0].Luid))
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+        printf("LookupPrivilegeValue() failed, hr = 0x%x\n", hr);
+        goto exit;
+    }
+
+    tokenPrivileges.PrivilegeCount = 1;  // one privilege to set
+    tokenPrivileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    // Set the UEFI-access privilege for this process.
+    if (!AdjustTokenPrivileges(hToken, FALSE, &tokenPrivileges, 0, (PTOKEN_PRIVILEGES)NULL, 0))
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+        printf("AdjustTokenPrivileges() failed, hr = 0x%x\n", hr);
+        goto exit;
+    }
+
+exit:
+    if (hToken != NULL)
+    {
+        CloseHandle(hToken);
+    }
+    return hr;
+}
+
+SarWin32FirmwareStore::SarWin32FirmwareStore() :
+    m_initResult(S_OK)
+{
+    memset(m_vendorGuids, 0, sizeof(m_vendorGuids));
+}
+
+_Check_return_
+HRESULT
+SarWin32FirmwareStore::Initialize()
+/*++
+
+Routine Description:
+
+    Enables the firmware privilege and formats each variable's vendor GUID, once per store.
+
+Arguments:
+
+    VOID
+
+Return Value:
+
+    S_OK on success or the (cached) failure code of the first attempt.
+
+--*/
+{
+    std::call_once(m_initOnce, [this]()
+    {
+        m_initResult = SarEnableFirmwarePrivilege();
+        if (FAILED(m_initResult))
+        {
+            printf("Failed to add privilege to ProcessToken\r\n");
+            return;
+        }
+
+        for (int blobId = 0; blobId < SarBlobCount; blobId++)
+        {
+            if (!StringFromGUID2(*SarConfigBlobInfo[blobId].VendorGuid,
+                                 m_vendorGuids[blobId],
+                                 ARRAYSIZE(m_vendorGuids[blobId])))
+            {
+                m_initResult = E_NOT_SUFFICIENT_BUFFER;
+                return;
+            }
+        }
+    });
+
+    return m_initResult;
+}
+
+_Check_return_
+HRESULT
+SarWin32FirmwareStore::ReadVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+{
+    HRESULT hr = Initialize();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+        DWORD bytesRead = 0;
+
+        variable.Transferred = 0;
+        variable.Result = hr;
+        if (FAILED(hr))
+        {
+            continue;
+        }
+
+        bytesRead = GetFirmwareEnvironmentVariableW(SarConfigBlobInfo[variable.BlobId].Name,
+                                                    m_vendorGuids[variable.BlobId],
+                                                    variable.Data,
+                                                    (DWORD)variable.Size);
+        if (bytesRead == 0)
+        {
+            variable.Result = HRESULT_FROM_WIN32(::GetLastError());
+            continue;
+        }
+
+        variable.Transferred = bytesRead;
+    }
+
+    for (size_t i = 0; (i < count) && SUCCEEDED(hr); i++)
+    {
+        hr = variables[i].Result;
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWin32FirmwareStore::WriteVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+{
+    HRESULT hr = Initialize();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+
+        variable.Result = hr;
+        if (FAILED(hr))
+        {
+            continue;
+        }
+
+        if (!SetFirmwareEnvironmentVariableW(SarConfigBlobInfo[variable.BlobId].Name,
+                                             m_vendorGuids[variable.BlobId],
+                                             variable.Data,
+                                             (DWORD)variable.Size))
+        {
+            variable.Result = HRESULT_FROM_WIN32(::GetLastError());
+        }
+    }
+
+    for (size_t i = 0; (i < count) && SUCCEEDED(hr); i++)
+    {
+        hr = variables[i].Result;
+    }
+
+    return hr;
+}
+
+SarFirmwareStore*
+SarFirmwareStoreDefault()
+{
+    static SarWin32FirmwareStore s_store;
+    return &s_store;
+}
+
+#else // !_WIN32
+
+SarEfivarfsFirmwareStore::SarEfivarfsFirmwareStore(
+    _In_z_ LPCSTR root
+    )
+/*++
+
+Routine Description:
+
+    Formats the efivarfs file name of every variable once: <root>/<Name>-<guid>, with the GUID
+    in lower case and without braces.
+
+Arguments:
+
+    root - The efivarfs mount point.
+
+--*/
+{
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        const GUID& guid = *SarConfigBlobInfo[blobId].VendorGuid;
+        char szGuid[37];
+        std::string& path = m_paths[blobId];
+
+        snprintf(szGuid, sizeof(szGuid), "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            guid.Data1, guid.Data2, guid.Data3,
+            guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+            guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+
+        path = root;
+        path += SAR_PATH_SEPARATOR;
+        for (LPCWSTR pName = SarConfigBlobInfo[blobId].Name; *pName != L'\0'; pName++)
+        {
+            path += (char)*pName;
+        }
+        path += '-';
+        path += szGuid;
+    }
+}
+
+_Check_return_
+HRESULT
+SarEfivarfsFirmwareStore::ReadVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+/*++
+
+Routine Description:
+
+    Reads each variable file.  efivarfs prefixes the data with the variable's 32-bit attributes,
+    so the file is read whole and the prefix stripped.  A variable larger than its buffer fails
+    with HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER), as GetFirmwareEnvironmentVariable does.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+        // One byte more than the buffer holds, so a larger variable is noticed.
+        std::vector<UINT8> image(sizeof(UINT32) + variable.Size + 1);
+        ssize_t bytesRead;
+
+        variable.Transferred = 0;
+        variable.Result = S_OK;
+
+        int fd = open(m_paths[variable.BlobId].c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            variable.Result = SarHresultFromErrno(errno);
+            goto next;
+        }
+
+        bytesRead = read(fd, image.data(), image.size());
+        if (bytesRead < 0)
+        {
+            variable.Result = SarHresultFromErrno(errno);
+        }
+        else if ((size_t)bytesRead < sizeof(UINT32))
+        {
+            variable.Result = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+        else if ((size_t)bytesRead > sizeof(UINT32) + variable.Size)
+        {
+            variable.Result = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+        }
+        else
+        {
+            variable.Transferred = (size_t)bytesRead - sizeof(UINT32);
+            memcpy(variable.Data, image.data() + sizeof(UINT32), variable.Transferred);
+        }
+        close(fd);
+
+    next:
+        if (SUCCEEDED(hr) && FAILED(variable.Result))
+        {
+            hr = variable.Result;
+        }
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarEfivarfsFirmwareStore::WriteVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+/*++
+
+Routine Description:
+
+    Writes each variable file as the attributes followed by the data.  efivarfs requires the whole
+    variable in a single write, and existing variables are usually marked immutable, so the flag is
+    cleared first (failures to do so are ignored; they only matter on real efivarfs.)
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+        const char* path = m_paths[variable.BlobId].c_str();
+        std::vector<UINT8> image(sizeof(UINT32) + variable.Size);
+        ssize_t written;
+        int fd;
+
+        SarStoreLe32(image.data(), SAR_FIRMWARE_VARIABLE_ATTRIBUTES);
+        memcpy(image.data() + sizeof(UINT32), variable.Data, variable.Size);
+        variable.Result = S_OK;
+
+#ifdef __linux__
+        fd = open(path, O_RDONLY);
+        if (fd >= 0)
+        {
+            int flags = 0;
+            if ((ioctl(fd, FS_IOC_GETFLAGS, &flags) == 0) && (flags & FS_IMMUTABLE_FL))
+            {
+                flags &= ~FS_IMMUTABLE_FL;
+                (VOID)ioctl(fd, FS_IOC_SETFLAGS, &flags);
+            }
+            close(fd);
+        }
+#endif
+
+        fd = open(path, O_WRONLY | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            variable.Result = SarHresultFromErrno(errno);
+            goto next;
+        }
+
+        written = write(fd, image.data(), image.size());
+        if (written < 0)
+        {
+            variable.Result = SarHresultFromErrno(errno);
+        }
+        else if ((size_t)written != image.size())
+        {
+            variable.Result = E_FAIL;
+        }
+        else
+        {
+            // efivarfs replaces the variable on write; a plain file (a scratch directory standing
+            // in for it) must also lose the tail of a longer previous value.  Ignored where
+            // truncation is not supported.
+            (VOID)ftruncate(fd, (off_t)image.size());
+        }
+
+        if ((close(fd) != 0) && SUCCEEDED(variable.Result))
+        {
+            variable.Result = SarHresultFromErrno(errno);
+        }
+
+    next:
+        if (SUCCEEDED(hr) && FAILED(variable.Result))
+        {
+            hr = variable.Result;
+        }
+    }
+
+    return hr;
+}
+
+SarFirmwareStore*
+SarFirmwareStoreDefault()
+{
+    static SarEfivarfsFirmwareStore s_store;
+    return &s_store;
+}
+
+#endif // _WIN32
+
+_Check_return_
+HRESULT
+SarMemoryFirmwareStore::ReadVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+{
+    HRESULT hr = S_OK;
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+        const std::vector<UINT8>& value = m_values[variable.BlobId];
+
+        variable.Transferred = 0;
+        variable.Result = S_OK;
+
+        if (!m_present[variable.BlobId])
+        {
+            variable.Result = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+        else if (value.size() > variable.Size)
+        {
+            variable.Result = E_NOT_SUFFICIENT_BUFFER;
+        }
+        else
+        {
+            memcpy(variable.Data, value.data(), value.size());
+            variable.Transferred = value.size();
+        }
+
+        if (SUCCEEDED(hr) && FAILED(variable.Result))
+        {
+            hr = variable.Result;
+        }
+    }
+
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarMemoryFirmwareStore::WriteVariables(
+    _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+    size_t count
+    )
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SAR_FIRMWARE_VARIABLE& variable = variables[i];
+
+        m_values[variable.BlobId].assign(variable.Data, variable.Data + variable.Size);
+        m_present[variable.BlobId] = true;
+        variable.Result = S_OK;
+    }
+
+    return S_OK;
+}
+
+VOID
+SarMemoryFirmwareStore::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        m_values[blobId].clear();
+        m_present[blobId] = false;
+    }
+}
+
+BOOL
+SarFirmwareIsPath(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Determines whether a getconfig/setconfig path selects UEFI rather than files on disk.
+
+Arguments:
+
+    path - The path specified by the user.
+
+Return Value:
+
+    TRUE if the path is "UEFI" (in any case.)
+
+--*/
+{
+    return (0 == _stricmp(path, SAR_UEFI_PATH));
+}
+
+// eof: SarFirmwareStore.cpp
+//
@@ -0,0 +1,217 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarFirmwareStore.h
+
+Abstract:
+
+    Firmware (UEFI) variable backends for the four provisioning variables.
+
+    SarFirmwareStore transfers all four variables in one batched call.  Each backend does its
+    one-time setup (e.g. enabling SE_SYSTEM_ENVIRONMENT_NAME, formatting the vendor GUIDs) on first
+    use and caches it, so repeated round-trips only pay for the variable I/O itself.
+
+        SarWin32FirmwareStore       Get/SetFirmwareEnvironmentVariable (Windows)
+        SarEfivarfsFirmwareStore    /sys/firmware/efi/efivars (Linux)
+        SarMemoryFirmwareStore      An in-process stand-in for tests and benchmarks
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The "path" that selects UEFI instead of files on disk for getconfig/setconfig.
+//
+static const char SAR_UEFI_PATH[] = "uefi";
+
+// Attributes the variables are written with: EFI_VARIABLE_NON_VOLATILE |
+// EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS (the SetFirmwareEnvironmentVariable
+// default.)
+//
+static const UINT32 SAR_FIRMWARE_VARIABLE_ATTRIBUTES = 0x00000007;
+
+// One variable in a batched transfer.
+//
+typedef struct _SAR_FIRMWARE_VARIABLE
+{
+    SAR_CONFIG_BLOB_ID BlobId;  // Selects the variable name and vendor GUID.
+    UINT8* Data;
+    size_t Size;                // Size of Data in bytes.
+    size_t Transferred;         // Out: bytes read (reads only.)
+    HRESULT Result;             // Out: outcome for this variable.
+} SAR_FIRMWARE_VARIABLE;
+
+class SarFirmwareStore
+{
+public:
+
+    virtual ~SarFirmwareStore() {}
+
+    // Reads or writes a batch of variables.  Every entry's Result is set; the return value is the
+    // first failure (or a failure that prevented the whole batch, such as a missing privilege.)
+    //
+    _Check_return_
+    virtual
+    HRESULT
+    ReadVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) = 0;
+
+    _Check_return_
+    virtual
+    HRESULT
+    WriteVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) = 0;
+
+    // Reads and decodes all four provisioning variables.  results, if specified, receives the
+    // outcome for each variable indexed by SAR_CONFIG_BLOB_ID.
+    //
+    _Check_return_
+    HRESULT
+    ReadConfig(
+        _Out_ SAR_CONFIG_BLOBS* blobs,
+        _Out_writes_opt_(SarBlobCount) HRESULT* results = nullptr
+        );
+
+    _Check_return_
+    HRESULT
+    WriteConfig(
+        _In_ const SAR_CONFIG_BLOBS* blobs,
+        _Out_writes_opt_(SarBlobCount) HRESULT* results = nullptr
+        );
+};
+
+#ifdef _WIN32
+
+class SarWin32FirmwareStore : public SarFirmwareStore
+{
+public:
+
+    SarWin32FirmwareStore();
+
+    _Check_return_
+    HRESULT
+    ReadVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+    _Check_return_
+    HRESULT
+    WriteVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+private:
+
+    _Check_return_
+    HRESULT
+    Initialize();
+
+    std::once_flag m_initOnce;
+    HRESULT m_initResult;
+    WCHAR m_vendorGuids[SarBlobCount][39];
+};
+
+#else // !_WIN32
+
+class SarEfivarfsFirmwareStore : public SarFirmwareStore
+{
+public:
+
+    // root is the efivarfs mount point; tests may point it at any directory.
+    //
+    SarEfivarfsFirmwareStore(
+        _In_z_ LPCSTR root = "/sys/firmware/efi/efivars"
+        );
+
+    _Check_return_
+    HRESULT
+    ReadVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+    _Check_return_
+    HRESULT
+    WriteVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+    // The file that backs a variable: <root>/<Name>-<vendor GUID>.
+    //
+    const std::string&
+    VariablePath(
+        SAR_CONFIG_BLOB_ID blobId
+        ) const
+    {
+        return m_paths[blobId];
+    }
+
+private:
+
+    std::string m_paths[SarBlobCount];
+};
+
+#endif // _WIN32
+
+class SarMemoryFirmwareStore : public SarFirmwareStore
+{
+public:
+
+    _Check_return_
+    HRESULT
+    ReadVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+    _Check_return_
+    HRESULT
+    WriteVariables(
+        _Inout_updates_(count) SAR_FIRMWARE_VARIABLE* variables,
+        size_t count
+        ) override;
+
+    // Deletes every variable.
+    //
+    VOID
+    Clear();
+
+private:
+
+    std::mutex m_lock;
+    bool m_present[SarBlobCount] = {};
+    std::vector<UINT8> m_values[SarBlobCount];
+};
+
+BOOL
+SarFirmwareIsPath(
+    _In_z_ LPCSTR path
+    );
+
+// The process-wide store for this platform's firmware.  Its one-time setup is shared by every
+// caller.
+//
+SarFirmwareStore*
+SarFirmwareStoreDefault();
+
+// eof: SarFirmwareStore.h
+//
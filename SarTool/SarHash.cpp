@@ -0,0 +1,140 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarHash.cpp
+
+Abstract:
+
+    XXH64.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarHash.h"
+#include "SarCodec.h"
+
+static const UINT64 SAR_HASH_PRIME1 = 0x9E3779B185EBCA87ull;
+static const UINT64 SAR_HASH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static const UINT64 SAR_HASH_PRIME3 = 0x165667B19E3779F9ull;
+static const UINT64 SAR_HASH_PRIME4 = 0x85EBCA77C2B2AE63ull;
+static const UINT64 SAR_HASH_PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline UINT64 SarRotl64(UINT64 value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+inline
+UINT64
+SarHashRound(
+    UINT64 accumulator,
+    UINT64 input
+    )
+{
+    accumulator += input * SAR_HASH_PRIME2;
+    return SarRotl64(accumulator, 31) * SAR_HASH_PRIME1;
+}
+
+inline
+UINT64
+SarHashMerge(
+    UINT64 hash,
+    UINT64 accumulator
+    )
+{
+    hash ^= SarHashRound(0, accumulator);
+    return hash * SAR_HASH_PRIME1 + SAR_HASH_PRIME4;
+}
+
+UINT64
+SarHash64(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT64 seed
+    )
+/*++
+
+Routine Description:
+
+    Hashes 32-byte stripes into four independent accumulators, then folds in the tail 8, 4 and 1
+    bytes at a time and mixes the result.  Reads are little-endian, so the hash is the same on
+    every host.
+
+Arguments:
+
+    data - The bytes to hash.
+    size - Number of bytes.
+    seed - Selects an independent hash function.
+
+Return Value:
+
+    The hash.
+
+--*/
+{
+    const UINT8* next = (const UINT8*)data;
+    const UINT8* end = next + size;
+    UINT64 hash;
+
+    if (size >= 32)
+    {
+        UINT64 v1 = seed + SAR_HASH_PRIME1 + SAR_HASH_PRIME2;
+        UINT64 v2 = seed + SAR_HASH_PRIME2;
+        UINT64 v3 = seed;
+        UINT64 v4 = seed - SAR_HASH_PRIME1;
+
+        do
+        {
+            v1 = SarHashRound(v1, SarLoadLe64(next));
+            v2 = SarHashRound(v2, SarLoadLe64(next + 8));
+            v3 = SarHashRound(v3, SarLoadLe64(next + 16));
+            v4 = SarHashRound(v4, SarLoadLe64(next + 24));
+            next += 32;
+        } while (end - next >= 32);
+
+        hash = SarRotl64(v1, 1) + SarRotl64(v2, 7) + SarRotl64(v3, 12) + SarRotl64(v4, 18);
+        hash = SarHashMerge(hash, v1);
+        hash = SarHashMerge(hash, v2);
+        hash = SarHashMerge(hash, v3);
+        hash = SarHashMerge(hash, v4);
+    }
+    else
+    {
+        hash = seed + SAR_HASH_PRIME5;
+    }
+
+    hash += (UINT64)size;
+
+    for (; end - next >= 8; next += 8)
+    {
+        hash ^= SarHashRound(0, SarLoadLe64(next));
+        hash = SarRotl64(hash, 27) * SAR_HASH_PRIME1 + SAR_HASH_PRIME4;
+    }
+
+    if (end - next >= 4)
+    {
+        hash ^= (UINT64)SarLoadLe32(next) * SAR_HASH_PRIME1;
+        hash = SarRotl64(hash, 23) * SAR_HASH_PRIME2 + SAR_HASH_PRIME3;
+        next += 4;
+    }
+
+    for (; next < end; next++)
+    {
+        hash ^= (UINT64)(*next) * SAR_HASH_PRIME5;
+        hash = SarRotl64(hash, 11) * SAR_HASH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= SAR_HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= SAR_HASH_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+// eof: SarHash.cpp
+//
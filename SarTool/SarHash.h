@@ -0,0 +1,36 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarHash.h
+
+Abstract:
+
+    64-bit non-cryptographic hash (XXH64) used to content-address provisioning blobs.  It is fast
+    on the short inputs SarTool hashes and well distributed, but offers no protection against
+    deliberately colliding inputs: callers that deduplicate by hash still compare the bytes.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include <stddef.h>
+
+// Computes the XXH64 hash of the buffer; different seeds give independent hashes of the same bytes.
+//
+UINT64
+SarHash64(
+    _In_reads_bytes_(size) const void* data,
+    size_t size,
+    UINT64 seed = 0
+    );
+
+// eof: SarHash.h
+//
@@ -0,0 +1,752 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarIndex.cpp
+
+Abstract:
+
+    Sorted on-disk index of fleet provisioning fields and the index/query commands.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarIndex.h"
+#include "SarCountry.h"
+#include "SarCrc32c.h"
+#include "SarThreadPool.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+static const LPCSTR SarIndexFieldNames[SarIndexFieldCount] =
+{
+    "ProductID",
+    "Version",
+    "Revision",
+    "WLANTechnology",
+    "GeoCountryString",
+    "GeoLocationValue",
+    "DynamicGeoState",
+    "DynamicGeoType",
+    "SARSafetyTimer",
+    "SARSafetyRequestResponseTimeout",
+    "SARUnsolicitedUpdateTimer",
+};
+
+LPCSTR
+SarIndexFieldName(
+    SAR_INDEX_FIELD field
+    )
+{
+    return SarIndexFieldNames[field];
+}
+
+static
+VOID
+SarIndexValues(
+    _In_ const SAR_CONFIG_BLOBS* blobs,
+    _Out_writes_(SarIndexFieldCount) UINT32* values
+    )
+{
+    values[SarIndexProductId] = blobs->Header.ProductID;
+    values[SarIndexVersion] = blobs->Header.Version;
+    values[SarIndexRevision] = blobs->Header.Revision;
+    values[SarIndexWlanTechnology] = blobs->Header.WLANTechnology;
+    values[SarIndexGeoCountryString] = blobs->Region.GeoCountryString.AsciiChars;
+    values[SarIndexGeoLocationValue] = blobs->Region.GeoLocationValue;
+    values[SarIndexDynamicGeoState] = blobs->Region.DynamicGeoState;
+    values[SarIndexDynamicGeoType] = blobs->Region.DynamicGeoType;
+    values[SarIndexSafetyTimer] = blobs->Values.SARSafetyTimer;
+    values[SarIndexSafetyRequestResponseTimeout] = blobs->Values.SARSafetyRequestResponseTimeout;
+    values[SarIndexUnsolicitedUpdateTimer] = blobs->Values.SARUnsolicitedUpdateTimer;
+}
+
+static
+VOID
+SarIndexFormatValue(
+    SAR_INDEX_FIELD field,
+    UINT32 value,
+    _Out_writes_(16) char* text
+    )
+{
+    if (field == SarIndexGeoCountryString)
+    {
+        SarFormatCountryCode((UINT16)value, text);
+    }
+    else
+    {
+        snprintf(text, 16, "0x%x", value);
+    }
+}
+
+_Check_return_
+HRESULT
+SarIndexParseCondition(
+    _In_z_ LPCSTR text,
+    _Out_ SAR_INDEX_CONDITION* condition
+    )
+/*++
+
+Routine Description:
+
+    Parses one query condition, e.g. "ProductID=4", "Country=PH" or "SARUnsolicitedUpdateTimer<1000".
+
+Arguments:
+
+    text - The condition.
+    condition - Receives the field and the range of values it accepts.
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the field, operator or value is not recognized.
+
+--*/
+{
+    size_t nameLength = strcspn(text, "!<>=");
+    LPCSTR op = text + nameLength;
+    LPCSTR valueText;
+    char* end = nullptr;
+    UINT32 value;
+    int field;
+
+    memset(condition, 0, sizeof(*condition));
+
+    for (field = 0; field < SarIndexFieldCount; field++)
+    {
+        if ((strlen(SarIndexFieldNames[field]) == nameLength) &&
+            (0 == _strnicmp(text, SarIndexFieldNames[field], nameLength)))
+        {
+            break;
+        }
+    }
+
+    if ((field == SarIndexFieldCount) && (nameLength == 7) && (0 == _strnicmp(text, "Country", nameLength)))
+    {
+        field = SarIndexGeoCountryString;
+    }
+
+    if ((field == SarIndexFieldCount) || (*op == '\0'))
+    {
+        return E_INVALIDARG;
+    }
+
+    valueText = op + (((op[1] == '=') && (op[0] != '=')) ? 2 : 1);
+    if ((field == SarIndexGeoCountryString) &&
+        isalpha((unsigned char)valueText[0]) && isalpha((unsigned char)valueText[1]) && (valueText[2] == '\0'))
+    {
+        value = (UINT32)((toupper((unsigned char)valueText[0]) << 8) | toupper((unsigned char)valueText[1]));
+    }
+    else
+    {
+        unsigned long long parsed = strtoull(valueText, &end, 0);
+
+        if ((*valueText == '\0') || (*end != '\0') || (parsed > 0xffffffffull))
+        {
+            return E_INVALIDARG;
+        }
+        value = (UINT32)parsed;
+    }
+
+    condition->Field = (SAR_INDEX_FIELD)field;
+    condition->Low = 0;
+    condition->High = 0xffffffff;
+
+    if (0 == strncmp(op, "!=", 2))
+    {
+        condition->Low = value;
+        condition->fNotEqual = TRUE;
+    }
+    else if (0 == strncmp(op, "<=", 2))
+    {
+        condition->High = value;
+    }
+    else if (0 == strncmp(op, ">=", 2))
+    {
+        condition->Low = value;
+    }
+    else if (op[0] == '<')
+    {
+        // "< 0" matches nothing: an empty range.
+        condition->Low = (value == 0) ? 1 : 0;
+        condition->High = (value == 0) ? 0 : value - 1;
+    }
+    else if (op[0] == '>')
+    {
+        condition->Low = (value == 0xffffffff) ? 1 : value + 1;
+        condition->High = (value == 0xffffffff) ? 0 : 0xffffffff;
+    }
+    else if (op[0] == '=')
+    {
+        condition->Low = value;
+        condition->High = value;
+    }
+    else
+    {
+        return E_INVALIDARG;
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarIndexWrite(
+    _In_z_ LPCSTR path,
+    _In_ const std::vector<SAR_BATCH_ITEM>& items,
+    UINT32 threadCount
+    )
+/*++
+
+Routine Description:
+
+    Sorts the records of the items that were read successfully, builds the per-field orderings in
+    parallel (one field per work item) and writes the index with a single write.
+
+Arguments:
+
+    path - The index file to create or overwrite.
+    items - The results of a batch getconfig.
+    threadCount - Number of worker threads; 0 selects one per hardware thread.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_INDEX_HEADER header = { 0 };
+    std::vector<SAR_INDEX_RECORD> unsorted;
+    std::vector<const SAR_BATCH_ITEM*> sources;
+    std::vector<UINT32> order;
+    std::vector<SAR_INDEX_RECORD> records;
+    std::vector<UINT32> orders;
+    std::string paths;
+    std::vector<UINT8> image;
+    FILE* output = nullptr;
+    UINT32 recordCount;
+
+    for (const SAR_BATCH_ITEM& item : items)
+    {
+        if (SUCCEEDED(item.Result))
+        {
+            SAR_INDEX_RECORD record = { { 0 } };
+
+            SarIndexValues(&item.Blobs, record.Values);
+            unsorted.push_back(record);
+            sources.push_back(&item);
+        }
+    }
+
+    recordCount = (UINT32)unsorted.size();
+    order.resize(recordCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&unsorted, &sources](UINT32 a, UINT32 b)
+    {
+        for (int field = 0; field < SarIndexFieldCount; field++)
+        {
+            if (unsorted[a].Values[field] != unsorted[b].Values[field])
+            {
+                return unsorted[a].Values[field] < unsorted[b].Values[field];
+            }
+        }
+
+        return sources[a]->Folder < sources[b]->Folder;
+    });
+
+    records.resize(recordCount);
+    for (UINT32 i = 0; i < recordCount; i++)
+    {
+        records[i] = unsorted[order[i]];
+        records[i].PathOffset = (UINT32)paths.size();
+        records[i].PathSize = (UINT32)sources[order[i]]->Folder.size();
+        paths += sources[order[i]]->Folder;
+    }
+
+    orders.resize((size_t)SarIndexFieldCount * recordCount);
+    {
+        SarThreadPool pool(threadCount);
+
+        pool.ParallelFor(SarIndexFieldCount, [&records, &orders, recordCount](size_t field)
+        {
+            UINT32* fieldOrder = orders.data() + field * recordCount;
+
+            std::iota(fieldOrder, fieldOrder + recordCount, 0);
+            std::stable_sort(fieldOrder, fieldOrder + recordCount, [&records, field](UINT32 a, UINT32 b)
+            {
+                return records[a].Values[field] < records[b].Values[field];
+            });
+        });
+    }
+
+    header.Signature = SAR_INDEX_SIGNATURE;
+    header.FormatVersion = SAR_INDEX_FORMAT_VERSION;
+    header.FieldCount = SarIndexFieldCount;
+    header.RecordCount = recordCount;
+    header.PathsSize = (UINT32)paths.size();
+    header.TotalSize = (UINT32)(sizeof(header) +
+                                records.size() * sizeof(SAR_INDEX_RECORD) +
+                                orders.size() * sizeof(UINT32) +
+                                paths.size());
+
+    image.reserve(header.TotalSize);
+    image.resize(sizeof(header));
+    image.insert(image.end(), (const UINT8*)records.data(), (const UINT8*)(records.data() + records.size()));
+    image.insert(image.end(), (const UINT8*)orders.data(), (const UINT8*)(orders.data() + orders.size()));
+    image.insert(image.end(), paths.begin(), paths.end());
+
+    header.Crc32c = SarCrc32c(image.data() + sizeof(header), image.size() - sizeof(header));
+    memcpy(image.data(), &header, sizeof(header));
+
+    output = fopen(path, "wb");
+    if (!output)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (fwrite(image.data(), 1, image.size(), output) != image.size())
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+SarIndexView::SarIndexView() :
+    m_records(nullptr),
+    m_orders(nullptr),
+    m_paths(nullptr),
+    m_recordCount(0)
+{
+}
+
+_Check_return_
+HRESULT
+SarIndexView::Open(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Maps an index and validates its header, CRC-32C, record paths and orderings.
+
+Arguments:
+
+    path - The index file.
+
+Return Value:
+
+    S_OK on success.
+    HRESULT_FROM_WIN32(ERROR_BAD_FORMAT) if the file is not an index of a known version.
+    HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if a record or ordering refers outside the index.
+    HRESULT_FROM_WIN32(ERROR_CRC) if the index fails its CRC check.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_INDEX_HEADER header;
+    const UINT8* data;
+    UINT64 expectedSize;
+
+    m_records = nullptr;
+    m_orders = nullptr;
+    m_paths = nullptr;
+    m_recordCount = 0;
+
+    hr = m_file.Open(path);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    data = m_file.Data();
+    if ((data == nullptr) || (m_file.Size() < sizeof(header)))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    if ((header.Signature != SAR_INDEX_SIGNATURE) ||
+        (header.FormatVersion != SAR_INDEX_FORMAT_VERSION) ||
+        (header.FieldCount != SarIndexFieldCount))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+        goto exit;
+    }
+
+    expectedSize = sizeof(header) +
+                   (UINT64)header.RecordCount * (sizeof(SAR_INDEX_RECORD) + SarIndexFieldCount * sizeof(UINT32)) +
+                   header.PathsSize;
+    if ((header.TotalSize != expectedSize) || (header.TotalSize > m_file.Size()))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    if (SarCrc32c(data + sizeof(header), header.TotalSize - sizeof(header)) != header.Crc32c)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_CRC);
+        goto exit;
+    }
+
+    m_records = reinterpret_cast<const SAR_INDEX_RECORD*>(data + sizeof(header));
+    m_orders = reinterpret_cast<const UINT32*>(m_records + header.RecordCount);
+    m_paths = reinterpret_cast<const char*>(m_orders + (size_t)SarIndexFieldCount * header.RecordCount);
+
+    for (UINT32 i = 0; i < header.RecordCount; i++)
+    {
+        if ((m_records[i].PathOffset > header.PathsSize) ||
+            (m_records[i].PathSize > header.PathsSize - m_records[i].PathOffset))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+    }
+
+    for (size_t i = 0; i < (size_t)SarIndexFieldCount * header.RecordCount; i++)
+    {
+        if (m_orders[i] >= header.RecordCount)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+    }
+
+    m_recordCount = header.RecordCount;
+
+exit:
+    if (FAILED(hr))
+    {
+        m_records = nullptr;
+        m_orders = nullptr;
+        m_paths = nullptr;
+        m_file.Close();
+    }
+    return hr;
+}
+
+VOID
+SarIndexView::Query(
+    _In_reads_(conditionCount) const SAR_INDEX_CONDITION* conditions,
+    size_t conditionCount,
+    _Inout_ std::vector<UINT32>* matches
+    ) const
+/*++
+
+Routine Description:
+
+    Intersects the range conditions of each field, finds the field whose range holds the fewest
+    records with a binary search of each field's ordering, and checks every condition on the
+    records in that range.
+
+Arguments:
+
+    conditions - The conditions; all must hold.
+    conditionCount - Number of conditions.
+    matches - Receives the matching record numbers, in index order.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    UINT32 low[SarIndexFieldCount];
+    UINT32 high[SarIndexFieldCount];
+    BOOL fBounded[SarIndexFieldCount] = { FALSE };
+    const UINT32* first = nullptr;
+    const UINT32* last = nullptr;
+    size_t start = matches->size();
+
+    for (int field = 0; field < SarIndexFieldCount; field++)
+    {
+        low[field] = 0;
+        high[field] = 0xffffffff;
+    }
+
+    for (size_t i = 0; i < conditionCount; i++)
+    {
+        if (!conditions[i].fNotEqual)
+        {
+            low[conditions[i].Field] = (std::max)(low[conditions[i].Field], conditions[i].Low);
+            high[conditions[i].Field] = (std::min)(high[conditions[i].Field], conditions[i].High);
+            fBounded[conditions[i].Field] = TRUE;
+        }
+    }
+
+    for (int field = 0; field < SarIndexFieldCount; field++)
+    {
+        const UINT32* fieldOrder = m_orders + (size_t)field * m_recordCount;
+        const UINT32* rangeFirst;
+        const UINT32* rangeLast;
+
+        if (!fBounded[field])
+        {
+            continue;
+        }
+
+        if (low[field] > high[field])
+        {
+            return;
+        }
+
+        rangeFirst = std::lower_bound(fieldOrder, fieldOrder + m_recordCount, low[field],
+            [this, field](UINT32 record, UINT32 value) { return m_records[record].Values[field] < value; });
+        rangeLast = std::upper_bound(rangeFirst, fieldOrder + m_recordCount, high[field],
+            [this, field](UINT32 value, UINT32 record) { return value < m_records[record].Values[field]; });
+
+        if ((first == nullptr) || (rangeLast - rangeFirst < last - first))
+        {
+            first = rangeFirst;
+            last = rangeLast;
+        }
+    }
+
+    for (UINT32 i = 0; (first == nullptr) && (i < m_recordCount); i++)
+    {
+        matches->push_back(i);
+    }
+
+    for (const UINT32* candidate = first; candidate != last; candidate++)
+    {
+        matches->push_back(*candidate);
+    }
+
+    // Keep the candidates that meet every condition, then restore index order.
+    matches->erase(std::remove_if(matches->begin() + start, matches->end(), [this, conditions, conditionCount](UINT32 record)
+    {
+        for (size_t i = 0; i < conditionCount; i++)
+        {
+            UINT32 value = m_records[record].Values[conditions[i].Field];
+
+            if (conditions[i].fNotEqual ? (value == conditions[i].Low) :
+                                          ((value < conditions[i].Low) || (value > conditions[i].High)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }), matches->end());
+
+    std::sort(matches->begin() + start, matches->end());
+}
+
+_Check_return_
+HRESULT
+SarIndexCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "index <index file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]".
+    Reads every configuration in parallel as batch getconfig does and writes the index.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the index file.
+
+Return Value:
+
+    S_OK if every configuration was indexed, E_INVALIDARG for a malformed command line, otherwise
+    E_FAIL or the failure code from writing the index.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    UINT32 threadCount = 0;
+    std::vector<std::string> paths;
+    std::vector<SAR_BATCH_ITEM> items;
+    SAR_BATCH_STATS stats = { 0 };
+
+    if (argc < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (argc >= 3)
+    {
+        hr = SarThreadPoolParseThreadCount(argv[2], &threadCount);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    hr = SarBatchCollectConfigs(argv[1], &paths);
+    if (FAILED(hr))
+    {
+        printf("Failed to enumerate targets in %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+        goto exit;
+    }
+
+    items.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        items[i].Folder = std::move(paths[i]);
+        items[i].Result = S_OK;
+    }
+
+    SarBatchRun(SAR_BATCH_GETCONFIG, &items, threadCount, &stats);
+
+    for (const SAR_BATCH_ITEM& item : items)
+    {
+        if (FAILED(item.Result))
+        {
+            printf("FAILED 0x%08x %s\n", (UINT32)item.Result, item.Folder.c_str());
+        }
+    }
+
+    hr = SarIndexWrite(argv[0], items, threadCount);
+    if (FAILED(hr))
+    {
+        printf("Failed to write index %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    printf("%zu devices indexed (%zu failed) on %u threads in %.3f s: %.0f devices/s\n",
+           stats.Succeeded,
+           stats.Failed,
+           stats.ThreadCount,
+           stats.ElapsedSeconds,
+           items.size() / ((stats.ElapsedSeconds > 0) ? stats.ElapsedSeconds : 1e-9));
+
+    if (stats.Failed != 0)
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarQueryCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "query <index file> [<condition> ...] [--count]".  Prints each matching device with
+    the fields the conditions name, e.g.
+
+        D:\factory\images\0042 ProductID=0x4 Version=0x5 GeoCountryString=PH
+
+    followed by the match count and the time taken to open and search the index.  With --count
+    only the summary is printed.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the index file.
+
+Return Value:
+
+    S_OK on success (even if nothing matches), E_INVALIDARG for a malformed command line, or the
+    failure code from opening the index.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarIndexView index;
+    std::vector<SAR_INDEX_CONDITION> conditions;
+    std::vector<UINT32> matches;
+    BOOL fCountOnly = FALSE;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double milliseconds;
+
+    if (argc < 1)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        SAR_INDEX_CONDITION condition;
+
+        if (0 == strcmp(argv[i], "--count"))
+        {
+            fCountOnly = TRUE;
+            continue;
+        }
+
+        hr = SarIndexParseCondition(argv[i], &condition);
+        if (FAILED(hr))
+        {
+            printf("Unrecognized condition '%s'\n", argv[i]);
+            goto exit;
+        }
+
+        conditions.push_back(condition);
+    }
+
+    hr = index.Open(argv[0]);
+    if (FAILED(hr))
+    {
+        printf("Failed to open index %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    index.Query(conditions.data(), conditions.size(), &matches);
+    milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; !fCountOnly && (i < matches.size()); i++)
+    {
+        const SAR_INDEX_RECORD* record = index.Record(matches[i]);
+        BOOL fPrinted[SarIndexFieldCount] = { FALSE };
+
+        printf("%s", index.Path(matches[i]).c_str());
+        for (const SAR_INDEX_CONDITION& condition : conditions)
+        {
+            char value[16];
+
+            if (!fPrinted[condition.Field])
+            {
+                SarIndexFormatValue(condition.Field, record->Values[condition.Field], value);
+                printf(" %s=%s", SarIndexFieldNames[condition.Field], value);
+                fPrinted[condition.Field] = TRUE;
+            }
+        }
+        printf("\n");
+    }
+
+    printf("%s%zu of %u devices match (%.3f ms)\n",
+           (fCountOnly || matches.empty()) ? "" : "\n",
+           matches.size(),
+           index.RecordCount(),
+           milliseconds);
+
+exit:
+    return hr;
+}
+
+// eof: SarIndex.cpp
+//
@@ -0,0 +1,196 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarIndex.h
+
+Abstract:
+
+    On-disk index of a fleet's provisioning fields, so questions like "which devices have
+    ProductID 0x4, Version 5 and country PH" are answered from one mapped file instead of reading
+    every device's .bin files again.
+
+    Layout (all fields little-endian):
+
+        SAR_INDEX_HEADER
+        SAR_INDEX_RECORD[RecordCount]           sorted by all fields in SAR_INDEX_FIELD order,
+                                                then by path
+        UINT32[FieldCount][RecordCount]         per field, the record numbers ordered by that
+                                                field's value (ties by record number)
+        device paths (PathsSize bytes, not terminated)
+
+    Records are sorted by all fields, so matches come out grouped by configuration, and the
+    per-field orderings turn a condition on any field into one binary search.  A query starts from
+    the range of its most selective condition and checks the others on each record in that range,
+    so its cost follows the number of candidates rather than the size of the fleet.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarBatch.h"
+#include "SarMappedFile.h"
+
+#include <string>
+#include <vector>
+
+static const UINT32 SAR_INDEX_SIGNATURE = 0x49524153; // "SARI"
+static const UINT16 SAR_INDEX_FORMAT_VERSION = 1;
+
+typedef enum _SAR_INDEX_FIELD
+{
+    SarIndexProductId = 0,                      // SAR_CONFIG_HEADER
+    SarIndexVersion,
+    SarIndexRevision,
+    SarIndexWlanTechnology,
+    SarIndexGeoCountryString,                   // REGION_CONFIG_VALUES
+    SarIndexGeoLocationValue,
+    SarIndexDynamicGeoState,
+    SarIndexDynamicGeoType,
+    SarIndexSafetyTimer,                        // SAR_CONFIG_VALUES
+    SarIndexSafetyRequestResponseTimeout,
+    SarIndexUnsolicitedUpdateTimer,
+    SarIndexFieldCount
+} SAR_INDEX_FIELD;
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct _SAR_INDEX_HEADER
+{
+    UINT32 Signature;
+    UINT16 FormatVersion;
+    UINT16 FieldCount;
+    UINT32 RecordCount;
+    UINT32 PathsSize;
+    UINT32 TotalSize;
+    UINT32 Crc32c;        // CRC-32C of the rest of the index.
+    UINT64 Reserved;
+} SAR_INDEX_HEADER;
+C_ASSERT(sizeof(SAR_INDEX_HEADER) == 0x20);
+
+typedef struct _SAR_INDEX_RECORD
+{
+    UINT32 Values[SarIndexFieldCount];
+    UINT32 PathOffset;    // From the start of the device paths.
+    UINT32 PathSize;
+} SAR_INDEX_RECORD;
+C_ASSERT(sizeof(SAR_INDEX_RECORD) == 0x34);
+#pragma pack(pop)
+
+// One condition of a query: Low <= value <= High, or value != Low when fNotEqual is set.
+//
+typedef struct _SAR_INDEX_CONDITION
+{
+    SAR_INDEX_FIELD Field;
+    UINT32 Low;
+    UINT32 High;
+    BOOL fNotEqual;
+} SAR_INDEX_CONDITION;
+
+// Returns the getconfig name of a field, e.g. "ProductID".
+//
+LPCSTR
+SarIndexFieldName(
+    SAR_INDEX_FIELD field
+    );
+
+// Parses "<field><op><value>" with op one of =, !=, <, <=, >, >=.  Fields are named as getconfig
+// prints them (or "Country" for GeoCountryString, which also takes a two-letter code as its value.)
+//
+_Check_return_
+HRESULT
+SarIndexParseCondition(
+    _In_z_ LPCSTR text,
+    _Out_ SAR_INDEX_CONDITION* condition
+    );
+
+// Writes an index of the configurations read by a batch getconfig; failed items are left out.
+//
+_Check_return_
+HRESULT
+SarIndexWrite(
+    _In_z_ LPCSTR path,
+    _In_ const std::vector<SAR_BATCH_ITEM>& items,
+    UINT32 threadCount
+    );
+
+// Maps an index file and validates it.
+//
+class SarIndexView
+{
+public:
+
+    SarIndexView();
+
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR path
+        );
+
+    UINT32
+    RecordCount() const
+    {
+        return m_recordCount;
+    }
+
+    const SAR_INDEX_RECORD*
+    Record(
+        UINT32 record
+        ) const
+    {
+        return &m_records[record];
+    }
+
+    std::string
+    Path(
+        UINT32 record
+        ) const
+    {
+        return std::string(m_paths + m_records[record].PathOffset, m_records[record].PathSize);
+    }
+
+    // Appends the numbers of the records meeting every condition, in index order.
+    //
+    VOID
+    Query(
+        _In_reads_(conditionCount) const SAR_INDEX_CONDITION* conditions,
+        size_t conditionCount,
+        _Inout_ std::vector<UINT32>* matches
+        ) const;
+
+private:
+
+    SarMappedFile m_file;
+    const SAR_INDEX_RECORD* m_records;
+    const UINT32* m_orders;               // [SarIndexFieldCount][m_recordCount]
+    const char* m_paths;
+    UINT32 m_recordCount;
+};
+
+// Implements "index <index file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]".
+//
+_Check_return_
+HRESULT
+SarIndexCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// Implements "query <index file> [<condition> ...] [--count]".
+//
+_Check_return_
+HRESULT
+SarQueryCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarIndex.h
+//
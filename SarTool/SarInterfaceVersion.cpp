@@ -0,0 +1,318 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarInterfaceVersion.cpp
+
+Abstract:
+
+    The cached WDI_GET_INTERFACE_VERSION handshake.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarInterfaceVersion.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// A fan-out handshakes every interface at once, so the cache's read-modify-write is serialized
+// within the process, and each write goes through a temporary file of its own so writers in
+// other processes cannot write into it.
+//
+static std::mutex s_cacheLock;
+static std::atomic<UINT32> s_temporaryCount(0);
+
+static
+VOID
+SarFormatInterfaceGuid(
+    _In_ const GUID& guid,
+    _Out_writes_(37) char* szGuid
+    )
+{
+    snprintf(szGuid, 37, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+        guid.Data1, guid.Data2, guid.Data3,
+        guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+        guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+}
+
+std::string
+SarInterfaceVersionCacheDefaultPath()
+{
+    std::string path;
+
+#ifdef _WIN32
+    const char* localAppData = getenv("LOCALAPPDATA");
+
+    if ((localAppData != nullptr) && (*localAppData != '\0'))
+    {
+        path = std::string(localAppData) + SAR_PATH_SEPARATOR + "SarTool";
+    }
+#else
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+
+    if ((cacheHome != nullptr) && (*cacheHome != '\0'))
+    {
+        path = std::string(cacheHome) + SAR_PATH_SEPARATOR + "sartool";
+    }
+    else if ((home != nullptr) && (*home != '\0'))
+    {
+        path = std::string(home) + SAR_PATH_SEPARATOR + ".cache" + SAR_PATH_SEPARATOR + "sartool";
+    }
+#endif
+
+    if (!path.empty())
+    {
+        path += SAR_PATH_SEPARATOR;
+        path += SAR_INTERFACE_VERSION_CACHE_NAME;
+    }
+
+    return path;
+}
+
+_Check_return_
+HRESULT
+SarInterfaceVersionCacheLookup(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_DEVICE_IDENTITY& identity,
+    _Out_ SAR_INTERFACE_VERSION* version
+    )
+/*++
+
+Routine Description:
+
+    Finds the line for the identity's interface in the cache file.  Malformed lines are ignored,
+    so a damaged cache only costs a handshake.
+
+Arguments:
+
+    path - The cache file.
+    identity - The interface and its driver version.
+    version - Receives the cached version; 0.0 if there is none.
+
+Return Value:
+
+    S_OK if the cache has the interface at identity.DriverVersion, otherwise S_FALSE.
+
+--*/
+{
+    char szGuid[37];
+    std::ifstream input(path);
+    std::string line;
+
+    version->Major = 0;
+    version->Minor = 0;
+
+    SarFormatInterfaceGuid(identity.InterfaceGuid, szGuid);
+
+    while (std::getline(input, line))
+    {
+        char lineGuid[37];
+        char driverVersion[sizeof(identity.DriverVersion)];
+        UINT32 major;
+        UINT32 minor;
+        int guidLength = 0;
+
+        // %36s stops after 36 characters, so the GUID must also be followed by a space.
+        if ((sscanf(line.c_str(), "%36s%n %u %u %63[^\r\n]", lineGuid, &guidLength, &major, &minor, driverVersion) == 4) &&
+            (line[guidLength] == ' ') &&
+            (0 == strcmp(lineGuid, szGuid)) &&
+            (0 == strcmp(driverVersion, identity.DriverVersion)))
+        {
+            version->Major = major;
+            version->Minor = minor;
+            return S_OK;
+        }
+    }
+
+    return S_FALSE;
+}
+
+_Check_return_
+HRESULT
+SarInterfaceVersionCacheStore(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_DEVICE_IDENTITY& identity,
+    _In_ const SAR_INTERFACE_VERSION& version
+    )
+/*++
+
+Routine Description:
+
+    Rewrites the cache file with the interface's line replaced (or added.)  The file is written
+    beside the cache and renamed over it, so readers never see a partial cache.  Stores from the
+    same process are serialized so none loses another's line; two processes storing at once can
+    still lose one, which only costs a handshake.
+
+Arguments:
+
+    path - The cache file; its directory is created if needed.
+    identity - The interface and its driver version.
+    version - The version the driver reported.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    char szGuid[37];
+    std::vector<std::string> lines;
+    std::string temporaryPath;
+    FILE* output = nullptr;
+    std::error_code ec;
+    std::lock_guard<std::mutex> lock(s_cacheLock);
+
+#ifdef _WIN32
+    temporaryPath = std::string(path) + "." + std::to_string(_getpid());
+#else
+    temporaryPath = std::string(path) + "." + std::to_string(getpid());
+#endif
+    temporaryPath += "." + std::to_string(s_temporaryCount++) + ".tmp";
+
+    SarFormatInterfaceGuid(identity.InterfaceGuid, szGuid);
+
+    {
+        std::ifstream input(path);
+        std::string line;
+
+        while (std::getline(input, line))
+        {
+            if (line.compare(0, strlen(szGuid), szGuid) != 0)
+            {
+                lines.push_back(line);
+            }
+        }
+    }
+
+    if (fs::path(path).has_parent_path())
+    {
+        fs::create_directories(fs::path(path).parent_path(), ec);
+    }
+
+    output = fopen(temporaryPath.c_str(), "w");
+    if (output == nullptr)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    for (const std::string& line : lines)
+    {
+        fprintf(output, "%s\n", line.c_str());
+    }
+    fprintf(output, "%s %u %u %s\n", szGuid, version.Major, version.Minor, identity.DriverVersion);
+
+    if (ferror(output))
+    {
+        hr = E_FAIL;
+    }
+
+    if ((fclose(output) != 0) && SUCCEEDED(hr))
+    {
+        hr = E_FAIL;
+    }
+
+    if (FAILED(hr))
+    {
+        fs::remove(temporaryPath, ec);
+        goto exit;
+    }
+
+    fs::rename(temporaryPath, path, ec);
+    if (ec)
+    {
+        hr = SarHresultFromErrno(ec.value());
+        fs::remove(temporaryPath, ec);
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarWifiHandshake(
+    _In_ SarDeviceService* device,
+    _In_opt_z_ LPCSTR cachePath,
+    _Out_ SAR_INTERFACE_VERSION* version
+    )
+/*++
+
+Routine Description:
+
+    Learns the SAR interface version of the device's driver, from the cache if it has the
+    interface at its current driver version and otherwise from WDI_GET_INTERFACE_VERSION, and
+    checks that SarTool can drive it.
+
+Arguments:
+
+    device - The device service.
+    cachePath - The cache file, or nullptr.  Nothing is cached for a device that cannot identify
+                its driver.
+    version - Receives the driver's version; 0.0 if it predates the opcode.
+
+Return Value:
+
+    S_OK if the version is compatible, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if it is not,
+    or the failure code of WDI_GET_INTERFACE_VERSION.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_DEVICE_IDENTITY identity;
+    BOOL fPersist = (cachePath != nullptr) && (*cachePath != '\0');
+
+    if (fPersist)
+    {
+        fPersist = SUCCEEDED(device->Identify(&identity));
+    }
+
+    if (fPersist && (SarInterfaceVersionCacheLookup(cachePath, identity, version) == S_OK))
+    {
+        goto check;
+    }
+
+    hr = SarWifiGetInterfaceVersion(device, version);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    if (fPersist)
+    {
+        // A cache that cannot be written only costs a handshake next time.
+        (VOID)SarInterfaceVersionCacheStore(cachePath, identity, *version);
+    }
+
+check:
+    hr = SarInterfaceVersionIsCompatible(*version) ? S_OK : HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH);
+
+exit:
+    return hr;
+}
+
+// eof: SarInterfaceVersion.cpp
+//
@@ -0,0 +1,93 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarInterfaceVersion.h
+
+Abstract:
+
+    The WDI_GET_INTERFACE_VERSION handshake, which checks that the driver implements the SAR
+    interface this tool was built against (WDI_SAR_INTERFACE_VERSION_MAJOR/MINOR.)
+
+    A driver's version only changes when the driver does, so the handshake is done once per WLAN
+    interface and driver version and its result kept in a small file in the user's cache
+    directory, one line per interface:
+
+        <interface GUID> <major> <minor> <driver version>
+
+    Later runs, and later sessions of a long-running client, find the version there without a
+    device-service round-trip.  A driver update changes the driver version and so repeats the
+    handshake.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarDeviceService.h"
+
+#include <string>
+
+#define SAR_INTERFACE_VERSION_CACHE_NAME "interface-version.cache"
+
+// TRUE if SarTool can drive a driver implementing version: the same major version, or 0.0 for a
+// driver that predates WDI_GET_INTERFACE_VERSION.  Minor versions only add to the interface.
+//
+inline
+BOOL
+SarInterfaceVersionIsCompatible(
+    _In_ const SAR_INTERFACE_VERSION& version
+    )
+{
+    return ((version.Major == 0) && (version.Minor == 0)) ||
+           (version.Major == (UINT32)WDI_SAR_INTERFACE_VERSION_MAJOR);
+}
+
+// Returns <LOCALAPPDATA>\SarTool\interface-version.cache on Windows and
+// <XDG_CACHE_HOME or ~/.cache>/sartool/interface-version.cache elsewhere, or an empty string if
+// there is no such directory.
+//
+std::string
+SarInterfaceVersionCacheDefaultPath();
+
+// Looks up the version cached for the identity's interface.  Returns S_FALSE if there is none,
+// or if it was recorded for a different driver version.
+//
+_Check_return_
+HRESULT
+SarInterfaceVersionCacheLookup(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_DEVICE_IDENTITY& identity,
+    _Out_ SAR_INTERFACE_VERSION* version
+    );
+
+// Records the version for the identity's interface, replacing any earlier entry for it.
+//
+_Check_return_
+HRESULT
+SarInterfaceVersionCacheStore(
+    _In_z_ LPCSTR path,
+    _In_ const SAR_DEVICE_IDENTITY& identity,
+    _In_ const SAR_INTERFACE_VERSION& version
+    );
+
+// Returns the cached version of the device's driver, or sends WDI_GET_INTERFACE_VERSION and
+// caches the reply.  cachePath is nullptr to keep nothing across calls.  Fails with
+// HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH), with version filled in, if the driver's version is
+// not compatible.
+//
+_Check_return_
+HRESULT
+SarWifiHandshake(
+    _In_ SarDeviceService* device,
+    _In_opt_z_ LPCSTR cachePath,
+    _Out_ SAR_INTERFACE_VERSION* version
+    );
+
+// eof: SarInterfaceVersion.h
+//
@@ -0,0 +1,254 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarMappedFile.cpp
+
+Abstract:
+
+    Read-only memory-mapped access to provisioning files.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarMappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SarMappedFile::SarMappedFile() :
+    m_data(nullptr),
+    m_size(0),
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_hMapping(NULL)
+#else
+    m_fd(-1)
+#endif
+{
+}
+
+SarMappedFile::~SarMappedFile()
+{
+    Close();
+}
+
+_Check_return_
+HRESULT
+SarMappedFile::Open(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Maps the specified file read-only.  Any previously mapped file is released first.  An empty
+    file opens successfully but yields no data.
+
+Arguments:
+
+    path - The file to map.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    Close();
+
+#ifdef _WIN32
+    LARGE_INTEGER fileSize = { 0 };
+
+    m_hFile = CreateFileA(path,
+                          GENERIC_READ,
+                          FILE_SHARE_READ,
+                          NULL,
+                          OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL,
+                          NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+
+    if (!GetFileSizeEx(m_hFile, &fileSize))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+
+    // CreateFileMapping rejects empty files.
+    if (fileSize.QuadPart == 0)
+    {
+        goto exit;
+    }
+
+    m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_hMapping == NULL)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+
+    m_data = (const UINT8*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == nullptr)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+
+    m_size = (size_t)fileSize.QuadPart;
+#else
+    struct stat fileStat;
+    void* mapping;
+
+    m_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (fstat(m_fd, &fileStat) != 0)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    // mmap rejects empty files.
+    if (fileStat.st_size == 0)
+    {
+        goto exit;
+    }
+
+    mapping = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    m_data = (const UINT8*)mapping;
+    m_size = (size_t)fileStat.st_size;
+#endif
+
+exit:
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+VOID
+SarMappedFile::Close()
+/*++
+
+Routine Description:
+
+    Unmaps the file and releases its handles.  Outstanding views become invalid.
+
+Arguments:
+
+    VOID
+
+Return Value:
+
+    VOID
+
+--*/
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+
+    if (m_hMapping != NULL)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data != nullptr)
+    {
+        munmap((void*)m_data, m_size);
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+_Check_return_
+HRESULT
+SarMappedConfigFolder::Open(
+    _In_z_ LPCSTR folder
+    )
+/*++
+
+Routine Description:
+
+    Maps the four provisioning files in the specified folder.
+
+Arguments:
+
+    folder - The folder containing the .bin files.
+
+Return Value:
+
+    S_OK if every file was mapped and is large enough for its struct (or holds a valid compressed
+    power table), otherwise the failure code of the first file that was not.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_POWER_TABLE decoded;
+
+    for (int blobId = 0; blobId < SarBlobCount; blobId++)
+    {
+        HRESULT hrBlob = m_files[blobId].Open(SarConfigBlobPath(folder, (SAR_CONFIG_BLOB_ID)blobId).c_str());
+
+        if (SUCCEEDED(hrBlob) &&
+            (m_files[blobId].Size() < SarConfigBlobInfo[blobId].Size) &&
+            !((blobId == SarBlobPowerTable) && SUCCEEDED(SarDecompressPowerTable(m_files[blobId].Data(), m_files[blobId].Size(), &decoded))))
+        {
+            hrBlob = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        if (SUCCEEDED(hr) && FAILED(hrBlob))
+        {
+            hr = hrBlob;
+        }
+    }
+
+    return hr;
+}
+
+// eof: SarMappedFile.cpp
+//
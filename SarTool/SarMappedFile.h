@@ -0,0 +1,145 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarMappedFile.h
+
+Abstract:
+
+    Read-only memory-mapped access to provisioning files.  SarMappedFile maps a single file and
+    hands out bounds-checked typed views into it; SarMappedConfigFolder maps the four .bin files
+    of a provisioning folder and exposes SAR_CONFIG_HEADER, SAR_CONFIG_VALUES, REGION_CONFIG_VALUES
+    and SAR_POWER_TABLE views without copying them.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+#include "SarTableCompression.h"
+
+class SarMappedFile
+{
+public:
+
+    SarMappedFile();
+    ~SarMappedFile();
+
+    SarMappedFile(const SarMappedFile&) = delete;
+    SarMappedFile& operator=(const SarMappedFile&) = delete;
+
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR path
+        );
+
+    VOID
+    Close();
+
+    const UINT8*
+    Data() const
+    {
+        return m_data;
+    }
+
+    size_t
+    Size() const
+    {
+        return m_size;
+    }
+
+    // Returns a view of a T located at the specified offset, or nullptr if the file is too short
+    // or the location is not suitably aligned for T.
+    //
+    template <typename T>
+    const T*
+    View(
+        size_t offset = 0
+        ) const
+    {
+        if ((m_data == nullptr) ||
+            (offset > m_size) ||
+            ((m_size - offset) < sizeof(T)) ||
+            ((((size_t)m_data + offset) % alignof(T)) != 0))
+        {
+            return nullptr;
+        }
+
+        return reinterpret_cast<const T*>(m_data + offset);
+    }
+
+private:
+
+    const UINT8* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_hFile;
+    HANDLE m_hMapping;
+#else
+    int m_fd;
+#endif
+};
+
+class SarMappedConfigFolder
+{
+public:
+
+    // Maps every .bin file in the folder.  Files that are missing or too short yield a null view;
+    // the first such failure is returned but the remaining files are still mapped.
+    //
+    _Check_return_
+    HRESULT
+    Open(
+        _In_z_ LPCSTR folder
+        );
+
+    const SarMappedFile&
+    File(
+        SAR_CONFIG_BLOB_ID blobId
+        ) const
+    {
+        return m_files[blobId];
+    }
+
+    const SAR_CONFIG_HEADER*
+    Header() const
+    {
+        return m_files[SarBlobHeader].View<SAR_CONFIG_HEADER>();
+    }
+
+    const SAR_CONFIG_VALUES*
+    Values() const
+    {
+        return m_files[SarBlobValues].View<SAR_CONFIG_VALUES>();
+    }
+
+    const REGION_CONFIG_VALUES*
+    Region() const
+    {
+        return m_files[SarBlobRegion].View<REGION_CONFIG_VALUES>();
+    }
+
+    // Views a raw power table in place; a compressed one is decompressed into *decoded.
+    //
+    const SAR_POWER_TABLE*
+    PowerTable(
+        _Out_ SAR_POWER_TABLE* decoded
+        ) const
+    {
+        return SarPowerTableView(m_files[SarBlobPowerTable].Data(), m_files[SarBlobPowerTable].Size(), decoded);
+    }
+
+private:
+
+    SarMappedFile m_files[SarBlobCount];
+};
+
+// eof: SarMappedFile.h
+//
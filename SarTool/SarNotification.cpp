@@ -0,0 +1,403 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarNotification.cpp
+
+Abstract:
+
+    Event-driven pipeline for unsolicited SAR notifications.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarNotification.h"
+#include "SarCodec.h"
+#include "SarStats.h"
+#include "Dmf_Wlan_Public.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <chrono>
+
+SarNotificationPipeline::SarNotificationPipeline(
+    _In_opt_ FILE* stream
+    ) :
+    m_stream(stream),
+    m_eventLog(nullptr),
+    m_analytics(nullptr),
+    m_fSleeping(false),
+    m_fStopping(false),
+    m_received(0),
+    m_dropped(0),
+    m_logged(0),
+    m_batches(0),
+    m_eventLogErrors(0),
+    m_monotonicAnchor(0),
+    m_wallClockAnchor(0)
+{
+}
+
+SarNotificationPipeline::~SarNotificationPipeline()
+{
+    Stop();
+}
+
+VOID
+SarNotificationPipeline::SetEventLog(
+    _In_opt_ SarEventLogWriter* eventLog
+    )
+{
+    m_eventLog = eventLog;
+}
+
+VOID
+SarNotificationPipeline::SetAnalytics(
+    _In_opt_ SarRequestAnalytics* analytics
+    )
+{
+    m_analytics = analytics;
+}
+
+_Check_return_
+HRESULT
+SarNotificationPipeline::Start()
+{
+    m_monotonicAnchor = SarStatsNow();
+    m_wallClockAnchor = (UINT64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    m_fStopping = false;
+
+    m_consumer = std::thread(&SarNotificationPipeline::ConsumerLoop, this);
+    return S_OK;
+}
+
+VOID
+SarNotificationPipeline::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fStopping = true;
+    }
+    m_wake.notify_one();
+    m_progress.notify_all();
+
+    if (m_consumer.joinable())
+    {
+        m_consumer.join();
+
+        if (m_analytics != nullptr)
+        {
+            m_analytics->PrintSummary(SarStatsNow());
+        }
+    }
+}
+
+VOID
+SarNotificationPipeline::Post(
+    _In_ const SAR_NOTIFICATION* notification
+    )
+/*++
+
+Routine Description:
+
+    Queues a notification for the consumer.  The consumer publishes m_fSleeping before its final
+    check of the ring and the ring publishes its tail before this reads m_fSleeping (both seq_cst),
+    so either the consumer sees the new notification or this sees the consumer asleep and wakes it.
+    The lock is only taken in the second case, and only to order the wake with the consumer's wait.
+
+--*/
+{
+    m_received.fetch_add(1, std::memory_order_relaxed);
+
+    if (!m_ring.TryPush(*notification))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (m_fSleeping.load(std::memory_order_seq_cst))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+        }
+        m_wake.notify_one();
+    }
+}
+
+VOID
+SarNotificationPipeline::WaitForHandled(
+    UINT64 count
+    )
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    // Drops are counted by the producer without the lock, so also re-check once a second in case
+    // the notification that completes the count was dropped.
+    while ((m_logged + m_dropped < count) && !m_fStopping)
+    {
+        m_progress.wait_for(lock, std::chrono::seconds(1));
+    }
+}
+
+VOID
+SarNotificationPipeline::GetCounters(
+    _Out_ SAR_NOTIFICATION_COUNTERS* counters
+    ) const
+{
+    counters->Received = m_received.load(std::memory_order_relaxed);
+    counters->Dropped = m_dropped.load(std::memory_order_relaxed);
+    counters->Logged = m_logged.load(std::memory_order_relaxed);
+    counters->Batches = m_batches.load(std::memory_order_relaxed);
+    counters->EventLogErrors = m_eventLogErrors.load(std::memory_order_relaxed);
+}
+
+VOID
+SarNotificationPipeline::ConsumerLoop()
+{
+    SAR_NOTIFICATION batch[SAR_NOTIFICATION_BATCH_SIZE];
+
+    for (;;)
+    {
+        size_t count = m_ring.PopBatch(batch, ARRAYSIZE(batch));
+
+        if ((m_analytics != nullptr) && (m_analytics->TimeToSummary(SarStatsNow()) == 0))
+        {
+            m_analytics->PrintSummary(SarStatsNow());
+        }
+
+        if (count != 0)
+        {
+            LogBatch(batch, count);
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_logged += count;
+                m_batches++;
+            }
+            m_progress.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        if (m_fStopping)
+        {
+            // The ring was empty after Stop was requested; anything posted later is not logged.
+            break;
+        }
+
+        m_fSleeping.store(true, std::memory_order_seq_cst);
+        if (m_ring.IsEmpty())
+        {
+            // With analytics, wake up in time for the next summary even if nothing arrives.
+            if (m_analytics != nullptr)
+            {
+                m_wake.wait_for(lock, std::chrono::nanoseconds(m_analytics->TimeToSummary(SarStatsNow())));
+            }
+            else
+            {
+                m_wake.wait(lock);
+            }
+        }
+        m_fSleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+static
+VOID
+SarAppendFormat(
+    _Inout_ std::string* buffer,
+    _In_z_ LPCSTR format,
+    ...
+    )
+{
+    char line[128];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (length > 0)
+    {
+        buffer->append(line, ((size_t)length < sizeof(line)) ? (size_t)length : sizeof(line) - 1);
+    }
+}
+
+VOID
+SarNotificationPipeline::LogBatch(
+    _In_reads_(count) const SAR_NOTIFICATION* notifications,
+    size_t count
+    )
+/*++
+
+Routine Description:
+
+    Decodes a batch of notifications into one buffer and writes it with a single write.  SAR
+    requests are logged with their arrival time (UTC); anything else is dumped as GUID, opcode
+    and data bytes.  If there is an event log, the batch is appended to it and flushed as well,
+    and if there is an analytics stage, every notification is recorded in it.
+
+--*/
+{
+    m_buffer.clear();
+
+    for (size_t i = 0; (m_stream != nullptr) && (i < count); i++)
+    {
+        const SAR_NOTIFICATION* notification = &notifications[i];
+        UINT32 keptSize = (notification->DataSize < SAR_NOTIFICATION_MAX_DATA) ? notification->DataSize : SAR_NOTIFICATION_MAX_DATA;
+
+        if (0 == memcmp(&notification->DeviceService, &WDI_SAR_DEVICE_SERVICE, sizeof(GUID)))
+        {
+            UINT64 wallClock = m_wallClockAnchor + (notification->Timestamp - m_monotonicAnchor);
+            UINT64 seconds = wallClock / 1000000000;
+            UINT32 request = (keptSize >= 2) ? (UINT32)(notification->Data[0] | (notification->Data[1] << 8)) : 0;
+
+            SarAppendFormat(&m_buffer,
+                            "%2.2u:%2.2u:%2.2u.%3.3u : We got SAR unsolicited request 0x%x\n",
+                            (UINT32)((seconds / 3600) % 24),
+                            (UINT32)((seconds / 60) % 60),
+                            (UINT32)(seconds % 60),
+                            (UINT32)((wallClock / 1000000) % 1000),
+                            request);
+            continue;
+        }
+
+        const GUID& guid = notification->DeviceService;
+        SarAppendFormat(&m_buffer,
+                        "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}\nopcode 0x%x\ndata size %u\n",
+                        guid.Data1, guid.Data2, guid.Data3,
+                        guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+                        guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7],
+                        notification->NotificationCode,
+                        notification->DataSize);
+
+        for (UINT32 j = 0; j < keptSize; j++)
+        {
+            SarAppendFormat(&m_buffer, "0x%2.2x ", notification->Data[j]);
+        }
+        m_buffer += "\n";
+    }
+
+    if (m_stream != nullptr)
+    {
+        fwrite(m_buffer.data(), 1, m_buffer.size(), m_stream);
+        fflush(m_stream);
+    }
+
+    if (m_eventLog != nullptr)
+    {
+        LogBatchToEventLog(notifications, count);
+    }
+
+    for (size_t i = 0; (m_analytics != nullptr) && (i < count); i++)
+    {
+        const SAR_NOTIFICATION* notification = &notifications[i];
+
+        if (0 == memcmp(&notification->DeviceService, &WDI_SAR_DEVICE_SERVICE, sizeof(GUID)))
+        {
+            UINT32 request = (notification->DataSize >= 2) ? SarLoadLe16(notification->Data) : 0;
+
+            m_analytics->Record(SarAnalyticsSarRequest, request, notification->Timestamp);
+        }
+        else
+        {
+            m_analytics->Record(SarAnalyticsNotification, notification->NotificationCode, notification->Timestamp);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SarStatsRecord(SarStatUnsolicitedDelivery, notifications[i].Timestamp);
+    }
+}
+
+VOID
+SarNotificationPipeline::LogBatchToEventLog(
+    _In_reads_(count) const SAR_NOTIFICATION* notifications,
+    size_t count
+    )
+/*++
+
+Routine Description:
+
+    Appends a batch to the event log and flushes it, so the log is never more than one batch
+    behind.  SAR requests carry just their data; other notifications are prefixed with the
+    device service GUID.  Events the log fails to write are counted in EventLogErrors.
+
+--*/
+{
+    UINT8 blob[sizeof(GUID) + SAR_NOTIFICATION_MAX_DATA];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const SAR_NOTIFICATION* notification = &notifications[i];
+        UINT32 keptSize = (notification->DataSize < SAR_NOTIFICATION_MAX_DATA) ? notification->DataSize : SAR_NOTIFICATION_MAX_DATA;
+        UINT64 timestamp = (m_wallClockAnchor + (notification->Timestamp - m_monotonicAnchor)) / 1000;
+        HRESULT hr;
+
+        if (0 == memcmp(&notification->DeviceService, &WDI_SAR_DEVICE_SERVICE, sizeof(GUID)))
+        {
+            hr = m_eventLog->Append(SarEventWlanSarRequest, timestamp, notification->NotificationCode, notification->Data, keptSize);
+        }
+        else
+        {
+            const GUID& guid = notification->DeviceService;
+
+            SarStoreLe32(blob, guid.Data1);
+            SarStoreLe16(blob + 4, guid.Data2);
+            SarStoreLe16(blob + 6, guid.Data3);
+            memcpy(blob + 8, guid.Data4, sizeof(guid.Data4));
+            memcpy(blob + sizeof(GUID), notification->Data, keptSize);
+
+            hr = m_eventLog->Append(SarEventWlanNotification, timestamp, notification->NotificationCode, blob, sizeof(GUID) + keptSize);
+        }
+
+        if (FAILED(hr))
+        {
+            m_eventLogErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (FAILED(m_eventLog->Flush()))
+    {
+        m_eventLogErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+VOID
+SarNotificationSyntheticProducer(
+    _In_ SarNotificationPipeline* pipeline,
+    UINT64 count,
+    UINT32 burstSize,
+    UINT32 burstIntervalMicroseconds
+    )
+{
+    SAR_NOTIFICATION notification;
+
+    memset(&notification, 0, sizeof(notification));
+    notification.DeviceService = WDI_SAR_DEVICE_SERVICE;
+    notification.DataSize = sizeof(UINT16);
+
+    for (UINT64 i = 0; i < count; i++)
+    {
+        if ((i != 0) && (burstSize != 0) && ((i % burstSize) == 0) && (burstIntervalMicroseconds != 0))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(burstIntervalMicroseconds));
+        }
+
+        notification.Timestamp = SarStatsNow();
+        notification.Data[0] = (UINT8)(i % SAR_NOTIFICATION_SYNTHETIC_REQUESTS);
+        notification.Data[1] = 0;
+        pipeline->Post(&notification);
+    }
+}
+
+// eof: SarNotification.cpp
+//
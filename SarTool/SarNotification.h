@@ -0,0 +1,183 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarNotification.h
+
+Abstract:
+
+    Event-driven pipeline for the unsolicited notifications a transmitter sends to request updated
+    SAR status.
+
+    The WLAN callback thread only timestamps the notification, copies it into a lock-free SPSC
+    ring and, if the consumer is asleep, wakes it.  A consumer thread drains the ring in batches,
+    decodes each notification and writes the whole batch to the log with one write, so bursts of
+    notifications never wait on console I/O.  Notifications that arrive while the ring is full are
+    counted and dropped rather than blocking the callback.  The consumer can also append every
+    notification to a binary event log (see SarEventLog.h) and feed it to an analytics stage that
+    summarizes request rates and bursts periodically (see SarAnalytics.h) for long-running monitors.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include "SarAnalytics.h"
+#include "SarEventLog.h"
+#include "SarSpscRing.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Bytes of notification data kept; the SAR request itself is a UINT16.
+//
+static const UINT32 SAR_NOTIFICATION_MAX_DATA = 48;
+
+// Notifications in flight between the callback and the consumer, and the most the consumer
+// writes in one batch.
+//
+static const size_t SAR_NOTIFICATION_RING_CAPACITY = 1024;
+static const size_t SAR_NOTIFICATION_BATCH_SIZE = 64;
+
+typedef struct _SAR_NOTIFICATION
+{
+    UINT64 Timestamp;               // SarStatsNow() when the notification arrived.
+    GUID DeviceService;
+    UINT32 NotificationCode;
+    UINT32 DataSize;                // As sent; only the first SAR_NOTIFICATION_MAX_DATA bytes are kept.
+    UINT8 Data[SAR_NOTIFICATION_MAX_DATA];
+} SAR_NOTIFICATION;
+
+typedef struct _SAR_NOTIFICATION_COUNTERS
+{
+    UINT64 Received;                // Every notification posted, including dropped ones.
+    UINT64 Dropped;                 // Posted while the ring was full.
+    UINT64 Logged;
+    UINT64 Batches;                 // Writes to the log.
+    UINT64 EventLogErrors;          // Events or flushes the event log failed to write.
+} SAR_NOTIFICATION_COUNTERS;
+
+class SarNotificationPipeline
+{
+public:
+
+    // stream, if not null, receives the decoded notifications as text.
+    //
+    explicit
+    SarNotificationPipeline(
+        _In_opt_ FILE* stream
+        );
+
+    ~SarNotificationPipeline();
+
+    SarNotificationPipeline(const SarNotificationPipeline&) = delete;
+    SarNotificationPipeline& operator=(const SarNotificationPipeline&) = delete;
+
+    // Also appends every notification to eventLog, which must stay open until Stop.  Call before
+    // Start.
+    //
+    VOID
+    SetEventLog(
+        _In_opt_ SarEventLogWriter* eventLog
+        );
+
+    // Also feeds every notification to analytics, and has the consumer print its summary whenever
+    // one is due and once more at Stop.  Call before Start.
+    //
+    VOID
+    SetAnalytics(
+        _In_opt_ SarRequestAnalytics* analytics
+        );
+
+    _Check_return_
+    HRESULT
+    Start();
+
+    // Logs whatever is still in the ring, then stops the consumer.
+    //
+    VOID
+    Stop();
+
+    // Called by the single producer (e.g. the WLAN notification callback, which WLAN invokes
+    // serially for a client handle.)  Never blocks on the consumer or on I/O.
+    //
+    VOID
+    Post(
+        _In_ const SAR_NOTIFICATION* notification
+        );
+
+    // Blocks until at least count notifications have been logged or dropped, or the pipeline stops.
+    //
+    VOID
+    WaitForHandled(
+        UINT64 count
+        );
+
+    VOID
+    GetCounters(
+        _Out_ SAR_NOTIFICATION_COUNTERS* counters
+        ) const;
+
+private:
+
+    VOID
+    ConsumerLoop();
+
+    VOID
+    LogBatch(
+        _In_reads_(count) const SAR_NOTIFICATION* notifications,
+        size_t count
+        );
+
+    VOID
+    LogBatchToEventLog(
+        _In_reads_(count) const SAR_NOTIFICATION* notifications,
+        size_t count
+        );
+
+    FILE* m_stream;
+    SarEventLogWriter* m_eventLog;
+    SarRequestAnalytics* m_analytics;   // Consumer only once started.
+    SarSpscRing<SAR_NOTIFICATION, SAR_NOTIFICATION_RING_CAPACITY> m_ring;
+    std::thread m_consumer;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_progress;
+    std::atomic<bool> m_fSleeping;
+    std::atomic<bool> m_fStopping;
+    std::atomic<UINT64> m_received;
+    std::atomic<UINT64> m_dropped;
+    std::atomic<UINT64> m_logged;
+    std::atomic<UINT64> m_batches;
+    std::atomic<UINT64> m_eventLogErrors;
+    UINT64 m_monotonicAnchor;       // SarStatsNow() at Start
+    UINT64 m_wallClockAnchor;       // UTC nanoseconds since 1970 at Start
+    std::string m_buffer;           // Consumer only.
+};
+
+// Stands in for the WLAN callback: posts count SAR requests, cycling through
+// SAR_NOTIFICATION_SYNTHETIC_REQUESTS request codes, from the calling thread in bursts of
+// burstSize, pausing burstIntervalMicroseconds between bursts.
+//
+static const UINT32 SAR_NOTIFICATION_SYNTHETIC_REQUESTS = 4;
+
+VOID
+SarNotificationSyntheticProducer(
+    _In_ SarNotificationPipeline* pipeline,
+    UINT64 count,
+    UINT32 burstSize,
+    UINT32 burstIntervalMicroseconds
+    );
+
+// eof: SarNotification.h
+//
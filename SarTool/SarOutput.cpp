@@ -0,0 +1,581 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarOutput.cpp
+
+Abstract:
+
+    Buffered text, JSON and CSV formatter for configurations and SAR state.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarOutput.h"
+#include "SarCountry.h"
+
+#include <string.h>
+
+_Check_return_
+HRESULT
+SarOutputTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ SAR_OUTPUT_FORMAT* format
+    )
+{
+    static const LPCSTR s_names[] = { "text", "json", "csv" };
+
+    HRESULT hr = S_OK;
+    int kept = 0;
+
+    *format = SarOutputText;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--format")))
+        {
+            BOOL fKnown = FALSE;
+
+            for (int name = 0; (i + 1 < *argc) && (name < (int)ARRAYSIZE(s_names)); name++)
+            {
+                if (0 == _stricmp(argv[i + 1], s_names[name]))
+                {
+                    *format = (SAR_OUTPUT_FORMAT)name;
+                    fKnown = TRUE;
+                }
+            }
+
+            if (!fKnown)
+            {
+                hr = E_INVALIDARG;
+            }
+
+            i++;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return hr;
+}
+
+SarOutput::SarOutput(
+    SAR_OUTPUT_FORMAT format,
+    _In_ FILE* stream
+    ) :
+    m_format(format),
+    m_stream(stream),
+    m_fFirstColumn(TRUE),
+    m_fHeaderWritten(FALSE)
+{
+    m_buffer.reserve(4096);
+}
+
+VOID
+SarOutput::Append(
+    _In_reads_(length) const char* text,
+    size_t length
+    )
+{
+    m_buffer.insert(m_buffer.end(), text, text + length);
+}
+
+VOID
+SarOutput::Append(
+    _In_z_ LPCSTR text
+    )
+{
+    Append(text, strlen(text));
+}
+
+VOID
+SarOutput::AppendDecimal(
+    UINT64 value
+    )
+{
+    char digits[20];
+    size_t count = 0;
+
+    do
+    {
+        digits[sizeof(digits) - 1 - count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    Append(digits + sizeof(digits) - count, count);
+}
+
+VOID
+SarOutput::AppendHex(
+    UINT32 value,
+    UINT32 digits
+    )
+{
+    static const char s_hex[] = "0123456789abcdef";
+    char text[10] = { '0', 'x' };
+    UINT32 count = 1;
+
+    // At least digits digits, more if the value needs them.
+    while ((count < 8) && ((count < digits) || ((value >> (4 * count)) != 0)))
+    {
+        count++;
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        text[2 + i] = s_hex[(value >> (4 * (count - 1 - i))) & 0xf];
+    }
+
+    Append(text, 2 + count);
+}
+
+VOID
+SarOutput::AppendPower(
+    UINT8 value,
+    BOOL fPad
+    )
+/*++
+
+Routine Description:
+
+    Writes a 1/8 dBm power value in dBm with three decimals, which represent every eighth exactly.
+
+Arguments:
+
+    value - The power value, 1/8 dBm.
+    fPad - Pad to six characters on the left, as "%6.3f" does.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    UINT32 thousandths = (value & 7) * 125;
+    UINT32 whole = value >> 3;
+    char text[6] =
+    {
+        (whole >= 10) ? (char)('0' + whole / 10) : ' ',
+        (char)('0' + whole % 10),
+        '.',
+        (char)('0' + thousandths / 100),
+        (char)('0' + (thousandths / 10) % 10),
+        (char)('0' + thousandths % 10),
+    };
+
+    if (fPad || (whole >= 10))
+    {
+        Append(text, sizeof(text));
+    }
+    else
+    {
+        Append(text + 1, sizeof(text) - 1);
+    }
+}
+
+VOID
+SarOutput::AppendQuoted(
+    _In_z_ LPCSTR text
+    )
+{
+    static const char s_hex[] = "0123456789abcdef";
+
+    m_buffer.push_back('"');
+    for (LPCSTR c = text; *c != '\0'; c++)
+    {
+        if (m_format == SarOutputCsv)
+        {
+            // RFC 4180: the only escape is a doubled quote.
+            if (*c == '"')
+            {
+                m_buffer.push_back('"');
+            }
+            m_buffer.push_back(*c);
+        }
+        else if ((*c == '"') || (*c == '\\'))
+        {
+            m_buffer.push_back('\\');
+            m_buffer.push_back(*c);
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            char escape[6] = { '\\', 'u', '0', '0', s_hex[(*c >> 4) & 0xf], s_hex[*c & 0xf] };
+
+            Append(escape, sizeof(escape));
+        }
+        else
+        {
+            m_buffer.push_back(*c);
+        }
+    }
+    m_buffer.push_back('"');
+}
+
+VOID
+SarOutput::AppendIndent()
+{
+    for (const FRAME& frame : m_frames)
+    {
+        if (frame.fList)
+        {
+            Append("    ", 4);
+        }
+    }
+}
+
+VOID
+SarOutput::BeginValue(
+    _In_opt_z_ LPCSTR name
+    )
+{
+    FRAME& frame = m_frames.back();
+
+    switch (m_format)
+    {
+    case SarOutputText:
+        AppendIndent();
+        Append(name);
+        Append(" = ", 3);
+        break;
+
+    case SarOutputJson:
+        if (!frame.fFirst)
+        {
+            m_buffer.push_back(',');
+        }
+        if (name != nullptr)
+        {
+            AppendQuoted(name);
+            m_buffer.push_back(':');
+        }
+        break;
+
+    case SarOutputCsv:
+        if (!m_fFirstColumn)
+        {
+            m_buffer.push_back(',');
+        }
+        m_fFirstColumn = FALSE;
+        if (!m_fHeaderWritten)
+        {
+            if (!m_header.empty())
+            {
+                m_header += ',';
+            }
+            m_header += m_path;
+            m_header += name;
+        }
+        break;
+    }
+
+    frame.fFirst = FALSE;
+}
+
+VOID
+SarOutput::BeginRecord(
+    _In_opt_z_ LPCSTR source
+    )
+{
+    FRAME root = { FALSE, TRUE, 0, 0 };
+
+    m_buffer.clear();
+    m_path.clear();
+    m_frames.assign(1, root);
+    m_fFirstColumn = TRUE;
+
+    if (m_format == SarOutputJson)
+    {
+        m_buffer.push_back('{');
+    }
+
+    if ((source != nullptr) && (m_format != SarOutputText))
+    {
+        BeginValue("Source");
+        AppendQuoted(source);
+    }
+}
+
+VOID
+SarOutput::EndRecord()
+{
+    if (m_format == SarOutputJson)
+    {
+        m_buffer.push_back('}');
+    }
+
+    if (m_format != SarOutputText)
+    {
+        m_buffer.push_back('\n');
+    }
+
+    if ((m_format == SarOutputCsv) && !m_fHeaderWritten)
+    {
+        m_header += '\n';
+        m_buffer.insert(m_buffer.begin(), m_header.begin(), m_header.end());
+        m_fHeaderWritten = TRUE;
+    }
+
+    fwrite(m_buffer.data(), 1, m_buffer.size(), m_stream);
+    m_buffer.clear();
+}
+
+VOID
+SarOutput::BeginGroup(
+    _In_opt_z_ LPCSTR name,
+    _In_opt_z_ LPCSTR textTitle
+    )
+{
+    FRAME& parent = m_frames.back();
+    FRAME frame = { FALSE, TRUE, 0, m_path.size() };
+
+    switch (m_format)
+    {
+    case SarOutputText:
+        if (textTitle != nullptr)
+        {
+            m_buffer.push_back('\n');
+            AppendIndent();
+            Append(textTitle);
+            m_buffer.push_back('\n');
+        }
+        break;
+
+    case SarOutputJson:
+        if (!parent.fFirst)
+        {
+            m_buffer.push_back(',');
+        }
+        if (name != nullptr)
+        {
+            AppendQuoted(name);
+            m_buffer.push_back(':');
+        }
+        m_buffer.push_back('{');
+        break;
+
+    case SarOutputCsv:
+        break;
+    }
+
+    if (name != nullptr)
+    {
+        m_path += name;
+        m_path += '.';
+    }
+    else if (parent.fList)
+    {
+        m_path += '[';
+        m_path += std::to_string(parent.Elements);
+        m_path += "].";
+    }
+
+    parent.fFirst = FALSE;
+    parent.Elements++;
+    m_frames.push_back(frame);
+}
+
+VOID
+SarOutput::EndGroup()
+{
+    m_path.resize(m_frames.back().PathLength);
+    m_frames.pop_back();
+
+    if (m_format == SarOutputJson)
+    {
+        m_buffer.push_back('}');
+    }
+}
+
+VOID
+SarOutput::BeginList(
+    _In_z_ LPCSTR name
+    )
+{
+    FRAME& parent = m_frames.back();
+    FRAME frame = { TRUE, TRUE, 0, m_path.size() };
+
+    if (m_format == SarOutputJson)
+    {
+        if (!parent.fFirst)
+        {
+            m_buffer.push_back(',');
+        }
+        AppendQuoted(name);
+        Append(":[", 2);
+        parent.fFirst = FALSE;
+    }
+
+    m_path += name;
+    m_frames.push_back(frame);
+}
+
+VOID
+SarOutput::EndList()
+{
+    m_path.resize(m_frames.back().PathLength);
+    m_frames.pop_back();
+
+    if (m_format == SarOutputJson)
+    {
+        m_buffer.push_back(']');
+    }
+}
+
+VOID
+SarOutput::Field(
+    _In_z_ LPCSTR name,
+    UINT32 value,
+    UINT32 hexDigits
+    )
+{
+    BeginValue(name);
+
+    if ((m_format == SarOutputText) && (hexDigits != 0))
+    {
+        AppendHex(value, hexDigits);
+    }
+    else
+    {
+        AppendDecimal(value);
+    }
+
+    if (m_format == SarOutputText)
+    {
+        m_buffer.push_back('\n');
+    }
+}
+
+VOID
+SarOutput::Country(
+    _In_z_ LPCSTR name,
+    UINT16 code
+    )
+/*++
+
+Routine Description:
+
+    Writes a GeoCountryString: in text as its AsciiChars with the country and regulatory domain,
+    e.g. "0x5048 (PH, Philippines, other)"; in JSON and CSV as the two-letter code, or the number
+    if it is not one.
+
+Arguments:
+
+    name - The field name.
+    code - The AsciiChars value.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    const SAR_COUNTRY* country = SarCountryFind(code);
+    char letters[3] = { (char)(code >> 8), (char)(code & 0xff), '\0' };
+
+    if (m_format == SarOutputText)
+    {
+        AppendIndent();
+        Append(name);
+        Append(".AsciiChars = ");
+        AppendHex(code, 4);
+        if (country != nullptr)
+        {
+            Append(" (", 2);
+            Append(letters, 2);
+            Append(", ", 2);
+            Append(country->Name);
+            Append(", ", 2);
+            Append(SarRegulatoryDomainName(country->Domain));
+            m_buffer.push_back(')');
+        }
+        m_buffer.push_back('\n');
+        return;
+    }
+
+    BeginValue(name);
+    if ((letters[0] >= 'A') && (letters[0] <= 'Z') && (letters[1] >= 'A') && (letters[1] <= 'Z'))
+    {
+        AppendQuoted(letters);
+    }
+    else
+    {
+        AppendDecimal(code);
+    }
+}
+
+VOID
+SarOutput::PowerTable(
+    _In_z_ LPCSTR name,
+    _In_ const SAR_POWER_TABLE* table
+    )
+{
+    FRAME& frame = m_frames.back();
+
+    switch (m_format)
+    {
+    case SarOutputText:
+        m_buffer.push_back('\n');
+        Append(name);
+        m_buffer.push_back('\n');
+        for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+            {
+                AppendPower(table->PowerValues[row][col], TRUE);
+                if ((col + 1) < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE)
+                {
+                    Append(" - ", 3);
+                }
+            }
+            m_buffer.push_back('\n');
+        }
+        break;
+
+    case SarOutputJson:
+        BeginValue(name);
+        m_buffer.push_back('[');
+        for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            Append((row == 0) ? "[" : ",[");
+            for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+            {
+                if (col != 0)
+                {
+                    m_buffer.push_back(',');
+                }
+                AppendPower(table->PowerValues[row][col], FALSE);
+            }
+            m_buffer.push_back(']');
+        }
+        m_buffer.push_back(']');
+        break;
+
+    case SarOutputCsv:
+        for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
+            {
+                // Column names are only needed for the header row.
+                std::string column = m_fHeaderWritten ? std::string() :
+                    std::string(name) + "[" + std::to_string(row) + "][" + std::to_string(col) + "]";
+
+                BeginValue(column.c_str());
+                AppendPower(table->PowerValues[row][col], FALSE);
+            }
+        }
+        break;
+    }
+
+    frame.fFirst = FALSE;
+}
+
+// eof: SarOutput.cpp
+//
@@ -0,0 +1,191 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarOutput.h
+
+Abstract:
+
+    Formatter for getconfig, batch getconfig and getsar output in text, JSON or CSV.  A record
+    (one device's configuration, or one SAR state) is built in a buffer that is reused from record
+    to record, without printf, and written with one fwrite when the record ends.  Power table
+    entries are 1/8 dBm, so they are formatted exactly in fixed point (31.875 is 31 and 7 * 125
+    thousandths) rather than through floating point.
+
+        text    "Name = 0x..." lines under a title per struct, as getconfig has always printed.
+        json    One object per line: structs are nested objects, lists are arrays, the power table
+                is an array of rows in dBm, and GeoCountryString is its two-letter code.
+        csv     One row per record, after a header row taken from the first record; columns are
+                named by their path, e.g. SAR_CONFIG_VALUES.SARSafetyTimer or SAR_POWER_TABLE[3][1].
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+#include "Wlan_Ihv_Config.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+typedef enum _SAR_OUTPUT_FORMAT
+{
+    SarOutputText = 0,
+    SarOutputJson,
+    SarOutputCsv,
+} SAR_OUTPUT_FORMAT;
+
+// Removes "--format {text | json | csv}" from argv, leaving argv[0] in place.  format receives
+// SarOutputText if the option is absent.  Returns E_INVALIDARG for a missing or unknown format.
+//
+_Check_return_
+HRESULT
+SarOutputTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ SAR_OUTPUT_FORMAT* format
+    );
+
+class SarOutput
+{
+public:
+
+    SarOutput(
+        SAR_OUTPUT_FORMAT format,
+        _In_ FILE* stream = stdout
+        );
+
+    SAR_OUTPUT_FORMAT
+    Format() const
+    {
+        return m_format;
+    }
+
+    // Starts a record; source (a device path or endpoint) is written as its first field in JSON
+    // and CSV.
+    //
+    VOID
+    BeginRecord(
+        _In_opt_z_ LPCSTR source
+        );
+
+    // Writes the record with a single fwrite and empties the buffer for the next one.
+    //
+    VOID
+    EndRecord();
+
+    // Starts a struct.  name is the JSON key and CSV prefix (nullptr for a list element);
+    // textTitle is the line printed before it in text ("" for a blank line, nullptr for none.)
+    //
+    VOID
+    BeginGroup(
+        _In_opt_z_ LPCSTR name,
+        _In_opt_z_ LPCSTR textTitle
+        );
+
+    VOID
+    EndGroup();
+
+    VOID
+    BeginList(
+        _In_z_ LPCSTR name
+        );
+
+    VOID
+    EndList();
+
+    // Writes a value as hexDigits hex digits in text (or decimal when hexDigits is 0), and always
+    // as decimal in JSON and CSV.
+    //
+    VOID
+    Field(
+        _In_z_ LPCSTR name,
+        UINT32 value,
+        UINT32 hexDigits
+        );
+
+    VOID
+    Country(
+        _In_z_ LPCSTR name,
+        UINT16 code
+        );
+
+    VOID
+    PowerTable(
+        _In_z_ LPCSTR name,
+        _In_ const SAR_POWER_TABLE* table
+        );
+
+private:
+
+    typedef struct _FRAME
+    {
+        BOOL fList;
+        BOOL fFirst;              // Nothing written in this frame yet, for JSON commas.
+        UINT32 Elements;          // List elements so far.
+        size_t PathLength;        // m_path length to restore when the frame ends.
+    } FRAME;
+
+    VOID
+    Append(
+        _In_reads_(length) const char* text,
+        size_t length
+        );
+
+    VOID
+    Append(
+        _In_z_ LPCSTR text
+        );
+
+    VOID
+    AppendDecimal(
+        UINT64 value
+        );
+
+    VOID
+    AppendHex(
+        UINT32 value,
+        UINT32 digits
+        );
+
+    VOID
+    AppendPower(
+        UINT8 value,
+        BOOL fPad
+        );
+
+    VOID
+    AppendQuoted(
+        _In_z_ LPCSTR text
+        );
+
+    VOID
+    AppendIndent();
+
+    // Writes what precedes a value: "name = " in text, the comma and key in JSON, the comma (and
+    // the header column, for the first record) in CSV.
+    //
+    VOID
+    BeginValue(
+        _In_opt_z_ LPCSTR name
+        );
+
+    SAR_OUTPUT_FORMAT m_format;
+    FILE* m_stream;
+    std::vector<char> m_buffer;
+    std::string m_header;         // CSV header row, built during the first record.
+    std::string m_path;           // CSV column prefix of the current frame.
+    std::vector<FRAME> m_frames;
+    BOOL m_fFirstColumn;          // No CSV column written yet in this record.
+    BOOL m_fHeaderWritten;
+};
+
+// eof: SarOutput.h
+//
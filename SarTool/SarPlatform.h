@@ -0,0 +1,218 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarPlatform.h
+
+Abstract:
+
+    Platform definitions shared by the portable SarTool modules.
+
+    On Windows this simply pulls in the SDK headers.  Elsewhere (e.g. Linux provisioning hosts) it
+    supplies the small subset of Windows types, HRESULT codes and SAL annotations used by
+    Dmf_Wlan_Public.h, Wlan_Ihv_Config.h and the Sar*.cpp modules so they compile unmodified.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#ifdef _WIN32
+
+// The portable modules use the standard C runtime (fopen, sprintf, ...) so they build unchanged on
+// other platforms; silence the _s-variant deprecation that /sdl would otherwise turn into errors.
+//
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#ifndef NOMINMAX
+#define NOMINMAX 0
+#endif
+#include <windows.h>
+#include <initguid.h>
+
+#define SAR_PATH_SEPARATOR '\\'
+
+#else // !_WIN32
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+
+typedef uint8_t         UINT8;
+typedef uint16_t        UINT16;
+typedef uint32_t        UINT32;
+typedef uint64_t        UINT64;
+typedef int32_t         INT32;
+typedef int64_t         INT64;
+typedef int             INT;
+typedef int32_t         LONG;
+typedef uint32_t        ULONG;
+typedef uint32_t        DWORD;
+typedef int             BOOL;
+typedef uint8_t         BOOLEAN;
+typedef int32_t         HRESULT;
+typedef char*           LPSTR;
+typedef const char*     LPCSTR;
+typedef const char*     PCSTR;
+typedef const wchar_t*  LPCWSTR;
+typedef void*           PVOID;
+
+#define VOID void
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+typedef struct _GUID
+{
+    UINT32 Data1;
+    UINT16 Data2;
+    UINT16 Data3;
+    UINT8  Data4[8];
+} GUID;
+
+// The Linux definitions are also valid C11, so that C callers can include SarApi.h.
+//
+#ifdef __cplusplus
+typedef const GUID& REFGUID;
+#else
+typedef const GUID* REFGUID;
+#endif
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    static const GUID name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+#ifdef __cplusplus
+#define C_ASSERT(e) static_assert(e, #e)
+#else
+#define C_ASSERT(e) _Static_assert(e, #e)
+#endif
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define INFINITE 0xFFFFFFFF
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+
+#define S_OK                    ((HRESULT)0x00000000L)
+#define S_FALSE                 ((HRESULT)0x00000001L)
+#define E_NOTIMPL               ((HRESULT)0x80004001L)
+#define E_POINTER               ((HRESULT)0x80004003L)
+#define E_ABORT                 ((HRESULT)0x80004004L)
+#define E_FAIL                  ((HRESULT)0x80004005L)
+#define E_UNEXPECTED            ((HRESULT)0x8000FFFFL)
+#define E_ACCESSDENIED          ((HRESULT)0x80070005L)
+#define E_OUTOFMEMORY           ((HRESULT)0x8007000EL)
+#define E_INVALIDARG            ((HRESULT)0x80070057L)
+#define E_NOT_SUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)    (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(x) \
+    ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000)))
+
+#define ERROR_SUCCESS           0L
+#define ERROR_FILE_NOT_FOUND    2L
+#define ERROR_PATH_NOT_FOUND    3L
+#define ERROR_ACCESS_DENIED     5L
+#define ERROR_INVALID_HANDLE    6L
+#define ERROR_BAD_FORMAT        11L
+#define ERROR_INVALID_DATA      13L
+#define ERROR_OUTOFMEMORY       14L
+#define ERROR_CRC               23L
+#define ERROR_HANDLE_EOF        38L
+#define ERROR_NOT_SUPPORTED     50L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_ALREADY_EXISTS    183L
+#define ERROR_FILE_TOO_LARGE    223L
+#define ERROR_MORE_DATA         234L
+#define ERROR_NOT_FOUND         1168L
+#define ERROR_REVISION_MISMATCH 1306L
+
+// SAL annotations are only meaningful to the Microsoft compiler.
+//
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _Check_return_
+#define _In_reads_(n)
+#define _In_reads_bytes_(n)
+#define _In_reads_bytes_opt_(n)
+#define _Out_writes_(n)
+#define _Out_writes_bytes_(n)
+#define _Out_writes_bytes_opt_(n)
+#define _Out_writes_bytes_to_(n, c)
+#define _Out_writes_opt_(n)
+#define _Inout_updates_(n)
+
+#define _cdecl
+
+#define SAR_PATH_SEPARATOR '/'
+
+#endif // _WIN32
+
+#ifdef __cplusplus
+
+#include <errno.h>
+
+inline
+HRESULT
+SarHresultFromErrno(
+    int err
+    )
+/*++
+
+Routine Description:
+
+    Maps a C runtime errno value to the closest HRESULT so that portable modules report failures the
+    same way the Win32 code paths do.
+
+Arguments:
+
+    err - The errno value.
+
+Return Value:
+
+    The corresponding HRESULT (E_FAIL if there is no close match.)
+
+--*/
+{
+    switch (err)
+    {
+    case 0:
+        return S_OK;
+    case ENOENT:
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    case ENOTDIR:
+        return HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
+    case EACCES:
+    case EPERM:
+        return E_ACCESSDENIED;
+    case ENOMEM:
+        return E_OUTOFMEMORY;
+    case EINVAL:
+        return E_INVALIDARG;
+    case EEXIST:
+        return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+    default:
+        return E_FAIL;
+    }
+}
+
+#endif // __cplusplus
+
+// eof: SarPlatform.h
+//
@@ -0,0 +1,638 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarServer.cpp
+
+Abstract:
+
+    Long-lived SarTool server and the client-side device service that talks to it.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarServer.h"
+#include "SarClient.h"
+#include "SarCodec.h"
+#include "SarInterfaceVersion.h"
+#include "SarStopSignal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+SarServer::SarServer(
+    _In_ SarDeviceService* device,
+    UINT32 coalesceMilliseconds
+    ) :
+    m_device(device),
+    m_fStopping(false),
+    m_requestCount(0),
+    m_setLane(0),
+    m_fVersionKnown(FALSE),
+    m_version()
+{
+    if (coalesceMilliseconds != 0)
+    {
+        m_setQueue.reset(new SarSetQueue(coalesceMilliseconds));
+        m_setLane = m_setQueue->AddLane([device](const std::vector<UINT8>& request) -> HRESULT
+        {
+            WDI_SAR_RESULT result = WDI_SAR_SUCCESS;
+            HRESULT hr = SarWifiSendSetSarState(device, request, &result);
+
+            return (SUCCEEDED(hr) && (result != WDI_SAR_SUCCESS)) ? E_INVALIDARG : hr;
+        });
+    }
+}
+
+SarServer::~SarServer()
+{
+    Stop();
+}
+
+_Check_return_
+HRESULT
+SarServer::Start(
+    _In_z_ LPCSTR endpoint
+    )
+/*++
+
+Routine Description:
+
+    Listens on the endpoint and starts the thread that accepts clients.  Each client is served on
+    its own thread for as long as it stays connected.
+
+Arguments:
+
+    endpoint - The pipe name (Windows) or socket path.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    hr = m_listener.Listen(endpoint);
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    m_fStopping = false;
+    m_acceptThread = std::thread(&SarServer::AcceptLoop, this);
+
+exit:
+    return hr;
+}
+
+VOID
+SarServer::Stop()
+{
+    m_fStopping = true;
+    m_listener.Close();
+
+    if (m_acceptThread.joinable())
+    {
+        m_acceptThread.join();
+    }
+
+    ReapClients(TRUE);
+
+    if (m_setQueue)
+    {
+        (VOID)m_setQueue->Flush(m_setLane);
+    }
+}
+
+BOOL
+SarServer::GetCoalescingStats(
+    _Out_ SAR_SET_QUEUE_STATS* stats
+    )
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (!m_setQueue)
+    {
+        return FALSE;
+    }
+
+    m_setQueue->GetStats(m_setLane, stats);
+    return TRUE;
+}
+
+VOID
+SarServer::AcceptLoop()
+{
+    while (!m_fStopping)
+    {
+        std::unique_ptr<CLIENT> client(new CLIENT);
+
+        client->Done = false;
+        if (FAILED(m_listener.Accept(&client->Connection)))
+        {
+            if (m_fStopping)
+            {
+                break;
+            }
+            continue;
+        }
+
+        ReapClients(FALSE);
+
+        std::lock_guard<std::mutex> lock(m_clientsLock);
+        CLIENT* pClient = client.get();
+        m_clients.push_back(std::move(client));
+        pClient->Thread = std::thread(&SarServer::Serve, this, pClient);
+    }
+}
+
+VOID
+SarServer::ReapClients(
+    BOOL fAll
+    )
+/*++
+
+Routine Description:
+
+    Joins the threads of clients that have disconnected.  With fAll, disconnects every remaining
+    client first.
+
+--*/
+{
+    std::list<std::unique_ptr<CLIENT>> finished;
+
+    {
+        std::lock_guard<std::mutex> lock(m_clientsLock);
+
+        for (auto it = m_clients.begin(); it != m_clients.end();)
+        {
+            if (fAll)
+            {
+                (*it)->Connection.Shutdown();
+            }
+
+            if (fAll || (*it)->Done)
+            {
+                finished.push_back(std::move(*it));
+                it = m_clients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    for (auto& client : finished)
+    {
+        if (client->Thread.joinable())
+        {
+            client->Thread.join();
+        }
+    }
+}
+
+VOID
+SarServer::Serve(
+    _In_ CLIENT* client
+    )
+/*++
+
+Routine Description:
+
+    Relays the client's requests to the device service until it disconnects or sends a malformed
+    request.
+
+--*/
+{
+    std::vector<UINT8> input;
+    std::vector<UINT8> output;
+
+    for (;;)
+    {
+        UINT8 request[sizeof(SAR_SERVER_REQUEST_HEADER)];
+        UINT32 opcode;
+        UINT32 inSize;
+        UINT32 outSize;
+        DWORD bytesReturned = 0;
+        DWORD payloadSize;
+        HRESULT hr;
+
+        if (FAILED(client->Connection.Receive(request, sizeof(request))))
+        {
+            break;
+        }
+
+        opcode = SarLoadLe32(request + offsetof(SAR_SERVER_REQUEST_HEADER, Opcode));
+        inSize = SarLoadLe32(request + offsetof(SAR_SERVER_REQUEST_HEADER, InSize));
+        outSize = SarLoadLe32(request + offsetof(SAR_SERVER_REQUEST_HEADER, OutSize));
+
+        if ((SarLoadLe32(request) != SAR_SERVER_REQUEST_SIGNATURE) ||
+            (inSize > SAR_SERVER_MAX_PAYLOAD) ||
+            (outSize > SAR_SERVER_MAX_PAYLOAD))
+        {
+            break;
+        }
+
+        input.resize(inSize);
+        if ((inSize != 0) && FAILED(client->Connection.Receive(input.data(), inSize)))
+        {
+            break;
+        }
+
+        // The response header and output are sent with a single write.
+        output.assign(sizeof(SAR_SERVER_RESPONSE_HEADER) + outSize, 0);
+
+        hr = Execute(opcode,
+                     input,
+                     (outSize != 0) ? output.data() + sizeof(SAR_SERVER_RESPONSE_HEADER) : nullptr,
+                     outSize,
+                     &bytesReturned);
+        m_requestCount++;
+
+        payloadSize = SUCCEEDED(hr) ? ((bytesReturned < outSize) ? bytesReturned : outSize) : 0;
+
+        SarStoreLe32(output.data() + offsetof(SAR_SERVER_RESPONSE_HEADER, Signature), SAR_SERVER_RESPONSE_SIGNATURE);
+        SarStoreLe32(output.data() + offsetof(SAR_SERVER_RESPONSE_HEADER, Result), (UINT32)hr);
+        SarStoreLe32(output.data() + offsetof(SAR_SERVER_RESPONSE_HEADER, BytesReturned), bytesReturned);
+
+        if (FAILED(client->Connection.Send(output.data(), sizeof(SAR_SERVER_RESPONSE_HEADER) + payloadSize)))
+        {
+            break;
+        }
+    }
+
+    client->Connection.Close();
+    client->Done = true;
+}
+
+_Check_return_
+HRESULT
+SarServer::Execute(
+    UINT32 opcode,
+    const std::vector<UINT8>& input,
+    _Out_writes_bytes_opt_(outSize) UINT8* output,
+    UINT32 outSize,
+    _Out_ DWORD* bytesReturned
+    )
+/*++
+
+Routine Description:
+
+    Runs one client command.  WDI_GET_INTERFACE_VERSION is answered from the server's handshake,
+    and a get or set fails without reaching the driver if the handshake found a version SarTool
+    cannot drive.  If sets are coalesced, a WDI_SET_SAR_STATE is queued and answered with
+    WDI_SAR_SUCCESS, and a WDI_GET_SAR_STATE first sends the pending set.
+
+Arguments:
+
+    opcode - The WDI_SAR_DEVICE_SERVICE_OPCODE.
+    input - The command's input.
+    output - Receives the command's output.
+    outSize - Size of output.
+    bytesReturned - Receives the size of the command's output.
+
+Return Value:
+
+    The command's result.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_INTERFACE_VERSION version;
+
+    *bytesReturned = 0;
+
+    if ((opcode == WDI_GET_INTERFACE_VERSION) || (opcode == WDI_SET_SAR_STATE) || (opcode == WDI_GET_SAR_STATE))
+    {
+        hr = Handshake(&version);
+
+        if (opcode == WDI_GET_INTERFACE_VERSION)
+        {
+            if (SUCCEEDED(hr) || (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH)))
+            {
+                hr = S_OK;
+                if (outSize >= 2 * sizeof(UINT32))
+                {
+                    SarStoreLe32(output, version.Major);
+                    SarStoreLe32(output + sizeof(UINT32), version.Minor);
+                    *bytesReturned = 2 * sizeof(UINT32);
+                }
+            }
+            goto exit;
+        }
+
+        if (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH))
+        {
+            goto exit;
+        }
+    }
+
+    if (m_setQueue && (opcode == WDI_SET_SAR_STATE))
+    {
+        m_setQueue->Submit(m_setLane, input);
+        if (outSize >= sizeof(UINT32))
+        {
+            SarStoreLe32(output, WDI_SAR_SUCCESS);
+            *bytesReturned = sizeof(UINT32);
+        }
+        hr = S_OK;
+        goto exit;
+    }
+
+    if (m_setQueue && (opcode == WDI_GET_SAR_STATE))
+    {
+        (VOID)m_setQueue->Flush(m_setLane);
+    }
+
+    hr = m_device->Command(opcode,
+                           input.empty() ? nullptr : input.data(),
+                           (DWORD)input.size(),
+                           output,
+                           outSize,
+                           bytesReturned);
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarServer::Handshake(
+    _Out_ SAR_INTERFACE_VERSION* version
+    )
+/*++
+
+Routine Description:
+
+    Learns the driver's SAR interface version once for every client, from the interface version
+    cache or with WDI_GET_INTERFACE_VERSION (see SarInterfaceVersion.h.)
+
+Arguments:
+
+    version - Receives the driver's version.
+
+Return Value:
+
+    S_OK, HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if SarTool cannot drive the driver, or the
+    failure code of WDI_GET_INTERFACE_VERSION, in which case the next command asks again.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::lock_guard<std::mutex> lock(m_versionLock);
+
+    if (!m_fVersionKnown)
+    {
+        std::string cachePath = SarInterfaceVersionCacheDefaultPath();
+
+        hr = SarWifiHandshake(m_device, cachePath.empty() ? nullptr : cachePath.c_str(), &m_version);
+        if (SUCCEEDED(hr) || (hr == HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH)))
+        {
+            m_fVersionKnown = TRUE;
+        }
+    }
+    else if (!SarInterfaceVersionIsCompatible(m_version))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH);
+    }
+
+    *version = m_version;
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarRemoteDeviceService::Connect(
+    _In_z_ LPCSTR endpoint
+    )
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_connection.Connect(endpoint);
+}
+
+_Check_return_
+HRESULT
+SarRemoteDeviceService::ExecuteCommand(
+    DWORD opcode,
+    _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+    DWORD inSize,
+    _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+    DWORD outSize,
+    _Out_ DWORD* bytesReturned
+    )
+/*++
+
+Routine Description:
+
+    Sends one command to the server and waits for its response.
+
+Return Value:
+
+    The server's result for the command, HRESULT_FROM_WIN32(ERROR_INVALID_DATA) if the response
+    is malformed, or the transport's failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::vector<UINT8> request(sizeof(SAR_SERVER_REQUEST_HEADER) + inSize);
+    UINT8 response[sizeof(SAR_SERVER_RESPONSE_HEADER)];
+    DWORD payloadSize;
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    *bytesReturned = 0;
+
+    if ((inSize > SAR_SERVER_MAX_PAYLOAD) || (outSize > SAR_SERVER_MAX_PAYLOAD))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    SarStoreLe32(request.data() + offsetof(SAR_SERVER_REQUEST_HEADER, Signature), SAR_SERVER_REQUEST_SIGNATURE);
+    SarStoreLe32(request.data() + offsetof(SAR_SERVER_REQUEST_HEADER, Opcode), opcode);
+    SarStoreLe32(request.data() + offsetof(SAR_SERVER_REQUEST_HEADER, InSize), inSize);
+    SarStoreLe32(request.data() + offsetof(SAR_SERVER_REQUEST_HEADER, OutSize), outSize);
+    if (inSize != 0)
+    {
+        memcpy(request.data() + sizeof(SAR_SERVER_REQUEST_HEADER), inBuffer, inSize);
+    }
+
+    hr = m_connection.Send(request.data(), request.size());
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    hr = m_connection.Receive(response, sizeof(response));
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    if (SarLoadLe32(response) != SAR_SERVER_RESPONSE_SIGNATURE)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        goto exit;
+    }
+
+    hr = (HRESULT)SarLoadLe32(response + offsetof(SAR_SERVER_RESPONSE_HEADER, Result));
+    *bytesReturned = SarLoadLe32(response + offsetof(SAR_SERVER_RESPONSE_HEADER, BytesReturned));
+
+    // Output only follows a successful command, and never more than the buffer we offered.
+    payloadSize = SUCCEEDED(hr) ? ((*bytesReturned < outSize) ? *bytesReturned : outSize) : 0;
+    if (payloadSize != 0)
+    {
+        HRESULT hrReceive = m_connection.Receive(outBuffer, payloadSize);
+        if (FAILED(hrReceive))
+        {
+            hr = hrReceive;
+        }
+    }
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarServeCommand(
+    _In_ SarDeviceService* device,
+    UINT32 coalesceMilliseconds,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Serves the device service on the endpoint until the process is interrupted, then reports how
+    many requests were relayed and, if sets were coalesced, how many driver calls that saved.
+
+Arguments:
+
+    device - The device service to relay commands to.
+    coalesceMilliseconds - The coalescing window for sets, or 0 to send every set at once.
+    argc - Count of arguments after "serve".
+    argv - Optionally the endpoint to listen on.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    LPCSTR endpoint = (argc >= 1) ? argv[0] : SAR_DEFAULT_ENDPOINT;
+    SarServer server(device, coalesceMilliseconds);
+    SAR_SET_QUEUE_STATS stats;
+
+    // Arm before the server starts any thread so only the wait below sees Ctrl+C.
+    hr = SarStopSignalArm();
+    if (FAILED(hr))
+    {
+        goto exit;
+    }
+
+    hr = server.Start(endpoint);
+    if (FAILED(hr))
+    {
+        printf("Failed to listen on %s, hr = 0x%08x\n", endpoint, (UINT32)hr);
+        goto exit;
+    }
+
+    printf("Serving SAR requests on %s; press Ctrl+C to stop.\n", endpoint);
+    fflush(stdout);
+
+    SarStopSignalWait(INFINITE);
+
+    server.Stop();
+    printf("Served %llu requests.\n", (unsigned long long)server.RequestCount());
+
+    if (server.GetCoalescingStats(&stats))
+    {
+        printf("Coalesced %llu sets into %llu driver calls (%llu replaced within %u ms, %llu unchanged, %llu failed.)\n",
+               (unsigned long long)stats.Requests,
+               (unsigned long long)stats.Issued,
+               (unsigned long long)stats.Coalesced,
+               coalesceMilliseconds,
+               (unsigned long long)stats.Unchanged,
+               (unsigned long long)stats.Failed);
+    }
+
+exit:
+    SarStopSignalDisarm();
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarRemoteCommand(
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Runs "getsar wifi" or "setsar wifi ..." through the SarTool server listening on the endpoint.
+
+Arguments:
+
+    format - Text, JSON or CSV output.
+    argc - Count of arguments after "remote".
+    argv - <endpoint> {getsar | setsar} wifi [setsar arguments]
+
+Return Value:
+
+    S_OK on success, E_INVALIDARG if the arguments are invalid, or the underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SAR_SESSION* session = nullptr;
+    BOOL fGet;
+
+    if ((argc < 3) || (0 != _stricmp(argv[2], "wifi")))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (0 == _stricmp(argv[1], "getsar"))
+    {
+        fGet = TRUE;
+    }
+    else if (0 == _stricmp(argv[1], "setsar"))
+    {
+        fGet = FALSE;
+    }
+    else
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    hr = SarSessionOpen(SarSessionRemote, argv[0], &session);
+    if (FAILED(hr))
+    {
+        printf("Failed to connect to %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    hr = SarWifiSarCommand(session, fGet, FALSE, format, argc - 3, &argv[3]);
+
+exit:
+    SarSessionClose(session);
+    return hr;
+}
+
+// eof: SarServer.cpp
+//
@@ -0,0 +1,226 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarServer.h
+
+Abstract:
+
+    Long-lived SarTool server.  Keeps one device service (and so one WLAN session) open and relays
+    device-service commands from local clients to it, so a SAR switch costs one local round-trip
+    instead of a process start plus WLAN handle setup.
+
+    The server makes the WDI_GET_INTERFACE_VERSION handshake once, answers its clients'
+    WDI_GET_INTERFACE_VERSION from it, and fails their gets and sets with
+    HRESULT_FROM_WIN32(ERROR_REVISION_MISMATCH) if it cannot drive the driver.
+
+    With a coalescing window, WDI_SET_SAR_STATE requests are acknowledged at once and sent to the
+    device through a SarSetQueue, so a flapping client's sets cost one driver call per window.
+
+    Protocol (all fields little-endian), any number of exchanges per connection:
+
+        client: SAR_SERVER_REQUEST_HEADER, followed by InSize bytes of input
+        server: SAR_SERVER_RESPONSE_HEADER, followed by BytesReturned bytes of output
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarDeviceService.h"
+#include "SarOutput.h"
+#include "SarSetQueue.h"
+#include "SarTransport.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const UINT32 SAR_SERVER_REQUEST_SIGNATURE = 0x51524153;  // "SARQ"
+static const UINT32 SAR_SERVER_RESPONSE_SIGNATURE = 0x50524153; // "SARP"
+
+// Upper bound on the input and output buffers of one command, so a bad request cannot make the
+// server allocate arbitrary amounts of memory.
+//
+static const UINT32 SAR_SERVER_MAX_PAYLOAD = 64 * 1024;
+
+#pragma pack(push)
+#pragma pack(1)
+typedef struct _SAR_SERVER_REQUEST_HEADER
+{
+    UINT32 Signature;
+    UINT32 Opcode;        // WDI_SAR_DEVICE_SERVICE_OPCODE
+    UINT32 InSize;
+    UINT32 OutSize;       // Size of the client's output buffer.
+} SAR_SERVER_REQUEST_HEADER;
+C_ASSERT(sizeof(SAR_SERVER_REQUEST_HEADER) == 0x10);
+
+typedef struct _SAR_SERVER_RESPONSE_HEADER
+{
+    UINT32 Signature;
+    UINT32 Result;        // HRESULT
+    UINT32 BytesReturned;
+} SAR_SERVER_RESPONSE_HEADER;
+C_ASSERT(sizeof(SAR_SERVER_RESPONSE_HEADER) == 0x0c);
+#pragma pack(pop)
+
+class SarServer
+{
+public:
+
+    // coalesceMilliseconds other than 0 puts a SarSetQueue with that window in front of the
+    // device's WDI_SET_SAR_STATE.
+    //
+    SarServer(
+        _In_ SarDeviceService* device,
+        UINT32 coalesceMilliseconds = 0
+        );
+
+    ~SarServer();
+
+    SarServer(const SarServer&) = delete;
+    SarServer& operator=(const SarServer&) = delete;
+
+    // Starts listening and serving clients on background threads.
+    //
+    _Check_return_
+    HRESULT
+    Start(
+        _In_z_ LPCSTR endpoint
+        );
+
+    // Stops accepting, disconnects every client and waits for the threads to exit.
+    //
+    VOID
+    Stop();
+
+    UINT64
+    RequestCount() const
+    {
+        return m_requestCount;
+    }
+
+    // Returns FALSE, and zero counts, if sets are not coalesced.
+    //
+    BOOL
+    GetCoalescingStats(
+        _Out_ SAR_SET_QUEUE_STATS* stats
+        );
+
+private:
+
+    typedef struct _CLIENT
+    {
+        SarConnection Connection;
+        std::thread Thread;
+        std::atomic<bool> Done;
+    } CLIENT;
+
+    VOID
+    AcceptLoop();
+
+    VOID
+    Serve(
+        _In_ CLIENT* client
+        );
+
+    _Check_return_
+    HRESULT
+    Execute(
+        UINT32 opcode,
+        const std::vector<UINT8>& input,
+        _Out_writes_bytes_opt_(outSize) UINT8* output,
+        UINT32 outSize,
+        _Out_ DWORD* bytesReturned
+        );
+
+    _Check_return_
+    HRESULT
+    Handshake(
+        _Out_ SAR_INTERFACE_VERSION* version
+        );
+
+    VOID
+    ReapClients(
+        BOOL fAll
+        );
+
+    SarDeviceService* m_device;
+    SarListener m_listener;
+    std::thread m_acceptThread;
+    std::mutex m_clientsLock;
+    std::list<std::unique_ptr<CLIENT>> m_clients;
+    std::atomic<bool> m_fStopping;
+    std::atomic<UINT64> m_requestCount;
+    std::unique_ptr<SarSetQueue> m_setQueue;
+    UINT32 m_setLane;
+    std::mutex m_versionLock;
+    BOOL m_fVersionKnown;
+    SAR_INTERFACE_VERSION m_version;
+};
+
+// A device service that relays every command to a SarTool server.  Commands from multiple
+// threads are serialized over the one connection.
+//
+class SarRemoteDeviceService : public SarDeviceService
+{
+public:
+
+    _Check_return_
+    HRESULT
+    Connect(
+        _In_z_ LPCSTR endpoint
+        );
+
+protected:
+
+    _Check_return_
+    HRESULT
+    ExecuteCommand(
+        DWORD opcode,
+        _In_reads_bytes_opt_(inSize) const VOID* inBuffer,
+        DWORD inSize,
+        _Out_writes_bytes_opt_(outSize) VOID* outBuffer,
+        DWORD outSize,
+        _Out_ DWORD* bytesReturned
+        ) override;
+
+private:
+
+    std::mutex m_lock;
+    SarConnection m_connection;
+};
+
+// "serve [--coalesce <ms>] [endpoint]": serves the device service until interrupted (Ctrl+C /
+// SIGTERM.)  coalesceMilliseconds is the --coalesce window, or 0.
+//
+_Check_return_
+HRESULT
+SarServeCommand(
+    _In_ SarDeviceService* device,
+    UINT32 coalesceMilliseconds,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// "remote <endpoint> {getsar | setsar} wifi ...": runs a Wi-Fi SAR command through a server.
+// Returns E_INVALIDARG for bad arguments so the caller can print its usage.
+//
+_Check_return_
+HRESULT
+SarRemoteCommand(
+    SAR_OUTPUT_FORMAT format,
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarServer.h
+//
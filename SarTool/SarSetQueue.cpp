@@ -0,0 +1,278 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarSetQueue.cpp
+
+Abstract:
+
+    The coalescing queue in front of the SAR set paths.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarSetQueue.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+SarSetQueue::SarSetQueue(
+    UINT32 windowMilliseconds
+    ) :
+    m_window(windowMilliseconds)
+{
+}
+
+SarSetQueue::~SarSetQueue()
+{
+    for (std::unique_ptr<LANE>& lane : m_lanes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(lane->Lock);
+
+            lane->fShutdown = TRUE;
+        }
+
+        lane->Changed.notify_all();
+    }
+
+    for (std::unique_ptr<LANE>& lane : m_lanes)
+    {
+        if (lane->Worker.joinable())
+        {
+            lane->Worker.join();
+        }
+    }
+}
+
+UINT32
+SarSetQueue::AddLane(
+    ISSUER issue
+    )
+{
+    std::unique_ptr<LANE> lane(new LANE());
+    LANE* pLane = lane.get();
+
+    lane->Issue = std::move(issue);
+    lane->fPending = FALSE;
+    lane->fIssuing = FALSE;
+    lane->fShutdown = FALSE;
+    lane->fAcknowledged = FALSE;
+    lane->LastResult = S_OK;
+    memset(&lane->Stats, 0, sizeof(lane->Stats));
+
+    m_lanes.push_back(std::move(lane));
+    pLane->Worker = std::thread(&SarSetQueue::WorkerLoop, this, pLane);
+
+    return (UINT32)(m_lanes.size() - 1);
+}
+
+VOID
+SarSetQueue::Submit(
+    UINT32 lane,
+    std::vector<UINT8> request
+    )
+{
+    LANE* pLane = m_lanes[lane].get();
+
+    {
+        std::lock_guard<std::mutex> lock(pLane->Lock);
+
+        pLane->Stats.Requests++;
+
+        if (pLane->fPending)
+        {
+            // Last writer wins; the window stays where the first set opened it.
+            pLane->Stats.Coalesced++;
+        }
+        else
+        {
+            pLane->fPending = TRUE;
+            pLane->Deadline = std::chrono::steady_clock::now() + m_window;
+        }
+
+        pLane->Pending.swap(request);
+    }
+
+    pLane->Changed.notify_all();
+}
+
+_Check_return_
+HRESULT
+SarSetQueue::Flush(
+    UINT32 lane
+    )
+{
+    LANE* pLane = m_lanes[lane].get();
+    std::unique_lock<std::mutex> lock(pLane->Lock);
+
+    if (pLane->fPending)
+    {
+        pLane->Deadline = std::chrono::steady_clock::now();
+        pLane->Changed.notify_all();
+    }
+
+    pLane->Changed.wait(lock, [pLane]() { return !pLane->fPending && !pLane->fIssuing; });
+
+    return pLane->LastResult;
+}
+
+VOID
+SarSetQueue::GetStats(
+    UINT32 lane,
+    _Out_ SAR_SET_QUEUE_STATS* stats
+    )
+{
+    LANE* pLane = m_lanes[lane].get();
+    std::lock_guard<std::mutex> lock(pLane->Lock);
+
+    *stats = pLane->Stats;
+}
+
+VOID
+SarSetQueue::WorkerLoop(
+    _In_ LANE* lane
+    )
+/*++
+
+Routine Description:
+
+    Sends each lane's pending set when its window closes (or at once when the lane is flushed or
+    the queue is shutting down), unless it matches the state the device last acknowledged.
+
+Arguments:
+
+    lane - The lane to serve.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    std::unique_lock<std::mutex> lock(lane->Lock);
+
+    for (;;)
+    {
+        std::vector<UINT8> request;
+        ISSUER issue;
+        HRESULT hr;
+
+        if (!lane->fPending)
+        {
+            if (lane->fShutdown)
+            {
+                break;
+            }
+
+            lane->Changed.wait(lock);
+            continue;
+        }
+
+        if (!lane->fShutdown && (std::chrono::steady_clock::now() < lane->Deadline))
+        {
+            // Woken early by a later set, a flush or shutdown; the loop rechecks all three.
+            lane->Changed.wait_until(lock, lane->Deadline);
+            continue;
+        }
+
+        request.swap(lane->Pending);
+        lane->fPending = FALSE;
+
+        if (lane->fAcknowledged && (request == lane->Acknowledged))
+        {
+            lane->Stats.Unchanged++;
+            lane->LastResult = S_OK;
+            lane->Changed.notify_all();
+            continue;
+        }
+
+        // A set submitted while this one is with the device opens a new window.
+        lane->fIssuing = TRUE;
+        issue = lane->Issue;
+        lock.unlock();
+
+        hr = issue(request);
+
+        lock.lock();
+        lane->fIssuing = FALSE;
+        lane->Stats.Issued++;
+        lane->LastResult = hr;
+
+        if (hr == S_OK)
+        {
+            lane->Acknowledged.swap(request);
+            lane->fAcknowledged = TRUE;
+        }
+        else
+        {
+            lane->Stats.Failed += FAILED(hr) ? 1 : 0;
+            lane->fAcknowledged = FALSE;
+        }
+
+        lane->Changed.notify_all();
+    }
+}
+
+_Check_return_
+HRESULT
+SarSetQueueTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ UINT32* windowMilliseconds
+    )
+{
+    HRESULT hr = S_OK;
+    int kept = 0;
+    LPCSTR text;
+    char* end;
+    unsigned long window;
+
+    *windowMilliseconds = 0;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--coalesce")))
+        {
+            if (i + 1 < *argc)
+            {
+                text = argv[i + 1];
+                errno = 0;
+                window = strtoul(text, &end, 10);
+
+                // strtoul skips leading spaces and takes "-5" as a huge number rather than fail.
+                if (!isdigit((unsigned char)text[0]) || (*end != '\0') || (errno == ERANGE) ||
+                    (window > SAR_SET_QUEUE_MAX_WINDOW_MILLISECONDS))
+                {
+                    hr = E_INVALIDARG;
+                }
+                else
+                {
+                    *windowMilliseconds = (UINT32)window;
+                }
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+
+            i++;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return hr;
+}
+
+// eof: SarSetQueue.cpp
+//
@@ -0,0 +1,158 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarSetQueue.h
+
+Abstract:
+
+    A coalescing queue in front of the Wi-Fi and LTE SAR set paths, for callers (e.g. a flapping
+    proximity sensor) that change the SAR state faster than it is worth telling the driver.
+
+    Each kind of set has its own lane with its own worker.  The first set to reach an idle lane
+    opens a window of windowMilliseconds; sets that arrive while it is open replace the pending
+    one (last writer wins), and when it closes the worker sends whichever set is then pending.
+    The window is not extended by later sets, so a sensor that never settles still has its
+    state sent once per window.  A set identical to the last one the device acknowledged is
+    skipped.  Each lane counts the sets it was given and how many device calls it saved.
+
+    The queue assumes it is the only writer of the device's SAR state: a state that someone else
+    changes between two sets is not noticed.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The longest window "--coalesce" and SarSessionSetCoalescing accept.  A set waits out the window before it reaches the
+// driver, so a longer one is taken for a typo.
+//
+static const UINT32 SAR_SET_QUEUE_MAX_WINDOW_MILLISECONDS = 60000;
+
+// How one lane has fared.  Requests = Issued + Coalesced + Unchanged + the set still pending, and
+// Coalesced + Unchanged device calls were saved.
+//
+typedef struct _SAR_SET_QUEUE_STATS
+{
+    UINT64 Requests;        // Sets submitted.
+    UINT64 Issued;          // Sets sent to the device.
+    UINT64 Coalesced;       // Sets replaced by a later set in the same window.
+    UINT64 Unchanged;       // Sets skipped as identical to the last acknowledged state.
+    UINT64 Failed;          // Issued sets that failed.
+} SAR_SET_QUEUE_STATS;
+
+class SarSetQueue
+{
+public:
+
+    // Sends an encoded set to the device.  S_OK acknowledges the state; a failure leaves the
+    // device's state unknown, so the next set is always sent.
+    //
+    typedef std::function<HRESULT(const std::vector<UINT8>& request)> ISSUER;
+
+    explicit
+    SarSetQueue(
+        UINT32 windowMilliseconds
+        );
+
+    // Sends every pending set without waiting for its window, then stops the workers.
+    //
+    ~SarSetQueue();
+
+    SarSetQueue(const SarSetQueue&) = delete;
+    SarSetQueue& operator=(const SarSetQueue&) = delete;
+
+    // Adds a lane and starts its worker.  Returns the lane's index for Submit.  Lanes are added
+    // before the first Submit.
+    //
+    UINT32
+    AddLane(
+        ISSUER issue
+        );
+
+    // Queues an encoded set; it replaces any set still pending in the lane.
+    //
+    VOID
+    Submit(
+        UINT32 lane,
+        std::vector<UINT8> request
+        );
+
+    // Sends the lane's pending set without waiting for its window and waits for it.  Returns the
+    // result of the lane's last set: the issuer's, or S_OK if it was skipped as unchanged.
+    //
+    _Check_return_
+    HRESULT
+    Flush(
+        UINT32 lane
+        );
+
+    VOID
+    GetStats(
+        UINT32 lane,
+        _Out_ SAR_SET_QUEUE_STATS* stats
+        );
+
+    UINT32
+    WindowMilliseconds() const
+    {
+        return (UINT32)m_window.count();
+    }
+
+private:
+
+    typedef struct _LANE
+    {
+        ISSUER Issue;
+        std::thread Worker;
+        std::mutex Lock;
+        std::condition_variable Changed;
+        BOOL fPending;
+        BOOL fIssuing;
+        BOOL fShutdown;
+        std::vector<UINT8> Pending;
+        std::chrono::steady_clock::time_point Deadline;
+        BOOL fAcknowledged;
+        std::vector<UINT8> Acknowledged;
+        HRESULT LastResult;
+        SAR_SET_QUEUE_STATS Stats;
+    } LANE;
+
+    VOID
+    WorkerLoop(
+        _In_ LANE* lane
+        );
+
+    std::chrono::milliseconds m_window;
+    std::vector<std::unique_ptr<LANE>> m_lanes;
+};
+
+// Removes "--coalesce <ms>" from the command line.  *windowMilliseconds receives its value, or 0
+// if it was not given.  Returns E_INVALIDARG if the value is missing, is not a decimal number or
+// is more than SAR_SET_QUEUE_MAX_WINDOW_MILLISECONDS.
+//
+_Check_return_
+HRESULT
+SarSetQueueTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[],
+    _Out_ UINT32* windowMilliseconds
+    );
+
+// eof: SarSetQueue.h
+//
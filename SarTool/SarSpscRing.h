@@ -0,0 +1,105 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarSpscRing.h
+
+Abstract:
+
+    A bounded, lock-free, single-producer/single-consumer ring buffer.
+
+    The producer only writes m_tail and the consumer only writes m_head, each on its own cache
+    line, so neither side ever waits for the other: a push into a full ring fails immediately
+    instead of blocking, which is what a driver callback thread needs.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <stddef.h>
+#include <atomic>
+
+static const size_t SAR_CACHE_LINE_SIZE = 64;
+
+template <typename T, size_t Capacity>
+class SarSpscRing
+{
+    static_assert((Capacity != 0) && ((Capacity & (Capacity - 1)) == 0), "Capacity must be a power of two");
+
+public:
+
+    SarSpscRing() :
+        m_head(0),
+        m_tail(0)
+    {
+    }
+
+    SarSpscRing(const SarSpscRing&) = delete;
+    SarSpscRing& operator=(const SarSpscRing&) = delete;
+
+    // Producer only.  Returns FALSE if the ring is full.
+    //
+    BOOL
+    TryPush(
+        const T& value
+        )
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+        {
+            return FALSE;
+        }
+
+        m_slots[tail & (Capacity - 1)] = value;
+
+        // seq_cst rather than release so a consumer that is about to sleep either sees this item
+        // or is seen sleeping by the producer (see SarNotificationPipeline::Post.)
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+        return TRUE;
+    }
+
+    // Consumer only.  Moves up to maxCount items into values and returns how many were moved.
+    //
+    size_t
+    PopBatch(
+        _Out_writes_(maxCount) T* values,
+        size_t maxCount
+        )
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t available = m_tail.load(std::memory_order_acquire) - head;
+        size_t count = (available < maxCount) ? available : maxCount;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            values[i] = m_slots[(head + i) & (Capacity - 1)];
+        }
+
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    BOOL
+    IsEmpty() const
+    {
+        return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_seq_cst);
+    }
+
+private:
+
+    alignas(SAR_CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+    alignas(SAR_CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+    alignas(SAR_CACHE_LINE_SIZE) T m_slots[Capacity];
+};
+
+// eof: SarSpscRing.h
+//
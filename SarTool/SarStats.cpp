@@ -0,0 +1,369 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarStats.cpp
+
+Abstract:
+
+    Log-bucketed latency histograms for the SAR device round-trips.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarStats.h"
+#include "Dmf_Wlan_Public.h"
+
+#include <string.h>
+#include <chrono>
+
+static const UINT64 SAR_HISTOGRAM_NO_MIN = ~(UINT64)0;
+
+static
+UINT32
+SarHighestBit(
+    UINT64 value
+    )
+{
+    UINT32 bit = 0;
+
+    if (value >> 32) { value >>= 32; bit += 32; }
+    if (value >> 16) { value >>= 16; bit += 16; }
+    if (value >> 8)  { value >>= 8;  bit += 8; }
+    if (value >> 4)  { value >>= 4;  bit += 4; }
+    if (value >> 2)  { value >>= 2;  bit += 2; }
+    if (value >> 1)  { bit += 1; }
+
+    return bit;
+}
+
+SarHistogram::SarHistogram()
+{
+    Reset();
+}
+
+VOID
+SarHistogram::Reset()
+{
+    for (UINT32 i = 0; i < SAR_HISTOGRAM_BUCKETS; i++)
+    {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(SAR_HISTOGRAM_NO_MIN, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+UINT32
+SarHistogram::BucketFromValue(
+    UINT64 value
+    )
+/*++
+
+Routine Description:
+
+    Maps a value to its bucket.  Values below 2^SAR_HISTOGRAM_SUB_BUCKET_BITS map to themselves;
+    above that, the highest set bit selects the power of two and the next
+    SAR_HISTOGRAM_SUB_BUCKET_BITS bits select the linear sub-bucket within it.
+
+--*/
+{
+    const UINT64 subBuckets = (UINT64)1 << SAR_HISTOGRAM_SUB_BUCKET_BITS;
+    UINT32 exponent;
+
+    if (value < subBuckets)
+    {
+        return (UINT32)value;
+    }
+
+    if (value >> SAR_HISTOGRAM_MAX_EXPONENT)
+    {
+        return SAR_HISTOGRAM_BUCKETS - 1;
+    }
+
+    exponent = SarHighestBit(value);
+
+    return ((exponent - SAR_HISTOGRAM_SUB_BUCKET_BITS + 1) << SAR_HISTOGRAM_SUB_BUCKET_BITS) +
+           (UINT32)((value >> (exponent - SAR_HISTOGRAM_SUB_BUCKET_BITS)) - subBuckets);
+}
+
+UINT64
+SarHistogram::ValueFromBucket(
+    UINT32 bucket
+    )
+{
+    const UINT32 subBuckets = 1 << SAR_HISTOGRAM_SUB_BUCKET_BITS;
+    UINT32 shift;
+
+    if (bucket < subBuckets)
+    {
+        return bucket;
+    }
+
+    shift = (bucket >> SAR_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+
+    return ((((UINT64)subBuckets + (bucket & (subBuckets - 1))) << shift) + ((UINT64)1 << shift)) - 1;
+}
+
+VOID
+SarHistogram::Record(
+    UINT64 value
+    )
+{
+    UINT64 current;
+
+    m_buckets[BucketFromValue(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    current = m_min.load(std::memory_order_relaxed);
+    while ((value < current) && !m_min.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+
+    current = m_max.load(std::memory_order_relaxed);
+    while ((value > current) && !m_max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+UINT64
+SarHistogram::Min() const
+{
+    UINT64 min = m_min.load(std::memory_order_relaxed);
+    return (min == SAR_HISTOGRAM_NO_MIN) ? 0 : min;
+}
+
+double
+SarHistogram::Mean() const
+{
+    UINT64 count = Count();
+    return (count == 0) ? 0.0 : (double)m_sum.load(std::memory_order_relaxed) / count;
+}
+
+UINT64
+SarHistogram::Percentile(
+    double fraction
+    ) const
+/*++
+
+Routine Description:
+
+    Walks the buckets until the running count reaches the requested fraction of the total.  The
+    result is the largest value of that bucket, clamped to the observed minimum and maximum so a
+    histogram holding a single value reports that value exactly.
+
+--*/
+{
+    UINT64 count = Count();
+    UINT64 target;
+    UINT64 seen = 0;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    target = (UINT64)(fraction * count + 0.5);
+    if (target < 1)
+    {
+        target = 1;
+    }
+    else if (target > count)
+    {
+        target = count;
+    }
+
+    for (UINT32 i = 0; i < SAR_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            UINT64 value = ValueFromBucket(i);
+
+            if (value > Max())
+            {
+                value = Max();
+            }
+            if (value < Min())
+            {
+                value = Min();
+            }
+            return value;
+        }
+    }
+
+    // A concurrent Record bumped the count before its bucket.
+    return Max();
+}
+
+static SarHistogram s_histograms[SarStatCount];
+
+static const LPCSTR s_statNames[SarStatCount] =
+{
+    "WlanOpenHandle",
+    "WlanEnumInterfaces",
+    "WDI_SET_SAR_STATE",
+    "WDI_GET_SAR_STATE",
+    "WDI_GET_GEO_STATE",
+    "WDI_GET_INTERFACE_VERSION",
+    "WDI_OTHER_OPCODE",
+    "LteGetModemConfiguration",
+    "LteGetSarState",
+    "LteSetConfiguration",
+    "UnsolicitedDelivery",
+};
+
+UINT64
+SarStatsNow()
+{
+    return (UINT64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+VOID
+SarStatsRecord(
+    SAR_STAT stat,
+    UINT64 start
+    )
+{
+    s_histograms[stat].Record(SarStatsNow() - start);
+}
+
+SAR_STAT
+SarStatFromOpcode(
+    DWORD opcode
+    )
+{
+    switch (opcode)
+    {
+    case WDI_SET_SAR_STATE:
+        return SarStatSetSarState;
+    case WDI_GET_SAR_STATE:
+        return SarStatGetSarState;
+    case WDI_GET_GEO_STATE:
+        return SarStatGetGeoState;
+    case WDI_GET_INTERFACE_VERSION:
+        return SarStatGetInterfaceVersion;
+    default:
+        return SarStatOtherOpcode;
+    }
+}
+
+SarHistogram*
+SarStatsHistogram(
+    SAR_STAT stat
+    )
+{
+    return &s_histograms[stat];
+}
+
+LPCSTR
+SarStatName(
+    SAR_STAT stat
+    )
+{
+    return s_statNames[stat];
+}
+
+VOID
+SarStatsReset()
+{
+    for (int stat = 0; stat < SarStatCount; stat++)
+    {
+        s_histograms[stat].Reset();
+    }
+}
+
+VOID
+SarStatsPrintJson(
+    _In_ FILE* stream
+    )
+/*++
+
+Routine Description:
+
+    Writes the histograms as JSON, e.g.
+
+        {
+          "unit": "ns",
+          "stats": {
+            "WDI_SET_SAR_STATE": { "count": 1, "min": 812300, "mean": 812300, "p50": 812300, ... }
+          }
+        }
+
+    Phases that recorded nothing are omitted.
+
+Arguments:
+
+    stream - Where to write the JSON.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    BOOL fFirst = TRUE;
+
+    fprintf(stream, "{\n  \"unit\": \"ns\",\n  \"stats\": {");
+
+    for (int stat = 0; stat < SarStatCount; stat++)
+    {
+        const SarHistogram* histogram = &s_histograms[stat];
+
+        if (histogram->Count() == 0)
+        {
+            continue;
+        }
+
+        fprintf(stream,
+                "%s\n    \"%s\": { \"count\": %llu, \"min\": %llu, \"mean\": %.0f, \"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu }",
+                fFirst ? "" : ",",
+                s_statNames[stat],
+                (unsigned long long)histogram->Count(),
+                (unsigned long long)histogram->Min(),
+                histogram->Mean(),
+                (unsigned long long)histogram->Percentile(0.50),
+                (unsigned long long)histogram->Percentile(0.99),
+                (unsigned long long)histogram->Percentile(0.999),
+                (unsigned long long)histogram->Max());
+        fFirst = FALSE;
+    }
+
+    fprintf(stream, "%s}\n}\n", fFirst ? "" : "\n  ");
+}
+
+BOOL
+SarStatsTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    )
+{
+    BOOL fFound = FALSE;
+    int kept = 0;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--stats")))
+        {
+            fFound = TRUE;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return fFound;
+}
+
+// eof: SarStats.cpp
+//
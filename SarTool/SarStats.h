@@ -0,0 +1,177 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarStats.h
+
+Abstract:
+
+    Always-on latency instrumentation for the SAR device round-trips.
+
+    Every phase (WlanOpenHandle, each device-service opcode, each LTE WinRT call, ...) records
+    into its own log-bucketed histogram in the style of HdrHistogram: values below 2^5 ns get a
+    bucket each, and every power of two above that is split into 32 linear sub-buckets, so any
+    recorded value is reported within 1/32 (about 3%) of its true value.  Recording is one clock
+    read and a few relaxed atomic increments, with no locks or allocation, so it stays on in
+    production builds.
+
+    "--stats" on the command line dumps the histograms as JSON when the command completes.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <stdio.h>
+#include <atomic>
+
+// The phases that are timed.  The device-service phases are per opcode.
+//
+typedef enum _SAR_STAT
+{
+    SarStatWlanOpenHandle,
+    SarStatWlanEnumInterfaces,
+    SarStatSetSarState,             // WDI_SET_SAR_STATE
+    SarStatGetSarState,             // WDI_GET_SAR_STATE
+    SarStatGetGeoState,             // WDI_GET_GEO_STATE
+    SarStatGetInterfaceVersion,     // WDI_GET_INTERFACE_VERSION
+    SarStatOtherOpcode,             // Any other device-service opcode.
+    SarStatLteGetModem,             // MobileBroadbandModem::GetDefault + GetCurrentConfigurationAsync
+    SarStatLteGetState,             // Reading IsBackoffEnabled and the antennas.
+    SarStatLteSetConfiguration,     // SetConfigurationAsync
+    SarStatUnsolicitedDelivery,     // From an unsolicited notification's arrival to it being logged.
+    SarStatCount
+} SAR_STAT;
+
+// Sub-buckets per power of two is 2^SAR_HISTOGRAM_SUB_BUCKET_BITS.  Values of 2^40 ns (about
+// 18 minutes) or more are recorded in the last bucket.
+//
+static const UINT32 SAR_HISTOGRAM_SUB_BUCKET_BITS = 5;
+static const UINT32 SAR_HISTOGRAM_MAX_EXPONENT = 40;
+static const UINT32 SAR_HISTOGRAM_BUCKETS =
+    (SAR_HISTOGRAM_MAX_EXPONENT - SAR_HISTOGRAM_SUB_BUCKET_BITS + 1) << SAR_HISTOGRAM_SUB_BUCKET_BITS;
+
+class SarHistogram
+{
+public:
+
+    SarHistogram();
+
+    SarHistogram(const SarHistogram&) = delete;
+    SarHistogram& operator=(const SarHistogram&) = delete;
+
+    // Thread-safe; may run concurrently with readers.
+    //
+    VOID
+    Record(
+        UINT64 value
+        );
+
+    VOID
+    Reset();
+
+    UINT64
+    Count() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    UINT64
+    Min() const;
+
+    UINT64
+    Max() const
+    {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    double
+    Mean() const;
+
+    // The value that fraction (0.0 - 1.0) of the recorded values are at or below, to the
+    // histogram's precision; 0 if nothing was recorded.
+    //
+    UINT64
+    Percentile(
+        double fraction
+        ) const;
+
+    static
+    UINT32
+    BucketFromValue(
+        UINT64 value
+        );
+
+    // The largest value that falls into the bucket.
+    //
+    static
+    UINT64
+    ValueFromBucket(
+        UINT32 bucket
+        );
+
+private:
+
+    std::atomic<UINT64> m_buckets[SAR_HISTOGRAM_BUCKETS];
+    std::atomic<UINT64> m_count;
+    std::atomic<UINT64> m_sum;
+    std::atomic<UINT64> m_min;
+    std::atomic<UINT64> m_max;
+};
+
+// A monotonic timestamp in nanoseconds, for SarStatsRecord.
+//
+UINT64
+SarStatsNow();
+
+// Records the time elapsed since start (from SarStatsNow) into the phase's histogram.
+//
+VOID
+SarStatsRecord(
+    SAR_STAT stat,
+    UINT64 start
+    );
+
+SAR_STAT
+SarStatFromOpcode(
+    DWORD opcode
+    );
+
+SarHistogram*
+SarStatsHistogram(
+    SAR_STAT stat
+    );
+
+LPCSTR
+SarStatName(
+    SAR_STAT stat
+    );
+
+VOID
+SarStatsReset();
+
+// Writes every phase that recorded anything, with count, min, mean, p50, p99, p999 and max in
+// nanoseconds, as one JSON object.
+//
+VOID
+SarStatsPrintJson(
+    _In_ FILE* stream
+    );
+
+// Removes every "--stats" from the command line.  Returns TRUE if there was one.
+//
+BOOL
+SarStatsTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    );
+
+// eof: SarStats.h
+//
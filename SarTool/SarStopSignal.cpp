@@ -0,0 +1,137 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarStopSignal.cpp
+
+Abstract:
+
+    Ctrl+C handling for long-running commands.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarStopSignal.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <time.h>
+#endif
+
+#ifdef _WIN32
+
+static HANDLE s_hStopEvent = NULL;
+
+static
+BOOL
+WINAPI
+SarStopSignalCtrlHandler(
+    DWORD ctrlType
+    )
+{
+    UNREFERENCED_PARAMETER(ctrlType);
+
+    SetEvent(s_hStopEvent);
+    return TRUE;
+}
+
+_Check_return_
+HRESULT
+SarStopSignalArm()
+{
+    HRESULT hr = S_OK;
+
+    s_hStopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if ((s_hStopEvent == NULL) || !SetConsoleCtrlHandler(SarStopSignalCtrlHandler, TRUE))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        SarStopSignalDisarm();
+    }
+
+    return hr;
+}
+
+BOOL
+SarStopSignalWait(
+    DWORD timeoutMilliseconds
+    )
+{
+    return WaitForSingleObject(s_hStopEvent, timeoutMilliseconds) == WAIT_OBJECT_0;
+}
+
+VOID
+SarStopSignalDisarm()
+{
+    if (s_hStopEvent != NULL)
+    {
+        SetConsoleCtrlHandler(SarStopSignalCtrlHandler, FALSE);
+        CloseHandle(s_hStopEvent);
+        s_hStopEvent = NULL;
+    }
+}
+
+#else
+
+static
+VOID
+SarStopSignalSet(
+    _Out_ sigset_t* signals
+    )
+{
+    sigemptyset(signals);
+    sigaddset(signals, SIGINT);
+    sigaddset(signals, SIGTERM);
+}
+
+_Check_return_
+HRESULT
+SarStopSignalArm()
+{
+    sigset_t signals;
+
+    // Blocked signals stay pending until SarStopSignalWait collects them, and threads created
+    // later inherit the mask so none of them can take the signal instead.
+    SarStopSignalSet(&signals);
+    return SarHresultFromErrno(pthread_sigmask(SIG_BLOCK, &signals, NULL));
+}
+
+BOOL
+SarStopSignalWait(
+    DWORD timeoutMilliseconds
+    )
+{
+    sigset_t signals;
+    int signal;
+
+    SarStopSignalSet(&signals);
+
+    if (timeoutMilliseconds == INFINITE)
+    {
+        return sigwait(&signals, &signal) == 0;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMilliseconds / 1000;
+    timeout.tv_nsec = (long)(timeoutMilliseconds % 1000) * 1000000;
+
+    return sigtimedwait(&signals, NULL, &timeout) > 0;
+}
+
+VOID
+SarStopSignalDisarm()
+{
+    sigset_t signals;
+
+    SarStopSignalSet(&signals);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+}
+
+#endif
+
+// eof: SarStopSignal.cpp
+//
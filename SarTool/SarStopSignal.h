@@ -0,0 +1,43 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarStopSignal.h
+
+Abstract:
+
+    Turns Ctrl+C (and SIGINT/SIGTERM on POSIX) into a stop request that a long-running command
+    waits for, so the command can shut down cleanly and report what it did instead of being
+    terminated.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+// Starts converting Ctrl+C into a stop request.  On POSIX the signals are blocked for the calling
+// thread and every thread it creates afterwards, so call this before starting any thread.
+//
+_Check_return_
+HRESULT
+SarStopSignalArm();
+
+// Waits up to timeoutMilliseconds (or INFINITE) for a stop request.  Returns TRUE if one arrived.
+//
+BOOL
+SarStopSignalWait(
+    DWORD timeoutMilliseconds
+    );
+
+VOID
+SarStopSignalDisarm();
+
+// eof: SarStopSignal.h
+//
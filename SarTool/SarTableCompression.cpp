@@ -0,0 +1,367 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarTableCompression.cpp
+
+Abstract:
+
+    Delta and bit-packing compression of SAR_POWER_TABLE.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarTableCompression.h"
+#include "SarCodec.h"
+
+#include <string.h>
+
+static const UINT32 SAR_COMPRESSED_TABLE_ROWS = MAX_NUM_SAR_WIFI_POWER_TABLE;
+static const UINT32 SAR_COMPRESSED_TABLE_COLUMNS = MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+static const UINT32 SAR_COMPRESSED_TABLE_MAX_WIDTH = 9;     // Zigzag of -255..255.
+
+C_ASSERT(SAR_COMPRESSED_TABLE_ROWS < 16);
+C_ASSERT(SAR_COMPRESSED_TABLE_COLUMNS < 16);
+
+// Worst case: every row in mode 0 with 9-bit deltas.  Images this large are never stored, but the
+// encoder needs room to find that out.
+//
+static const size_t SAR_COMPRESSED_TABLE_MAX_IMAGE =
+    2 + (SAR_COMPRESSED_TABLE_ROWS * (13 + (SAR_COMPRESSED_TABLE_COLUMNS - 1) * SAR_COMPRESSED_TABLE_MAX_WIDTH) + 7) / 8;
+
+inline UINT32 SarZigzag(int delta) { return ((UINT32)delta << 1) ^ (UINT32)(delta >> 31); }
+inline int SarUnzigzag(UINT32 value) { return (int)(value >> 1) ^ -(int)(value & 1); }
+
+static
+UINT32
+SarBitWidth(
+    UINT32 value
+    )
+{
+    UINT32 width = 0;
+
+    while ((value >> width) != 0)
+    {
+        width++;
+    }
+
+    return width;
+}
+
+// Accumulates fields least significant bit first and emits them a 32-bit word at a time.  A field
+// is at most 13 bits, so the accumulator never holds more than 44.
+//
+typedef struct _SAR_BIT_WRITER
+{
+    UINT8* Next;
+    UINT64 Bits;
+    UINT32 Count;
+} SAR_BIT_WRITER;
+
+inline
+VOID
+SarBitWrite(
+    _Inout_ SAR_BIT_WRITER* writer,
+    UINT32 value,
+    UINT32 width
+    )
+{
+    writer->Bits |= (UINT64)value << writer->Count;
+    writer->Count += width;
+
+    if (writer->Count >= 32)
+    {
+        SarStoreLe32(writer->Next, (UINT32)writer->Bits);
+        writer->Next += 4;
+        writer->Bits >>= 32;
+        writer->Count -= 32;
+    }
+}
+
+// Loads the 64 bits of the image starting at offset, reading zeroes past its end.  A row is at most
+// 50 bits, plus up to 7 bits of offset into its first byte, so one load fetches a whole row.
+//
+inline
+UINT64
+SarLoadRow(
+    _In_reads_bytes_(size) const UINT8* image,
+    size_t size,
+    size_t offset
+    )
+{
+    UINT64 bits = 0;
+
+    if (offset + sizeof(UINT64) <= size)
+    {
+        return SarLoadLe64(image + offset);
+    }
+
+    for (size_t i = offset; i < size; i++)
+    {
+        bits |= (UINT64)image[i] << (8 * (i - offset));
+    }
+
+    return bits;
+}
+
+C_ASSERT(13 + (SAR_COMPRESSED_TABLE_COLUMNS - 1) * SAR_COMPRESSED_TABLE_MAX_WIDTH + 7 <= 64);
+C_ASSERT(5 + SAR_COMPRESSED_TABLE_COLUMNS * SAR_COMPRESSED_TABLE_MAX_WIDTH + 7 <= 64);
+
+_Check_return_
+HRESULT
+SarCompressPowerTable(
+    _In_ const SAR_POWER_TABLE* value,
+    _Out_writes_bytes_to_(size, *pImageSize) UINT8* buffer,
+    size_t size,
+    _Out_ size_t* pImageSize
+    )
+/*++
+
+Routine Description:
+
+    Compresses a power table row by row.  Each row is coded both along the row and against the row
+    above, and whichever needs fewer bits is kept.
+
+Arguments:
+
+    value - The table to compress.
+    buffer - Receives the compressed image.
+    size - Size of buffer in bytes.
+    pImageSize - Receives the size of the image.
+
+Return Value:
+
+    S_OK on success, S_FALSE if the table does not compress (store it raw), or
+    E_NOT_SUFFICIENT_BUFFER if buffer is too small for the image.
+
+--*/
+{
+    UINT8 image[SAR_COMPRESSED_TABLE_MAX_IMAGE + sizeof(UINT32)];
+    SAR_BIT_WRITER writer = { image + 2, 0, 0 };
+    size_t imageSize;
+
+    *pImageSize = 0;
+
+    image[0] = SAR_COMPRESSED_TABLE_SIGNATURE;
+    image[1] = (UINT8)((SAR_COMPRESSED_TABLE_ROWS << 4) | SAR_COMPRESSED_TABLE_COLUMNS);
+
+    for (UINT32 row = 0; row < SAR_COMPRESSED_TABLE_ROWS; row++)
+    {
+        const UINT8* values = value->PowerValues[row];
+        UINT32 alongRow[SAR_COMPRESSED_TABLE_COLUMNS];
+        UINT32 fromAbove[SAR_COMPRESSED_TABLE_COLUMNS];
+        UINT32 alongWidth = 0;
+        UINT32 aboveWidth = 0;
+
+        for (UINT32 column = 1; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+        {
+            alongRow[column] = SarZigzag((int)values[column] - (int)values[column - 1]);
+            alongWidth |= alongRow[column];
+        }
+        alongWidth = SarBitWidth(alongWidth);
+
+        if (row > 0)
+        {
+            for (UINT32 column = 0; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+            {
+                fromAbove[column] = SarZigzag((int)values[column] - (int)value->PowerValues[row - 1][column]);
+                aboveWidth |= fromAbove[column];
+            }
+            aboveWidth = SarBitWidth(aboveWidth);
+        }
+
+        if ((row > 0) &&
+            (SAR_COMPRESSED_TABLE_COLUMNS * aboveWidth < 8 + (SAR_COMPRESSED_TABLE_COLUMNS - 1) * alongWidth))
+        {
+            SarBitWrite(&writer, 1 | (aboveWidth << 1), 5);
+            for (UINT32 column = 0; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+            {
+                SarBitWrite(&writer, fromAbove[column], aboveWidth);
+            }
+        }
+        else
+        {
+            SarBitWrite(&writer, (alongWidth << 1) | ((UINT32)values[0] << 5), 13);
+            for (UINT32 column = 1; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+            {
+                SarBitWrite(&writer, alongRow[column], alongWidth);
+            }
+        }
+    }
+
+    // Flush the partial word; only its bytes that hold bits belong to the image.
+    SarStoreLe32(writer.Next, (UINT32)writer.Bits);
+    imageSize = (writer.Next - image) + (writer.Count + 7) / 8;
+
+    if (imageSize >= sizeof(SAR_POWER_TABLE))
+    {
+        return S_FALSE;
+    }
+
+    if (size < imageSize)
+    {
+        return E_NOT_SUFFICIENT_BUFFER;
+    }
+
+    memcpy(buffer, image, imageSize);
+    *pImageSize = imageSize;
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarDecompressPowerTable(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ SAR_POWER_TABLE* value
+    )
+/*++
+
+Routine Description:
+
+    Decompresses a power table.  Each row is fetched with one load and unpacked with shifts;
+    out-of-range values are collected as the row is decoded and checked once per row, so a damaged
+    image is still rejected rather than decoded into plausible-looking power values.
+
+Arguments:
+
+    buffer - The compressed image.
+    size - Size of the image in bytes.
+    value - Receives the table.
+
+Return Value:
+
+    S_OK on success, otherwise ERROR_INVALID_DATA.
+
+--*/
+{
+    HRESULT hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    size_t bit = 16;
+
+    if (!SarIsCompressedPowerTable(buffer, size) ||
+        (buffer[1] != ((SAR_COMPRESSED_TABLE_ROWS << 4) | SAR_COMPRESSED_TABLE_COLUMNS)))
+    {
+        goto exit;
+    }
+
+    for (UINT32 row = 0; row < SAR_COMPRESSED_TABLE_ROWS; row++)
+    {
+        UINT8* values = value->PowerValues[row];
+        UINT64 bits = SarLoadRow(buffer, size, bit / 8) >> (bit % 8);
+        UINT32 fromAbove = (UINT32)bits & 1;
+        UINT32 width = (UINT32)(bits >> 1) & 0xf;
+        UINT64 mask = (1ull << width) - 1;
+        UINT32 invalid = 0;
+        int previous;
+
+        if ((width > SAR_COMPRESSED_TABLE_MAX_WIDTH) || (fromAbove && (row == 0)))
+        {
+            goto exit;
+        }
+
+        bits >>= 5;
+        if (fromAbove)
+        {
+            for (UINT32 column = 0; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+            {
+                previous = value->PowerValues[row - 1][column] + SarUnzigzag((UINT32)(bits & mask));
+                invalid |= (UINT32)previous;
+                values[column] = (UINT8)previous;
+                bits >>= width;
+            }
+            bit += 5 + SAR_COMPRESSED_TABLE_COLUMNS * width;
+        }
+        else
+        {
+            previous = (int)(bits & 0xff);
+            values[0] = (UINT8)previous;
+            bits >>= 8;
+            for (UINT32 column = 1; column < SAR_COMPRESSED_TABLE_COLUMNS; column++)
+            {
+                previous += SarUnzigzag((UINT32)(bits & mask));
+                invalid |= (UINT32)previous;
+                values[column] = (UINT8)previous;
+                bits >>= width;
+            }
+            bit += 13 + (SAR_COMPRESSED_TABLE_COLUMNS - 1) * width;
+        }
+
+        // A value outside 0-255, or a row that ran past the end of the image.
+        if (((invalid >> 8) != 0) || (bit > size * 8))
+        {
+            goto exit;
+        }
+    }
+
+    // The image must end in the last byte the table reaches, padded with zero bits.
+    if (((bit + 7) / 8 != size) ||
+        ((bit % 8 != 0) && ((buffer[size - 1] >> (bit % 8)) != 0)))
+    {
+        goto exit;
+    }
+
+    hr = S_OK;
+
+exit:
+    return hr;
+}
+
+const SAR_POWER_TABLE*
+SarPowerTableView(
+    _In_reads_bytes_opt_(size) const UINT8* image,
+    size_t size,
+    _Out_ SAR_POWER_TABLE* decoded
+    )
+{
+    C_ASSERT(alignof(SAR_POWER_TABLE) == 1);
+
+    if (image == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (size >= sizeof(SAR_POWER_TABLE))
+    {
+        return reinterpret_cast<const SAR_POWER_TABLE*>(image);
+    }
+
+    if (FAILED(SarDecompressPowerTable(image, size, decoded)))
+    {
+        return nullptr;
+    }
+
+    return decoded;
+}
+
+BOOL
+SarTableCompressionTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    )
+{
+    BOOL fFound = FALSE;
+    int kept = 0;
+
+    for (int i = 0; i < *argc; i++)
+    {
+        if ((i > 0) && (0 == strcmp(argv[i], "--compress")))
+        {
+            fFound = TRUE;
+            continue;
+        }
+
+        argv[kept++] = argv[i];
+    }
+
+    *argc = kept;
+    return fFound;
+}
+
+// eof: SarTableCompression.cpp
+//
@@ -0,0 +1,107 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarTableCompression.h
+
+Abstract:
+
+    Compact encoding of SAR_POWER_TABLE for UEFI variables and provisioning files, selected by
+    SAR_CONFIG_HEADER.SARTablesCompressed == SAR_TABLES_COMPRESSED_DELTA.
+
+    Power values (1/8 dBm) change little from one band or antenna to the next, so each row is
+    stored as small zigzag deltas packed at the narrowest bit width that holds them:
+
+        UINT8       SAR_COMPRESSED_TABLE_SIGNATURE
+        UINT8       Rows << 4 | values per row
+        bits        Per row, least significant bit first:
+                        1 bit   Mode: 0 = deltas along the row, 1 = deltas from the row above.
+                        4 bits  Delta width w, 0-9.
+                        Mode 0: 8-bit first value, then (values per row - 1) deltas of w bits.
+                        Mode 1: (values per row) deltas of w bits.
+                    Zero bits pad the last byte.
+
+    A compressed image is always shorter than the raw 0x3c-byte table (a table that would not
+    shrink is stored raw), so the two are told apart by size alone and readers never need the
+    header to decode the power table.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+
+// SAR_CONFIG_HEADER.SARTablesCompressed value that makes setconfig compress the power table.  Any
+// other value stores it raw, as SarTool always has.
+//
+static const UINT8 SAR_TABLES_COMPRESSED_DELTA = 0x01;
+
+static const UINT8 SAR_COMPRESSED_TABLE_SIGNATURE = 0xd7;
+
+// Smallest possible image: the two header bytes, a first row of equal values (13 bits) and rows
+// equal to the one above (5 bits each.)
+//
+static const size_t SAR_COMPRESSED_TABLE_MIN_SIZE = 2 + (13 + (MAX_NUM_SAR_WIFI_POWER_TABLE - 1) * 5 + 7) / 8;
+
+inline
+BOOL
+SarIsCompressedPowerTable(
+    _In_reads_bytes_(size) const UINT8* image,
+    size_t size
+    )
+{
+    return (size >= SAR_COMPRESSED_TABLE_MIN_SIZE) &&
+           (size < sizeof(SAR_POWER_TABLE)) &&
+           (image[0] == SAR_COMPRESSED_TABLE_SIGNATURE);
+}
+
+// Compresses a power table.  Returns S_OK with the image size, S_FALSE if the image would be no
+// smaller than the raw table (nothing useful is written; store the table raw), or
+// E_NOT_SUFFICIENT_BUFFER.
+//
+_Check_return_
+HRESULT
+SarCompressPowerTable(
+    _In_ const SAR_POWER_TABLE* value,
+    _Out_writes_bytes_to_(size, *pImageSize) UINT8* buffer,
+    size_t size,
+    _Out_ size_t* pImageSize
+    );
+
+// Decompresses an image written by SarCompressPowerTable.  Fails with ERROR_INVALID_DATA unless
+// the image is well formed and exactly size bytes long.
+//
+_Check_return_
+HRESULT
+SarDecompressPowerTable(
+    _In_reads_bytes_(size) const UINT8* buffer,
+    size_t size,
+    _Out_ SAR_POWER_TABLE* value
+    );
+
+// Returns a power table from a raw or compressed image: the image itself when it is raw (no copy),
+// otherwise the table decompressed into *decoded.  Returns nullptr if the image is neither.
+//
+const SAR_POWER_TABLE*
+SarPowerTableView(
+    _In_reads_bytes_opt_(size) const UINT8* image,
+    size_t size,
+    _Out_ SAR_POWER_TABLE* decoded
+    );
+
+// Removes "--compress" from the command line.  Returns TRUE if it was given.
+//
+BOOL
+SarTableCompressionTakeOption(
+    _Inout_ int* argc,
+    _Inout_updates_(*argc) LPSTR argv[]
+    );
+
+// eof: SarTableCompression.h
+//
@@ -0,0 +1,370 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarThreadPool.cpp
+
+Abstract:
+
+    A small work-stealing thread pool.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarThreadPool.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+
+// Identifies the pool (and the queue within it) that the current thread works for, so that work
+// submitted from inside a work item lands on the submitting worker's own deque.
+//
+static thread_local SarThreadPool* t_currentPool = nullptr;
+static thread_local UINT32 t_currentWorker = 0;
+
+SarThreadPool::SarThreadPool(
+    UINT32 threadCount
+    ) :
+    m_queued(0),
+    m_pending(0),
+    m_nextQueue(0),
+    m_shutdown(FALSE)
+/*++
+
+Routine Description:
+
+    Creates the worker threads and their deques.
+
+Arguments:
+
+    threadCount - Number of workers; 0 selects std::thread::hardware_concurrency().  Clamped to
+        SAR_THREAD_POOL_MAX_THREADS.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+        {
+            threadCount = 1;
+        }
+    }
+
+    if (threadCount > SAR_THREAD_POOL_MAX_THREADS)
+    {
+        threadCount = SAR_THREAD_POOL_MAX_THREADS;
+    }
+
+    for (UINT32 i = 0; i < threadCount; i++)
+    {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (UINT32 i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&SarThreadPool::WorkerLoop, this, i);
+    }
+}
+
+SarThreadPool::~SarThreadPool()
+/*++
+
+Routine Description:
+
+    Waits for outstanding work and then stops and joins the workers.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    None
+
+--*/
+{
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_shutdown = TRUE;
+    }
+    m_workAvailable.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+VOID
+SarThreadPool::Submit(
+    std::function<VOID()> work
+    )
+/*++
+
+Routine Description:
+
+    Queues a work item.
+
+Arguments:
+
+    work - The work item.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    UINT32 queueIndex;
+
+    if (t_currentPool == this)
+    {
+        queueIndex = t_currentWorker;
+    }
+    else
+    {
+        queueIndex = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % (UINT32)m_queues.size();
+    }
+
+    m_pending.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> guard(m_queues[queueIndex]->Lock);
+        m_queues[queueIndex]->Items.push_back(std::move(work));
+    }
+
+    // Publish the item under m_lock so a worker evaluating its wait predicate cannot miss it.
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_queued.fetch_add(1);
+    }
+    m_workAvailable.notify_one();
+}
+
+VOID
+SarThreadPool::Wait()
+/*++
+
+Routine Description:
+
+    Blocks until every submitted work item has completed.
+
+Arguments:
+
+    VOID
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    assert(t_currentPool != this);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this] { return m_pending.load() == 0; });
+}
+
+VOID
+SarThreadPool::ParallelFor(
+    size_t count,
+    const std::function<VOID(size_t)>& work
+    )
+/*++
+
+Routine Description:
+
+    Runs work(i) for every i in [0, count) on the pool and waits for completion.  A worker of
+    this pool that waited for the pool would wait for its own work item, so on a worker the
+    iterations run inline.
+
+Arguments:
+
+    count - Number of iterations.
+    work - The routine to run for each index.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    if (t_currentPool == this)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            work(i);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Submit([&work, i]() { work(i); });
+    }
+
+    Wait();
+}
+
+BOOL
+SarThreadPool::TryDequeue(
+    UINT32 workerIndex,
+    _Out_ std::function<VOID()>* work
+    )
+/*++
+
+Routine Description:
+
+    Takes the newest item from the worker's own deque or, failing that, steals the oldest item from
+    another worker's deque.
+
+Arguments:
+
+    workerIndex - The worker looking for work.
+    work - Receives the work item.
+
+Return Value:
+
+    TRUE if a work item was dequeued.
+
+--*/
+{
+    UINT32 queueCount = (UINT32)m_queues.size();
+
+    for (UINT32 i = 0; i < queueCount; i++)
+    {
+        UINT32 victim = (workerIndex + i) % queueCount;
+        WorkerQueue& queue = *m_queues[victim];
+
+        std::lock_guard<std::mutex> guard(queue.Lock);
+        if (queue.Items.empty())
+        {
+            continue;
+        }
+
+        if (victim == workerIndex)
+        {
+            *work = std::move(queue.Items.back());
+            queue.Items.pop_back();
+        }
+        else
+        {
+            *work = std::move(queue.Items.front());
+            queue.Items.pop_front();
+        }
+
+        m_queued.fetch_sub(1);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+VOID
+SarThreadPool::WorkerLoop(
+    UINT32 workerIndex
+    )
+/*++
+
+Routine Description:
+
+    Worker thread body: runs work items until the pool shuts down.
+
+Arguments:
+
+    workerIndex - Index of this worker's deque.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    t_currentPool = this;
+    t_currentWorker = workerIndex;
+
+    for (;;)
+    {
+        std::function<VOID()> work;
+
+        if (TryDequeue(workerIndex, &work))
+        {
+            work();
+
+            if (m_pending.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_workAvailable.wait(lock, [this] { return m_shutdown || (m_queued.load() > 0); });
+        if (m_shutdown && (m_queued.load() == 0))
+        {
+            break;
+        }
+    }
+
+    t_currentPool = nullptr;
+}
+
+_Check_return_
+HRESULT
+SarThreadPoolParseThreadCount(
+    _In_z_ LPCSTR text,
+    _Out_ UINT32* threadCount
+    )
+/*++
+
+Routine Description:
+
+    Parses a thread count given on the command line.
+
+Arguments:
+
+    text - The argument.
+    threadCount - Receives the count; 0 if the argument is not valid.
+
+Return Value:
+
+    S_OK, or E_INVALIDARG if the argument is not a decimal number of at most
+    SAR_THREAD_POOL_MAX_THREADS.
+
+--*/
+{
+    char* end;
+    unsigned long count;
+
+    *threadCount = 0;
+
+    // strtoul skips leading spaces and takes "-1" as a huge number rather than fail.
+    errno = 0;
+    count = strtoul(text, &end, 10);
+    if (!isdigit((unsigned char)text[0]) || (*end != '\0') || (errno == ERANGE) ||
+        (count > SAR_THREAD_POOL_MAX_THREADS))
+    {
+        return E_INVALIDARG;
+    }
+
+    *threadCount = (UINT32)count;
+    return S_OK;
+}
+
+// eof: SarThreadPool.cpp
+//
@@ -0,0 +1,128 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarThreadPool.h
+
+Abstract:
+
+    A small work-stealing thread pool used to fan provisioning work out across many device folders.
+
+    Each worker owns a deque.  Work submitted from outside the pool is spread round-robin across the
+    deques; work submitted by a worker goes to its own deque.  A worker pops from the back of its own
+    deque and, when that runs dry, steals from the front of the other workers' deques so that a few
+    slow items (e.g. folders on a network share) do not leave the remaining threads idle.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The most workers a pool starts; a larger thread count is clamped to it.
+//
+static const UINT32 SAR_THREAD_POOL_MAX_THREADS = 256;
+
+// Parses the [threads] argument of a command: a decimal number from 0 (one worker per hardware
+// thread) to SAR_THREAD_POOL_MAX_THREADS.  Returns E_INVALIDARG for anything else.
+//
+_Check_return_
+HRESULT
+SarThreadPoolParseThreadCount(
+    _In_z_ LPCSTR text,
+    _Out_ UINT32* threadCount
+    );
+
+class SarThreadPool
+{
+public:
+
+    // threadCount of 0 selects one worker per hardware thread; no more than
+    // SAR_THREAD_POOL_MAX_THREADS are started.
+    //
+    explicit
+    SarThreadPool(
+        UINT32 threadCount = 0
+        );
+
+    ~SarThreadPool();
+
+    SarThreadPool(const SarThreadPool&) = delete;
+    SarThreadPool& operator=(const SarThreadPool&) = delete;
+
+    // Work items report their own status; they must not throw.
+    //
+    VOID
+    Submit(
+        std::function<VOID()> work
+        );
+
+    // Blocks until every submitted work item has completed.  Must not be called from a work item
+    // of this pool: the caller's own item would never complete.
+    //
+    VOID
+    Wait();
+
+    // Submits work(0) .. work(count - 1) and waits for all of them.  Called from a work item of
+    // this pool (a nested fan-out), runs them inline on the calling worker instead.
+    //
+    VOID
+    ParallelFor(
+        size_t count,
+        const std::function<VOID(size_t)>& work
+        );
+
+    UINT32
+    ThreadCount() const
+    {
+        return (UINT32)m_workers.size();
+    }
+
+private:
+
+    struct WorkerQueue
+    {
+        std::mutex Lock;
+        std::deque<std::function<VOID()>> Items;
+    };
+
+    VOID
+    WorkerLoop(
+        UINT32 workerIndex
+        );
+
+    BOOL
+    TryDequeue(
+        UINT32 workerIndex,
+        _Out_ std::function<VOID()>* work
+        );
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_lock;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+    std::atomic<size_t> m_queued;
+    std::atomic<size_t> m_pending;
+    std::atomic<UINT32> m_nextQueue;
+    BOOL m_shutdown;
+};
+
+// eof: SarThreadPool.h
+//
@@ -41,8 +41,6 @@ Environment:
 #include <wlanapi.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <fstream>
-#include <iterator>
 #include <vector>
 #include <Roapi.h> // RO_INIT_MULTITHREADED
 #include "winrt\Windows.Networking.NetworkOperators.h"
@@ -50,6 +48,26 @@ Environment:
 #include <initguid.h>
 #include "Dmf_Wlan_Public.h"
 #include "Wlan_Ihv_Config.h"
+#include "SarAnalytics.h"
+#include "SarArchive.h"
+#include "SarBatch.h"
+#include "SarClient.h"
+#include "SarColumns.h"
+#include "SarCompile.h"
+#include "SarConfigFiles.h"
+#include "SarDeviceService.h"
+#include "SarEventLog.h"
+#include "SarFanOut.h"
+#include "SarFirmwareStore.h"
+#include "SarIndex.h"
+#include "SarNotification.h"
+#include "SarOutput.h"
+#include "SarServer.h"
+#include "SarSetQueue.h"
+#include "SarStats.h"
+#include "SarStopSignal.h"
+#include "SarTableCompression.h"
+#include "SarValidate.h"
 
 // link an umbrella app lib that resolves WINRT_SetRestrictedErrorInfo and other external symbols
 #pragma comment(lib, "windowsapp")
@@ -57,15 +75,15 @@ Environment:
 using namespace winrt::Windows::Networking::NetworkOperators;
 
 //
-// The number of milliseconds to monitor for LTE transmit status updates
+// The default number of milliseconds to monitor for LTE transmit status updates
 // 
 const DWORD LteTxStatusMonitorPeriod = 60000;
 
 //
-// The "path" a user specifies for GetConfig/SetConfig when she wants to read from
-// (or write to) UEFI instead of files on disk.
-// 
-LPCSTR UEFI = "uefi";
+// The number of Wi-Fi unsolicited notifications to monitor for, unless they are being logged with --log
+// or summarized with --summary
+//
+const UINT64 UnsolicitedMonitorCount = 128;
 
 //
 // Commands
@@ -73,879 +91,55 @@ LPCSTR UEFI = "uefi";
 //
 LPCSTR CMD_GETCONFIG = "getconfig";
 LPCSTR CMD_SETCONFIG = "setconfig";
+LPCSTR CMD_DIFFCONFIG = "diffconfig";
 LPCSTR CMD_GETSAR = "getsar";
 LPCSTR CMD_SETSAR = "setsar";
 LPCSTR CMD_UNSOLMON = "unsolMon";
-
-_Check_return_
-HRESULT
-SetProcessPrivilege()
-/*++
-
-Routine Description:
-
-    Attempts to enable the SE_SYSTEM_ENVIRONMENT_NAME privilege in our process token.  Otherwise,
-    Get/SetFirmwareEnvironmentVariable API's will not succeed.
-
-Arguments:
-
-    VOID
-
-Return Value:
-
-    S_OK on success or underlying failure code.
-
-*/
-{
-    HANDLE           hToken = NULL;
-    TOKEN_PRIVILEGES tokenPrivileges = { 0 };
-    HRESULT          hr = S_OK;
-    BOOL             fOk = FALSE;
-
-    // Get the token for this process. 
-    fOk = OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken);
-    if (!fOk)
-    {
-        hr = HRESULT_FROM_WIN32(::GetLastError());
-        _tprintf(TEXT("OpenProcessToken() failed, hr = 0x%x\n"), hr);
-        goto exit;
-    }
-
-    // Get the LUID for the UEFI-access privilege. 
-    fOk = LookupPrivilegeValue(NULL, SE_SYSTEM_ENVIRONMENT_NAME, &tokenPrivileges.Privileges[0].Luid);
-    if (!fOk)
-    {
-        hr = HRESULT_FROM_WIN32(::GetLastError());
-        _tprintf(TEXT("LookupPrivilegeValue() failed, hr = 0x%x\n"), hr);
-        goto exit;
-    }
-
-    tokenPrivileges.PrivilegeCount = 1;  // one privilege to set    
-    tokenPrivileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
-
-    // Set the UEFI-access privilege for this process. 
-    fOk = AdjustTokenPrivileges(hToken, FALSE, &tokenPrivileges, 0, (PTOKEN_PRIVILEGES)NULL, 0);
-    if (!fOk)
-    {
-        hr = HRESULT_FROM_WIN32(::GetLastError());
-        _tprintf(TEXT("AdjustTokenPrivileges() failed, hr = 0x%x\n"), hr);
-        goto exit;
-    }
-
-exit:
-    return hr;
-}
-
-VOID
-PrintLastError()
-/*++
-
-Routine Description:
-
-    Prints a formatted message explaining the last encountered error to the screen.
-
-Arguments:
-
-    VOID
-
-Return Value:
-
-    VOID
-
-*/
-{
-    LPWSTR messageBuffer;
-
-    FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER |
-                  FORMAT_MESSAGE_FROM_SYSTEM |
-                  FORMAT_MESSAGE_IGNORE_INSERTS,
-                  NULL,
-                  GetLastError(),
-                  MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-                  (LPWSTR)&messageBuffer,
-                  0,
-                  NULL);
-
-    printf("%S", messageBuffer);
-
-    if (messageBuffer)
-    {
-        LocalFree(messageBuffer);
-    }
-}
-
-HRESULT
-SetConfig(
-    LPSTR path
-    )
-/*++
-
-Routine Description:
-
-    Writes config to a set of binary provisioning files or directly to UEFI.
-
-Arguments:
-
-    path - "UEFI" or the path to the folder where the .bin files should be written.
-
-Return Value:
-
-    S_OK on success or underlying failure code.
-
-*/
-{
-    HRESULT hr = S_OK;
-
-    // Populate an example SAR_CONFIG_HEADER.
-    SAR_CONFIG_HEADER sarConfigHeader = { 0 };
-
-    sarConfigHeader.Size = sizeof(sarConfigHeader) + 2 * sizeof(SAR_CONFIG_VALUES);
-    sarConfigHeader.HeaderOffset1 = sizeof(SAR_CONFIG_HEADER);
-    sarConfigHeader.HeaderOffset2 = sizeof(SAR_CONFIG_HEADER) + sizeof(SAR_CONFIG_VALUES);
-    sarConfigHeader.WLANTechnology = WDI_802_11_AD;
-    sarConfigHeader.ProductID = 0x4;
-    sarConfigHeader.Version = 0x5;
-    sarConfigHeader.Revision = 0x6;
-    sarConfigHeader.NumberSARTables = 0x7;
-    sarConfigHeader.SARTablesCompressed = 0x8;
-    sarConfigHeader.SARTimersFormat = 0x9;
-    sarConfigHeader.ReservedA = 0xa;
-    sarConfigHeader.ReservedB = 0xb;
-    sarConfigHeader.ReservedC = 0xc;
-    sarConfigHeader.ReservedD = 0xd;
-    sarConfigHeader.ReservedE = 0xe;
-    sarConfigHeader.ReservedF = 0xf;
-
-    // The header should occupy 16 bytes in the output file.
-    C_ASSERT(sizeof(SAR_CONFIG_HEADER) == 0x10);
-
-    // Populate an example SAR_CONFIG_VALUES structure.
-    SAR_CONFIG_VALUES sarConfigValues = { 0 };
-
-    sarConfigValues.Size = sizeof(sarConfigValues);
-    sarConfigValues.SARSafetyTimer = 0xabcdef01;
-    sarConfigValues.SARSafetyRequestResponseTimeout = 0xbbbbbbbb;
-    sarConfigValues.SARUnsolicitedUpdateTimer = 0xcccccccc;
-    sarConfigValues.SARState = 0x55;
-    sarConfigValues.SleepModeState = 0x44;
-    sarConfigValues.SARPowerOnState = 0x33;
-    sarConfigValues.SARPowerOnStateAfterFailure = 0x22;
-    sarConfigValues.SARSafetyTableIndex = 0x11;
-    sarConfigValues.SleepModeStateIndexTable = 0x05;
-
-    // The values struct should occupy 26 bytes in the output file.
-    C_ASSERT(sizeof(SAR_CONFIG_VALUES) == 0x13);
-
-    // Populate a REGION_CONFIG_VALUES and SAR_POWER_TABLE (i.e. the IHV-only structs
-    //  defined in Wlan_Ihv_Config.h)
-    //
-    REGION_CONFIG_VALUES regionConfigValues = {0};
-    regionConfigValues.GeoCountryString.AsciiChars = 0x5048; // 'PH' == Philippines!
-    regionConfigValues.GeoLocationValue = 0x11111111;
-    regionConfigValues.DynamicGeoState = WDI_DYNAMIC_GEO_VALUE_ENABLED;
-    regionConfigValues.DynamicGeoType = WDI_DYNAMIC_GEO_TYPE_DYNAMIC_THEN_STATIC;
-
-    SAR_POWER_TABLE sarPowerTable = {0};
-    for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
-    {
-        for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
-        {
-            // Uniquely number each entry in sarPowerTable.PowerValues.
-            sarPowerTable.PowerValues[row][col] = 1 + col + (row*MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE);
-        }
-    }
-
-    if (0 == _stricmp(path, UEFI))
-    {
-        WCHAR szGuid[39] = { 0 };
-
-        if (!SUCCEEDED(SetProcessPrivilege()))
-        {
-            _tprintf(TEXT("Failed to add privilege to ProcessToken\r\n"));
-        }
-
-        // Write to WDI_SAR_UEFI_COMMON_PARAMS.
-        //
-        if (!StringFromGUID2(WDI_SAR_UEFI_COMMON_PARAMS, szGuid, ARRAYSIZE(szGuid)))
-        {
-            hr = E_NOT_SUFFICIENT_BUFFER;
-            goto exit;
-        }
-
-        // Write SAR_CONFIG_HEADER to UEFI.
-        if (!SetFirmwareEnvironmentVariable(WifiSARHeader,
-                                            szGuid,
-                                            &sarConfigHeader,
-                                            sizeof(sarConfigHeader)))
-        {
-            _tprintf(TEXT("Failed to write %s to UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARHeader,
-                     GetLastError());
-        }
-
-        // Write SAR_CONFIG_VALUES to UEFI.
-        if (!SetFirmwareEnvironmentVariable(WifiSARConfig,
-                                            szGuid,
-                                            &sarConfigValues,
-                                            sizeof(sarConfigValues)))
-        {
-            _tprintf(TEXT("Failed to write %s to UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARConfig,
-                     GetLastError());
-        }
-
-        // Write to WDI_SAR_UEFI_IHV_PARAMS.
-        //
-        if (!StringFromGUID2(WDI_SAR_UEFI_IHV_PARAMS, szGuid, ARRAYSIZE(szGuid)))
-        {
-            hr = E_NOT_SUFFICIENT_BUFFER;
-            goto exit;
-        }
-
-        // Write REGION_CONFIG_VALUES to UEFI.
-        if (!SetFirmwareEnvironmentVariable(WifiRegionConfig,
-                                            szGuid,
-                                            &regionConfigValues,
-                                            sizeof(regionConfigValues)))
-        {
-            _tprintf(TEXT("Failed to write %s to UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiRegionConfig,
-                     GetLastError());
-        }
-
-        // Write SAR_POWER_TABLE to UEFI.
-        if (!SetFirmwareEnvironmentVariable(WifiSARTable,
-                                            szGuid,
-                                            &sarPowerTable,
-                                            sizeof(sarPowerTable)))
-        {
-            _tprintf(TEXT("Failed to write %s to UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARTable,
-                     GetLastError());
-        }
-    }
-    else
-    {
-        // Write to the appropriate file.
-        char fullPath[MAX_PATH] = {0};
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARHeader);
-        std::ofstream output(fullPath, std::ofstream::out | std::ofstream::binary);
-        output.write((const char *)&sarConfigHeader, sizeof(sarConfigHeader));
-        output.close();
-
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARConfig);
-        output.open(fullPath, std::ofstream::out | std::ofstream::binary);
-        output.write((const char *)&sarConfigValues, sizeof(sarConfigValues));
-        output.close();
-
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiRegionConfig);
-        output.open(fullPath, std::ofstream::out | std::ofstream::binary);
-        output.write((const char *)&regionConfigValues, sizeof(regionConfigValues));
-        output.close();
-
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARTable);
-        output.open(fullPath, std::ofstream::out | std::ofstream::binary);
-        output.write((const char *)&sarPowerTable, sizeof(sarPowerTable));
-        output.close();
-    }
-
-exit:
-    return hr;
-}
-
-HRESULT
-GetConfig(
-    LPSTR path
-    )
-/*++
-
-Routine Description:
-
-    Reads config from a binary PROVISION file on the local filesystem or from UEFI.
-
-Arguments:
-
-    path - "UEFI" or the path to the folder containing the .bin files containing provisioning info.
-
-Return Value:
-
-    S_OK on success or underlying failure code.
-
-*/
-{
-    HRESULT hr = S_OK;
-    SAR_CONFIG_HEADER sarConfigHeader = { 0 };
-    SAR_CONFIG_VALUES sarConfigValues = { 0 };
-    REGION_CONFIG_VALUES regionConfigValues = {0};
-    SAR_POWER_TABLE sarPowerTable = {0};
-
-    if (0 == _stricmp(path, UEFI))
-    {
-        WCHAR szGuid[39] = { 0 };
-
-        hr = SetProcessPrivilege();
-        if (!SUCCEEDED(hr))
-        {
-            _tprintf(TEXT("Failed to add privilege to ProcessToken\r\n"));
-            goto exit;
-        }
-
-        // Read from WDI_SAR_UEFI_COMMON_PARAMS.
-        //
-        if (!StringFromGUID2(WDI_SAR_UEFI_COMMON_PARAMS, szGuid, ARRAYSIZE(szGuid)))
-        {
-            hr = E_NOT_SUFFICIENT_BUFFER;
-            goto exit;
-        }
-
-        // Read SAR_CONFIG_HEADER from UEFI.
-        if (!GetFirmwareEnvironmentVariable(WifiSARHeader,
-                                            szGuid,
-                                            &sarConfigHeader,
-                                            sizeof(sarConfigHeader)))
-        {
-            PrintLastError();
-            _tprintf(TEXT("Failed to read %s from UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARHeader,
-                     GetLastError());
-        }
-
-        // Read SAR_CONFIG_VALUES from UEFI.
-        if (!GetFirmwareEnvironmentVariable(WifiSARConfig,
-                                            szGuid,
-                                            &sarConfigValues,
-                                            sizeof(sarConfigValues)))
-        {
-            _tprintf(TEXT("Failed to read %s from UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARConfig,
-                     GetLastError());
-        }
-
-        // Read from WDI_SAR_UEFI_IHV_PARAMS.
-        //
-        if (!StringFromGUID2(WDI_SAR_UEFI_IHV_PARAMS, szGuid, ARRAYSIZE(szGuid)))
-        {
-            hr = E_NOT_SUFFICIENT_BUFFER;
-            goto exit;
-        }
-
-
-        // Read REGION_CONFIG_VALUES from UEFI.
-        if (!GetFirmwareEnvironmentVariable(WifiRegionConfig,
-                                            szGuid,
-                                            &regionConfigValues,
-                                            sizeof(regionConfigValues)))
-        {
-            _tprintf(TEXT("Failed to read %s from UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiRegionConfig,
-                     GetLastError());
-        }
-
-        // Read SAR_POWER_TABLE from UEFI.
-        if (!GetFirmwareEnvironmentVariable(WifiSARTable,
-                                            szGuid,
-                                            &sarPowerTable,
-                                            sizeof(sarPowerTable)))
-        {
-            _tprintf(TEXT("Failed to read %s from UEFI with error: - GetLastError returns:0x%08X\r\n"),
-                     WifiSARTable,
-                     GetLastError());
-        }
-    }
-    else
-    {
-        // The specified path is a folder.  We look for hard-coded file names that match the UEFI variable names.
-        // For each file, copy the contents of the into the buffer and then copy the buffer into the struct.
-        char fullPath[MAX_PATH] = {0};
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARHeader);
-        std::vector<char> buffer;
-        std::ifstream input(fullPath, std::ios::binary);
-        std::vector<char>::iterator it;
-        it = buffer.begin();
-        buffer.insert(it,
-                      std::istreambuf_iterator<char>(input),
-                      std::istreambuf_iterator<char>());
-        input.close();
-        if (buffer.size() >= sizeof(sarConfigHeader))
-        {
-            memcpy(&sarConfigHeader, buffer.data(), sizeof(sarConfigHeader));
-        }
-        buffer.clear();
-
-        // SAR_CONFIG_VALUES
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARConfig);
-        input.open(fullPath, std::ios::binary);
-        it = buffer.begin();
-        buffer.insert(it,
-                      std::istreambuf_iterator<char>(input),
-                      std::istreambuf_iterator<char>());
-        input.close();
-        memcpy(&sarConfigValues, buffer.data(), sizeof(sarConfigValues));
-        buffer.clear();
-
-        // REGION_CONFIG_VALUES
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiRegionConfig);
-        input.open(fullPath, std::ios::binary);
-        it = buffer.begin();
-        buffer.insert(it,
-                      std::istreambuf_iterator<char>(input),
-                      std::istreambuf_iterator<char>());
-        input.close();
-        memcpy(&regionConfigValues, buffer.data(), sizeof(regionConfigValues));
-        buffer.clear();
-
-        // SAR_POWER_TABLE 
-        sprintf_s(fullPath, sizeof(fullPath), "%s\\%ws.bin", path, WifiSARTable);
-        input.open(fullPath, std::ios::binary);
-        it = buffer.begin();
-        buffer.insert(it,
-                      std::istreambuf_iterator<char>(input),
-                      std::istreambuf_iterator<char>());
-        input.close();
-
-#define SPEW_EACH_BYTE Yeah!
-#ifdef SPEW_EACH_BYTE
-        wprintf(L"\nSAR_POWER_TABLE rawData \n");
-        for (DWORD i = 0; i < buffer.size(); i++)
-        {
-            if (i % MAX_NUM_SAR_WIFI_POWER_TABLE == 0)
-            {
-                printf("\n");
-            }
-            printf("%02x ", (uint8_t)buffer[i]);
-        }
-        printf("\n");
-#endif
-
-        // Read SAR_POWER_TABLE (a fixed-sized PowerValues 2-D array.)
-        memcpy(&sarPowerTable, buffer.data(), sizeof(sarPowerTable));
-        buffer.clear();
-    }
-
-    // Print the contents of the SAR_CONFIG_HEADER.
-    wprintf(L"\n\n");
-    wprintf(L"Size = 0x%02x\n", sarConfigHeader.Size);
-    wprintf(L"HeaderOffset1 = 0x%02x\n", sarConfigHeader.HeaderOffset1);
-    wprintf(L"HeaderOffset2 = 0x%02x\n", sarConfigHeader.HeaderOffset2);
-    wprintf(L"WLANTechnology = 0x%02x\n", sarConfigHeader.WLANTechnology);
-    wprintf(L"ProductID = 0x%02x\n", sarConfigHeader.ProductID);
-    wprintf(L"Version = 0x%02x\n", sarConfigHeader.Version);
-    wprintf(L"Revision = 0x%02x\n", sarConfigHeader.Revision);
-    wprintf(L"NumberSARTables = 0x%02x\n", sarConfigHeader.NumberSARTables);
-    wprintf(L"SARTablesCompressed = 0x%02x\n", sarConfigHeader.SARTablesCompressed);
-    wprintf(L"SARTimersFormat = 0x%02x\n", sarConfigHeader.SARTimersFormat);
-    wprintf(L"ReservedA = 0x%02x\n", sarConfigHeader.ReservedA);
-    wprintf(L"ReservedB = 0x%02x\n", sarConfigHeader.ReservedB);
-    wprintf(L"ReservedC = 0x%02x\n", sarConfigHeader.ReservedC);
-    wprintf(L"ReservedD = 0x%02x\n", sarConfigHeader.ReservedD);
-    wprintf(L"ReservedE = 0x%02x\n", sarConfigHeader.ReservedE);
-    wprintf(L"ReservedF = 0x%02x\n", sarConfigHeader.ReservedF);
-
-    // Print the contents of the SAR_CONFIG_VALUES.
-    wprintf(L"\nSAR_CONFIG_VALUES 1\n");
-    wprintf(L"Size = 0x%02x\n", sarConfigValues.Size);
-    wprintf(L"SARSafetyTimer = 0x%08x\n", sarConfigValues.SARSafetyTimer);
-    wprintf(L"SARSafetyRequestResponseTimeout = 0x%08x\n", sarConfigValues.SARSafetyRequestResponseTimeout);
-    wprintf(L"SARUnsolicitedUpdateTimer = 0x%08x\n", sarConfigValues.SARUnsolicitedUpdateTimer);
-    wprintf(L"SARState = 0x%02x\n", sarConfigValues.SARState);
-    wprintf(L"SleepModeState = 0x%02x\n", sarConfigValues.SleepModeState);
-    wprintf(L"SARPowerOnState = 0x%02x\n", sarConfigValues.SARPowerOnState);
-    wprintf(L"SARPowerOnStateAfterFailure = 0x%02x\n", sarConfigValues.SARPowerOnStateAfterFailure);
-    wprintf(L"SARSafetyTableIndex = 0x%02x\n", sarConfigValues.SARSafetyTableIndex);
-    wprintf(L"SleepModeStateIndexTable = 0x%02x\n", sarConfigValues.SleepModeStateIndexTable);
-
-    // REGION_CONFIG_VALUES and SAR_POWER_TABLE (i.e. the IHV-only structs defined in Wlan_Ihv_Config.h)
-    //
-    wprintf(L"\nREGION_CONFIG_VALUES\n");
-    wprintf(L"GeoCountryString.AsciiChars = 0x%04x\n", regionConfigValues.GeoCountryString.AsciiChars);
-    wprintf(L"GeoLocationValue = 0x%08x\n", regionConfigValues.GeoLocationValue);
-    wprintf(L"DynamicGeoState = 0x%02x\n", regionConfigValues.DynamicGeoState);
-    wprintf(L"DynamicGeoType = 0x%02x\n", regionConfigValues.DynamicGeoType);
-
-    wprintf(L"\nSAR_POWER_TABLE\n");
-    for (int row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
-    {
-        for (int col = 0; col < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; col++)
-        {
-            wprintf(L"%6.3f", sarPowerTable.PowerValues[row][col]/8.0);
-            if ((col+1) < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE)
-            {
-                wprintf(L" - ");
-            }
-        }
-        wprintf(L"\n");
-    }
-
-exit:
-    return hr;
-}
+LPCSTR CMD_BATCH = "batch";
+LPCSTR CMD_VALIDATE = "validate";
+LPCSTR CMD_ARCHIVE = "archive";
+LPCSTR CMD_INDEX = "index";
+LPCSTR CMD_QUERY = "query";
+LPCSTR CMD_COLUMNS = "columns";
+LPCSTR CMD_COMPILE = "compile";
+LPCSTR CMD_SERVE = "serve";
+LPCSTR CMD_REMOTE = "remote";
+LPCSTR CMD_DECODELOG = "decodelog";
 
 VOID
 PrintGuid(
     REFGUID guid
-    )
-/*++
-
-Routine Description:
-
-    Prints the specified GUID to the screen.
-
-Arguments:
-
-    guid - The GUID to print to the screen.
-
-Return Value:
-
-    VOID
-
-*/
-{
-    WCHAR szGuid[39] = { 0 };
-
-// Ignore compiler Warning C6031 Return value ignored
-//
-#pragma warning (push)
-#pragma warning (disable : 6031)
-    StringFromGUID2(guid, szGuid, ARRAYSIZE(szGuid));
-#pragma warning (pop)
-
-    wprintf(szGuid);
-
-    return;
-}
-
-HRESULT
-GetSetSARWiFi(
-    DWORD dwOpCode,
-    WDI_SAR_BACKOFF_STATE wdiSARBackoffState,
-    UINT32 mimoConfigType,
-    _In_ int argc,
-    _In_reads_(argc) LPSTR argv[]
-    )
-/*++
-
-Routine Description:
-
-    Gets or sets the SAR configuration on the Wi-Fi radio using the WlanDeviceServiceCommand API
-    available since Windows 10 version 1809 (build 17763.)
-
-Arguments:
-
-    dwOpCode - WDI_SET_SAR_STATE or WDI_GET_SAR_STATE
-    wdiSARBackoffState - WDI_SARBACKOFF_DISABLED or WDI_SARBACKOFF_ENABLED
-    mimoConfigType - Antenna selection bit mask.
-    argc - Count of arguments.
-    argv - Array of arguments.
-
-Return Value:
-
-    S_OK on success or underlying failure code.
-
-*/
-{
-    HRESULT hr = S_OK;
-
-#if (NTDDI_WIN10_RS4 && (NTDDI_VERSION >= NTDDI_WIN10_RS4))
-    HANDLE hClient = NULL;
-    DWORD dwMaxClient = 2;
-    DWORD dwCurVersion = 0;
-    DWORD dwResult = 0;
-    GUID ifaceGuid = { 0 };
-    WDI_SAR_STATE * pwdiSARState;
-    WDI_SAR_CONFIG_SET * pwdiSARConfig;
-
-    GUID deviceServiceGuid = WDI_SAR_DEVICE_SERVICE;
-    DWORD dwInBufferSize = 0;
-    PVOID pInBuffer = nullptr;
-    DWORD dwOutBuffer = { 0 };
-    DWORD dwOutBufferSize = sizeof(dwOutBuffer);
-    PVOID pOutBuffer = &dwOutBuffer;
-    DWORD dwBytesReturned;
-
-    int antennaPairs = argc / 2;
-    int32_t antennaIndex1 = 0;
-    LONG sarBackoffIndex1 = 0;
-    int32_t antennaIndex2 = 0;
-    int32_t sarBackoffIndex2 = 0;
-
-    dwResult = WlanOpenHandle(dwMaxClient, NULL, &dwCurVersion, &hClient);
-    if (dwResult != ERROR_SUCCESS)
-    {
-        hr = HRESULT_FROM_WIN32(dwResult);
-        goto exit;
-    }
-
-    PWLAN_INTERFACE_INFO_LIST pInterfaceList;
-    dwResult = WlanEnumInterfaces(hClient, nullptr, &pInterfaceList);
-    if (dwResult != ERROR_SUCCESS)
-    {
-        hr = HRESULT_FROM_WIN32(dwResult);
-        goto exit;
-    }
-
-    ifaceGuid = pInterfaceList->InterfaceInfo[pInterfaceList->dwIndex].InterfaceGuid;
-
-#undef GET_SERVICES
-#ifdef GET_SERVICES
-    PWLAN_DEVICE_SERVICE_GUID_LIST pServiceGuidList = NULL;
-    dwResult = WlanGetSupportedDeviceServices(hClient, &ifaceGuid, &pServiceGuidList);
-    if (dwResult != ERROR_SUCCESS)
-    {
-        printf("WlanGetSupportedDeviceServices returned %u\r\n", dwResult);
-        hr = HRESULT_FROM_WIN32(dwResult);
-        goto exit;
-    }
-
-    // iterate over returned service GUID list
-    for (DWORD i = 0; i < pServiceGuidList->dwNumberOfItems; i++)
-    {
-        PrintGuid(pServiceGuidList->DeviceService[i]);
-        printf("\r\n");
-    }
-    WlanFreeMemory(pServiceGuidList);
-#endif
-
-    if (antennaPairs >= 1)
-    {
-        antennaIndex1 = strtoul(argv[0], nullptr, 16);
-        sarBackoffIndex1 = atoi(argv[1]);
-    }
-
-    if (antennaPairs == 2)
-    {
-        antennaIndex2 = strtoul(argv[2], nullptr, 16);
-        sarBackoffIndex2 = atoi(argv[3]);
-    }
-
-    if (dwOpCode == WDI_SET_SAR_STATE)
-    {
-        dwInBufferSize = sizeof(WDI_SAR_STATE) + 2*sizeof(WDI_SAR_CONFIG_SET);
-        pwdiSARState = (WDI_SAR_STATE *)malloc(dwInBufferSize);
-        if (!pwdiSARState)
-        {
-            hr = E_OUTOFMEMORY;
-            goto exit;
-        }
-        memset(pwdiSARState, 0, dwInBufferSize);
-        pwdiSARConfig = (WDI_SAR_CONFIG_SET *)(pwdiSARState + 1);
-
-        pwdiSARState->SarBackoffStatus = wdiSARBackoffState;
-        pwdiSARState->MIMOConfigType = mimoConfigType;
-        pwdiSARState->NumWdiSarConfigElements = antennaPairs;
-
-        pwdiSARConfig->WDI_SARAntennaIndex = antennaIndex1;
-        pwdiSARConfig->WDI_SARBackOffIndex = sarBackoffIndex1;
-
-        pwdiSARConfig++;
-
-        pwdiSARConfig->WDI_SARAntennaIndex = antennaIndex2;
-        pwdiSARConfig->WDI_SARBackOffIndex = sarBackoffIndex2;
-
-        pInBuffer = (PVOID)pwdiSARState;
-    }
-    else
-    {
-        dwOutBufferSize = sizeof(WDI_SAR_STATE) + 2*sizeof(WDI_SAR_CONFIG_SET);
-        pOutBuffer = (WDI_SAR_STATE *)malloc(dwOutBufferSize);
-        if (!pOutBuffer)
-        {
-            hr = E_OUTOFMEMORY;
-            goto exit;
-        }
-        memset(pOutBuffer, 0, dwOutBufferSize);
-    }
-
-#undef SPEW_EACH_BYTE
-#ifdef SPEW_EACH_BYTE
-    for (DWORD i = 0; i < dwInBufferSize; i++)
-    {
-        if (i % 8 == 0)
-        {
-            printf("\n");
-        }
-        printf("%02x ", ((UINT8*)pInBuffer)[i]);
-    }
-    printf("\n");
-#endif
-
-    dwResult = WlanDeviceServiceCommand(
-        hClient,
-        &ifaceGuid,
-        &deviceServiceGuid,
-        dwOpCode,
-        dwInBufferSize,
-        pInBuffer,
-        dwOutBufferSize,
-        pOutBuffer,
-        &dwBytesReturned
-    );
-
-    if (dwResult != ERROR_SUCCESS)
-    {
-        printf("WlanDeviceServiceCommand returned %u\r\n", dwResult);
-        hr = HRESULT_FROM_WIN32(dwResult);
-        goto exit;
-    }
-
-    printf("WlanDeviceServiceCommand returned %u, dwOutBuffer=%u, dwBytesReturned=%u\r\n", dwResult, dwOutBuffer, dwBytesReturned);
-    if (dwOpCode == WDI_GET_SAR_STATE)
-    {
-        if (pOutBuffer)
-        {
-            printf("WlanDeviceServiceCommand returned a null output buffer.u\r\n");
-            hr = E_UNEXPECTED;
-            goto exit;
-        }
-
-        pwdiSARState = (WDI_SAR_STATE *)pOutBuffer;
-        pwdiSARConfig = (WDI_SAR_CONFIG_SET *)(pwdiSARState + 1);
-
-        printf("WlanDeviceServiceCommand SarBackoffStatus %u, MIMOConfigType=%u, NumWdiSarConfigElements=%u\r\n",
-            pwdiSARState->SarBackoffStatus,
-            pwdiSARState->MIMOConfigType,
-            pwdiSARState->NumWdiSarConfigElements);
-
-        for (UINT32 i=0; i<pwdiSARState->NumWdiSarConfigElements; i++)
-        {
-            printf("    WDI_SARAntennaIndex %u, WDI_SARBackOffIndex=%u\r\n",
-                pwdiSARConfig->WDI_SARAntennaIndex,
-                pwdiSARConfig->WDI_SARBackOffIndex);
-            pwdiSARConfig++;
-        }
-    }
-    else
-    {
-        // Print the UINT32 result returned in pOutputBuffer.
-        if (dwBytesReturned == 4)
-        {
-            WDI_SAR_RESULT* pwdiSARResult = (WDI_SAR_RESULT*)pOutBuffer;
-            printf("WlanDeviceServiceCommand WDI_SAR_RESULT = %u\r\n",
-                *pwdiSARResult);
-    
-        }
-    }
-
-exit:
-    if (NULL != hClient)
-    {
-        dwResult = WlanCloseHandle(hClient, NULL);
-    }
-#else
-    _tprintf(TEXT("\n\n--->>>> Compiled against an RS3 SDK or older - so WlanDeviceServiceCommand is not defined\n\n\n"));
-#endif
-
-    return hr;
-}
-
-HRESULT
-GetSetSARLTE(
-    BOOLEAN fGet,
-    _In_ int argc,
-    _In_reads_(argc) LPSTR argv[]
-    )
-/*++
-
-Routine Description:
-
-    Gets or sets the SAR configuration on the LTE radio using the MobileBroadbandSarManager WinRT API.
-
-Arguments:
-
-    fGet - TRUE if we should get the config; FALSE if we should set the config.
-    argc - Count of arguments.
-    argv - Array of arguments.
-
-Return Value:
-
-    S_OK on success or underlying failure code.
-
-*/
-{
-    HRESULT hr = S_OK;
-
-    WINRT_RoInitialize(RO_INIT_MULTITHREADED);
-
-    try
-    {
-        auto modem = MobileBroadbandModem::GetDefault();
-        auto config = modem.GetCurrentConfigurationAsync().get();
-        auto sarManager = config.SarManager();
-
-        if (!sarManager)
-        {
-            printf("\nERROR: couldn't get valid SarManager.\n");
-            hr = E_POINTER;
-            goto Exit;
-        }
+    )
+/*++
 
-        if (fGet)
-        {
-            printf("\r\n");
+Routine Description:
 
-            if (sarManager.IsBackoffEnabled())
-            {
-                printf("Backoff is ENabled.\r\n");
-            }
-            else
-            {
-                printf("Backoff is DISabled\r\n.");
-            }
+    Prints the specified GUID to the screen.
 
-            printf("\r\n");
+Arguments:
 
-            // Iterate over antennas and determine what their current config is.
-            for (auto antenna : sarManager.Antennas())
-            {
-                printf("AntennaIndex 0x%08x configed to use BackoffIndex %u\r\n",
-                    antenna.AntennaIndex(),
-                    antenna.SarBackoffIndex());
-            }
-        }
-        else
-        {
-            int antennaPairs = argc / 2;
-            if ((antennaPairs != 1) && (antennaPairs != 2))
-            {
-                printf("\nERROR: invalid set of {AntennaIndex, PowerTableIndex} pairs\n");
-                hr = E_INVALIDARG;
-                goto Exit;
-            }
+    guid - The GUID to print to the screen.
 
-            std::vector<MobileBroadbandAntennaSar> antennas;
-            int32_t antennaIndex = 0;
-            int32_t sarBackoffIndex = 0;
-            if (antennaPairs >= 1)
-            {
-                printf("\n setting {AntennaIndex=%s, PowerTableIndex=%s}\n", argv[0], argv[1]);
-                antennaIndex = atoi(argv[0]);
-                sarBackoffIndex = atoi(argv[1]);
-                antennas.insert(antennas.end(), { antennaIndex, sarBackoffIndex });
-            }
-            if (antennaPairs == 2)
-            {
-                printf("\n setting {AntennaIndex=%s, PowerTableIndex=%s}\n", argv[2], argv[3]);
-                antennaIndex = atoi(argv[2]);
-                sarBackoffIndex = atoi(argv[3]);
-                antennas.insert(antennas.end(), { antennaIndex, sarBackoffIndex });
-            }
+Return Value:
 
-            sarManager.SetConfigurationAsync(std::move(antennas)).get();
-        }
-    }
-    catch (winrt::hresult_error ex)
-    {
-        printf("0x%08x - %ws\n",
-            ex.code().value,
-            ex.message().c_str());
-    }
+    VOID
 
-Exit:
-    WINRT_RoUninitialize();
+*/
+{
+    WCHAR szGuid[39] = { 0 };
 
-    return hr;
+// Ignore compiler Warning C6031 Return value ignored
+//
+#pragma warning (push)
+#pragma warning (disable : 6031)
+    StringFromGUID2(guid, szGuid, ARRAYSIZE(szGuid));
+#pragma warning (pop)
+
+    wprintf(szGuid);
+
+    return;
 }
 
-static int s_nCallbacks = 0;
 VOID
 DeviceServiceNotificationCallback(
     PWLAN_NOTIFICATION_DATA pdata,
@@ -956,48 +150,38 @@ DeviceServiceNotificationCallback(
 Routine Description:
 
     This callback is called when an 'unsolicited notification' is sent by the WLAN (Wi-Fi)
-    transmitter.  Each call is a request for updated SAR status.  A status message will be
-    printed to the screen.
+    transmitter.  Each call is a request for updated SAR status.  The notification is timestamped
+    and queued for the pipeline's consumer thread, which prints a status message; nothing here
+    waits on console I/O.
 
 Arguments:
 
     pdata - The information specific to this call; sent by Wi-Fi transmitter.
-    pCtxt - The context passed along to the callback.
+    pCtxt - The SarNotificationPipeline passed to WlanRegisterNotification.
 
 Return Value:
 
-    S_OK on success or underlying failure code.
+    VOID
 
 */
 {
 #if (NTDDI_WIN10_RS5 && (NTDDI_VERSION >= NTDDI_WIN10_RS5))
-    DWORD i;
+    SarNotificationPipeline* pipeline = (SarNotificationPipeline*)pCtxt;
     PWLAN_DEVICE_SERVICE_NOTIFICATION_DATA pNotData = NULL;
-    GUID deviceServiceGuid = WDI_SAR_DEVICE_SERVICE;
+    SAR_NOTIFICATION notification;
 
-    s_nCallbacks++;
+    notification.Timestamp = SarStatsNow();
 
     pNotData = (PWLAN_DEVICE_SERVICE_NOTIFICATION_DATA)pdata->pData;
 
-    if (!memcmp(&deviceServiceGuid, &pNotData->DeviceService, sizeof(GUID)))
-    {
-        SYSTEMTIME time;
-
-        GetSystemTime(&time);
-
-        printf("%2.2d:%2.2d:%2.2d.%3.3d : We got SAR unsolicited request 0x%x\n", time.wHour, time.wMinute, time.wSecond, time.wMilliseconds, *(UINT16 *)pNotData->DataBlob);
-
-        return;
-    }
-
-    PrintGuid(pNotData->DeviceService);
-    printf("\nopcode 0x%x\n", pdata->NotificationCode);
-    printf("data size %d\n", pNotData->dwDataSize);
+    notification.DeviceService = pNotData->DeviceService;
+    notification.NotificationCode = pdata->NotificationCode;
+    notification.DataSize = pNotData->dwDataSize;
+    memcpy(notification.Data,
+           pNotData->DataBlob,
+           (pNotData->dwDataSize < SAR_NOTIFICATION_MAX_DATA) ? pNotData->dwDataSize : SAR_NOTIFICATION_MAX_DATA);
 
-    for (i = 0; i < pNotData->dwDataSize; i++) {
-        printf("0x%2.2x ", pNotData->DataBlob[i]);
-    }
-    printf("\n");
+    pipeline->Post(&notification);
 #else
     _tprintf(TEXT("\n\n--->>>> Compiled against an RS4 SDK or older - so WlanDeviceServiceCommand is not defined\n\n\n"));
 #endif
@@ -1005,7 +189,8 @@ Return Value:
 
 INT
 UnsolicitedMonitor(
-    HANDLE hClient
+    HANDLE hClient,
+    _In_ SarNotificationPipeline* pipeline
     )
 /*++
 
@@ -1016,6 +201,7 @@ Routine Description:
 Arguments:
 
     hClient - Handle to the WLAN (Wi-Fi) subsystem.
+    pipeline - Receives the notifications.
 
 Return Value:
 
@@ -1053,7 +239,7 @@ Return Value:
         WLAN_NOTIFICATION_SOURCE_DEVICE_SERVICE,
         FALSE,
         DeviceServiceNotificationCallback,
-        NULL,
+        pipeline,
         NULL,
         NULL);
     if (dwResult != ERROR_SUCCESS)
@@ -1072,18 +258,23 @@ exit:
 }
 
 HRESULT
-LteTxStatusMonitor()
+LteTxStatusMonitor(
+    DWORD period,
+    _In_opt_ SarEventLogWriter* eventLog
+    )
 /*++
 
 Routine Description:
 
     This method will register with the LTE transmitter for 'unsolicited notifications' that are
     sent by the LTE transmitter to request updated SAR status.  Each time a notification is received
-    during the monitoring period, a status message will be printed to the screen.
+    during the monitoring period, a status message will be printed to the screen and, if there is
+    an event log, the new transmission state is appended to it.  Ctrl+C ends the period early.
 
 Arguments:
 
-    VOID
+    period - Milliseconds to monitor for, or INFINITE to monitor until Ctrl+C.
+    eventLog - Optionally receives every TransmissionStateChanged event.
 
 Return Value:
 
@@ -1093,6 +284,12 @@ Return Value:
 {
     HRESULT hr = S_OK;
 
+    hr = SarStopSignalArm();
+    if (FAILED(hr))
+    {
+        goto Exit;
+    }
+
     winrt::init_apartment();
 
     try
@@ -1120,11 +317,18 @@ Return Value:
         {
             printf("TransmissionStateChanged: %s\n",
                 eventArgs.IsTransmitting()? "transmitting" : "not transmitting");
+
+            if ((eventLog != nullptr) &&
+                (FAILED(eventLog->Append(SarEventLteTransmissionState, SarEventLogNow(), eventArgs.IsTransmitting() ? 1 : 0, nullptr, 0)) ||
+                 FAILED(eventLog->Flush())))
+            {
+                printf("failed to write TransmissionStateChanged to the event log\n");
+            }
         });
 
         sarManager.StartTransmissionStateMonitoring();
 
-        Sleep(LteTxStatusMonitorPeriod);
+        SarStopSignalWait(period);
 
         sarManager.StopTransmissionStateMonitoring();
     }
@@ -1137,6 +341,7 @@ Return Value:
 
 Exit:
 
+    SarStopSignalDisarm();
     return hr;
 }
 
@@ -1244,31 +449,99 @@ Return Value:
 
     printf("\n\n------------------------------------------------------------\n\n");
 
-    printf("Usage: %s getconfig {UEFI | <path>}\n  The getconfig command reads configuration from UEFI using GetFirmwareEnvironmentVariable or a binary file.",
+    printf("Usage: %s getconfig {UEFI | <path> | <file>.sarc}\n  The getconfig command reads configuration from UEFI using GetFirmwareEnvironmentVariable, binary files or a provisioning container.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s setconfig {UEFI | <path> | <file>.sarc} [UEFI | <source path> | <source file>.sarc] [--compress]\n  The setconfig command writes the example configuration (or the configuration read from the source) to UEFI, binary files or a provisioning container.  --compress sets SARTablesCompressed and stores the SAR_POWER_TABLE delta-encoded and bit-packed.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s diffconfig {UEFI | <path> | <file>.sarc} {UEFI | <path> | <file>.sarc}\n  The diffconfig command compares two configurations and prints every field and SAR_POWER_TABLE entry that differs.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s getsar {WiFi [--all] | LTE}\n  The getsar command uses the WlanDeviceServiceCommand or MobileBroadbandSarManager API to get the current configuration.  --all reads every WLAN interface at once and prints each interface's configuration.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage:\n%s setsar LTE {AntennaIndex1 PowerTableIndex1} {AntennaIndex2 PowerTableIndex2} ...\t\t--or--\n%s setsar WiFi [--all] {on | off} {MIMO config} {AntennaIndex1 PowerTableIndex1} {AntennaIndex2 PowerTableIndex2} ...\n  The setsar command uses the WlanDeviceServiceCommand or MobileBroadbandSarManager API to set a new configuration.  Any number of pairs is sent in a single request.  --all sends it to every WLAN interface at once and prints each interface's result.",
+        exeName,
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s unsolMon {WiFi | LTE [seconds]} [--log <base path>] [--summary <seconds> [--timer <ms | config source>]]\n  The unsolMon command registers for 'unsolicited notifications' sent by the transmitter to request updated SAR status.  LTE is monitored for 60 seconds by default (0 = until Ctrl+C).  With --log, every notification is appended to a rotating binary log (<base path>.<n>.sarlog, %u segments of %u KB) and Wi-Fi is monitored until Ctrl+C.  With --summary, Wi-Fi per-opcode counts, rates, inter-arrival percentiles and bursts are printed every <seconds> until Ctrl+C; --timer {<ms> | UEFI | <path> | <file>.sarc} sets the expected SARUnsolicitedUpdateTimer, and requests arriving sooner are counted as early.",
+        exeName,
+        SAR_EVENT_LOG_DEFAULT_SEGMENT_COUNT,
+        SAR_EVENT_LOG_DEFAULT_SEGMENT_SIZE / 1024);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s decodelog {<base path> | <file>.sarlog} [text | csv]\n  The decodelog command converts a log written by unsolMon --log to text or CSV, oldest event first.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s batch {getconfig | setconfig} {<manifest> | <directory>} [threads]\n  The batch command reads or writes the configuration of every folder listed in <manifest> (or found under <directory>) in parallel.  batch getconfig also reads every .sarc container it finds.",
         exeName);
 
     printf("\n\n------------------------------------------------------------\n\n");
 
-    printf("Usage: %s setconfig {UEFI | <path>}\n  The setconfig command writes configuration to a binary file.",
+    printf("Usage: %s archive add <archive> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n       %s archive list <archive>\n       %s archive get <archive> <device> [UEFI | <path> | <file>.sarc]\n  The archive command keeps fleet configuration dumps in a content-addressed archive that stores each distinct blob once.  add reads the configurations in parallel and adds (or replaces) one device per path, list prints the distinct configurations with their device counts, and get prints a device's configuration or writes it to a destination.",
+        exeName, exeName, exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s index <index file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n  The index command reads every configuration in parallel and writes a sorted index of its header fields (ProductID, Version, Revision, WLANTechnology), REGION_CONFIG_VALUES and SAR_CONFIG_VALUES timers.",
         exeName);
 
     printf("\n\n------------------------------------------------------------\n\n");
 
-    printf("Usage: %s getsar {WiFi | LTE}\n  The getsar command uses the WlanDeviceServiceCommand or MobileBroadbandSarManager API to get the current configuration.",
+    printf("Usage: %s query <index file> [<field>{= | != | < | <= | > | >=}<value> ...] [--count]\n  The query command lists the devices in an index that meet every condition, e.g. ProductID=4 Version=5 Country=PH, without reading their configurations.",
         exeName);
 
     printf("\n\n------------------------------------------------------------\n\n");
 
-    printf("Usage:\n%s setsar LTE {AntennaIndex1 PowerTableIndex1} {AntennaIndex2 PowerTableIndex2} ...\t\t--or--\n%s setsar WiFi {on | off} {MIMO config} {AntennaIndex1 PowerTableIndex1} {AntennaIndex2 PowerTableIndex2} ...\n  The setsar command uses the WlanDeviceServiceCommand or MobileBroadbandSarManager API to set a new configuration.",
+    printf("Usage: %s columns export <column file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n       %s columns stats <column file> [<field> ...]\n       %s columns histogram <column file> <field>\n       %s columns bycountry <column file> <field>\n  The columns command exports every configuration to a columnar file with one column per field and per SAR_POWER_TABLE entry, and reports the count, min, max and mean of fields (all of them, with the mean power table, when none are named), the devices per distinct value of a field, or a field's statistics per country.",
+        exeName,
         exeName,
+        exeName,
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s compile <spec> <output directory> [threads] [--container] [--force]\n  The compile command builds the four provisioning files (or, with --container, a .sarc container) of every SKU in a spec of base values and per-SKU overrides into <output directory>, in parallel.  SKUs whose compiled values are unchanged since the last run are not written again; --force writes every SKU.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s validate <caps file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n  The validate command checks the SAR_POWER_TABLE of every configuration against the caps listed for its country in <caps file> (a country code or * followed by 1, 5 or 60 caps in dBm per entry) and reports each row and column over its cap.",
         exeName);
 
     printf("\n\n------------------------------------------------------------\n\n");
 
-    printf("Usage: %s unsolMon {WiFi | LTE}\n  The unsolMon command registers for 'unsolicited notifications' sent by the transmitter to request updated SAR status.",
+    printf("Usage: %s serve [--coalesce <ms>] [endpoint]\n  The serve command keeps the WLAN session open and serves getsar/setsar WiFi requests from local clients until Ctrl+C (default endpoint %s). With --coalesce, sets are acknowledged at once and only the last set of each <ms> window is sent to the driver.",
+        exeName, SAR_DEFAULT_ENDPOINT);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s remote <endpoint> {getsar | setsar} WiFi ...\n  The remote command runs a getsar or setsar WiFi command through a running SarTool server.",
         exeName);
 
     printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Add --stats to any command to print the latency (p50/p99/p999 in ns) of each device round-trip as JSON when it completes.");
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Add --format {text | json | csv} to getconfig, batch getconfig, getsar WiFi or remote to print each configuration or SAR state as a JSON object per line or a CSV row (after a header row) instead of text.");
+
+    printf("\n\n------------------------------------------------------------\n\n");
 }
 
 int
@@ -1297,14 +570,63 @@ Return Value:
 {
     HRESULT hr = S_OK;
     int nReturnVal = 1;
+    BOOL fStats = SarStatsTakeOption(&argc, argv);
+    LPCSTR eventLogPath = nullptr;
+    SarEventLogWriter eventLog;
+    UINT32 summaryInterval = 0;
+    LPCSTR timer = nullptr;
+    UINT32 expectedInterval = 0;
+    BOOL fAnalytics = FALSE;
+    SAR_OUTPUT_FORMAT format = SarOutputText;
+    SAR_SESSION* session = nullptr;
 
-    if (argc < 2)
+    hr = SarEventLogTakeOption(&argc, argv, &eventLogPath);
+    if (SUCCEEDED(hr))
+    {
+        hr = SarAnalyticsTakeOptions(&argc, argv, &summaryInterval, &timer);
+        fAnalytics = (summaryInterval != 0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = SarOutputTakeOption(&argc, argv, &format);
+    }
+
+    if (FAILED(hr) || (argc < 2))
     {
         PrintUsage(argv[0]);
         hr = E_INVALIDARG;
         goto Exit;
     }
 
+    // getconfig, setconfig, getsar and setsar go through the same session API as services that
+    // link the library.  The WLAN handle and the modem are only opened if a command uses them.
+    hr = SarSessionOpen(SarSessionLocal, nullptr, &session);
+    if (FAILED(hr))
+    {
+        goto Exit;
+    }
+
+    if (eventLogPath != nullptr)
+    {
+        hr = eventLog.Open(eventLogPath);
+        if (FAILED(hr))
+        {
+            printf("Failed to open event log %s, hr = 0x%08x\n", eventLogPath, (UINT32)hr);
+            goto Exit;
+        }
+    }
+
+    if (timer != nullptr)
+    {
+        hr = SarAnalyticsResolveTimer(timer, &expectedInterval);
+        if (FAILED(hr))
+        {
+            printf("Failed to read SARUnsolicitedUpdateTimer from %s, hr = 0x%08x\n", timer, (UINT32)hr);
+            goto Exit;
+        }
+    }
+
     // verify arg is "getconfig" or "getConfig" or "GeTcONfIG", etc.
     if (0 == _stricmp(argv[1], CMD_GETCONFIG))
     {
@@ -1315,10 +637,12 @@ Return Value:
             goto Exit;
         }
 
-        hr = GetConfig(argv[2]);
+        hr = SarGetConfigCommand(session, argv[2], format);
     }
     else if (0 == _stricmp(argv[1], CMD_SETCONFIG))
     {
+        BOOL fCompress = SarTableCompressionTakeOption(&argc, argv);
+
         if (argc < 3)
         {
             PrintUsage(argv[0]);
@@ -1326,11 +650,23 @@ Return Value:
             goto Exit;
         }
 
-        hr = SetConfig(argv[2]);
+        hr = SarSetConfigCommand(session, argv[2], (argc >= 4) ? argv[3] : NULL, fCompress);
+    }
+    else if (0 == _stricmp(argv[1], CMD_DIFFCONFIG))
+    {
+        if (argc < 4)
+        {
+            PrintUsage(argv[0]);
+            hr = E_INVALIDARG;
+            goto Exit;
+        }
+
+        hr = SarDiffConfigCommand(session, argv[2], argv[3]);
     }
     else if (0 == _stricmp(argv[1], CMD_GETSAR))
     {
         BOOL fLte = FALSE;
+        BOOL fAllInterfaces = SarFanOutTakeOption(&argc, argv);
 
         if (argc < 3)
         {
@@ -1357,23 +693,25 @@ Return Value:
 
         if (TRUE == fLte)
         {
-            hr = GetSetSARLTE(TRUE,
-                              argc-3,
-                              &argv[3]);
+            hr = SarLteSarCommand(session,
+                                  TRUE,
+                                  argc - 3,
+                                  &argv[3]);
         }
         else
         {
-            hr = GetSetSARWiFi(WDI_GET_SAR_STATE,
-                               WDI_SARBACKOFF_ENABLED,
-                               0,
-                               argc - 4,
-                               &argv[4]);
+            hr = SarWifiSarCommand(session,
+                                   TRUE,
+                                   fAllInterfaces,
+                                   format,
+                                   argc - 3,
+                                   &argv[3]);
         }
     }
     else if (0 == _stricmp(argv[1], CMD_SETSAR))
     {
-        BOOL fOn = FALSE;
         BOOL fLte = FALSE;
+        BOOL fAllInterfaces = SarFanOutTakeOption(&argc, argv);
 
         if (argc < 4)
         {
@@ -1400,52 +738,23 @@ Return Value:
 
         if (TRUE == fLte)
         {
-            hr = GetSetSARLTE(FALSE,
-                              argc - 3,
-                              &argv[3]);
+            hr = SarLteSarCommand(session,
+                                  FALSE,
+                                  argc - 3,
+                                  &argv[3]);
         }
         else
         {
-            int argCount = argc - 4;
-            LPSTR* argList = &argv[4];
-
-            // verify 2nd arg is "On" or "on" or "oFf" or "OFF", etc.
-            if (0 == _stricmp(argv[3], "on"))
-            {
-                fOn = TRUE;
-            }
-            else if (0 == _stricmp(argv[3], "off"))
-            {
-                fOn = FALSE;
-            }
-            else
+            hr = SarWifiSarCommand(session,
+                                   FALSE,
+                                   fAllInterfaces,
+                                   format,
+                                   argc - 3,
+                                   &argv[3]);
+            if (hr == E_INVALIDARG)
             {
                 PrintUsage(argv[0]);
-                hr = E_INVALIDARG;
-                goto Exit;
-            }
-
-            // verify 3rd arg is numerical MIMO config value
-            UINT32 mimoConfigType = 0x0;
-            if (fOn)
-            {
-                if (argc < 7)
-                {
-                    PrintUsage(argv[0]);
-                    hr = E_INVALIDARG;
-                    goto Exit;
-                }
-                _snscanf_s(argv[4], 5, "0x%x", &mimoConfigType);
-                printf("mimoConfigType = %u\n", mimoConfigType);
-                argCount--;
-                argList = &argv[5];
             }
-
-            hr = GetSetSARWiFi(WDI_SET_SAR_STATE,
-                               fOn ? WDI_SARBACKOFF_ENABLED : WDI_SARBACKOFF_DISABLED,
-                               mimoConfigType,
-                               argCount,
-                               argList);
         }
     }
     else if (0 == _stricmp(argv[1], CMD_UNSOLMON))
@@ -1477,7 +786,18 @@ Return Value:
 
         if (TRUE == fLte)
         {
-            hr = LteTxStatusMonitor();
+            DWORD period = LteTxStatusMonitorPeriod;
+
+            if (argc >= 4)
+            {
+                period = strtoul(argv[3], nullptr, 10) * 1000;
+                if (period == 0)
+                {
+                    period = INFINITE;
+                }
+            }
+
+            hr = LteTxStatusMonitor(period, (eventLogPath != nullptr) ? &eventLog : nullptr);
         }
         else
         {
@@ -1492,24 +812,163 @@ Return Value:
                 goto Exit;
             }
 
-            nReturnVal = UnsolicitedMonitor(hClient);
+            // A logged or summarized session runs for days, so the notifications are not printed
+            // one by one.
+            BOOL fUntilStopped = (eventLogPath != nullptr) || fAnalytics;
+            SarNotificationPipeline pipeline(fUntilStopped ? nullptr : stdout);
+            SarRequestAnalytics analytics(stdout, summaryInterval, expectedInterval);
+
+            if (eventLogPath != nullptr)
+            {
+                pipeline.SetEventLog(&eventLog);
+            }
+
+            if (fAnalytics)
+            {
+                pipeline.SetAnalytics(&analytics);
+            }
 
-            if (nReturnVal == ERROR_SUCCESS)
+            if (fUntilStopped)
             {
-                boolean bWait = true;
-                while ((bWait) && (s_nCallbacks < 128))
+                hr = SarStopSignalArm();
+                if (FAILED(hr))
                 {
-                    Sleep(5000);
+                    goto UnsolMonExit;
                 }
-                printf("called back %d times\n",
-                       s_nCallbacks);
             }
-            else
+
+            hr = pipeline.Start();
+            if (FAILED(hr))
+            {
+                goto UnsolMonExit;
+            }
+
+            nReturnVal = UnsolicitedMonitor(hClient, &pipeline);
+            if (nReturnVal != ERROR_SUCCESS)
             {
                 printf("error registering for DeviceServiceNotifications\n");
                 hr = E_FAIL;
+                goto UnsolMonExit;
+            }
+
+            if (fUntilStopped)
+            {
+                printf("Monitoring unsolicited notifications; press Ctrl+C to stop.\n");
+                SarStopSignalWait(INFINITE);
+            }
+            else
+            {
+                pipeline.WaitForHandled(UnsolicitedMonitorCount);
             }
+
+        UnsolMonExit:
+            // Closing the handle first guarantees no callback is still posting.  Stop and disarm
+            // are harmless if Start or Arm never ran.
             WlanCloseHandle(hClient, NULL);
+            pipeline.Stop();
+            SarStopSignalDisarm();
+
+            if (SUCCEEDED(hr))
+            {
+                SAR_NOTIFICATION_COUNTERS counters;
+
+                pipeline.GetCounters(&counters);
+                printf("called back %llu times (%llu logged in %llu batches, %llu dropped)\n",
+                       counters.Received,
+                       counters.Logged,
+                       counters.Batches,
+                       counters.Dropped);
+
+                if (counters.EventLogErrors != 0)
+                {
+                    printf("%llu event log writes failed\n", counters.EventLogErrors);
+                }
+            }
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_BATCH))
+    {
+        hr = SarBatchCommand(format, argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_ARCHIVE))
+    {
+        hr = SarArchiveCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_INDEX))
+    {
+        hr = SarIndexCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_QUERY))
+    {
+        hr = SarQueryCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_COLUMNS))
+    {
+        hr = SarColumnsCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_COMPILE))
+    {
+        hr = SarCompileCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_VALIDATE))
+    {
+        hr = SarValidateCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_SERVE))
+    {
+        UINT32 coalesceMilliseconds;
+
+        hr = SarSetQueueTakeOption(&argc, argv, &coalesceMilliseconds);
+        if (FAILED(hr))
+        {
+            PrintUsage(argv[0]);
+            goto Exit;
+        }
+
+        hr = SarServeCommand(SarWlanDeviceServiceDefault(), coalesceMilliseconds, argc - 2, &argv[2]);
+    }
+    else if (0 == _stricmp(argv[1], CMD_REMOTE))
+    {
+        hr = SarRemoteCommand(format, argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_DECODELOG))
+    {
+        hr = SarEventLogDecodeCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
         }
     }
     else
@@ -1521,6 +980,22 @@ Return Value:
 
 Exit:
 
+    SarSessionClose(session);
+
+    if (eventLogPath != nullptr)
+    {
+        eventLog.Close();
+        printf("%llu events logged to %s in %llu segments\n",
+               eventLog.EventCount(),
+               eventLogPath,
+               eventLog.SegmentsWritten());
+    }
+
+    if (fStats)
+    {
+        SarStatsPrintJson(stdout);
+    }
+
     if (hr == S_OK)
     {
         nReturnVal = 0;
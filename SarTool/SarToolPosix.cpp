@@ -0,0 +1,456 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name
+
+    SarToolPosix.cpp
+
+Abstract:
+
+    Entry point for non-Windows builds of SarTool.  The provisioning commands are available (UEFI
+    is accessed through efivarfs), the server runs against a mock Wi-Fi device service so clients
+    can be exercised and load-tested, and unsolMon drives the notification pipeline (and event
+    log) from a synthetic producer; the WLAN and LTE commands require Windows.
+
+Environment:
+
+    User Mode
+
+--*/
+
+#include "SarPlatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#include "SarAnalytics.h"
+#include "SarArchive.h"
+#include "SarBatch.h"
+#include "SarClient.h"
+#include "SarColumns.h"
+#include "SarCompile.h"
+#include "SarConfigFiles.h"
+#include "SarDeviceService.h"
+#include "SarEventLog.h"
+#include "SarIndex.h"
+#include "SarNotification.h"
+#include "SarOutput.h"
+#include "SarServer.h"
+#include "SarSetQueue.h"
+#include "SarStats.h"
+#include "SarTableCompression.h"
+#include "SarValidate.h"
+
+//
+// Commands
+// These are the commands a user can enter on the command-line to determine what functionality SarTool exercises.
+//
+LPCSTR CMD_GETCONFIG = "getconfig";
+LPCSTR CMD_SETCONFIG = "setconfig";
+LPCSTR CMD_DIFFCONFIG = "diffconfig";
+LPCSTR CMD_BATCH = "batch";
+LPCSTR CMD_VALIDATE = "validate";
+LPCSTR CMD_ARCHIVE = "archive";
+LPCSTR CMD_INDEX = "index";
+LPCSTR CMD_QUERY = "query";
+LPCSTR CMD_COLUMNS = "columns";
+LPCSTR CMD_COMPILE = "compile";
+LPCSTR CMD_UNSOLMON = "unsolMon";
+LPCSTR CMD_SERVE = "serve";
+LPCSTR CMD_REMOTE = "remote";
+LPCSTR CMD_DECODELOG = "decodelog";
+
+VOID
+PrintUsage(
+    _In_ PCSTR exeName
+    )
+/*++
+
+Routine Description:
+
+    Prints help text to the screen so the user can decide which command-line parameters to specify.
+
+Arguments:
+
+    exeName - The name of the executable.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s getconfig {UEFI | <path> | <file>.sarc}\n  The getconfig command reads configuration from UEFI (via efivarfs), binary files or a provisioning container.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s setconfig {UEFI | <path> | <file>.sarc} [UEFI | <source path> | <source file>.sarc] [--compress]\n  The setconfig command writes the example configuration (or the configuration read from the source) to UEFI, binary files or a provisioning container.  --compress sets SARTablesCompressed and stores the SAR_POWER_TABLE delta-encoded and bit-packed.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s diffconfig {UEFI | <path> | <file>.sarc} {UEFI | <path> | <file>.sarc}\n  The diffconfig command compares two configurations and prints every field and SAR_POWER_TABLE entry that differs.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s batch {getconfig | setconfig} {<manifest> | <directory>} [threads]\n  The batch command reads or writes the configuration of every folder listed in <manifest> (or found under <directory>) in parallel.  batch getconfig also reads every .sarc container it finds.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s archive add <archive> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n       %s archive list <archive>\n       %s archive get <archive> <device> [UEFI | <path> | <file>.sarc]\n  The archive command keeps fleet configuration dumps in a content-addressed archive that stores each distinct blob once.  add reads the configurations in parallel and adds (or replaces) one device per path, list prints the distinct configurations with their device counts, and get prints a device's configuration or writes it to a destination.",
+        exeName, exeName, exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s index <index file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n  The index command reads every configuration in parallel and writes a sorted index of its header fields (ProductID, Version, Revision, WLANTechnology), REGION_CONFIG_VALUES and SAR_CONFIG_VALUES timers.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s query <index file> [<field>{= | != | < | <= | > | >=}<value> ...] [--count]\n  The query command lists the devices in an index that meet every condition, e.g. ProductID=4 Version=5 Country=PH, without reading their configurations.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s columns export <column file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n       %s columns stats <column file> [<field> ...]\n       %s columns histogram <column file> <field>\n       %s columns bycountry <column file> <field>\n  The columns command exports every configuration to a columnar file with one column per field and per SAR_POWER_TABLE entry, and reports the count, min, max and mean of fields (all of them, with the mean power table, when none are named), the devices per distinct value of a field, or a field's statistics per country.",
+        exeName,
+        exeName,
+        exeName,
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s compile <spec> <output directory> [threads] [--container] [--force]\n  The compile command builds the four provisioning files (or, with --container, a .sarc container) of every SKU in a spec of base values and per-SKU overrides into <output directory>, in parallel.  SKUs whose compiled values are unchanged since the last run are not written again; --force writes every SKU.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s validate <caps file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]\n  The validate command checks the SAR_POWER_TABLE of every configuration against the caps listed for its country in <caps file> (a country code or * followed by 1, 5 or 60 caps in dBm per entry) and reports each row and column over its cap.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s unsolMon WiFi [count] [burst size] [burst interval us] [--log <base path>] [--summary <seconds> [--timer <ms | config source>]]\n  The unsolMon command feeds synthetic unsolicited SAR requests (default 128, in bursts of 16 every 1000 us) through the notification pipeline and reports how many were logged and dropped.  With --log, they are appended to a rotating binary log (<base path>.<n>.sarlog, %u segments of %u KB) instead of printed.  With --summary <seconds>, per-opcode counts, rates, inter-arrival percentiles and bursts are printed every <seconds> instead; --timer {<ms> | UEFI | <path> | <file>.sarc} sets the expected SARUnsolicitedUpdateTimer, and requests arriving sooner are counted as early.",
+        exeName,
+        SAR_EVENT_LOG_DEFAULT_SEGMENT_COUNT,
+        SAR_EVENT_LOG_DEFAULT_SEGMENT_SIZE / 1024);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s decodelog {<base path> | <file>.sarlog} [text | csv]\n  The decodelog command converts a log written by unsolMon --log to text or CSV, oldest event first.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s serve [--coalesce <ms>] [endpoint]\n  The serve command serves getsar/setsar WiFi requests from local clients against a mock device service until Ctrl+C (default endpoint %s). With --coalesce, sets are acknowledged at once and only the last set of each <ms> window is sent to the device.",
+        exeName, SAR_DEFAULT_ENDPOINT);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Usage: %s remote <endpoint> {getsar | setsar} WiFi ...\n  The remote command runs a getsar or setsar WiFi command through a running SarTool server.",
+        exeName);
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Add --stats to any command to print the latency (p50/p99/p999 in ns) of each device round-trip as JSON when it completes.");
+
+    printf("\n\n------------------------------------------------------------\n\n");
+
+    printf("Add --format {text | json | csv} to getconfig, batch getconfig, getsar WiFi or remote to print each configuration or SAR state as a JSON object per line or a CSV row (after a header row) instead of text.");
+
+    printf("\n\n------------------------------------------------------------\n\n");
+}
+
+int
+main(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR *argv
+    )
+/*++
+
+Routine Description:
+
+    Process command-line and call corresponding function.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments.
+
+Return Value:
+
+    0 on success
+    non-zero to indicate a failure
+
+--*/
+{
+    HRESULT hr = S_OK;
+    int nReturnVal = 1;
+    BOOL fStats = SarStatsTakeOption(&argc, argv);
+    LPCSTR eventLogPath = nullptr;
+    SarEventLogWriter eventLog;
+    UINT32 summaryInterval = 0;
+    LPCSTR timer = nullptr;
+    UINT32 expectedInterval = 0;
+    BOOL fAnalytics = FALSE;
+    SAR_OUTPUT_FORMAT format = SarOutputText;
+    SAR_SESSION* session = nullptr;
+
+    hr = SarEventLogTakeOption(&argc, argv, &eventLogPath);
+    if (SUCCEEDED(hr))
+    {
+        hr = SarAnalyticsTakeOptions(&argc, argv, &summaryInterval, &timer);
+        fAnalytics = (summaryInterval != 0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = SarOutputTakeOption(&argc, argv, &format);
+    }
+
+    if (FAILED(hr) || (argc < 2))
+    {
+        PrintUsage(argv[0]);
+        hr = E_INVALIDARG;
+        goto Exit;
+    }
+
+    // getconfig and setconfig go through the same session API as services that link the library.
+    hr = SarSessionOpen(SarSessionLocal, nullptr, &session);
+    if (FAILED(hr))
+    {
+        goto Exit;
+    }
+
+    if (eventLogPath != nullptr)
+    {
+        hr = eventLog.Open(eventLogPath);
+        if (FAILED(hr))
+        {
+            printf("Failed to open event log %s, hr = 0x%08x\n", eventLogPath, (UINT32)hr);
+            goto Exit;
+        }
+    }
+
+    if (timer != nullptr)
+    {
+        hr = SarAnalyticsResolveTimer(timer, &expectedInterval);
+        if (FAILED(hr))
+        {
+            printf("Failed to read SARUnsolicitedUpdateTimer from %s, hr = 0x%08x\n", timer, (UINT32)hr);
+            goto Exit;
+        }
+    }
+
+    if (0 == _stricmp(argv[1], CMD_SERVE))
+    {
+        SarMockDeviceService device;
+        UINT32 coalesceMilliseconds;
+
+        hr = SarSetQueueTakeOption(&argc, argv, &coalesceMilliseconds);
+        if (FAILED(hr))
+        {
+            PrintUsage(argv[0]);
+            goto Exit;
+        }
+
+        hr = SarServeCommand(&device, coalesceMilliseconds, argc - 2, &argv[2]);
+    }
+    else if (0 == _stricmp(argv[1], CMD_REMOTE))
+    {
+        hr = SarRemoteCommand(format, argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_UNSOLMON))
+    {
+        SarNotificationPipeline pipeline(((eventLogPath != nullptr) || fAnalytics) ? nullptr : stdout);
+        SarRequestAnalytics analytics(stdout, summaryInterval, expectedInterval);
+        SAR_NOTIFICATION_COUNTERS counters;
+        UINT64 count = (argc >= 4) ? strtoull(argv[3], nullptr, 0) : 128;
+        UINT32 burstSize = (argc >= 5) ? (UINT32)strtoul(argv[4], nullptr, 0) : 16;
+        UINT32 burstInterval = (argc >= 6) ? (UINT32)strtoul(argv[5], nullptr, 0) : 1000;
+
+        if ((argc < 3) || (0 != _stricmp(argv[2], "wifi")))
+        {
+            PrintUsage(argv[0]);
+            hr = E_INVALIDARG;
+            goto Exit;
+        }
+
+        if (eventLogPath != nullptr)
+        {
+            pipeline.SetEventLog(&eventLog);
+        }
+
+        if (fAnalytics)
+        {
+            pipeline.SetAnalytics(&analytics);
+        }
+
+        hr = pipeline.Start();
+        if (FAILED(hr))
+        {
+            goto Exit;
+        }
+
+        // The producer runs on its own thread, as the WLAN callback would.
+        std::thread producer(SarNotificationSyntheticProducer, &pipeline, count, burstSize, burstInterval);
+        producer.join();
+        pipeline.Stop();
+
+        pipeline.GetCounters(&counters);
+        printf("called back %llu times (%llu logged in %llu batches, %llu dropped)\n",
+               (unsigned long long)counters.Received,
+               (unsigned long long)counters.Logged,
+               (unsigned long long)counters.Batches,
+               (unsigned long long)counters.Dropped);
+
+        if (counters.EventLogErrors != 0)
+        {
+            printf("%llu event log writes failed\n", (unsigned long long)counters.EventLogErrors);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_DECODELOG))
+    {
+        hr = SarEventLogDecodeCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (argc < 3)
+    {
+        PrintUsage(argv[0]);
+        hr = E_INVALIDARG;
+        goto Exit;
+    }
+    else if (0 == _stricmp(argv[1], CMD_GETCONFIG))
+    {
+        hr = SarGetConfigCommand(session, argv[2], format);
+    }
+    else if (0 == _stricmp(argv[1], CMD_SETCONFIG))
+    {
+        BOOL fCompress = SarTableCompressionTakeOption(&argc, argv);
+
+        if (argc < 3)
+        {
+            PrintUsage(argv[0]);
+            hr = E_INVALIDARG;
+            goto Exit;
+        }
+
+        hr = SarSetConfigCommand(session, argv[2], (argc >= 4) ? argv[3] : nullptr, fCompress);
+    }
+    else if (0 == _stricmp(argv[1], CMD_DIFFCONFIG))
+    {
+        if (argc < 4)
+        {
+            PrintUsage(argv[0]);
+            hr = E_INVALIDARG;
+            goto Exit;
+        }
+
+        hr = SarDiffConfigCommand(session, argv[2], argv[3]);
+    }
+    else if (0 == _stricmp(argv[1], CMD_BATCH))
+    {
+        hr = SarBatchCommand(format, argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_ARCHIVE))
+    {
+        hr = SarArchiveCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_INDEX))
+    {
+        hr = SarIndexCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_QUERY))
+    {
+        hr = SarQueryCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_COLUMNS))
+    {
+        hr = SarColumnsCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_COMPILE))
+    {
+        hr = SarCompileCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else if (0 == _stricmp(argv[1], CMD_VALIDATE))
+    {
+        hr = SarValidateCommand(argc - 2, &argv[2]);
+        if (hr == E_INVALIDARG)
+        {
+            PrintUsage(argv[0]);
+        }
+    }
+    else
+    {
+        PrintUsage(argv[0]);
+        hr = E_INVALIDARG;
+        goto Exit;
+    }
+
+Exit:
+
+    SarSessionClose(session);
+
+    if (eventLogPath != nullptr)
+    {
+        eventLog.Close();
+        printf("%llu events logged to %s in %llu segments\n",
+               (unsigned long long)eventLog.EventCount(),
+               eventLogPath,
+               (unsigned long long)eventLog.SegmentsWritten());
+    }
+
+    if (fStats)
+    {
+        SarStatsPrintJson(stdout);
+    }
+
+    if (hr == S_OK)
+    {
+        nReturnVal = 0;
+    }
+
+    return nReturnVal;
+}
+
+// eof: SarToolPosix.cpp
+//
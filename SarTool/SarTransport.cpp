@@ -0,0 +1,468 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarTransport.cpp
+
+Abstract:
+
+    Local byte-stream transport between a SarTool server and its clients.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarTransport.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+// Milliseconds a client waits for a busy pipe server to offer a new instance.
+//
+static const DWORD SAR_PIPE_BUSY_TIMEOUT = 5000;
+
+static const DWORD SAR_PIPE_BUFFER_SIZE = 4096;
+
+SarConnection::SarConnection() :
+#ifdef _WIN32
+    m_hPipe(INVALID_HANDLE_VALUE),
+    m_fServer(FALSE)
+#else
+    m_fd(-1)
+#endif
+{
+}
+
+SarConnection::~SarConnection()
+{
+    Close();
+}
+
+_Check_return_
+HRESULT
+SarConnection::Connect(
+    _In_z_ LPCSTR endpoint
+    )
+/*++
+
+Routine Description:
+
+    Connects to a SarTool server listening on the specified endpoint.
+
+Arguments:
+
+    endpoint - The pipe name (Windows) or socket path.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    Close();
+
+#ifdef _WIN32
+    for (;;)
+    {
+        m_hPipe = CreateFileA(endpoint, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (m_hPipe != INVALID_HANDLE_VALUE)
+        {
+            break;
+        }
+
+        if ((GetLastError() != ERROR_PIPE_BUSY) || !WaitNamedPipeA(endpoint, SAR_PIPE_BUSY_TIMEOUT))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            goto exit;
+        }
+    }
+
+    m_fServer = FALSE;
+#else
+    struct sockaddr_un address = {};
+
+    if (strlen(endpoint) >= sizeof(address.sun_path))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, endpoint);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if (connect(m_fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+    {
+        hr = SarHresultFromErrno(errno);
+        Close();
+        goto exit;
+    }
+#endif
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarConnection::Send(
+    _In_reads_bytes_(size) const VOID* data,
+    size_t size
+    )
+{
+    const UINT8* pData = (const UINT8*)data;
+
+    while (size > 0)
+    {
+#ifdef _WIN32
+        DWORD written = 0;
+        if (!WriteFile(m_hPipe, pData, (DWORD)size, &written, NULL))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+#else
+        ssize_t written = send(m_fd, pData, size, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return SarHresultFromErrno(errno);
+        }
+#endif
+        pData += written;
+        size -= (size_t)written;
+    }
+
+    return S_OK;
+}
+
+_Check_return_
+HRESULT
+SarConnection::Receive(
+    _Out_writes_bytes_(size) VOID* data,
+    size_t size
+    )
+{
+    UINT8* pData = (UINT8*)data;
+
+    while (size > 0)
+    {
+#ifdef _WIN32
+        DWORD received = 0;
+        if (!ReadFile(m_hPipe, pData, (DWORD)size, &received, NULL))
+        {
+            DWORD error = GetLastError();
+            return HRESULT_FROM_WIN32((error == ERROR_BROKEN_PIPE) ? ERROR_HANDLE_EOF : error);
+        }
+#else
+        ssize_t received = recv(m_fd, pData, size, 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return SarHresultFromErrno(errno);
+        }
+#endif
+        if (received == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+        }
+
+        pData += received;
+        size -= (size_t)received;
+    }
+
+    return S_OK;
+}
+
+VOID
+SarConnection::Shutdown()
+{
+#ifdef _WIN32
+    if (m_hPipe != INVALID_HANDLE_VALUE)
+    {
+        CancelIoEx(m_hPipe, NULL);
+        if (m_fServer)
+        {
+            DisconnectNamedPipe(m_hPipe);
+        }
+    }
+#else
+    if (m_fd >= 0)
+    {
+        shutdown(m_fd, SHUT_RDWR);
+    }
+#endif
+}
+
+VOID
+SarConnection::Close()
+{
+#ifdef _WIN32
+    if (m_hPipe != INVALID_HANDLE_VALUE)
+    {
+        if (m_fServer)
+        {
+            DisconnectNamedPipe(m_hPipe);
+        }
+        CloseHandle(m_hPipe);
+        m_hPipe = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+SarListener::SarListener() :
+    m_fClosed(false),
+#ifdef _WIN32
+    m_hPipe(INVALID_HANDLE_VALUE)
+#else
+    m_fd(-1)
+#endif
+{
+}
+
+SarListener::~SarListener()
+{
+    Close();
+
+#ifdef _WIN32
+    if (m_hPipe != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hPipe);
+    }
+#else
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+#endif
+}
+
+#ifdef _WIN32
+
+static
+HANDLE
+SarCreatePipeInstance(
+    _In_z_ LPCSTR endpoint,
+    BOOL fFirst
+    )
+{
+    return CreateNamedPipeA(endpoint,
+                            PIPE_ACCESS_DUPLEX | (fFirst ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES,
+                            SAR_PIPE_BUFFER_SIZE,
+                            SAR_PIPE_BUFFER_SIZE,
+                            0,
+                            NULL);
+}
+
+#endif
+
+_Check_return_
+HRESULT
+SarListener::Listen(
+    _In_z_ LPCSTR endpoint
+    )
+/*++
+
+Routine Description:
+
+    Starts listening on the specified endpoint.  A stale socket file left behind by a previous
+    server is replaced; a pipe name already owned by a running server is an error.
+
+Arguments:
+
+    endpoint - The pipe name (Windows) or socket path.
+
+Return Value:
+
+    S_OK on success or underlying failure code.
+
+--*/
+{
+    HRESULT hr = S_OK;
+
+    m_endpoint = endpoint;
+    m_fClosed = false;
+
+#ifdef _WIN32
+    m_hPipe = SarCreatePipeInstance(endpoint, TRUE);
+    if (m_hPipe == INVALID_HANDLE_VALUE)
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+#else
+    struct sockaddr_un address = {};
+    struct stat existing;
+
+    if (m_endpoint.size() >= sizeof(address.sun_path))
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, endpoint);
+
+    if ((stat(endpoint, &existing) == 0) && S_ISSOCK(existing.st_mode))
+    {
+        unlink(endpoint);
+    }
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0)
+    {
+        hr = SarHresultFromErrno(errno);
+        goto exit;
+    }
+
+    if ((bind(m_fd, (struct sockaddr*)&address, sizeof(address)) != 0) ||
+        (chmod(endpoint, S_IRUSR | S_IWUSR) != 0) ||
+        (listen(m_fd, SOMAXCONN) != 0))
+    {
+        hr = SarHresultFromErrno(errno);
+        close(m_fd);
+        m_fd = -1;
+        goto exit;
+    }
+#endif
+
+exit:
+    return hr;
+}
+
+_Check_return_
+HRESULT
+SarListener::Accept(
+    _Out_ SarConnection* connection
+    )
+{
+    HRESULT hr = S_OK;
+
+    connection->Close();
+
+    if (m_fClosed)
+    {
+        hr = E_ABORT;
+        goto exit;
+    }
+
+#ifdef _WIN32
+    // Each client gets its own pipe instance; the one created by Listen (or the previous Accept)
+    // is handed to this client and a new one is created for the next.
+    if (m_hPipe == INVALID_HANDLE_VALUE)
+    {
+        m_hPipe = SarCreatePipeInstance(m_endpoint.c_str(), FALSE);
+        if (m_hPipe == INVALID_HANDLE_VALUE)
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            goto exit;
+        }
+    }
+
+    if (!ConnectNamedPipe(m_hPipe, NULL) && (GetLastError() != ERROR_PIPE_CONNECTED))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        goto exit;
+    }
+
+    if (m_fClosed)
+    {
+        hr = E_ABORT;
+        goto exit;
+    }
+
+    connection->m_hPipe = m_hPipe;
+    connection->m_fServer = TRUE;
+    m_hPipe = INVALID_HANDLE_VALUE;
+#else
+    for (;;)
+    {
+        int fd = accept(m_fd, NULL, NULL);
+        if (m_fClosed)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            hr = E_ABORT;
+            goto exit;
+        }
+
+        if (fd >= 0)
+        {
+            connection->m_fd = fd;
+            break;
+        }
+
+        if ((errno != EINTR) && (errno != ECONNABORTED))
+        {
+            hr = SarHresultFromErrno(errno);
+            goto exit;
+        }
+    }
+#endif
+
+exit:
+    return hr;
+}
+
+VOID
+SarListener::Close()
+{
+    if (m_fClosed.exchange(true) || m_endpoint.empty())
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    // Wake a pending ConnectNamedPipe by connecting to it.
+    HANDLE hWake = CreateFileA(m_endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (hWake != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hWake);
+    }
+#else
+    if (m_fd >= 0)
+    {
+        shutdown(m_fd, SHUT_RDWR);
+        unlink(m_endpoint.c_str());
+    }
+#endif
+}
+
+// eof: SarTransport.cpp
+//
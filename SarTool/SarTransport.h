@@ -0,0 +1,131 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarTransport.h
+
+Abstract:
+
+    Local byte-stream transport between a SarTool server and its clients: a named pipe on Windows
+    and a Unix domain socket elsewhere.  Only local clients can connect.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarPlatform.h"
+
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+// The endpoint used when none is specified.
+//
+#ifdef _WIN32
+static const char SAR_DEFAULT_ENDPOINT[] = "\\\\.\\pipe\\SarTool";
+#else
+static const char SAR_DEFAULT_ENDPOINT[] = "/tmp/sartool.sock";
+#endif
+
+class SarConnection
+{
+public:
+
+    SarConnection();
+    ~SarConnection();
+
+    SarConnection(const SarConnection&) = delete;
+    SarConnection& operator=(const SarConnection&) = delete;
+
+    _Check_return_
+    HRESULT
+    Connect(
+        _In_z_ LPCSTR endpoint
+        );
+
+    // Sends or receives exactly size bytes.  Receive fails with HRESULT_FROM_WIN32(ERROR_HANDLE_EOF)
+    // if the peer closed the connection.
+    //
+    _Check_return_
+    HRESULT
+    Send(
+        _In_reads_bytes_(size) const VOID* data,
+        size_t size
+        );
+
+    _Check_return_
+    HRESULT
+    Receive(
+        _Out_writes_bytes_(size) VOID* data,
+        size_t size
+        );
+
+    // Unblocks any Send/Receive in progress on another thread; they (and later calls) fail.
+    //
+    VOID
+    Shutdown();
+
+    VOID
+    Close();
+
+private:
+
+    friend class SarListener;
+
+#ifdef _WIN32
+    HANDLE m_hPipe;
+    BOOL m_fServer;
+#else
+    int m_fd;
+#endif
+};
+
+class SarListener
+{
+public:
+
+    SarListener();
+    ~SarListener();
+
+    SarListener(const SarListener&) = delete;
+    SarListener& operator=(const SarListener&) = delete;
+
+    _Check_return_
+    HRESULT
+    Listen(
+        _In_z_ LPCSTR endpoint
+        );
+
+    // Waits for the next client.  Fails once Close has been called.
+    //
+    _Check_return_
+    HRESULT
+    Accept(
+        _Out_ SarConnection* connection
+        );
+
+    // Stops listening and unblocks a pending Accept.  Resources are released by the destructor,
+    // after the thread that called Accept is done with the listener.
+    //
+    VOID
+    Close();
+
+private:
+
+    std::string m_endpoint;
+    std::atomic<bool> m_fClosed;
+#ifdef _WIN32
+    HANDLE m_hPipe;
+#else
+    int m_fd;
+#endif
+};
+
+// eof: SarTransport.h
+//
@@ -0,0 +1,563 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarValidate.cpp
+
+Abstract:
+
+    Regulatory-limit validation of power tables, vectorized where the CPU allows.
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include "SarValidate.h"
+#include "SarBatch.h"
+#include "SarThreadPool.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define SAR_VALIDATE_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SAR_VALIDATE_NEON
+#ifdef _MSC_VER
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+static const UINT64 SAR_POWER_TABLE_ENTRY_MASK = (1ull << SAR_POWER_TABLE_ENTRIES) - 1;
+
+// The vector kernels cover the table with four 16-byte blocks; the last one overlaps the third so
+// nothing past the end of the table is read.
+//
+static const UINT32 SAR_VALIDATE_LAST_BLOCK = SAR_POWER_TABLE_ENTRIES - 16;
+
+C_ASSERT(sizeof(SAR_POWER_TABLE) == SAR_POWER_TABLE_ENTRIES);
+C_ASSERT((SAR_POWER_TABLE_ENTRIES > 48) && (SAR_POWER_TABLE_ENTRIES <= 64));
+
+UINT64
+SarPowerTableViolationsSoftware(
+    _In_ const SAR_POWER_TABLE* table,
+    _In_ const SAR_POWER_TABLE* caps
+    )
+{
+    const UINT8* power = &table->PowerValues[0][0];
+    const UINT8* cap = &caps->PowerValues[0][0];
+    UINT64 violations = 0;
+
+    for (UINT32 i = 0; i < SAR_POWER_TABLE_ENTRIES; i++)
+    {
+        violations |= (UINT64)(power[i] > cap[i]) << i;
+    }
+
+    return violations;
+}
+
+#if defined(SAR_VALIDATE_SSE2)
+
+inline
+UINT64
+SarBlockViolations(
+    _In_reads_bytes_(16) const UINT8* power,
+    _In_reads_bytes_(16) const UINT8* cap
+    )
+{
+    __m128i powerBlock = _mm_loadu_si128((const __m128i*)power);
+    __m128i capBlock = _mm_loadu_si128((const __m128i*)cap);
+
+    // SSE2 has no unsigned byte compare: an entry is within its cap when max(power, cap) == cap.
+    return (UINT64)(~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(powerBlock, capBlock), capBlock)) & 0xffff);
+}
+
+#elif defined(SAR_VALIDATE_NEON)
+
+inline
+UINT64
+SarBlockViolations(
+    _In_reads_bytes_(16) const UINT8* power,
+    _In_reads_bytes_(16) const UINT8* cap
+    )
+{
+    static const UINT8 s_laneBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t over = vcgtq_u8(vld1q_u8(power), vld1q_u8(cap));
+    uint8x16_t bits = vandq_u8(over, vld1q_u8(s_laneBits));
+
+    // Each half sums to the movemask of its eight lanes.
+    return (UINT64)vaddv_u8(vget_low_u8(bits)) | ((UINT64)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+#endif
+
+UINT64
+SarPowerTableViolations(
+    _In_ const SAR_POWER_TABLE* table,
+    _In_ const SAR_POWER_TABLE* caps
+    )
+/*++
+
+Routine Description:
+
+    Compares every entry of a power table with its cap.
+
+Arguments:
+
+    table - The provisioned power table.
+    caps - The caps for the table's country.
+
+Return Value:
+
+    The violation mask: bit (row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE + column) is set for
+    each entry above its cap.
+
+--*/
+{
+#if defined(SAR_VALIDATE_SSE2) || defined(SAR_VALIDATE_NEON)
+    const UINT8* power = &table->PowerValues[0][0];
+    const UINT8* cap = &caps->PowerValues[0][0];
+
+    return (SarBlockViolations(power, cap) |
+            (SarBlockViolations(power + 16, cap + 16) << 16) |
+            (SarBlockViolations(power + 32, cap + 32) << 32) |
+            (SarBlockViolations(power + SAR_VALIDATE_LAST_BLOCK, cap + SAR_VALIDATE_LAST_BLOCK) << SAR_VALIDATE_LAST_BLOCK)) &
+           SAR_POWER_TABLE_ENTRY_MASK;
+#else
+    return SarPowerTableViolationsSoftware(table, caps);
+#endif
+}
+
+LPCSTR
+SarPowerTableViolationsKernel()
+{
+#if defined(SAR_VALIDATE_SSE2)
+    return "SSE2";
+#elif defined(SAR_VALIDATE_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+static
+UINT32
+SarPopulationCount(
+    UINT64 value
+    )
+{
+    UINT32 count = 0;
+
+    while (value != 0)
+    {
+        value &= value - 1;
+        count++;
+    }
+
+    return count;
+}
+
+SarCapTables::SarCapTables()
+{
+    for (UINT32& capIndex : m_capIndex)
+    {
+        capIndex = SAR_COUNTRY_NONE;
+    }
+}
+
+_Check_return_
+HRESULT
+SarCapTables::Load(
+    _In_z_ LPCSTR path
+    )
+/*++
+
+Routine Description:
+
+    Reads a caps file (see SarValidate.h.)  Caps are given in dBm and stored in the 1/8 dBm units
+    of SAR_POWER_TABLE, rounded down so a cap is never loosened.
+
+Arguments:
+
+    path - The caps file.
+
+Return Value:
+
+    S_OK on success, ERROR_FILE_NOT_FOUND or ERROR_INVALID_DATA (after printing the offending
+    line.)
+
+--*/
+{
+    HRESULT hr = S_OK;
+    std::ifstream file(path);
+    std::string line;
+    UINT32 lineNumber = 0;
+    std::vector<std::pair<UINT32, std::vector<double>>> entries;
+
+    m_caps.clear();
+    for (UINT32& capIndex : m_capIndex)
+    {
+        capIndex = SAR_COUNTRY_NONE;
+    }
+
+    if (!file.is_open())
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        goto exit;
+    }
+
+    while (std::getline(file, line))
+    {
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string token;
+
+        lineNumber++;
+
+        while (tokens >> token)
+        {
+            if ((token == "*") || ((token.size() == 2) && isalpha((unsigned char)token[0]) && isalpha((unsigned char)token[1])))
+            {
+                UINT32 country = (token == "*") ?
+                    SAR_CAPS_DEFAULT_INDEX :
+                    SarCountryIndex((UINT16)((toupper((unsigned char)token[0]) << 8) | toupper((unsigned char)token[1])));
+
+                if (country == SAR_COUNTRY_NONE)
+                {
+                    printf("%s(%u): '%s' is not an ISO 3166-1 country code\n", path, lineNumber, token.c_str());
+                    hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                    goto exit;
+                }
+
+                entries.emplace_back(country, std::vector<double>());
+                continue;
+            }
+
+            char* end = nullptr;
+            double cap = strtod(token.c_str(), &end);
+
+            if (entries.empty() || (*end != '\0') || !(cap >= 0.0) || (cap > 255 / 8.0))
+            {
+                printf("%s(%u): '%s' is neither a country code nor a cap between 0 and %.3f dBm\n",
+                       path, lineNumber, token.c_str(), 255 / 8.0);
+                hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                goto exit;
+            }
+
+            entries.back().second.push_back(cap);
+        }
+    }
+
+    for (const auto& entry : entries)
+    {
+        const std::vector<double>& values = entry.second;
+        SAR_POWER_TABLE caps;
+        LPCSTR country = (entry.first == SAR_CAPS_DEFAULT_INDEX) ? "*" : SarCountryAt(entry.first)->Name;
+
+        if (m_capIndex[entry.first] != SAR_COUNTRY_NONE)
+        {
+            printf("%s: %s is listed more than once\n", path, country);
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        if ((values.size() != 1) &&
+            (values.size() != MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE) &&
+            (values.size() != SAR_POWER_TABLE_ENTRIES))
+        {
+            printf("%s: %s has %zu caps; expected 1, %d or %u\n",
+                   path, country, values.size(), MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE, SAR_POWER_TABLE_ENTRIES);
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            goto exit;
+        }
+
+        for (UINT32 i = 0; i < SAR_POWER_TABLE_ENTRIES; i++)
+        {
+            double cap = values[(values.size() == 1) ? 0 : i % values.size()];
+
+            (&caps.PowerValues[0][0])[i] = (UINT8)floor(cap * 8 + 1e-9);
+        }
+
+        m_capIndex[entry.first] = (UINT32)m_caps.size();
+        m_caps.push_back(caps);
+    }
+
+exit:
+    return hr;
+}
+
+const SAR_POWER_TABLE*
+SarCapTables::Find(
+    UINT16 country
+    ) const
+{
+    UINT32 index = SarCountryIndex(country);
+    UINT32 capIndex = SAR_COUNTRY_NONE;
+
+    if (index != SAR_COUNTRY_NONE)
+    {
+        capIndex = m_capIndex[index];
+    }
+
+    if (capIndex == SAR_COUNTRY_NONE)
+    {
+        capIndex = m_capIndex[SAR_CAPS_DEFAULT_INDEX];
+    }
+
+    return (capIndex == SAR_COUNTRY_NONE) ? nullptr : &m_caps[capIndex];
+}
+
+typedef struct _SAR_VALIDATE_ITEM
+{
+    std::string Path;
+    HRESULT Result;
+    UINT16 Country;
+    const SAR_POWER_TABLE* Caps;
+    UINT64 Violations;
+    SAR_POWER_TABLE PowerTable;
+} SAR_VALIDATE_ITEM;
+
+static
+VOID
+SarValidatePrintItem(
+    _In_ const SAR_VALIDATE_ITEM* item
+    )
+/*++
+
+Routine Description:
+
+    Prints one line for a dump that could not be read, has no caps or exceeds its caps, e.g.
+
+        OVER   PH    D:\dumps\0042  [3,2] 18.125 > 18.000  [3,4] 16.250 > 16.000
+
+    Entries are [row,column], in dBm.
+
+--*/
+{
+    char country[8];
+
+    SarFormatCountryCode(item->Country, country);
+
+    if (FAILED(item->Result))
+    {
+        printf("FAILED 0x%08x %s\n", (UINT32)item->Result, item->Path.c_str());
+    }
+    else if (item->Caps == nullptr)
+    {
+        printf("NOCAPS %-5s %s\n", country, item->Path.c_str());
+    }
+    else if (item->Violations != 0)
+    {
+        printf("OVER   %-5s %s", country, item->Path.c_str());
+        for (UINT32 entry = 0; entry < SAR_POWER_TABLE_ENTRIES; entry++)
+        {
+            if ((item->Violations >> entry) & 1)
+            {
+                printf(" [%u,%u] %.3f > %.3f",
+                       entry / MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE,
+                       entry % MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE,
+                       (&item->PowerTable.PowerValues[0][0])[entry] / 8.0,
+                       (&item->Caps->PowerValues[0][0])[entry] / 8.0);
+            }
+        }
+        printf("\n");
+    }
+}
+
+_Check_return_
+HRESULT
+SarValidateCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    )
+/*++
+
+Routine Description:
+
+    Implements "validate <caps file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]".
+    Every configuration is read and checked against the caps of its GeoCountryString in parallel;
+    one line is printed per dump that is unreadable, has no caps or exceeds them, followed by how
+    often each row and column was over its cap, the tables and violations per regulatory domain and
+    the overall throughput.
+
+Arguments:
+
+    argc - Count of arguments.
+    argv - Array of arguments, starting with the caps file.
+
+Return Value:
+
+    S_OK if every table is within its caps, E_INVALIDARG for a malformed command line, otherwise
+    E_FAIL.
+
+--*/
+{
+    HRESULT hr = S_OK;
+    SarCapTables capTables;
+    UINT32 threadCount = 0;
+    std::vector<std::string> paths;
+    std::vector<SAR_VALIDATE_ITEM> items;
+    UINT64 rowCounts[MAX_NUM_SAR_WIFI_POWER_TABLE] = { 0 };
+    UINT64 columnCounts[MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE] = { 0 };
+    size_t domainTables[SarDomainCount] = { 0 };
+    size_t domainOver[SarDomainCount] = { 0 };
+    size_t failed = 0;
+    size_t uncapped = 0;
+    size_t over = 0;
+    UINT32 poolThreads = 0;
+    double seconds = 0;
+
+    if (argc < 2)
+    {
+        hr = E_INVALIDARG;
+        goto exit;
+    }
+
+    if (argc >= 3)
+    {
+        hr = SarThreadPoolParseThreadCount(argv[2], &threadCount);
+        if (FAILED(hr))
+        {
+            goto exit;
+        }
+    }
+
+    hr = capTables.Load(argv[0]);
+    if (FAILED(hr))
+    {
+        printf("Failed to read caps from %s, hr = 0x%08x\n", argv[0], (UINT32)hr);
+        goto exit;
+    }
+
+    hr = SarBatchCollectConfigs(argv[1], &paths);
+    if (FAILED(hr))
+    {
+        printf("Failed to enumerate targets in %s, hr = 0x%08x\n", argv[1], (UINT32)hr);
+        goto exit;
+    }
+
+    items.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        items[i].Path = std::move(paths[i]);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        SarThreadPool pool(threadCount);
+
+        pool.ParallelFor(items.size(), [&items, &capTables](size_t index)
+        {
+            SAR_VALIDATE_ITEM& item = items[index];
+            SAR_CONFIG_BLOBS blobs = {};
+
+            item.Result = SarConfigLoad(item.Path.c_str(), &blobs);
+            item.Country = blobs.Region.GeoCountryString.AsciiChars;
+            item.Caps = capTables.Find(item.Country);
+            item.Violations = 0;
+            item.PowerTable = blobs.PowerTable;
+
+            if (SUCCEEDED(item.Result) && (item.Caps != nullptr))
+            {
+                item.Violations = SarPowerTableViolations(&blobs.PowerTable, item.Caps);
+            }
+        });
+
+        poolThreads = pool.ThreadCount();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    for (const SAR_VALIDATE_ITEM& item : items)
+    {
+        const SAR_COUNTRY* country = SarCountryFind(item.Country);
+        SAR_REGULATORY_DOMAIN domain = (country != nullptr) ? country->Domain : SarDomainOther;
+
+        SarValidatePrintItem(&item);
+
+        if (FAILED(item.Result))
+        {
+            failed++;
+            continue;
+        }
+
+        domainTables[domain]++;
+
+        if (item.Caps == nullptr)
+        {
+            uncapped++;
+            continue;
+        }
+
+        if (item.Violations != 0)
+        {
+            over++;
+            domainOver[domain]++;
+        }
+
+        for (UINT32 row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+        {
+            UINT64 rowMask = (item.Violations >> (row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE)) &
+                             ((1u << MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE) - 1);
+
+            rowCounts[row] += SarPopulationCount(rowMask);
+            for (UINT32 column = 0; column < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; column++)
+            {
+                columnCounts[column] += (rowMask >> column) & 1;
+            }
+        }
+    }
+
+    printf("\nentries over cap by row:    ");
+    for (UINT32 row = 0; row < MAX_NUM_SAR_WIFI_POWER_TABLE; row++)
+    {
+        printf(" %llu", (unsigned long long)rowCounts[row]);
+    }
+    printf("\nentries over cap by column: ");
+    for (UINT32 column = 0; column < MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE; column++)
+    {
+        printf(" %llu", (unsigned long long)columnCounts[column]);
+    }
+    printf("\ntables by regulatory domain:");
+    for (UINT32 domain = 0; domain < SarDomainCount; domain++)
+    {
+        if (domainTables[domain] != 0)
+        {
+            printf(" %s %zu (%zu over)", SarRegulatoryDomainName((SAR_REGULATORY_DOMAIN)domain), domainTables[domain], domainOver[domain]);
+        }
+    }
+
+    printf("\n\n%zu tables (%zu within caps, %zu over, %zu without caps, %zu unreadable) against %zu cap tables on %u threads in %.3f s: %.0f tables/s (%s)\n",
+           items.size(),
+           items.size() - over - uncapped - failed,
+           over,
+           uncapped,
+           failed,
+           capTables.Count(),
+           poolThreads,
+           seconds,
+           items.size() / ((seconds > 0) ? seconds : 1e-9),
+           SarPowerTableViolationsKernel());
+
+    if ((over != 0) || (uncapped != 0) || (failed != 0))
+    {
+        hr = E_FAIL;
+    }
+
+exit:
+    return hr;
+}
+
+// eof: SarValidate.cpp
+//
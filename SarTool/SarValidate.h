@@ -0,0 +1,110 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    SarValidate.h
+
+Abstract:
+
+    Regulatory-limit validation of SAR_POWER_TABLE against per-country caps.
+
+    A cap table has the shape of SAR_POWER_TABLE (1/8 dBm per entry) and is chosen by
+    REGION_CONFIG_VALUES.GeoCountryString.  A power table is checked against its caps in one pass
+    over all 60 entries: with SSE2 on x86/x64 and NEON on ARM64 the whole table is compared in four
+    16-byte unsigned max/compare steps, and a scalar loop is used elsewhere.  Both produce the same
+    violation mask: bit (row * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE + column) is set for every
+    entry above its cap.
+
+    The caps file lists one entry per country; each entry is an ISO 3166-1 code ("PH", or "*" for
+    countries not listed) followed by caps in dBm, either 1 (every entry), 5 (per column, every row)
+    or 60 (row by row) values.  An entry may span lines, and '#' starts a comment:
+
+        # country   caps in dBm
+        *           20
+        PH          18 18 17.5 17 16
+
+Environment:
+
+    User-mode
+
+--*/
+
+#pragma once
+
+#include "SarConfigFiles.h"
+#include "SarCountry.h"
+
+#include <vector>
+
+static const UINT32 SAR_POWER_TABLE_ENTRIES = MAX_NUM_SAR_WIFI_POWER_TABLE * MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE;
+
+// Slot of the "*" entry, after those indexed by SarCountryIndex.
+//
+static const UINT32 SAR_CAPS_DEFAULT_INDEX = SAR_COUNTRY_COUNT;
+
+// Returns the mask of entries of table above the matching entry of caps.
+//
+UINT64
+SarPowerTableViolations(
+    _In_ const SAR_POWER_TABLE* table,
+    _In_ const SAR_POWER_TABLE* caps
+    );
+
+// The portable implementation, exposed so callers can compare it with the vectorized path.
+//
+UINT64
+SarPowerTableViolationsSoftware(
+    _In_ const SAR_POWER_TABLE* table,
+    _In_ const SAR_POWER_TABLE* caps
+    );
+
+// "SSE2", "NEON" or "scalar".
+//
+LPCSTR
+SarPowerTableViolationsKernel();
+
+class SarCapTables
+{
+public:
+
+    SarCapTables();
+
+    _Check_return_
+    HRESULT
+    Load(
+        _In_z_ LPCSTR path
+        );
+
+    // Returns the caps for a GeoCountryString.AsciiChars value, the "*" caps if the country is not
+    // listed (or not an ISO 3166-1 code), or nullptr if neither is.
+    //
+    const SAR_POWER_TABLE*
+    Find(
+        UINT16 country
+        ) const;
+
+    size_t
+    Count() const
+    {
+        return m_caps.size();
+    }
+
+private:
+
+    std::vector<SAR_POWER_TABLE> m_caps;
+    UINT32 m_capIndex[SAR_CAPS_DEFAULT_INDEX + 1];  // Index into m_caps by country, or SAR_COUNTRY_NONE.
+};
+
+// Implements "validate <caps file> {UEFI | <path> | <file>.sarc | <manifest> | <directory>} [threads]".
+//
+_Check_return_
+HRESULT
+SarValidateCommand(
+    _In_ int argc,
+    _In_reads_(argc) LPSTR argv[]
+    );
+
+// eof: SarValidate.h
+//
@@ -22,8 +22,17 @@ Abstract:
 static const int WDI_SAR_IHV_VERSION_MAJOR = 1;
 static const int WDI_SAR_IHV_VERSION_MINOR = 3;
 
+#ifdef __cplusplus
 static const int MAX_NUM_SAR_WIFI_POWER_TABLE = 12;
 static const int MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE= 5;
+#else
+// C needs constant expressions for the SAR_POWER_TABLE bounds below.
+enum
+{
+    MAX_NUM_SAR_WIFI_POWER_TABLE = 12,
+    MAX_NUM_SAR_WIFI_POWER_VALUES_PER_TABLE = 5
+};
+#endif
 
 // The GUID used to store IHV-specific WLAN configuration variables in UEFI. These variables are
 // only read by the IHV WLAN driver (e.g. REGION_CONFIG_VALUES and SAR_POWER_TABLE.)